@@ -10,6 +10,7 @@ let package = Package(
     .library(name: "AUv3-Support-iOS", targets: ["AUv3Support_iOS"]),
     .library(name: "AUv3-Support-macOS", targets: ["AUv3Support_macOS"]),
     .library(name: "AUv3-DSP-Headers", targets: ["DSPHeaders"]),
+    .library(name: "AUv3-DSP-RealtimeSafety", type: .dynamic, targets: ["DSPHeadersRealtimeSafety"]),
   ],
   targets: [
     .target(
@@ -48,6 +49,10 @@ let package = Package(
         ], .none)
       ]
     ),
+    .target(
+      name: "DSPHeadersRealtimeSafety",
+      dependencies: ["DSPHeaders"]
+    ),
     .target(
       name: "AUv3Support",
       dependencies: [],
@@ -92,6 +97,9 @@ let package = Package(
       dependencies: ["DSPHeaders"],
       exclude: ["Pirkle/README.md",
                 "Pirkle/readme.txt"],
+      cxxSettings: [
+        .define("DSP_HEADERS_REALTIME_SAFETY_CHECKS")
+      ],
       linkerSettings: [
         .linkedFramework("AVFoundation")
       ]
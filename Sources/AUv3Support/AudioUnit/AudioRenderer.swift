@@ -32,4 +32,11 @@ import AVKit
    - parameter state: new state of bypass
    */
   func setBypass(_ state: Bool)
+
+  /**
+   Obtain the processing delay of the kernel, such as that added by oversampling or lookahead.
+
+   - returns: the delay in sample frames at the rendering sample rate
+   */
+  @objc optional func latency() -> Double
 }
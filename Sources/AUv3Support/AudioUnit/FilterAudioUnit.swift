@@ -134,6 +134,11 @@ extension FilterAudioUnit {
   override public var shouldBypassEffect: Bool { didSet { kernel.setBypass(shouldBypassEffect); }}
   /// Announce that the filter can work directly on upstream sample buffers
   override public var canProcessInPlace: Bool { true }
+  /// The processing delay of the kernel in seconds
+  override public var latency: TimeInterval {
+    guard let frames = kernel?.latency?() else { return 0.0 }
+    return frames / outputBus.format.sampleRate
+  }
 
   /// Active preset management. Setting a non-nil value updates the components parameters to hold the values found in
   /// the preset. Factory presets are done internally via the `ParameterSource.usePreset` function. User presets rely
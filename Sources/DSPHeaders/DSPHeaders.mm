@@ -1,18 +1,43 @@
 // Copyright © 2022 Brad Howes. All rights reserved.
 
+#include "DSPHeaders/AlignedArena.hpp"
+#include "DSPHeaders/BatchRenderer.hpp"
 #include "DSPHeaders/Biquad.hpp"
 #include "DSPHeaders/BoolParameter.hpp"
 #include "DSPHeaders/BufferFacet.hpp"
 #include "DSPHeaders/ConstMath.hpp"
 #include "DSPHeaders/DelayBuffer.hpp"
 #include "DSPHeaders/DSP.hpp"
+#include "DSPHeaders/DynamicsProcessor.hpp"
 #include "DSPHeaders/EventProcessor.hpp"
+#include "DSPHeaders/FFT.hpp"
+#include "DSPHeaders/FormatAdapter.hpp"
 #include "DSPHeaders/LFO.hpp"
+#include "DSPHeaders/Meter.hpp"
 #include "DSPHeaders/MillisecondsParameter.hpp"
+#include "DSPHeaders/Mixer.hpp"
+#include "DSPHeaders/OfflineRenderer.hpp"
+#include "DSPHeaders/Oversampler.hpp"
+#include "DSPHeaders/ParameterAutomation.hpp"
+#include "DSPHeaders/ParameterStore.hpp"
+#include "DSPHeaders/ParameterTimeline.hpp"
+#include "DSPHeaders/PartitionedConvolver.hpp"
 #include "DSPHeaders/PercentageParameter.hpp"
 #include "DSPHeaders/PhaseShifter.hpp"
 #include "DSPHeaders/RampingParameter.hpp"
+#include "DSPHeaders/RealtimeSafety.hpp"
+#include "DSPHeaders/RenderProfiler.hpp"
+#include "DSPHeaders/RingBuffer.hpp"
 #include "DSPHeaders/SampleBuffer.hpp"
+#include "DSPHeaders/SampleConversion.hpp"
+#include "DSPHeaders/SampleRateConverter.hpp"
+#include "DSPHeaders/ScratchPool.hpp"
+#include "DSPHeaders/SmallChannelArray.hpp"
+#include "DSPHeaders/SpectralProcessor.hpp"
+#include "DSPHeaders/SpectrumAnalyzer.hpp"
+#include "DSPHeaders/SwappableConvolver.hpp"
+#include "DSPHeaders/TruePeakLimiter.hpp"
+#include "DSPHeaders/WaveFile.hpp"
 
 using namespace DSPHeaders;
 using namespace DSPHeaders::DSP;
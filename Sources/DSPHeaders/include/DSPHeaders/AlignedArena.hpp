@@ -0,0 +1,154 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <cstddef>
+#import <cstdlib>
+#import <cstring>
+#import <new>
+#import <utility>
+
+#import <sys/mman.h>
+
+namespace DSPHeaders {
+
+/**
+ A single block of memory aligned to a cache line, from which fixed-size pieces are handed out with a bump pointer.
+ Used to hold all of the sample buffers of a kernel in one allocation made when the rendering format is set, instead of
+ many separate allocations with no alignment guarantee.
+
+ The block is zero-filled when allocated, which also touches every page so that the first render does not take page
+ faults. Optionally the block can be locked into physical memory with `mlock` so that it is never paged out; if locking
+ fails (for instance, due to resource limits) the block is still usable and `isLocked` reports false.
+
+ All pieces handed out by `take` are invalidated by the next `reserve` or `release` call.
+ */
+class AlignedArena {
+public:
+
+  /// The alignment of the block and of every piece handed out by `take`
+  inline static constexpr size_t Alignment = 64;
+
+  /**
+   Round a byte count up to a multiple of `Alignment`.
+
+   @param size the number of bytes
+   @returns the rounded value
+   */
+  static constexpr size_t alignedSize(size_t size) noexcept { return (size + Alignment - 1) & ~(Alignment - 1); }
+
+  AlignedArena() noexcept = default;
+
+  ~AlignedArena() noexcept { release(); }
+
+  AlignedArena(const AlignedArena&) = delete;
+  AlignedArena& operator =(const AlignedArena&) = delete;
+
+  AlignedArena(AlignedArena&& rhs) noexcept
+  : block_{rhs.block_}, capacity_{rhs.capacity_}, used_{rhs.used_}, locked_{rhs.locked_}
+  {
+    rhs.block_ = nullptr;
+    rhs.capacity_ = 0;
+    rhs.used_ = 0;
+    rhs.locked_ = false;
+  }
+
+  AlignedArena& operator =(AlignedArena&& rhs) noexcept {
+    if (this != &rhs) {
+      release();
+      std::swap(block_, rhs.block_);
+      std::swap(capacity_, rhs.capacity_);
+      std::swap(used_, rhs.used_);
+      std::swap(locked_, rhs.locked_);
+    }
+    return *this;
+  }
+
+  /**
+   Make sure that the arena holds at least the given number of bytes, and forget all pieces handed out so far. The
+   existing block is reused if it is large enough, otherwise it is replaced. In either case the memory is zero-filled.
+
+   @param size the number of bytes to hold
+   @param lockPages if true, lock the block into physical memory
+   @throws std::bad_alloc if the memory could not be allocated
+   */
+  void reserve(size_t size, bool lockPages = false) {
+    size = alignedSize(size);
+    if (size > capacity_) {
+      release();
+      if (size > 0) {
+        void* block = nullptr;
+        if (posix_memalign(&block, Alignment, size) != 0) throw std::bad_alloc();
+        block_ = static_cast<std::byte*>(block);
+        capacity_ = size;
+      }
+    }
+
+    used_ = 0;
+    if (block_ != nullptr) {
+      memset(block_, 0, capacity_);
+      if (lockPages && !locked_) {
+        locked_ = mlock(block_, capacity_) == 0;
+      } else if (!lockPages && locked_) {
+        munlock(block_, capacity_);
+        locked_ = false;
+      }
+    }
+  }
+
+  /**
+   Free the block.
+   */
+  void release() noexcept {
+    if (block_ != nullptr) {
+      if (locked_) munlock(block_, capacity_);
+      free(block_);
+    }
+    block_ = nullptr;
+    capacity_ = 0;
+    used_ = 0;
+    locked_ = false;
+  }
+
+  /**
+   Forget all pieces handed out so far without touching the memory.
+   */
+  void reset() noexcept { used_ = 0; }
+
+  /**
+   Obtain a piece of the block for `count` values of type T. The piece starts on an `Alignment` boundary. The memory is
+   zero-filled when the block is reserved but the values are not constructed, so T should be a trivial type.
+
+   @param count the number of values to hold
+   @returns pointer to the first value or nullptr if there is not enough space left in the block
+   */
+  template <typename T>
+  T* take(size_t count) noexcept {
+    static_assert(alignof(T) <= Alignment, "type alignment is larger than arena alignment");
+    auto size = alignedSize(count * sizeof(T));
+    if (size > capacity_ - used_) return nullptr;
+    auto ptr = block_ + used_;
+    used_ += size;
+    return reinterpret_cast<T*>(ptr);
+  }
+
+  /// @returns the number of bytes in the block
+  size_t capacity() const noexcept { return capacity_; }
+
+  /// @returns the number of bytes handed out by `take`
+  size_t size() const noexcept { return used_; }
+
+  /// @returns true if the block is locked into physical memory
+  bool isLocked() const noexcept { return locked_; }
+
+  /// @returns pointer to the start of the block
+  const void* data() const noexcept { return block_; }
+
+private:
+  std::byte* block_{nullptr};
+  size_t capacity_{0};
+  size_t used_{0};
+  bool locked_{false};
+};
+
+} // end namespace DSPHeaders
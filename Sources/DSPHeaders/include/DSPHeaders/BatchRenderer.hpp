@@ -0,0 +1,278 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <atomic>
+#import <chrono>
+#import <deque>
+#import <functional>
+#import <map>
+#import <memory>
+#import <mutex>
+#import <string>
+#import <thread>
+#import <vector>
+
+#import "DSPHeaders/OfflineRenderer.hpp"
+#import "DSPHeaders/ParameterAutomation.hpp"
+#import "DSPHeaders/WaveFile.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Renders many offline jobs (for instance, every preset against every input file) across a pool of worker threads.
+
+ Each worker owns one kernel instance and one `OfflineRenderer`, both of which are reused for every job the worker
+ runs: the kernel is reconfigured with `setRenderingFormat` and released with `renderingStopped` by the renderer, and
+ the renderer keeps its sample buffers between jobs. Input files are opened once per `run` and shared read-only by all
+ workers through their memory mappings.
+
+ Jobs are dealt out to per-worker queues in contiguous runs. A worker takes jobs from the front of its own queue, and
+ when that is empty it steals from the back of another worker's queue, so workers that draw short jobs do not sit idle
+ while others still have work. Jobs are coarse (a whole file each), so a mutex per queue is all the synchronization
+ needed; the queues are only touched once per job.
+
+ A job that fails does not stop the batch. Its error message is recorded in its `JobResult`.
+ */
+template <typename Kernel>
+class BatchRenderer {
+public:
+
+  /// Function that creates a kernel for a worker. Called on the worker's thread.
+  using KernelFactory = std::function<std::unique_ptr<Kernel>()>;
+
+  /// Function that configures a kernel for a job, such as by applying a preset.
+  using Preset = std::function<void(Kernel&)>;
+
+  /// Description of one render.
+  struct Job {
+    /// The location of the WAVE file to render
+    std::string inputPath;
+    /// The location of the WAVE file to write
+    std::string outputPath;
+    /// Optional kernel configuration to apply before rendering. Kernels are reused, so this should set all of the
+    /// state that the job depends on.
+    Preset preset{};
+    /// Parameter changes to apply during the render
+    ParameterAutomation automation{};
+  };
+
+  /// Outcome of one job.
+  struct JobResult {
+    /// The render summary. Only valid if the job succeeded.
+    OfflineRenderer::Result render{};
+    /// The index of the worker that ran the job
+    size_t worker{0};
+    /// Description of the failure, empty if the job succeeded
+    std::string error{};
+
+    /// @returns true if the job succeeded
+    bool succeeded() const noexcept { return error.empty(); }
+  };
+
+  /// Summary of a `run`.
+  struct Statistics {
+    /// The number of jobs run
+    size_t jobCount{0};
+    /// The number of jobs that failed
+    size_t failedCount{0};
+    /// The number of jobs that were run by a worker other than the one they were dealt to
+    size_t stolenCount{0};
+    /// The number of worker threads used
+    size_t workerCount{0};
+    /// The total number of frames rendered
+    uint64_t frameCount{0};
+    /// The total duration of the audio rendered
+    double audioSeconds{0.0};
+    /// The wall-clock time taken by the batch
+    double elapsedSeconds{0.0};
+
+    /// @returns how many seconds of audio were rendered per second of wall-clock time
+    double realtimeFactor() const noexcept { return elapsedSeconds > 0.0 ? audioSeconds / elapsedSeconds : 0.0; }
+
+    /// @returns the number of frames rendered per second of wall-clock time
+    double framesPerSecond() const noexcept { return elapsedSeconds > 0.0 ? double(frameCount) / elapsedSeconds : 0.0; }
+  };
+
+  /**
+   Construct new instance.
+
+   @param workerCount the number of worker threads to use. If 0, use one per hardware thread.
+   @param options the settings to use for each render
+   @param factory function that creates the kernel for a worker. If not set, kernels are default-constructed.
+   */
+  explicit BatchRenderer(size_t workerCount = 0, const OfflineRenderer::Options& options = OfflineRenderer::Options(),
+                         KernelFactory factory = KernelFactory())
+  : factory_{factory ? std::move(factory) : []() { return std::make_unique<Kernel>(); }}
+  {
+    if (workerCount == 0) workerCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    workers_.reserve(workerCount);
+    for (size_t index = 0; index < workerCount; ++index) {
+      workers_.push_back(std::make_unique<Worker>(options));
+    }
+  }
+
+  /// @returns the number of worker threads
+  size_t workerCount() const noexcept { return workers_.size(); }
+
+  /**
+   Add a job to the batch.
+
+   @param job the job to add
+   @returns the index of the job, which is also the index of its entry in `results`
+   */
+  size_t add(Job job) {
+    jobs_.push_back(std::move(job));
+    return jobs_.size() - 1;
+  }
+
+  /// @returns the number of jobs in the batch
+  size_t size() const noexcept { return jobs_.size(); }
+
+  /**
+   Remove all jobs and results. The workers and their kernels are kept for the next batch.
+   */
+  void clear() noexcept {
+    jobs_.clear();
+    results_.clear();
+  }
+
+  /**
+   Run all of the jobs in the batch, blocking until they are done.
+
+   @returns summary of the batch
+   */
+  Statistics run() {
+    results_.assign(jobs_.size(), JobResult());
+    auto startTime = std::chrono::steady_clock::now();
+    openInputs();
+    deal();
+
+    std::atomic<size_t> stolenCount{0};
+    std::vector<std::thread> threads;
+    threads.reserve(workers_.size());
+    for (size_t index = 0; index < workers_.size(); ++index) {
+      threads.emplace_back([this, index, &stolenCount]() { work(index, stolenCount); });
+    }
+    for (auto& thread : threads) thread.join();
+    inputs_.clear();
+
+    Statistics statistics;
+    statistics.jobCount = jobs_.size();
+    statistics.stolenCount = stolenCount.load();
+    statistics.workerCount = workers_.size();
+    for (const auto& result : results_) {
+      if (!result.succeeded()) {
+        ++statistics.failedCount;
+      } else {
+        statistics.frameCount += result.render.frameCount;
+        statistics.audioSeconds += result.render.audioSeconds;
+      }
+    }
+    statistics.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return statistics;
+  }
+
+  /// @returns the outcomes of the jobs in the last `run`, in the order the jobs were added
+  const std::vector<JobResult>& results() const noexcept { return results_; }
+
+private:
+
+  struct Worker {
+    explicit Worker(const OfflineRenderer::Options& options) : renderer{options} {}
+
+    std::mutex mutex{};
+    std::deque<size_t> queue{};
+    std::unique_ptr<Kernel> kernel{};
+    OfflineRenderer renderer;
+  };
+
+  struct Input {
+    std::unique_ptr<WaveFileReader> reader{};
+    std::string error{};
+  };
+
+  void openInputs() {
+    inputs_.clear();
+    for (const auto& job : jobs_) {
+      auto [pos, added] = inputs_.try_emplace(job.inputPath);
+      if (!added) continue;
+      try {
+        pos->second.reader = std::make_unique<WaveFileReader>(job.inputPath);
+      } catch (const std::exception& error) {
+        pos->second.error = error.what();
+      }
+    }
+  }
+
+  /// Hand out the jobs in contiguous runs so that a worker tends to render consecutive jobs.
+  void deal() {
+    auto workerCount = workers_.size();
+    for (size_t index = 0; index < workerCount; ++index) {
+      auto& queue = workers_[index]->queue;
+      queue.clear();
+      for (size_t job = index * jobs_.size() / workerCount; job < (index + 1) * jobs_.size() / workerCount; ++job) {
+        queue.push_back(job);
+      }
+    }
+  }
+
+  bool takeOwn(Worker& worker, size_t& job) {
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.queue.empty()) return false;
+    job = worker.queue.front();
+    worker.queue.pop_front();
+    return true;
+  }
+
+  bool steal(size_t thief, size_t& job) {
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+      auto& victim = *workers_[(thief + offset) % workers_.size()];
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      if (victim.queue.empty()) continue;
+      job = victim.queue.back();
+      victim.queue.pop_back();
+      return true;
+    }
+    return false;
+  }
+
+  void work(size_t index, std::atomic<size_t>& stolenCount) {
+    auto& worker = *workers_[index];
+    size_t job;
+    while (true) {
+      if (!takeOwn(worker, job)) {
+        if (!steal(index, job)) return;
+        stolenCount.fetch_add(1, std::memory_order_relaxed);
+      }
+      runJob(worker, index, job);
+    }
+  }
+
+  void runJob(Worker& worker, size_t index, size_t jobIndex) noexcept {
+    auto& job = jobs_[jobIndex];
+    auto& result = results_[jobIndex];
+    result.worker = index;
+    try {
+      const auto& input = inputs_.at(job.inputPath);
+      if (!input.reader) throw std::runtime_error(input.error);
+      if (!worker.kernel) worker.kernel = factory_();
+      if (job.preset) job.preset(*worker.kernel);
+      result.render = worker.renderer.render(*worker.kernel, *input.reader, job.outputPath, job.automation);
+    } catch (const std::exception& error) {
+      result.error = error.what();
+      if (result.error.empty()) result.error = "unknown error";
+    } catch (...) {
+      result.error = "unknown error";
+    }
+  }
+
+  KernelFactory factory_;
+  std::vector<std::unique_ptr<Worker>> workers_{};
+  std::vector<Job> jobs_{};
+  std::vector<JobResult> results_{};
+  std::map<std::string, Input> inputs_{};
+};
+
+} // end namespace DSPHeaders
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#import <cassert>
+#import <stdexcept>
 #import <string>
 
 #import <os/log.h>
@@ -15,6 +17,11 @@ namespace DSPHeaders {
 
 /**
  Provides a simple view of an N-channel AudioBufferList as a collection of AUValue pointers.
+
+ There are two sets of methods for working with the underlying buffers. The checked methods (`setBufferList`,
+ `setOffset`, `setFrameCount`, `copyInto`) validate their state and throw `std::runtime_error` on failure. The
+ `Unchecked` variants are meant for use on the render thread: they never throw and only validate via `assert` in
+ debug builds. Any validation must be done before rendering starts, such as in `EventProcessor::setRenderingFormat`.
  */
 struct BufferFacet {
 
@@ -24,14 +31,17 @@ struct BufferFacet {
   BufferFacet() noexcept {}
 
   /**
-   Set the expected number of channels to support during rendering. The goal is to not encounter any memory
-   allocations while rendering, so this *must* be called before rendering is started.
+   Set the expected number of channels to support during rendering. This *must* be called before rendering is started.
+   The count cannot be more than `BusBuffers::MaxChannelCount`.
 
    @param channelCount the number of channels to expect
+   @throws std::runtime_error if the count is more than `BusBuffers::MaxChannelCount`
    */
-  void setChannelCount(AUAudioChannelCount channelCount) noexcept
+  void setChannelCount(AUAudioChannelCount channelCount)
   {
-    pointers_.reserve(channelCount);
+    if (channelCount > BusBuffers::MaxChannelCount) {
+      throw std::runtime_error("channelCount > BusBuffers::MaxChannelCount");
+    }
     pointers_.resize(channelCount);
   }
 
@@ -49,35 +59,63 @@ struct BufferFacet {
    @param inPlaceSource if not nullptr, use their mData elements for storage
    */
   void setBufferList(AudioBufferList* bufferList, AudioBufferList* inPlaceSource = nullptr) {
+    if (bufferList->mBuffers[0].mData == nullptr && inPlaceSource == nullptr) {
+      bufferList_ = bufferList;
+      throw std::runtime_error("inPlaceSource == nullptr");
+    }
+
+    size_t numBuffers = bufferList->mNumberBuffers;
+    if (numBuffers != pointers_.size()) {
+      bufferList_ = bufferList;
+      throw std::runtime_error("numBuffers != pointers_.size()");
+    }
+
+    setBufferListUnchecked(bufferList, inPlaceSource);
+  }
+
+  /**
+   Render-thread version of `setBufferList`. The caller must guarantee that `bufferList` has `channelCount()` buffers,
+   and that `inPlaceSource` is not nullptr if the `bufferList` buffers have no storage.
+
+   @param bufferList the collection of buffers to use
+   @param inPlaceSource if not nullptr, use their mData elements for storage
+   */
+  void setBufferListUnchecked(AudioBufferList* bufferList, AudioBufferList* inPlaceSource = nullptr) noexcept {
+    assert(bufferList != nullptr && bufferList->mNumberBuffers == pointers_.size());
     bufferList_ = bufferList;
     if (bufferList->mBuffers[0].mData == nullptr) {
-      if (inPlaceSource == nullptr) {
-        throw std::runtime_error("inPlaceSource == nullptr");
-      }
-      assert(inPlaceSource != nullptr);
+      assert(inPlaceSource != nullptr && inPlaceSource->mNumberBuffers == bufferList->mNumberBuffers);
       for (UInt32 channel = 0; channel < bufferList->mNumberBuffers; ++channel) {
         bufferList->mBuffers[channel].mData = inPlaceSource->mBuffers[channel].mData;
       }
     }
 
-    size_t numBuffers = bufferList_->mNumberBuffers;
-    if (numBuffers != pointers_.size()) {
-      throw std::runtime_error("numBuffers != pointers_.size()");
-    }
-
-    setOffset(0);
+    setOffsetUnchecked(0);
   }
 
   /**
-   Set the facet to start at the given offset into the source buffers. Once done, the std::vector AUValue
+   Set the facet to start at the given offset into the source buffers. Once done, the AUValue
    pointers will start `offset` samples into the underlying buffer.
 
    @param offset number of samples to offset.
    */
   void setOffset(AUAudioFrameCount offset) {
     validateBufferList();
-    for (size_t channel = 0; channel < pointers_.size(); ++channel) {
-      pointers_[channel] = static_cast<AUValue*>(bufferList_->mBuffers[channel].mData) + offset;
+    setOffsetUnchecked(offset);
+  }
+
+  /**
+   Render-thread version of `setOffset`. The facet must be linked to a buffer list.
+
+   @param offset number of samples to offset.
+   */
+  void setOffsetUnchecked(AUAudioFrameCount offset) noexcept {
+    assert(bufferList_ != nullptr);
+    auto buffers = bufferList_->mBuffers;
+    auto pointers = pointers_.data();
+    auto size = pointers_.size();
+    for (size_t channel = 0; channel < size; ++channel) {
+      pointers[channel] = static_cast<AUValue*>(buffers[channel].mData) + offset;
     }
   }
 
@@ -89,6 +127,16 @@ struct BufferFacet {
    */
   void setFrameCount(AUAudioFrameCount frameCount) {
     validateBufferList();
+    setFrameCountUnchecked(frameCount);
+  }
+
+  /**
+   Render-thread version of `setFrameCount`. The facet must be linked to a buffer list.
+
+   @param frameCount number of samples in a buffer.
+   */
+  void setFrameCountUnchecked(AUAudioFrameCount frameCount) noexcept {
+    assert(bufferList_ != nullptr);
     UInt32 byteSize = frameCount * sizeof(AUValue);
     for (UInt32 channel = 0; channel < bufferList_->mNumberBuffers; ++channel) {
       bufferList_->mBuffers[channel].mDataByteSize = byteSize;
@@ -119,6 +167,21 @@ struct BufferFacet {
    */
   void copyInto(BufferFacet& destination, AUAudioFrameCount offset, AUAudioFrameCount frameCount) const {
     validateBufferList();
+    destination.validateBufferList();
+    copyIntoUnchecked(destination, offset, frameCount);
+  }
+
+  /**
+   Render-thread version of `copyInto`. Both facets must be linked to buffer lists with the same number of buffers.
+
+   @param destination the buffer to copy into
+   @param offset the offset to apply before writing
+   @param frameCount the number of samples to write
+   */
+  void copyIntoUnchecked(BufferFacet& destination, AUAudioFrameCount offset,
+                         AUAudioFrameCount frameCount) const noexcept {
+    assert(bufferList_ != nullptr && destination.bufferList_ != nullptr);
+    assert(bufferList_->mNumberBuffers == destination.bufferList_->mNumberBuffers);
     auto outputs = destination.bufferList_;
     for (UInt32 channel = 0; channel < bufferList_->mNumberBuffers; ++channel) {
       if (bufferList_->mBuffers[channel].mData == outputs->mBuffers[channel].mData) {
@@ -149,7 +212,7 @@ private:
   }
 
   AudioBufferList* bufferList_{nullptr};
-  std::vector<AUValue*> pointers_{};
+  BusBuffers::ChannelPointers pointers_{};
 };
 
 } // end namespace DSPHeaders
@@ -2,29 +2,57 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 
 #import <AudioToolbox/AudioToolbox.h>
 
+#import "DSPHeaders/SmallChannelArray.hpp"
+
 namespace DSPHeaders {
 
 /**
  Grouping of audio buffers that are always worked on together as a bus. Most of the time, a bus will have 1 (mono) or
  two (stereo) channels of audio. There are methods specific to mono and stereo as well as general-purpose methods for
  treating them all the same or as alternating variations like stereo but as even (0/L) and odd (1/R) pairs.
+
+ The channel pointers are held by value in inline storage, so an instance is cheap to copy and pass by value, and the
+ pointers are not reloaded from memory on each sample access. The block methods assume that the sample buffers of
+ different channels do not overlap each other or the source samples.
  */
 class BusBuffers
 {
 public:
 
+  /// The maximum number of channels in a bus. This matches `FilterAudioUnit.maxNumberOfChannels`.
+  inline static constexpr size_t MaxChannelCount = 8;
+
+  /// Inline collection of channel sample pointers.
+  using ChannelPointers = SmallChannelArray<AUValue*, MaxChannelCount>;
+
   /**
    Construct a new instance using the given collection of AUValue pointers.
 
    @param buffers the AUValue pointers to use
    */
-  explicit BusBuffers(std::vector<AUValue*>& buffers) noexcept : buffers_{buffers} {}
+  explicit BusBuffers(const ChannelPointers& buffers) noexcept : buffers_{buffers} {}
+
+  /**
+   Construct a new instance using the given collection of AUValue pointers. Only the first `MaxChannelCount` pointers
+   are used.
+
+   @param buffers the AUValue pointers to use
+   */
+  explicit BusBuffers(const std::vector<AUValue*>& buffers) noexcept : buffers_{}
+  {
+    assert(buffers.size() <= MaxChannelCount);
+    buffers_.resize(std::min(buffers.size(), MaxChannelCount));
+    std::copy(buffers.begin(), buffers.begin() + ptrdiff_t(buffers_.size()), buffers_.begin());
+  }
 
   /// @returns true if the buffer collection is usable
   bool isValid() const noexcept { return !buffers_.empty(); }
@@ -90,6 +118,67 @@ public:
     }
   }
 
+  /**
+   Add a block of samples to a mono collection.
+
+   @param frame the first frame to update
+   @param samples the samples to add
+   @param frameCount the number of samples to add
+   */
+  void addMono(AUAudioFrameCount frame, const AUValue* samples, AUAudioFrameCount frameCount) noexcept
+  {
+    assert(isMono());
+    addBlock(buffers_[0] + frame, samples, frameCount);
+  }
+
+  /**
+   Add blocks of samples to a stereo collection.
+
+   @param frame the first frame to update
+   @param leftSamples the samples to add to the left channel
+   @param rightSamples the samples to add to the right channel
+   @param frameCount the number of samples to add
+   */
+  void addStereo(AUAudioFrameCount frame, const AUValue* leftSamples, const AUValue* rightSamples,
+                 AUAudioFrameCount frameCount) noexcept
+  {
+    assert(isStereo());
+    addBlock(buffers_[0] + frame, leftSamples, frameCount);
+    addBlock(buffers_[1] + frame, rightSamples, frameCount);
+  }
+
+  /**
+   Add a block of samples to all buffers in the collection.
+
+   @param frame the first frame to update
+   @param samples the samples to add
+   @param frameCount the number of samples to add
+   */
+  void addAll(AUAudioFrameCount frame, const AUValue* samples, AUAudioFrameCount frameCount) noexcept
+  {
+    for (auto buffer : buffers_) {
+      addBlock(buffer + frame, samples, frameCount);
+    }
+  }
+
+  /**
+   Add blocks of samples to all buffers in the collection, using one block for "even" channels and another for "odd"
+   channels.
+
+   @param frame the first frame to update
+   @param evenSamples the samples to add to even (0 (L), 2, 4...) channels
+   @param oddSamples the samples to add to odd (1 (R), 3, 5...) channels
+   @param frameCount the number of samples to add
+   */
+  void addAlternating(AUAudioFrameCount frame, const AUValue* evenSamples, const AUValue* oddSamples,
+                      AUAudioFrameCount frameCount) noexcept
+  {
+    size_t size{buffers_.size()};
+    for (size_t index = 0; index < size; ++index) {
+      addBlock(buffers_[index] + frame, (index % 2) ? oddSamples : evenSamples, frameCount);
+    }
+  }
+
   /**
    Obtain the sample pointer for the given channel index.
 
@@ -99,7 +188,8 @@ public:
   AUValue* operator[](size_t index) const noexcept { return buffers_[index]; }
 
   /**
-   Obtain the modifiable sample pointer for the given channel index.
+   Obtain the modifiable sample pointer for the given channel index. Note that this only changes the pointer held by
+   this instance.
 
    @param index the index of the channel to get
    @returns reference to the sample pointer at the given channel index
@@ -120,6 +210,32 @@ public:
     }
   }
 
+  /**
+   Obtain the largest sample magnitude found in all of the channels. Compares the bit patterns of the magnitudes as
+   integers (which order the same way as the float values) so that the loop is a simple integer max that the compiler
+   can vectorize. A NaN is reported as a very large magnitude.
+
+   @param frameCount the number of frames to scan
+   @returns the largest absolute sample value
+   */
+  AUValue peakMagnitude(AUAudioFrameCount frameCount) const noexcept
+  {
+    uint32_t peak = 0;
+    for (size_t channel = 0; channel < buffers_.size(); ++channel) {
+      const AUValue* samples = buffers_[channel];
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        uint32_t bits;
+        memcpy(&bits, samples + frame, sizeof(bits));
+        bits &= 0x7FFFFFFF;
+        peak = bits > peak ? bits : peak;
+      }
+    }
+
+    AUValue value;
+    memcpy(&value, &peak, sizeof(value));
+    return value;
+  }
+
   /// @returns number of channel buffers
   size_t size() const noexcept { return buffers_.size(); }
 
@@ -130,7 +246,15 @@ public:
   AUValue** data() noexcept { return buffers_.data(); }
 
 private:
-  std::vector<AUValue*>& buffers_;
+
+  static void addBlock(AUValue* __restrict out, const AUValue* __restrict in, AUAudioFrameCount frameCount) noexcept
+  {
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      out[frame] += in[frame];
+    }
+  }
+
+  ChannelPointers buffers_;
 };
 
 } // end namespace
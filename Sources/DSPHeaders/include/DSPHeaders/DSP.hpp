@@ -5,6 +5,8 @@
 #import <array>
 #import <algorithm>
 #import <cmath>
+#import <cstdint>
+#import <cstring>
 
 #import "DSPHeaders/ConstMath.hpp"
 
@@ -69,6 +71,143 @@ template <typename T> constexpr auto parabolicSine(T angle) noexcept {
   return Py * ConstMath::abs<T>(y) - Py + y;
 }
 
+/**
+ Estimate log2() of a positive value. The value is split into a power of 2 and a mantissa in [√½, √2), and the log of
+ the mantissa comes from the first four terms of the atanh series. The worst-case deviation from std::log2 is ~2e-7
+ (plus the rounding of the float result), and there are no branches or calls so a loop over a block of values can be
+ vectorized. Values at or below 1e-30 are treated as 1e-30.
+
+ @param value the value to work on
+ @returns approximate log2 value
+ */
+inline float fastLog2(float value) noexcept {
+  value = std::fmax(value, 1.0e-30f);
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  auto exponent = int32_t((bits >> 23) & 0xFF) - 127;
+  bits = (bits & 0x007FFFFF) | 0x3F800000;
+  float mantissa;
+  std::memcpy(&mantissa, &bits, sizeof(mantissa));
+
+  // Move the mantissa into [√½, √2) so that the series argument stays small.
+  auto high = mantissa > float(M_SQRT2);
+  mantissa = high ? mantissa * 0.5f : mantissa;
+  exponent += high ? 1 : 0;
+
+  auto t = (mantissa - 1.0f) / (mantissa + 1.0f);
+  auto t2 = t * t;
+  auto series = t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+  return float(exponent) + series * float(2.0 / M_LN2);
+}
+
+/**
+ Estimate exp2() of a value. The value is split into an integer which becomes the exponent bits of the result, and a
+ fraction whose power of 2 comes from a 6th-order Taylor series around 0.5. The worst-case relative deviation from
+ std::exp2 is ~3e-7. Values are limited to [-126, 127].
+
+ @param value the value to work on
+ @returns approximate exp2 value
+ */
+inline float fastExp2(float value) noexcept {
+  value = std::fmin(std::fmax(value, -126.0f), 127.0f);
+  auto whole = std::floor(value);
+  auto x = (value - whole - 0.5f) * float(M_LN2);
+  auto fraction = float(M_SQRT2) * (1.0f + x * (1.0f + x * (1.0f / 2.0f + x * (1.0f / 6.0f + x * (1.0f / 24.0f +
+                  x * (1.0f / 120.0f + x * (1.0f / 720.0f)))))));
+  auto bits = uint32_t(int32_t(whole) + 127) << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return fraction * scale;
+}
+
+/**
+ Estimate atan2() of a point. The ratio of the smaller to the larger coordinate magnitude is brought into
+ [0, tan(π/8)] -- using the identity atan(a) = π/4 + atan((a - 1) / (a + 1)) for larger ratios -- where a 9th-order
+ odd polynomial (the one from Cephes `atanf`) is accurate to float precision. The result is then moved into the right
+ octant. The worst-case deviation from std::atan2 is ~3e-7 radians, and there is one division and no branches or
+ calls, so a loop over a block of values can be vectorized. Returns 0 for the origin.
+
+ @param y the vertical coordinate
+ @param x the horizontal coordinate
+ @returns approximate angle in radians in [-π, π]
+ */
+inline float fastAtan2(float y, float x) noexcept {
+  auto ax = std::fabs(x);
+  auto ay = std::fabs(y);
+  auto low = ax < ay ? ax : ay;
+  auto high = ax < ay ? ay : ax;
+  auto reduce = low > 0.41421356f * high;
+  auto denominator = high + (reduce ? low : 0.0f);
+  auto ratio = (low - (reduce ? high : 0.0f)) / (denominator > 1.0e-37f ? denominator : 1.0e-37f);
+  auto z = ratio * ratio;
+  auto angle = ((((8.05374449538e-2f * z - 1.38776856032e-1f) * z + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z *
+                ratio + ratio) + (reduce ? float(M_PI_4) : 0.0f);
+  angle = ay > ax ? float(M_PI_2) - angle : angle;
+  angle = x < 0.0f ? float(M_PI) - angle : angle;
+  return std::copysign(angle, y);
+}
+
+/**
+ Estimate both sin() and cos() of an angle. The angle is reduced to [-π/4, π/4] by subtracting the nearest multiple of
+ π/2 (in three parts to keep the precision), and the polynomials from Cephes `sinf` and `cosf` give the sine and cosine
+ of what remains, which are then swapped and negated for the quadrant. The worst-case deviation from std::sin and
+ std::cos is ~1e-7 for angles within ±1000 radians, and there are no branches or calls so a loop over a block of values
+ can be vectorized.
+
+ @param angle the angle in radians
+ @param sine where to store the sine
+ @param cosine where to store the cosine
+ */
+inline void fastSinCos(float angle, float& sine, float& cosine) noexcept {
+  auto quadrant = int32_t(angle * float(M_2_PI) + (angle < 0.0f ? -0.5f : 0.5f));
+  auto whole = float(quadrant);
+  auto x = ((angle - whole * 1.5703125f) - whole * 4.837512969970703125e-4f) - whole * 7.549789954891882e-8f;
+  auto z = x * x;
+  auto s = ((-1.9515295891e-4f * z + 8.3321608736e-3f) * z - 1.6666654611e-1f) * z * x + x;
+  auto c = ((2.443315711809948e-5f * z - 1.388731625493765e-3f) * z + 4.166664568298827e-2f) * z * z - 0.5f * z + 1.0f;
+  auto swap = (quadrant & 1) != 0;
+  auto sinValue = swap ? c : s;
+  auto cosValue = swap ? s : c;
+  sine = (quadrant & 2) != 0 ? -sinValue : sinValue;
+  cosine = ((quadrant + 1) & 2) != 0 ? -cosValue : cosValue;
+}
+
+/**
+ Compute the modified Bessel function of the first kind and order zero from its power series. Used to make Kaiser
+ windows.
+
+ @param x the value to evaluate at
+ @returns I0(x)
+ */
+inline double besselI0(double x) noexcept {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 50; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+    if (term < sum * 1.0e-12) break;
+  }
+  return sum;
+}
+
+/**
+ Compute one tap of a lowpass filter made by multiplying a sinc by a Kaiser window. Taps are given by their offset from
+ the center of the filter, which need not be a whole number of samples, so the same function serves half-band filters
+ and the phases of polyphase interpolators. The taps are not normalized.
+
+ @param offset the distance of the tap from the center of the filter in samples
+ @param cutoff the cutoff frequency as a fraction of the Nyquist frequency
+ @param halfWidth the distance from the center at which the window ends
+ @param beta the shape of the window. Larger values give more stopband attenuation and a wider transition band.
+ @returns the value of the tap
+ */
+inline double kaiserSinc(double offset, double cutoff, double halfWidth, double beta) noexcept {
+  auto x = M_PI * cutoff * offset;
+  auto sinc = x == 0.0 ? 1.0 : std::sin(x) / x;
+  auto ratio = std::min(1.0, std::abs(offset) / halfWidth);
+  return cutoff * sinc * besselI0(beta * std::sqrt(1.0 - ratio * ratio)) / besselI0(beta);
+}
+
 namespace Interpolation {
 
 /**
@@ -0,0 +1,396 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cmath>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/DSP.hpp"
+#import "DSPHeaders/DelayBuffer.hpp"
+#import "DSPHeaders/MillisecondsParameter.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Feed-forward dynamics processor that works as a compressor, downward expander, or limiter.
+
+ The level of the input is followed by a peak or RMS detector whose attack and release times come from
+ `MillisecondsParameter` values. A soft-knee gain computer turns the detected level into a gain in dB, which is then
+ applied to the input. The input can be delayed by a lookahead amount (using a `DelayBuffer` per channel) so that the
+ gain starts to change before a transient arrives. With stereo linking, all channels share one detector and one gain so
+ that the stereo image does not shift when one side is louder.
+
+ Work is done a block at a time: the detector levels for the whole block are made first, then the envelope, then the
+ dB conversions and gain curve -- which use the `DSP::fastLog2` and `DSP::fastExp2` approximations over the block --
+ and finally the gains are applied. Only the envelope has a dependency from one sample to the next. RMS detection
+ follows the squared signal and halves the dB scale instead of taking a square root.
+
+ Loosely based on the `DynamicsProcessor` and `PeakLimiter` classes in "Designing Audio Effect Plugins in C++" by Will
+ C. Pirkle (2019). All storage is allocated in `setRenderingFormat`.
+ */
+class DynamicsProcessor {
+public:
+
+  /// The kind of processing to do.
+  enum struct Mode {
+    /// Reduce the gain of levels above the threshold by the ratio
+    compressor,
+    /// Reduce the gain of levels below the threshold by the ratio
+    expander,
+    /// Keep levels from going above the threshold
+    limiter
+  };
+
+  /// The kind of level detection to do.
+  enum struct Detection {
+    peak,
+    rms
+  };
+
+  /// Lowest gain in dB that the processor will apply.
+  inline static constexpr AUValue MinimumGain = -120.0;
+
+  /**
+   Construct a new instance.
+
+   @param mode the kind of processing to do
+   @param detection the kind of level detection to do
+   */
+  explicit DynamicsProcessor(Mode mode = Mode::compressor, Detection detection = Detection::peak) noexcept :
+  mode_{mode}, detection_{detection}
+  {
+    updateCurve();
+  }
+
+  /**
+   Allocate storage for rendering, and reset the detectors.
+
+   @param sampleRate the sample rate of the samples to process
+   @param channelCount the number of channels to process
+   @param maxFramesToRender the maximum number of frames in a `process` call
+   @param maxLookahead the longest lookahead in milliseconds that will be used
+   */
+  void setRenderingFormat(double sampleRate, size_t channelCount, AUAudioFrameCount maxFramesToRender,
+                          AUValue maxLookahead = 10.0)
+  {
+    assert(channelCount <= BusBuffers::MaxChannelCount);
+    sampleRate_ = sampleRate;
+    channelCount_ = channelCount;
+    maxFramesToRender_ = maxFramesToRender;
+    maxLookaheadFrames_ = AUAudioFrameCount(std::ceil(maxLookahead * sampleRate / 1000.0));
+    delays_.assign(channelCount, DelayBuffer<AUValue>(double(maxLookaheadFrames_ + 1)));
+    keys_.assign(channelCount, std::vector<AUValue>(maxFramesToRender, 0.0));
+    envelopes_.assign(channelCount, 0.0);
+    setLookahead(lookahead_);
+    attackCoefficient_ = coefficient(attackMilliseconds_);
+    releaseCoefficient_ = coefficient(releaseMilliseconds_);
+    reset();
+  }
+
+  /**
+   Clear the detectors and the lookahead delays.
+   */
+  void reset() noexcept
+  {
+    for (auto& delay : delays_) delay.clear();
+    std::fill(envelopes_.begin(), envelopes_.end(), 0.0f);
+    gainReduction_ = 0.0;
+  }
+
+  /// @param mode the kind of processing to do
+  void setMode(Mode mode) noexcept { mode_ = mode; updateCurve(); }
+
+  /// @returns the kind of processing being done
+  Mode mode() const noexcept { return mode_; }
+
+  /// @param detection the kind of level detection to do
+  void setDetection(Detection detection) noexcept { detection_ = detection; }
+
+  /// @returns the kind of level detection being done
+  Detection detection() const noexcept { return detection_; }
+
+  /// @param threshold the level in dB where gain changes start
+  void setThreshold(AUValue threshold) noexcept { threshold_ = threshold; }
+
+  /// @returns the level in dB where gain changes start
+  AUValue threshold() const noexcept { return threshold_; }
+
+  /// @param ratio the ratio of input level change to output level change past the threshold. Must be >= 1.
+  void setRatio(AUValue ratio) noexcept { ratio_ = std::max(ratio, 1.0f); updateCurve(); }
+
+  /// @returns the ratio of input level change to output level change past the threshold
+  AUValue ratio() const noexcept { return ratio_; }
+
+  /// @param kneeWidth the width in dB of the soft knee centered on the threshold. Zero gives a hard knee.
+  void setKneeWidth(AUValue kneeWidth) noexcept { kneeWidth_ = std::max(kneeWidth, 0.0f); updateCurve(); }
+
+  /// @returns the width in dB of the soft knee
+  AUValue kneeWidth() const noexcept { return kneeWidth_; }
+
+  /// @param makeupGain the gain in dB to apply to the output
+  void setMakeupGain(AUValue makeupGain) noexcept
+  {
+    makeupGain_ = makeupGain;
+    makeupScale_ = AUValue(std::pow(10.0, makeupGain / 20.0));
+  }
+
+  /// @returns the gain in dB applied to the output
+  AUValue makeupGain() const noexcept { return makeupGain_; }
+
+  /**
+   Set the attack time, the time for the detector to move 63% of the way to a higher level.
+
+   @param milliseconds the new attack time
+   @param rampingDuration number of frames to ramp over
+   */
+  void setAttack(AUValue milliseconds, AUAudioFrameCount rampingDuration = 0) noexcept
+  {
+    attack_.set(milliseconds, rampingDuration);
+  }
+
+  /// @returns the attack time in milliseconds
+  AUValue attack() const noexcept { return attack_.get(); }
+
+  /**
+   Set the release time, the time for the detector to move 63% of the way to a lower level.
+
+   @param milliseconds the new release time
+   @param rampingDuration number of frames to ramp over
+   */
+  void setRelease(AUValue milliseconds, AUAudioFrameCount rampingDuration = 0) noexcept
+  {
+    release_.set(milliseconds, rampingDuration);
+  }
+
+  /// @returns the release time in milliseconds
+  AUValue release() const noexcept { return release_.get(); }
+
+  /**
+   Set the amount of time that the gain changes happen ahead of the input. This delays the output by the same amount,
+   which should be reported to the host. The value is limited to the maximum given to `setRenderingFormat`.
+
+   @param milliseconds the new lookahead time
+   */
+  void setLookahead(AUValue milliseconds) noexcept
+  {
+    lookahead_ = std::max(milliseconds, 0.0f);
+    lookaheadFrames_ = std::min(AUAudioFrameCount(std::round(lookahead_ * sampleRate_ / 1000.0)),
+                                maxLookaheadFrames_);
+  }
+
+  /// @returns the lookahead time in milliseconds
+  AUValue lookahead() const noexcept { return lookahead_; }
+
+  /// @returns the delay in frames added by the lookahead
+  double latency() const noexcept { return double(lookaheadFrames_); }
+
+  /// @param stereoLinked if true, all channels share one detector and gain
+  void setStereoLinked(bool stereoLinked) noexcept { stereoLinked_ = stereoLinked; }
+
+  /// @returns true if all channels share one detector and gain
+  bool isStereoLinked() const noexcept { return stereoLinked_; }
+
+  /// @returns the gain in dB that was applied to the last frame of the first channel, without the makeup gain
+  AUValue gainReduction() const noexcept { return gainReduction_; }
+
+  /**
+   Process a block of samples.
+
+   @param ins the samples to process
+   @param outs storage for the results. May be the same as `ins`.
+   @param frameCount the number of frames to process
+   */
+  void process(BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) noexcept
+  {
+    assert(frameCount <= maxFramesToRender_);
+    auto channelCount = std::min({ins.size(), outs.size(), channelCount_});
+    if (channelCount == 0 || frameCount == 0) return;
+
+    updateBallistics(frameCount);
+    auto linked = stereoLinked_ && channelCount > 1;
+    auto keyCount = linked ? 1 : channelCount;
+
+    detect(ins, channelCount, linked, frameCount);
+    for (size_t key = 0; key < keyCount; ++key) {
+      follow(keys_[key].data(), envelopes_[key], frameCount);
+      computeGains(keys_[key].data(), frameCount);
+    }
+    gainReduction_ = AUValue(20.0 * std::log10(keys_[0][frameCount - 1] / makeupScale_));
+
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      const AUValue* __restrict gains = keys_[linked ? 0 : channel].data();
+      const AUValue* in = ins[channel];
+      AUValue* out = outs[channel];
+      if (lookaheadFrames_ == 0) {
+        for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+          out[frame] = in[frame] * gains[frame];
+        }
+      } else {
+        auto& delay = delays_[channel];
+        for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+          delay.write(in[frame]);
+          out[frame] = delay.readFromOffset(ssize_t(lookaheadFrames_)) * gains[frame];
+        }
+      }
+    }
+  }
+
+private:
+
+  /// Natural log of the amount left after one time constant (36.8%).
+  inline static constexpr double TimeConstant = -0.99967234081320612357829304641019;
+
+  /// Tiny level added to the detector input to keep the envelope out of denormals and away from log(0).
+  inline static constexpr AUValue LevelFloor = 1.0e-30f;
+
+  AUValue coefficient(AUValue milliseconds) const noexcept
+  {
+    return milliseconds > 0.0f ? AUValue(std::exp(TimeConstant / (milliseconds * 0.001 * sampleRate_))) : 0.0f;
+  }
+
+  static AUValue advance(Parameters::MillisecondsParameter<AUValue>& parameter,
+                         AUAudioFrameCount frameCount) noexcept
+  {
+    auto value = parameter.frameValue();
+    for (AUAudioFrameCount frame = 1; frame < frameCount && parameter.isRamping(); ++frame) {
+      value = parameter.frameValue();
+    }
+    return value;
+  }
+
+  void updateBallistics(AUAudioFrameCount frameCount) noexcept
+  {
+    // The coefficients are updated once per block, and only when the times change.
+    auto attack = advance(attack_, frameCount);
+    if (attack != attackMilliseconds_) {
+      attackMilliseconds_ = attack;
+      attackCoefficient_ = coefficient(attack);
+    }
+    auto release = advance(release_, frameCount);
+    if (release != releaseMilliseconds_) {
+      releaseMilliseconds_ = release;
+      releaseCoefficient_ = coefficient(release);
+    }
+  }
+
+  void updateCurve() noexcept
+  {
+    // The gain is `slope * (knee^2 / (2 * width) + max(over - width / 2, 0))` where `over` is how far the level is past
+    // the threshold (above for compressing, below for expanding) and `knee` is `over + width / 2` limited to
+    // [0, width]. This is 0 on one side of the knee, the 2nd-order curve inside it, and the ratio line past it.
+    switch (mode_) {
+      case Mode::compressor: direction_ = 1.0f; slope_ = 1.0f / ratio_ - 1.0f; break;
+      case Mode::expander: direction_ = -1.0f; slope_ = 1.0f - ratio_; break;
+      case Mode::limiter: direction_ = 1.0f; slope_ = -1.0f; break;
+    }
+    auto width = std::max(kneeWidth_, 1.0e-3f);
+    halfKnee_ = width / 2.0f;
+    fullKnee_ = width;
+    inverseKnee_ = 1.0f / (2.0f * width);
+  }
+
+  void detect(BusBuffers ins, size_t channelCount, bool linked, AUAudioFrameCount frameCount) noexcept
+  {
+    auto rms = detection_ == Detection::rms;
+    if (!linked) {
+      for (size_t channel = 0; channel < channelCount; ++channel) {
+        const AUValue* in = ins[channel];
+        AUValue* __restrict key = keys_[channel].data();
+        for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+          key[frame] = (rms ? in[frame] * in[frame] : std::abs(in[frame])) + LevelFloor;
+        }
+      }
+      return;
+    }
+
+    // Linked peak detection uses the loudest channel, and linked RMS detection the mean power of the channels.
+    AUValue* __restrict key = keys_[0].data();
+    const AUValue* first = ins[0];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      key[frame] = rms ? first[frame] * first[frame] : std::abs(first[frame]);
+    }
+    for (size_t channel = 1; channel < channelCount; ++channel) {
+      const AUValue* in = ins[channel];
+      if (rms) {
+        for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) key[frame] += in[frame] * in[frame];
+      } else {
+        for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+          key[frame] = std::max(key[frame], std::abs(in[frame]));
+        }
+      }
+    }
+    auto scale = rms ? 1.0f / AUValue(channelCount) : 1.0f;
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) key[frame] = key[frame] * scale + LevelFloor;
+  }
+
+  void follow(AUValue* __restrict levels, AUValue& envelope, AUAudioFrameCount frameCount) const noexcept
+  {
+    auto value = envelope;
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      auto level = levels[frame];
+      auto coefficient = level > value ? attackCoefficient_ : releaseCoefficient_;
+      value = coefficient * (value - level) + level;
+      levels[frame] = value;
+    }
+    envelope = value;
+  }
+
+  void computeGains(AUValue* __restrict values, AUAudioFrameCount frameCount) const noexcept
+  {
+    // dB per octave of level: 20 * log10(2) for amplitudes, half of that for the squared values of RMS detection.
+    auto toDecibels = AUValue(detection_ == Detection::rms ? 10.0 * M_LN2 / M_LN10 : 20.0 * M_LN2 / M_LN10);
+    constexpr auto toOctaves = AUValue(M_LN10 / (20.0 * M_LN2));
+    auto threshold = threshold_;
+    auto direction = direction_;
+    auto slope = slope_;
+    auto halfKnee = halfKnee_;
+    auto fullKnee = fullKnee_;
+    auto inverseKnee = inverseKnee_;
+    auto makeupScale = makeupScale_;
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      auto level = toDecibels * DSP::fastLog2(values[frame]);
+      auto over = direction * (level - threshold);
+      auto knee = std::min(std::max(over + halfKnee, 0.0f), fullKnee);
+      auto gain = slope * (knee * knee * inverseKnee + std::max(over - halfKnee, 0.0f));
+      values[frame] = DSP::fastExp2(std::max(gain, MinimumGain) * toOctaves) * makeupScale;
+    }
+  }
+
+  Mode mode_;
+  Detection detection_;
+  AUValue threshold_{-10.0};
+  AUValue ratio_{4.0};
+  AUValue kneeWidth_{10.0};
+  AUValue makeupGain_{0.0};
+  AUValue makeupScale_{1.0};
+  Parameters::MillisecondsParameter<AUValue> attack_{10.0};
+  Parameters::MillisecondsParameter<AUValue> release_{100.0};
+  AUValue lookahead_{0.0};
+  bool stereoLinked_{true};
+
+  AUValue direction_{1.0};
+  AUValue slope_{0.0};
+  AUValue halfKnee_{0.0};
+  AUValue fullKnee_{0.0};
+  AUValue inverseKnee_{0.0};
+  AUValue attackMilliseconds_{10.0};
+  AUValue releaseMilliseconds_{100.0};
+  AUValue attackCoefficient_{0.0};
+  AUValue releaseCoefficient_{0.0};
+
+  double sampleRate_{44'100.0};
+  size_t channelCount_{0};
+  AUAudioFrameCount maxFramesToRender_{0};
+  AUAudioFrameCount maxLookaheadFrames_{0};
+  AUAudioFrameCount lookaheadFrames_{0};
+  std::vector<DelayBuffer<AUValue>> delays_{};
+  std::vector<std::vector<AUValue>> keys_{};
+  std::vector<AUValue> envelopes_{};
+  AUValue gainReduction_{0.0};
+};
+
+} // end namespace DSPHeaders
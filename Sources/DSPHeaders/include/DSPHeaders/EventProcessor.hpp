@@ -4,27 +4,107 @@
 
 #import <os/log.h>
 #import <algorithm>
+#import <limits>
 #import <string>
+#import <type_traits>
+#import <utility>
 #import <vector>
 
 #import <AudioToolbox/AudioToolbox.h>
 
+#import "DSPHeaders/AlignedArena.hpp"
 #import "DSPHeaders/SampleBuffer.hpp"
 #import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/ParameterTimeline.hpp"
+#import "DSPHeaders/RealtimeSafety.hpp"
+#import "DSPHeaders/RenderProfiler.hpp"
+#import "DSPHeaders/ScratchPool.hpp"
 
 namespace DSPHeaders {
 
+namespace Detail {
+
+/// Detects if a kernel class defines a `drainParameterChanges` method.
+template <typename T, typename = void>
+struct HasDrainParameterChanges : std::false_type {};
+
+template <typename T>
+struct HasDrainParameterChanges<T, std::void_t<decltype(std::declval<T&>().drainParameterChanges())>>
+: std::true_type {};
+
+/// Detects if a kernel class defines a `tailLength` method.
+template <typename T, typename = void>
+struct HasTailLength : std::false_type {};
+
+template <typename T>
+struct HasTailLength<T, std::void_t<decltype(std::declval<const T&>().tailLength())>> : std::true_type {};
+
+/// Detects if a kernel class defines a `renderProfiler` method.
+template <typename T, typename = void>
+struct HasRenderProfiler : std::false_type {};
+
+template <typename T>
+struct HasRenderProfiler<T, std::void_t<decltype(std::declval<T&>().renderProfiler())>> : std::true_type {};
+
+/// Detects if a kernel class defines a `doRenderingAllBuses` method.
+template <typename T, typename = void>
+struct HasRenderingAllBuses : std::false_type {};
+
+template <typename T>
+struct HasRenderingAllBuses<T, std::void_t<decltype(std::declval<T&>().doRenderingAllBuses(
+  std::declval<BusBuffers>(), std::declval<const BusBuffers*>(), size_t(), AUAudioFrameCount()))>>
+: std::true_type {};
+
+/// Detects if a kernel class defines a `scratchSize` method.
+template <typename T, typename = void>
+struct HasScratchSize : std::false_type {};
+
+template <typename T>
+struct HasScratchSize<T, std::void_t<decltype(std::declval<const T&>().scratchSize(AUAudioFrameCount()))>>
+: std::true_type {};
+
+} // end namespace Detail
+
+/**
+ How events are handled when `EventProcessor` renders in fixed-size chunks.
+
+ - exact -- events are applied at their exact sample time. Chunks are split at event times, so a kernel may see
+ chunks shorter than the chunk size in the middle of a render cycle.
+ - quantized -- events are applied at the start of the chunk that contains them. All chunks but the last one in a render
+ cycle have exactly the chunk size.
+ */
+enum struct ChunkEventPolicy { exact, quantized };
+
 /**
  Base template class for DSP kernels that provides common functionality. It uses the "Curiously Recurring Template
  Pattern (CRTP)" to interleave base functionality contained in this class with custom functionality from the derived
  class without the need for virtual dispatching.
 
+ When `DSP_HEADERS_REALTIME_SAFETY_CHECKS` is defined, `processAndRender` marks the calling thread as rendering so that
+ any allocations or locks reported to `RealtimeSafety` while it runs are counted as violations.
+
  It is expected that the template parameter class T defines the following methods which this class will
  invoke at the appropriate times but without any virtual dispatching.
 
- - doParameterEvent
+ - setParameterFromEvent
  - doMIDIEvent
- - doRenderFrames
+ - doRendering
+
+ The following methods are optional. They are only invoked if the derived class defines them.
+
+ - drainParameterChanges -- called at the start of `processAndRender` so that the kernel can apply any parameter
+ changes that were posted from other threads, such as by way of a `ParameterStore`.
+ - tailLength -- returns the number of frames that the kernel can keep producing output after its input goes silent.
+ When defined, rendering is skipped once the pulled input has been silent for longer than this, and the output is
+ marked as silent. Return `std::numeric_limits<AUAudioFrameCount>::max()` to never skip.
+ - renderProfiler -- returns a reference to a `RenderProfiler` that records the time taken by each `processAndRender`
+ and `doRendering` call.
+ - scratchSize -- given the maximum number of frames to render, returns the number of bytes of scratch space the kernel
+ needs in each `doRendering` call (use `ScratchPool::bytesFor` to size each piece). The space is allocated in
+ `setRenderingFormat` and handed out by `scratch()`.
+ - doRenderingAllBuses -- renders all output buses in one call when multi-bus rendering is enabled. It receives the
+ input and an array of `BusBuffers`, one per output bus. Without it, multi-bus rendering calls `doRendering` once per
+ bus instead.
 
  */
 template <typename T> class EventProcessor {
@@ -48,22 +128,121 @@ public:
   bool isBypassed() const noexcept { return bypassed_; }
 
   /**
-   Update kernel and buffers to support the given format.
+   Set the parameter timeline mode. When enabled, all parameter events for a render cycle are gathered into a
+   `ParameterTimeline` before rendering starts, and rendering is only split at MIDI event times. The kernel obtains
+   sample-accurate, per-sample parameter values via `parameterTimeline().render(...)` in its `doRendering` method. Any
+   parameter events that the kernel does not consume this way are given to `setParameterFromEvent` at the end of the
+   render cycle.
+
+   @param enabled if true gather parameter events into a timeline instead of splitting rendering at each event
+   */
+  void setParameterTimelineEnabled(bool enabled) noexcept { parameterTimelineEnabled_ = enabled; }
+
+  /// @returns true if parameter timeline mode is enabled
+  bool isParameterTimelineEnabled() const noexcept { return parameterTimelineEnabled_; }
+
+  /**
+   Set the fixed chunk size to use when rendering. When non-zero, `doRendering` is never asked to render more than
+   `chunkSize` frames at a time, so kernels can use fixed-size scratch buffers and loops. A render cycle is broken up
+   into chunks of `chunkSize` frames plus a remainder.
+
+   @param chunkSize the maximum number of frames to give to `doRendering`. A value of 0 disables chunking.
+   @param policy how to handle events that fall within a chunk
+   */
+  void setRenderChunkSize(AUAudioFrameCount chunkSize, ChunkEventPolicy policy = ChunkEventPolicy::exact) noexcept {
+    chunkSize_ = chunkSize;
+    chunkEventPolicy_ = policy;
+  }
+
+  /// @returns the current chunk size (0 if chunking is disabled)
+  AUAudioFrameCount renderChunkSize() const noexcept { return chunkSize_; }
+
+  /// @returns the current chunk event policy
+  ChunkEventPolicy chunkEventPolicy() const noexcept { return chunkEventPolicy_; }
+
+  /**
+   Set the largest sample magnitude that is still considered to be silence when scanning pulled input. Only used if the
+   kernel defines a `tailLength` method.
+
+   @param threshold the magnitude at or below which input is silent
+   */
+  void setSilenceThreshold(AUValue threshold) noexcept { silenceThreshold_ = threshold; }
+
+  /// @returns the largest sample magnitude that is considered to be silence
+  AUValue silenceThreshold() const noexcept { return silenceThreshold_; }
+
+  /// @returns true if rendering was skipped in the last render cycle due to silent input
+  bool isSkippingSilence() const noexcept { return skippingSilence_; }
+
+  /**
+   Set the memory locking mode. When enabled, the sample buffers allocated in `setRenderingFormat` are locked into
+   physical memory so that they are never paged out while rendering. Takes effect at the next `setRenderingFormat`.
+
+   @param enabled if true lock the sample buffers into physical memory
+   */
+  void setMemoryLockingEnabled(bool enabled) noexcept { memoryLockingEnabled_ = enabled; }
+
+  /// @returns true if memory locking is enabled
+  bool isMemoryLockingEnabled() const noexcept { return memoryLockingEnabled_; }
+
+  /// @returns true if the sample buffers are currently locked into physical memory
+  bool isMemoryLocked() const noexcept { return arena_.isLocked(); }
+
+  /// @returns the number of bytes held for sample buffers and scratch space
+  size_t renderingMemorySize() const noexcept { return arena_.capacity(); }
+
+  /**
+   Set the multi-bus rendering mode. When enabled, the first `processAndRender` call of a render cycle processes the
+   events and renders every output bus into its internal buffer in one pass, and the calls for the other buses of the
+   same cycle (same sample time and frame count) just hand over the samples already rendered. The hand-over is a
+   pointer assignment when the host asks to render in-place (null `mData`) and a copy otherwise. Input is pulled once
+   per cycle, from input bus 0, into a buffer of its own so that the kernel can read it while writing every bus.
+
+   Must be set before `setRenderingFormat`.
+
+   @param enabled if true render all output buses on the first pull of a render cycle
+   */
+  void setMultiBusRenderingEnabled(bool enabled) noexcept { multiBusRenderingEnabled_ = enabled; }
+
+  /// @returns true if multi-bus rendering is enabled
+  bool isMultiBusRenderingEnabled() const noexcept { return multiBusRenderingEnabled_; }
+
+  /**
+   Update kernel and buffers to support the given format. The sample buffers of all buses are allocated in one
+   cache-aligned block, which is zero-filled here so that the first render does not take page faults.
 
    @param format the sample format to expect
    @param maxFramesToRender the maximum number of frames to expect on input
+   @returns `kAudioUnitErr_FormatNotSupported` if the format has more than `BusBuffers::MaxChannelCount` channels, in
+   which case nothing is changed. Otherwise `noErr`.
    */
-  void setRenderingFormat(NSInteger busCount, AVAudioFormat* format, AUAudioFrameCount maxFramesToRender) noexcept {
+  AUAudioUnitStatus setRenderingFormat(NSInteger busCount, AVAudioFormat* format,
+                                       AUAudioFrameCount maxFramesToRender) noexcept {
     auto channelCount{[format channelCount]};
+    if (channelCount > BusBuffers::MaxChannelCount) {
+      return kAudioUnitErr_FormatNotSupported;
+    }
+
+    channelCount_ = channelCount;
 
     // We want an internal buffer for each bus that we can generate output on.
     while (buffers_.size() < size_t(busCount)) {
       buffers_.emplace_back();
-      facets_.emplace_back();
     }
 
-    // Extra facet to use for input buffer used by a `pullInputBlock`
-    facets_.emplace_back();
+    size_t scratchSize = 0;
+    if constexpr (Detail::HasScratchSize<T>::value) {
+      scratchSize = AlignedArena::alignedSize(derived_.scratchSize(maxFramesToRender));
+    }
+
+    // Multi-bus rendering pulls input into a buffer of its own.
+    auto sampleBufferCount = buffers_.size() + (multiBusRenderingEnabled_ ? 1 : 0);
+    arena_.reserve(sampleBufferCount * SampleBuffer::arenaSize(channelCount, maxFramesToRender) + scratchSize,
+                   memoryLockingEnabled_);
+    scratch_.assign(arena_.take<std::byte>(scratchSize), scratchSize);
+
+    // One facet per bus plus an extra one to use for input buffer used by a `pullInputBlock`
+    facets_.resize(buffers_.size() + 1);
 
     // Setup facets to have the right channel count so we do not allocate while rendering
     for (auto& entry : facets_) {
@@ -72,13 +251,39 @@ public:
 
     // Setup sample buffers to have the right format and capacity
     for (auto& entry : buffers_) {
-      entry.allocate(format, maxFramesToRender);
+      entry.allocate(format, maxFramesToRender, arena_);
+    }
+
+    if (multiBusRenderingEnabled_) {
+      multiBusInput_.allocate(format, maxFramesToRender, arena_);
     }
 
-    // Link the output buffers with their corresponding facets. This only needs to be done once.
+    multiBusOutputs_.clear();
+    multiBusOutputs_.reserve(buffers_.size());
+    busServed_.assign(buffers_.size(), false);
+    multiBusCycleValid_ = false;
+
+    // Link the output buffers with their corresponding facets. This only needs to be done once. This is also where we
+    // validate the buffers so that the render thread does not have to.
     for (size_t busIndex = 0; busIndex < buffers_.size(); ++busIndex) {
-      facets_[busIndex].setBufferList(buffers_[busIndex].mutableAudioBufferList());
+      auto bufferList = buffers_[busIndex].mutableAudioBufferList();
+      assert(bufferList != nullptr && bufferList->mNumberBuffers == channelCount);
+      facets_[busIndex].setBufferListUnchecked(bufferList);
+    }
+
+    if (timeline_.capacity() < ParameterTimeline::DefaultCapacity) {
+      timeline_.reserve(ParameterTimeline::DefaultCapacity);
     }
+
+    // Each bus pulls its own input when rendered one at a time, so each needs its own count of silent frames.
+    silentFrameCounts_.assign(buffers_.size(), 0);
+    skippingSilence_ = false;
+
+    if constexpr (Detail::HasRenderProfiler<T>::value) {
+      derived_.renderProfiler().setSampleRate([format sampleRate]);
+    }
+
+    return noErr;
   }
 
   /**
@@ -92,6 +297,14 @@ public:
     for (auto& entry : buffers_) {
       entry.release();
     }
+
+    if (multiBusInput_.mutableAudioBufferList() != nullptr) {
+      multiBusInput_.release();
+    }
+
+    multiBusCycleValid_ = false;
+    scratch_.assign(nullptr, 0);
+    arena_.release();
   }
 
   /**
@@ -104,11 +317,75 @@ public:
    @param output the buffer to hold the rendered samples
    @param realtimeEventListHead pointer to the first AURenderEvent (may be null)
    @param pullInputBlock the closure to call to obtain upstream samples
+   @param actionFlags optional render flags from the host. Receives `kAudioUnitRenderAction_OutputIsSilence` when
+   rendering is skipped due to silent input.
    */
   AUAudioUnitStatus processAndRender(const AudioTimeStamp* timestamp, UInt32 frameCount, NSInteger outputBusNumber,
                                      AudioBufferList* output, const AURenderEvent* realtimeEventListHead,
-                                     AURenderPullInputBlock pullInputBlock) noexcept
+                                     AURenderPullInputBlock pullInputBlock,
+                                     AudioUnitRenderActionFlags* actionFlags = nullptr) noexcept
   {
+#if defined(DSP_HEADERS_REALTIME_SAFETY_CHECKS)
+    RealtimeSafety::Scope realtimeScope;
+#endif
+
+    if constexpr (Detail::HasRenderProfiler<T>::value) {
+      auto start = RenderProfiler::now();
+      auto status = doProcessAndRender(timestamp, frameCount, outputBusNumber, output, realtimeEventListHead,
+                                       pullInputBlock, actionFlags);
+      derived_.renderProfiler().record(RenderProfiler::Kind::processAndRender, start, frameCount);
+      return status;
+    } else {
+      return doProcessAndRender(timestamp, frameCount, outputBusNumber, output, realtimeEventListHead, pullInputBlock,
+                                actionFlags);
+    }
+  }
+
+protected:
+
+  /**
+   Obtain a `busBuffer` for the given bus.
+
+   @param bus the bus to whose buffers will be pointed to
+   @returns BusBuffers instance
+   */
+  BusBuffers busBuffers(size_t bus) noexcept { return facets_[bus].busBuffers(); }
+
+  /**
+   Obtain the parameter events for the current render cycle. Only has events when parameter timeline mode is enabled.
+
+   @returns reference to the timeline of parameter events
+   */
+  ParameterTimeline& parameterTimeline() noexcept { return timeline_; }
+
+  /**
+   Obtain the scratch space for the current `doRendering` call. It is empty unless the kernel defines `scratchSize`.
+   Pieces taken from it are only valid until `doRendering` returns.
+
+   @returns reference to the scratch pool
+   */
+  ScratchPool& scratch() noexcept { return scratch_; }
+
+private:
+
+  /// Bus number given to the render methods to render all output buses at once.
+  inline static constexpr NSInteger AllBuses = -1;
+
+  AUAudioUnitStatus doProcessAndRender(const AudioTimeStamp* timestamp, UInt32 frameCount, NSInteger outputBusNumber,
+                                       AudioBufferList* output, const AURenderEvent* realtimeEventListHead,
+                                       const AURenderPullInputBlock& pullInputBlock,
+                                       AudioUnitRenderActionFlags* actionFlags) noexcept
+  {
+    if (multiBusRenderingEnabled_) {
+      return doProcessAndRenderAllBuses(timestamp, frameCount, outputBusNumber, output, realtimeEventListHead,
+                                        pullInputBlock, actionFlags);
+    }
+
+    // Apply any parameter changes made outside of the render thread before we do anything else.
+    if constexpr (Detail::HasDrainParameterChanges<T>::value) {
+      derived_.drainParameterChanges();
+    }
+
     size_t outputBusIndex = size_t(outputBusNumber);
     assert(outputBusIndex < buffers_.size());
 
@@ -119,68 +396,237 @@ public:
       return kAudioUnitErr_TooManyFramesToProcess;
     }
 
+    // The only check we need to do here to make the render path safe: the host must give us the same number of
+    // channels that we were configured for in `setRenderingFormat`.
+    if (output->mNumberBuffers != channelCount_) {
+      return kAudioUnitErr_FormatNotSupported;
+    }
+
     // This only applies for effects -- instruments do not have anything to pull.
     BufferFacet& input{inputFacet()};
+    AudioUnitRenderActionFlags pullFlags = 0;
     if (pullInputBlock) {
-      input.setBufferList(output, buffer.mutableAudioBufferList());
-      input.setFrameCount(frameCount);
-
-      AudioUnitRenderActionFlags actionFlags = 0;
-      auto status = buffer.pullInput(&actionFlags, timestamp, frameCount, outputBusNumber, pullInputBlock);
+      auto status = buffer.pullInput(&pullFlags, timestamp, frameCount, outputBusNumber, pullInputBlock);
       if (status != noErr) {
         return status;
       }
+
+      // The input facet views the samples we just pulled.
+      input.setBufferListUnchecked(buffer.mutableAudioBufferList());
     }
 
-    facets_[outputBusIndex].setBufferList(output, buffer.mutableAudioBufferList());
-    facets_[outputBusIndex].setFrameCount(frameCount);
+    // If the host did not provide storage for the output, render in-place using our internal buffer.
+    auto& outputFacet{facets_[outputBusIndex]};
+    outputFacet.setBufferListUnchecked(output, buffer.mutableAudioBufferList());
+    outputFacet.setFrameCountUnchecked(frameCount);
+
+    // If the input has been silent for longer than the kernel's tail, there is nothing to render. Events are still
+    // given to the kernel so that its state stays current.
+    skippingSilence_ = false;
+    if constexpr (Detail::HasTailLength<T>::value) {
+      if (pullInputBlock && isInputSilent(silentFrameCounts_[outputBusIndex], pullFlags, input, frameCount)) {
+        skippingSilence_ = true;
+        processEventsUntil(std::numeric_limits<AUEventSampleTime>::max(), realtimeEventListHead);
+        clearOutput(output, frameCount);
+        if (actionFlags != nullptr) {
+          *actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+        }
+        return noErr;
+      }
+    }
 
     // Clear the output buffer before use when there is no input data.
     if (!pullInputBlock) {
-      UInt32 byteSize = frameCount * sizeof(AUValue);
-      for (UInt32 index = 0; index < output->mNumberBuffers; ++index) {
-        AudioBuffer& buffer = output->mBuffers[index];
-        memset(buffer.mData, 0, byteSize);
-      }
+      clearOutput(output, frameCount);
     }
 
     render(outputBusNumber, timestamp, frameCount, realtimeEventListHead);
     return noErr;
   }
 
-protected:
-
   /**
-   Obtain a `busBuffer` for the given bus.
-
-   @param bus the bus to whose buffers will be pointed to
-   @returns BusBuffers instance
+   Multi-bus version of `doProcessAndRender`. Renders all output buses if this is the first call for a new render
+   cycle, and then hands over the samples of the requested bus.
    */
-  BusBuffers busBuffers(size_t bus) noexcept { return facets_[bus].busBuffers(); }
+  AUAudioUnitStatus doProcessAndRenderAllBuses(const AudioTimeStamp* timestamp, UInt32 frameCount,
+                                               NSInteger outputBusNumber, AudioBufferList* output,
+                                               const AURenderEvent* realtimeEventListHead,
+                                               const AURenderPullInputBlock& pullInputBlock,
+                                               AudioUnitRenderActionFlags* actionFlags) noexcept
+  {
+    size_t outputBusIndex = size_t(outputBusNumber);
+    assert(outputBusIndex < buffers_.size());
 
-private:
+    if (frameCount > multiBusInput_.capacity()) {
+      return kAudioUnitErr_TooManyFramesToProcess;
+    }
+
+    if (output->mNumberBuffers != channelCount_) {
+      return kAudioUnitErr_FormatNotSupported;
+    }
+
+    // A bus that was already served, or a different time or size, starts a new render cycle.
+    bool sameCycle = multiBusCycleValid_ && !busServed_[outputBusIndex] &&
+    timestamp->mSampleTime == multiBusSampleTime_ && frameCount == multiBusFrameCount_;
+    if (!sameCycle) {
+      auto status = renderAllBuses(timestamp, frameCount, realtimeEventListHead, pullInputBlock);
+      if (status != noErr) {
+        return status;
+      }
+    }
+
+    busServed_[outputBusIndex] = true;
+    handOver(buffers_[outputBusIndex], output, frameCount);
+    if (skippingSilence_ && actionFlags != nullptr) {
+      *actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+    }
+
+    return noErr;
+  }
+
+  AUAudioUnitStatus renderAllBuses(const AudioTimeStamp* timestamp, UInt32 frameCount,
+                                   const AURenderEvent* realtimeEventListHead,
+                                   const AURenderPullInputBlock& pullInputBlock) noexcept
+  {
+    multiBusCycleValid_ = false;
+    std::fill(busServed_.begin(), busServed_.end(), false);
+
+    if constexpr (Detail::HasDrainParameterChanges<T>::value) {
+      derived_.drainParameterChanges();
+    }
+
+    BufferFacet& input{inputFacet()};
+    AudioUnitRenderActionFlags pullFlags = 0;
+    if (pullInputBlock) {
+      auto status = multiBusInput_.pullInput(&pullFlags, timestamp, frameCount, 0, pullInputBlock);
+      if (status != noErr) {
+        return status;
+      }
+
+      input.setBufferListUnchecked(multiBusInput_.mutableAudioBufferList());
+    }
+
+    // Every bus renders into its own internal buffer.
+    for (size_t busIndex = 0; busIndex < buffers_.size(); ++busIndex) {
+      buffers_[busIndex].setFrameCount(frameCount);
+      facets_[busIndex].setBufferListUnchecked(buffers_[busIndex].mutableAudioBufferList());
+      facets_[busIndex].setFrameCountUnchecked(frameCount);
+    }
+
+    skippingSilence_ = false;
+    bool silent = false;
+    if constexpr (Detail::HasTailLength<T>::value) {
+      // Input is pulled once per render cycle here, so bus 0's count covers every bus.
+      silent = pullInputBlock && isInputSilent(silentFrameCounts_[0], pullFlags, input, frameCount);
+    }
+
+    if (silent || !pullInputBlock) {
+      for (auto& buffer : buffers_) {
+        clearOutput(buffer.mutableAudioBufferList(), frameCount);
+      }
+    }
+
+    if (silent) {
+      skippingSilence_ = true;
+      processEventsUntil(std::numeric_limits<AUEventSampleTime>::max(), realtimeEventListHead);
+    } else {
+      render(AllBuses, timestamp, frameCount, realtimeEventListHead);
+    }
+
+    multiBusSampleTime_ = timestamp->mSampleTime;
+    multiBusFrameCount_ = frameCount;
+    multiBusCycleValid_ = true;
+    return noErr;
+  }
+
+  /**
+   Give the samples of an internal buffer to the host. If the host asked for in-place rendering, just point it at the
+   internal buffer, otherwise copy the samples into the host's storage.
+   */
+  static void handOver(const SampleBuffer& source, AudioBufferList* output, AUAudioFrameCount frameCount) noexcept {
+    auto sourceList = source.mutableAudioBufferList();
+    UInt32 byteSize = frameCount * sizeof(AUValue);
+    for (UInt32 index = 0; index < output->mNumberBuffers; ++index) {
+      AudioBuffer& buffer = output->mBuffers[index];
+      auto data = sourceList->mBuffers[index].mData;
+      if (buffer.mData == nullptr) {
+        buffer.mData = data;
+      } else if (buffer.mData != data) {
+        memcpy(buffer.mData, data, byteSize);
+      }
+      buffer.mDataByteSize = byteSize;
+    }
+  }
 
   BufferFacet& inputFacet() noexcept { assert(!facets_.empty()); return facets_.back(); }
 
+  static void clearOutput(AudioBufferList* output, AUAudioFrameCount frameCount) noexcept {
+    UInt32 byteSize = frameCount * sizeof(AUValue);
+    for (UInt32 index = 0; index < output->mNumberBuffers; ++index) {
+      AudioBuffer& buffer = output->mBuffers[index];
+      memset(buffer.mData, 0, byteSize);
+    }
+  }
+
+  /**
+   Track how long the pulled input has been silent, using the upstream silence flag if set or else a scan of the
+   samples.
+
+   @param silentFrameCount the number of silent frames pulled so far for the bus being rendered
+   @returns true if the input has been silent for at least as long as the kernel's tail, so that the kernel's output
+   over the next `frameCount` frames will be silent as well.
+   */
+  bool isInputSilent(AUAudioFrameCount& silentFrameCount, AudioUnitRenderActionFlags pullFlags, BufferFacet& input,
+                     AUAudioFrameCount frameCount) noexcept {
+    bool silent = (pullFlags & kAudioUnitRenderAction_OutputIsSilence) != 0 ||
+    input.busBuffers().peakMagnitude(frameCount) <= silenceThreshold_;
+    if (!silent) {
+      silentFrameCount = 0;
+      return false;
+    }
+
+    bool skip = silentFrameCount >= derived_.tailLength();
+    silentFrameCount = std::min(silentFrameCount, std::numeric_limits<AUAudioFrameCount>::max() - frameCount) +
+    frameCount;
+    return skip;
+  }
+
   void render(NSInteger outputBusNumber, AudioTimeStamp const* timestamp, AUAudioFrameCount frameCount,
               AURenderEvent const* events) noexcept
   {
+    if (parameterTimelineEnabled_) {
+      renderWithTimeline(outputBusNumber, timestamp, frameCount, events);
+      return;
+    }
+
     auto zero = AUEventSampleTime(0);
     auto now = AUEventSampleTime(timestamp->mSampleTime);
     auto framesRemaining = frameCount;
 
+    if (isQuantizingEvents()) {
+      while (framesRemaining > 0) {
+        // Process all events that fall within the chunk before rendering it.
+        auto framesThisSegment = std::min(chunkSize_, framesRemaining);
+        events = processEventsUntil(now + AUEventSampleTime(framesThisSegment) - 1, events);
+        renderSegment(outputBusNumber, framesThisSegment, frameCount - framesRemaining);
+        framesRemaining -= framesThisSegment;
+        now += AUEventSampleTime(framesThisSegment);
+      }
+      return;
+    }
+
     while (framesRemaining > 0) {
 
       // Short-circuit if there are no more events to interleave
       if (events == nullptr) {
-        renderFrames(outputBusNumber, framesRemaining, frameCount - framesRemaining);
+        renderSegment(outputBusNumber, framesRemaining, frameCount - framesRemaining);
         return;
       }
 
       // Render the frames for the times between now and the time of the first event.
       auto framesThisSegment = AUAudioFrameCount(std::max(events->head.eventSampleTime - now, zero));
       if (framesThisSegment > 0) {
-        renderFrames(outputBusNumber, framesThisSegment, frameCount - framesRemaining);
+        renderSegment(outputBusNumber, framesThisSegment, frameCount - framesRemaining);
         framesRemaining -= framesThisSegment;
         now += AUEventSampleTime(framesThisSegment);
       }
@@ -190,6 +636,93 @@ private:
     }
   }
 
+  void renderWithTimeline(NSInteger outputBusNumber, AudioTimeStamp const* timestamp, AUAudioFrameCount frameCount,
+                          AURenderEvent const* events) noexcept
+  {
+    auto zero = AUEventSampleTime(0);
+    auto now = AUEventSampleTime(timestamp->mSampleTime);
+
+    // Gather all of the parameter events into the timeline. If the timeline is full, just apply the event now.
+    timeline_.beginBlock();
+    for (auto event = events; event != nullptr; event = event->head.next) {
+      if (isParameterEvent(event)) {
+        auto offset = AUAudioFrameCount(std::clamp(event->head.eventSampleTime - now, zero,
+                                                   AUEventSampleTime(frameCount)));
+        if (!timeline_.add(event->parameter, offset)) {
+          derived_.setParameterFromEvent(event->parameter);
+        }
+      }
+    }
+    timeline_.finalize();
+
+    // Render, splitting only at MIDI events.
+    auto framesRemaining = frameCount;
+    auto midi = nextMIDIEvent(events);
+    while (framesRemaining > 0) {
+      auto framesThisSegment = framesRemaining;
+      if (isQuantizingEvents()) {
+        // Process all MIDI events that fall within the chunk before rendering it.
+        framesThisSegment = std::min(chunkSize_, framesRemaining);
+        while (midi != nullptr && midi->head.eventSampleTime < now + AUEventSampleTime(framesThisSegment)) {
+          derived_.doMIDIEvent(midi->MIDI);
+          midi = nextMIDIEvent(midi->head.next);
+        }
+      } else if (midi != nullptr) {
+        framesThisSegment = AUAudioFrameCount(std::clamp(midi->head.eventSampleTime - now, zero,
+                                                         AUEventSampleTime(framesRemaining)));
+      }
+
+      if (framesThisSegment > 0) {
+        renderSegment(outputBusNumber, framesThisSegment, frameCount - framesRemaining);
+        framesRemaining -= framesThisSegment;
+        now += AUEventSampleTime(framesThisSegment);
+      }
+
+      while (midi != nullptr && midi->head.eventSampleTime <= now) {
+        derived_.doMIDIEvent(midi->MIDI);
+        midi = nextMIDIEvent(midi->head.next);
+      }
+    }
+
+    // MIDI events stamped after the block are delivered at its end, just as parameter events are clamped to it.
+    for (; midi != nullptr; midi = nextMIDIEvent(midi->head.next)) {
+      derived_.doMIDIEvent(midi->MIDI);
+    }
+
+    // Give any remaining parameter events to the kernel so that its state is current for the next render cycle.
+    timeline_.endBlock([this](const AUParameterEvent& event) { derived_.setParameterFromEvent(event); });
+  }
+
+  bool isQuantizingEvents() const noexcept {
+    return chunkSize_ > 0 && chunkEventPolicy_ == ChunkEventPolicy::quantized;
+  }
+
+  /**
+   Render a span of frames that has no events in it, breaking it up into chunks if chunking is enabled.
+   */
+  void renderSegment(NSInteger outputBusNumber, AUAudioFrameCount frameCount, AUAudioFrameCount processedFrameCount)
+  {
+    auto chunkSize = chunkSize_ > 0 ? chunkSize_ : frameCount;
+    while (frameCount > 0) {
+      auto framesThisChunk = std::min(chunkSize, frameCount);
+      renderFrames(outputBusNumber, framesThisChunk, processedFrameCount);
+      if (parameterTimelineEnabled_) timeline_.advance(framesThisChunk);
+      processedFrameCount += framesThisChunk;
+      frameCount -= framesThisChunk;
+    }
+  }
+
+  static bool isParameterEvent(AURenderEvent const* event) noexcept {
+    return event->head.eventType == AURenderEventParameter || event->head.eventType == AURenderEventParameterRamp;
+  }
+
+  static AURenderEvent const* nextMIDIEvent(AURenderEvent const* event) noexcept {
+    while (event != nullptr && event->head.eventType != AURenderEventMIDI) {
+      event = event->head.next;
+    }
+    return event;
+  }
+
   void unlinkBuffers() noexcept
   {
     for (auto& entry : facets_) {
@@ -215,36 +748,112 @@ private:
     return event;
   }
 
-  void renderFrames(NSInteger outputBusNumber, AUAudioFrameCount frameCount, AUAudioFrameCount processedFrameCount)
+  void renderFrames(NSInteger outputBusNumber, AUAudioFrameCount frameCount,
+                    AUAudioFrameCount processedFrameCount) noexcept
   {
+    if (outputBusNumber == AllBuses) {
+      renderAllBusFrames(frameCount, processedFrameCount);
+      return;
+    }
+
     size_t outputBusIndex = size_t(outputBusNumber);
 
     // This method can be called multiple times during one `processAndRender` call due to interleaved audio events
     // such as MIDI messages. We will generate in total `frameCount` + `processedFrameCount` samples, but maybe not in
     // one shot. As a result, we must adjust buffer pointers by the number of processed samples so far before we
-    // let the kernel render into our buffers.
-    for (size_t busIndex = 0; busIndex < buffers_.size(); ++busIndex) {
-      auto& facet{facets_[busIndex]};
-      facet.setOffset(processedFrameCount);
-    }
+    // let the kernel render into our buffers. Only the input and output facets in use need to be adjusted.
+    auto& input{inputFacet()};
+    auto& output{facets_[outputBusIndex]};
+    output.setOffsetUnchecked(processedFrameCount);
 
     // If we have input samples from an upstream node *and* we are in bypass mode, either use the sample buffers
     // directly or copy samples over to the output buffer and be done.
-    auto& input{inputFacet()};
-    if (input.isLinked() && isBypassed()) {
-      input.copyInto(facets_[outputBusIndex], processedFrameCount, frameCount);
-      return;
+    if (input.isLinked()) {
+      if (isBypassed()) {
+        input.copyIntoUnchecked(output, processedFrameCount, frameCount);
+        return;
+      }
+      input.setOffsetUnchecked(processedFrameCount);
     }
 
     // Pass off to the kernel to render the desired number of samples.
-    auto& output{facets_[outputBusIndex]};
-    derived_.doRendering(outputBusNumber, input.busBuffers(), output.busBuffers(), frameCount);
+    profiled(frameCount, [&]() {
+      scratch_.reset();
+      derived_.doRendering(outputBusNumber, input.busBuffers(), output.busBuffers(), frameCount);
+    });
+  }
+
+  /**
+   Multi-bus version of `renderFrames` that renders every output bus.
+   */
+  void renderAllBusFrames(AUAudioFrameCount frameCount, AUAudioFrameCount processedFrameCount) noexcept
+  {
+    auto& input{inputFacet()};
+    multiBusOutputs_.clear();
+    for (size_t busIndex = 0; busIndex < buffers_.size(); ++busIndex) {
+      facets_[busIndex].setOffsetUnchecked(processedFrameCount);
+      multiBusOutputs_.push_back(facets_[busIndex].busBuffers());
+    }
+
+    if (input.isLinked()) {
+      if (isBypassed()) {
+        for (size_t busIndex = 0; busIndex < buffers_.size(); ++busIndex) {
+          input.copyIntoUnchecked(facets_[busIndex], processedFrameCount, frameCount);
+        }
+        return;
+      }
+      input.setOffsetUnchecked(processedFrameCount);
+    }
+
+    profiled(frameCount, [&]() {
+      if constexpr (Detail::HasRenderingAllBuses<T>::value) {
+        scratch_.reset();
+        derived_.doRenderingAllBuses(input.busBuffers(), multiBusOutputs_.data(), multiBusOutputs_.size(), frameCount);
+      } else {
+        for (size_t busIndex = 0; busIndex < multiBusOutputs_.size(); ++busIndex) {
+          scratch_.reset();
+          derived_.doRendering(NSInteger(busIndex), input.busBuffers(), multiBusOutputs_[busIndex], frameCount);
+        }
+      }
+    });
+  }
+
+  /**
+   Invoke a rendering function, recording the time it takes if the kernel has a `RenderProfiler`.
+   */
+  template <typename Proc>
+  void profiled(AUAudioFrameCount frameCount, Proc&& proc) noexcept {
+    if constexpr (Detail::HasRenderProfiler<T>::value) {
+      auto start = RenderProfiler::now();
+      proc();
+      derived_.renderProfiler().record(RenderProfiler::Kind::doRendering, start, frameCount);
+    } else {
+      proc();
+    }
   }
 
   T& derived_;
+  AlignedArena arena_{};
   std::vector<SampleBuffer> buffers_;
   std::vector<BufferFacet> facets_;
+  ParameterTimeline timeline_{};
+  ScratchPool scratch_{};
+  SampleBuffer multiBusInput_{};
+  std::vector<BusBuffers> multiBusOutputs_{};
+  std::vector<bool> busServed_{};
+  Float64 multiBusSampleTime_ = 0.0;
+  UInt32 multiBusFrameCount_ = 0;
+  bool multiBusCycleValid_ = false;
+  AUAudioChannelCount channelCount_ = 0;
   bool bypassed_ = false;
+  bool parameterTimelineEnabled_ = false;
+  AUAudioFrameCount chunkSize_ = 0;
+  ChunkEventPolicy chunkEventPolicy_ = ChunkEventPolicy::exact;
+  bool memoryLockingEnabled_ = false;
+  bool multiBusRenderingEnabled_ = false;
+  AUValue silenceThreshold_ = 0.0;
+  std::vector<AUAudioFrameCount> silentFrameCounts_{};
+  bool skippingSilence_ = false;
 };
 
 } // end namespace DSPHeaders
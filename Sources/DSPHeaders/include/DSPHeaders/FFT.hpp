@@ -0,0 +1,279 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <cmath>
+#import <stdexcept>
+#import <utility>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+namespace DSPHeaders {
+
+/**
+ Fast Fourier transform of real-valued `AUValue` samples. The transform size must be a power of 2 that is at least 4.
+
+ Spectra are held in split form -- separate arrays for the real and imaginary parts of the `binCount()` bins from DC
+ to Nyquist -- so that per-bin operations such as multiply-accumulate are simple loops the compiler can vectorize. The
+ imaginary parts of the DC and Nyquist bins are always zero.
+
+ Internally a size N real transform is done as a complex transform of size N/2 followed by a split into even and odd
+ halves. The complex transform is a Stockham auto-sort FFT made up of radix-4 passes, with one radix-2 pass when
+ needed. Each pass reads and writes whole rows of samples with unit stride, and the twiddle factors for all passes are
+ computed up front, so the butterflies are plain loops with no table lookups or bit-reversal shuffles.
+
+ All storage is allocated in the constructor -- the transforms do not allocate. An instance holds working storage,
+ so it must not be used by more than one thread at a time.
+ */
+class RealFFT {
+public:
+
+  /**
+   Construct a new transform.
+
+   @param size the number of real samples to transform. Must be a power of 2 that is at least 4.
+   @throws std::invalid_argument if `size` is not valid
+   */
+  explicit RealFFT(size_t size) :
+  size_{size}, half_{size / 2}, real_(half_), imag_(half_), workReal_(half_), workImag_(half_),
+  splitReal_(half_ + 1), splitImag_(half_ + 1)
+  {
+    if (size < 4 || (size & (size - 1)) != 0) throw std::invalid_argument("FFT size must be a power of 2 >= 4");
+
+    // Twiddle factors for each radix-4 pass, in the order the passes use them.
+    for (size_t length = half_; length >= 4; length /= 4) {
+      auto theta = 2.0 * M_PI / double(length);
+      for (size_t p = 0; p < length / 4; ++p) {
+        for (size_t k = 1; k <= 3; ++k) {
+          twiddles_.push_back(AUValue(std::cos(theta * double(p * k))));
+          twiddles_.push_back(AUValue(-std::sin(theta * double(p * k))));
+        }
+      }
+    }
+
+    // Twiddle factors for splitting the complex transform into the real one.
+    for (size_t bin = 0; bin <= half_; ++bin) {
+      auto theta = M_PI * double(bin) / double(half_);
+      splitReal_[bin] = AUValue(std::cos(theta));
+      splitImag_[bin] = AUValue(-std::sin(theta));
+    }
+  }
+
+  /// @returns the number of real samples in a transform
+  size_t size() const noexcept { return size_; }
+
+  /// @returns the number of frequency bins in a spectrum (DC through Nyquist)
+  size_t binCount() const noexcept { return half_ + 1; }
+
+  /**
+   Transform real samples into a spectrum.
+
+   @param input the `size()` samples to transform
+   @param re storage for the real parts of the `binCount()` bins
+   @param im storage for the imaginary parts of the `binCount()` bins
+   */
+  void forward(const AUValue* input, AUValue* re, AUValue* im) noexcept
+  {
+    // Treat even samples as the real part and odd samples as the imaginary part of a complex sequence.
+    for (size_t index = 0; index < half_; ++index) {
+      real_[index] = input[2 * index];
+      imag_[index] = input[2 * index + 1];
+    }
+
+    auto [zr, zi] = transform(real_.data(), imag_.data(), workReal_.data(), workImag_.data());
+
+    re[0] = zr[0] + zi[0];
+    im[0] = 0.0;
+    re[half_] = zr[0] - zi[0];
+    im[half_] = 0.0;
+    for (size_t bin = 1; bin < half_; ++bin) {
+      auto mirror = half_ - bin;
+      // Even and odd halves of the spectrum, each scaled by 2
+      AUValue evenRe = zr[bin] + zr[mirror];
+      AUValue evenIm = zi[bin] - zi[mirror];
+      AUValue oddRe = zi[bin] + zi[mirror];
+      AUValue oddIm = zr[mirror] - zr[bin];
+      re[bin] = 0.5f * (evenRe + oddRe * splitReal_[bin] - oddIm * splitImag_[bin]);
+      im[bin] = 0.5f * (evenIm + oddRe * splitImag_[bin] + oddIm * splitReal_[bin]);
+    }
+  }
+
+  /**
+   Transform a spectrum back into real samples. The result is scaled so that `inverse` of `forward` gives back the
+   original samples.
+
+   @param re the real parts of the `binCount()` bins
+   @param im the imaginary parts of the `binCount()` bins. The DC and Nyquist values are ignored.
+   @param output storage for the `size()` samples
+   */
+  void inverse(const AUValue* re, const AUValue* im, AUValue* output) noexcept
+  {
+    // Rebuild the complex sequence from its even and odd halves. Swapping the real and imaginary parts going in and
+    // coming out of the forward transform gives the inverse transform.
+    for (size_t bin = 0; bin < half_; ++bin) {
+      auto mirror = half_ - bin;
+      AUValue evenRe = re[bin] + re[mirror];
+      AUValue evenIm = bin == 0 ? 0.0f : im[bin] - im[mirror];
+      AUValue diffRe = re[bin] - re[mirror];
+      AUValue diffIm = bin == 0 ? 0.0f : im[bin] + im[mirror];
+      AUValue oddRe = diffRe * splitReal_[bin] + diffIm * splitImag_[bin];
+      AUValue oddIm = diffIm * splitReal_[bin] - diffRe * splitImag_[bin];
+      real_[bin] = evenIm + oddRe;
+      imag_[bin] = evenRe - oddIm;
+    }
+
+    auto [zi, zr] = transform(real_.data(), imag_.data(), workReal_.data(), workImag_.data());
+
+    AUValue scale = 0.5f / AUValue(half_);
+    for (size_t index = 0; index < half_; ++index) {
+      output[2 * index] = zr[index] * scale;
+      output[2 * index + 1] = zi[index] * scale;
+    }
+  }
+
+private:
+
+  /**
+   Perform a complex forward transform of `half_` values, using `yr` and `yi` as working storage.
+
+   @returns the pair of pointers (real and imaginary) that hold the result. These are either the `xr`/`xi` pair or the
+   `yr`/`yi` pair.
+   */
+  std::pair<const AUValue*, const AUValue*> transform(AUValue* xr, AUValue* xi, AUValue* yr, AUValue* yi) noexcept
+  {
+    const AUValue* twiddles = twiddles_.data();
+    size_t stride = 1;
+    size_t length = half_;
+    for (; length >= 4; length /= 4) {
+      radix4(length, stride, twiddles, xr, xi, yr, yi);
+      twiddles += 6 * (length / 4);
+      stride *= 4;
+      std::swap(xr, yr);
+      std::swap(xi, yi);
+    }
+
+    if (length == 2) {
+      for (size_t q = 0; q < stride; ++q) {
+        auto ar = xr[q];
+        auto ai = xi[q];
+        auto br = xr[q + stride];
+        auto bi = xi[q + stride];
+        yr[q] = ar + br;
+        yi[q] = ai + bi;
+        yr[q + stride] = ar - br;
+        yi[q + stride] = ai - bi;
+      }
+      std::swap(xr, yr);
+      std::swap(xi, yi);
+    }
+
+    return {xr, xi};
+  }
+
+  static void radix4(size_t length, size_t stride, const AUValue* twiddles, const AUValue* __restrict xr,
+                     const AUValue* __restrict xi, AUValue* __restrict yr, AUValue* __restrict yi) noexcept
+  {
+    auto quarter = length / 4;
+    for (size_t p = 0; p < quarter; ++p) {
+      auto w1r = twiddles[6 * p + 0];
+      auto w1i = twiddles[6 * p + 1];
+      auto w2r = twiddles[6 * p + 2];
+      auto w2i = twiddles[6 * p + 3];
+      auto w3r = twiddles[6 * p + 4];
+      auto w3i = twiddles[6 * p + 5];
+      const AUValue* ar = xr + stride * p;
+      const AUValue* ai = xi + stride * p;
+      const AUValue* br = ar + stride * quarter;
+      const AUValue* bi = ai + stride * quarter;
+      const AUValue* cr = br + stride * quarter;
+      const AUValue* ci = bi + stride * quarter;
+      const AUValue* dr = cr + stride * quarter;
+      const AUValue* di = ci + stride * quarter;
+      AUValue* y0r = yr + stride * 4 * p;
+      AUValue* y0i = yi + stride * 4 * p;
+      AUValue* y1r = y0r + stride;
+      AUValue* y1i = y0i + stride;
+      AUValue* y2r = y1r + stride;
+      AUValue* y2i = y1i + stride;
+      AUValue* y3r = y2r + stride;
+      AUValue* y3i = y2i + stride;
+      for (size_t q = 0; q < stride; ++q) {
+        auto apcR = ar[q] + cr[q];
+        auto apcI = ai[q] + ci[q];
+        auto amcR = ar[q] - cr[q];
+        auto amcI = ai[q] - ci[q];
+        auto bpdR = br[q] + dr[q];
+        auto bpdI = bi[q] + di[q];
+        // j * (b - d)
+        auto jbmdR = di[q] - bi[q];
+        auto jbmdI = br[q] - dr[q];
+
+        y0r[q] = apcR + bpdR;
+        y0i[q] = apcI + bpdI;
+
+        auto t1r = amcR - jbmdR;
+        auto t1i = amcI - jbmdI;
+        y1r[q] = t1r * w1r - t1i * w1i;
+        y1i[q] = t1r * w1i + t1i * w1r;
+
+        auto t2r = apcR - bpdR;
+        auto t2i = apcI - bpdI;
+        y2r[q] = t2r * w2r - t2i * w2i;
+        y2i[q] = t2r * w2i + t2i * w2r;
+
+        auto t3r = amcR + jbmdR;
+        auto t3i = amcI + jbmdI;
+        y3r[q] = t3r * w3r - t3i * w3i;
+        y3i[q] = t3r * w3i + t3i * w3r;
+      }
+    }
+  }
+
+  size_t size_;
+  size_t half_;
+  std::vector<AUValue> real_;
+  std::vector<AUValue> imag_;
+  std::vector<AUValue> workReal_;
+  std::vector<AUValue> workImag_;
+  std::vector<AUValue> twiddles_{};
+  std::vector<AUValue> splitReal_;
+  std::vector<AUValue> splitImag_;
+};
+
+/// Window functions to apply to samples before a `RealFFT`.
+enum struct Window {
+  /// Raised cosine. Overlapped copies at 1/2 or 1/4 of the size sum to a constant. Sidelobes fall from -31 dB.
+  hann,
+  /// 4-term Blackman-Harris. Sidelobes stay below -92 dB at the cost of a wider main lobe. Overlapped copies at 1/4
+  /// of the size sum to a constant.
+  blackmanHarris
+};
+
+/**
+ Generate window values. These are periodic (DFT-even) -- the sample that would make the window symmetric is left
+ off -- which is the form to use for spectral analysis and overlap-add.
+
+ @param kind the kind of window to make
+ @param size the number of values to make
+ @returns the window values
+ */
+inline std::vector<AUValue> makeWindow(Window kind, size_t size)
+{
+  std::vector<AUValue> values(size);
+  for (size_t index = 0; index < size; ++index) {
+    auto theta = 2.0 * M_PI * double(index) / double(size);
+    switch (kind) {
+      case Window::hann:
+        values[index] = AUValue(0.5 - 0.5 * std::cos(theta));
+        break;
+      case Window::blackmanHarris:
+        values[index] = AUValue(0.35875 - 0.48829 * std::cos(theta) + 0.14128 * std::cos(2.0 * theta) -
+                                0.01168 * std::cos(3.0 * theta));
+        break;
+    }
+  }
+  return values;
+}
+
+} // end namespace DSPHeaders
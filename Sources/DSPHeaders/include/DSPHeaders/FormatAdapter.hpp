@@ -0,0 +1,187 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <AudioToolbox/AudioToolbox.h>
+#import <AVFoundation/AVFoundation.h>
+
+#import "DSPHeaders/BufferFacet.hpp"
+#import "DSPHeaders/SampleBuffer.hpp"
+#import "DSPHeaders/SampleConversion.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Drives an `EventProcessor` kernel with interleaved float or integer samples instead of non-interleaved float buffers.
+ Input samples are decoded and deinterleaved straight into the kernel's input buffer by the pull-input block that the
+ adapter gives to `processAndRender`, and the rendered output is encoded and interleaved straight into the caller's
+ storage. Each direction is therefore a single conversion pass with no intermediate copies.
+
+ All buffers are allocated in `setRenderingFormat`. The `render` method does not allocate and is safe to call from a
+ render thread. The adapter only renders bus 0 of the kernel.
+ */
+class FormatAdapter {
+public:
+
+  /**
+   Construct new instance. The pull-input block is copied to the heap since a block literal only lives as long as the
+   scope that creates it.
+   */
+  FormatAdapter() noexcept {
+    pullInputBlock_ = [^AUAudioUnitStatus(AudioUnitRenderActionFlags*, const AudioTimeStamp*,
+                                          AUAudioFrameCount frameCount, NSInteger, AudioBufferList* inputData) {
+      return this->decodeInput(frameCount, inputData);
+    } copy];
+  }
+
+  /**
+   Destructor. Releases the copied pull-input block when not using ARC, which otherwise does it for us.
+   */
+  ~FormatAdapter() noexcept {
+#if !__has_feature(objc_arc)
+    [pullInputBlock_ release];
+#endif
+  }
+
+  // The pull-input block refers to `this` so instances cannot be copied or moved.
+  FormatAdapter(const FormatAdapter&) = delete;
+  FormatAdapter& operator =(const FormatAdapter&) = delete;
+
+  /**
+   Set the formats to use. The kernel must be configured with the same `format` in its own `setRenderingFormat`.
+
+   @param format the non-interleaved float format that the kernel renders with. Provides the channel count of the
+   interleaved data.
+   @param sampleType the type of the interleaved samples
+   @param maxFramesToRender the maximum number of frames to render in one `render` call
+   @returns `kAudioUnitErr_FormatNotSupported` if the format has more than `BusBuffers::MaxChannelCount` channels,
+   `kAudioUnitErr_FailedInitialization` if the sample buffer could not be allocated. Otherwise `noErr`.
+   */
+  AUAudioUnitStatus setRenderingFormat(AVAudioFormat* format, SampleConversion::SampleType sampleType,
+                                       AUAudioFrameCount maxFramesToRender) noexcept {
+    return setRenderingFormat(format, sampleType, sampleType, maxFramesToRender);
+  }
+
+  /**
+   Set the formats to use, with different sample types for the input and output data. The kernel must be configured
+   with the same `format` in its own `setRenderingFormat`.
+
+   @param format the non-interleaved float format that the kernel renders with. Provides the channel count of the
+   interleaved data.
+   @param inputSampleType the type of the interleaved input samples
+   @param outputSampleType the type of the interleaved output samples
+   @param maxFramesToRender the maximum number of frames to render in one `render` call
+   @returns `kAudioUnitErr_FormatNotSupported` if the format has more than `BusBuffers::MaxChannelCount` channels, in
+   which case nothing is changed. `kAudioUnitErr_FailedInitialization` if the sample buffer could not be allocated, in
+   which case `render` fails until a later call succeeds. Otherwise `noErr`.
+   */
+  AUAudioUnitStatus setRenderingFormat(AVAudioFormat* format, SampleConversion::SampleType inputSampleType,
+                                       SampleConversion::SampleType outputSampleType,
+                                       AUAudioFrameCount maxFramesToRender) noexcept {
+    auto channelCount{[format channelCount]};
+    if (channelCount > BusBuffers::MaxChannelCount) {
+      return kAudioUnitErr_FormatNotSupported;
+    }
+
+    try {
+      buffer_.allocate(format, maxFramesToRender);
+    } catch (...) {
+      // The old buffer may be gone, so render nothing until a format change succeeds.
+      if (buffer_.mutableAudioBufferList() != nullptr) buffer_.release();
+      outputFacet_.setChannelCount(0);
+      inputFacet_.setChannelCount(0);
+      return kAudioUnitErr_FailedInitialization;
+    }
+
+    inputSampleType_ = inputSampleType;
+    sampleType_ = outputSampleType;
+    outputFacet_.setChannelCount(channelCount);
+    outputFacet_.setBufferListUnchecked(buffer_.mutableAudioBufferList());
+    inputFacet_.setChannelCount(channelCount);
+    return noErr;
+  }
+
+  /**
+   Set the dither mode used when writing integer samples.
+
+   @param enabled if true add TPDF dither to samples before they are rounded to integers
+   */
+  void setDitherEnabled(bool enabled) noexcept { ditherEnabled_ = enabled; }
+
+  /// @returns true if TPDF dither is applied when writing integer samples
+  bool isDitherEnabled() const noexcept { return ditherEnabled_; }
+
+  /// @returns the type of the interleaved output samples
+  SampleConversion::SampleType sampleType() const noexcept { return sampleType_; }
+
+  /// @returns the type of the interleaved input samples
+  SampleConversion::SampleType inputSampleType() const noexcept { return inputSampleType_; }
+
+  /// @returns the number of bytes in one interleaved output frame
+  size_t bytesPerFrame() const noexcept {
+    return SampleConversion::bytesPerSample(sampleType_) * outputFacet_.channelCount();
+  }
+
+  /**
+   Render a number of frames from interleaved input to interleaved output.
+
+   @param kernel the `EventProcessor` kernel to render with
+   @param timestamp the timestamp of the first sample or the first event
+   @param frameCount the number of frames to process
+   @param realtimeEventListHead pointer to the first AURenderEvent (may be null)
+   @param input pointer to the interleaved input samples, or nullptr if the kernel does not take any input
+   @param output pointer to the storage for the interleaved output samples
+   @returns `kAudioUnitErr_Uninitialized` if no format has been set successfully, otherwise the status from the kernel
+   */
+  template <typename Kernel>
+  AUAudioUnitStatus render(Kernel& kernel, const AudioTimeStamp* timestamp, AUAudioFrameCount frameCount,
+                           const AURenderEvent* realtimeEventListHead, const void* input, void* output) noexcept {
+    if (buffer_.mutableAudioBufferList() == nullptr) {
+      return kAudioUnitErr_Uninitialized;
+    }
+    if (frameCount > buffer_.capacity()) {
+      return kAudioUnitErr_TooManyFramesToProcess;
+    }
+
+    input_ = input;
+    outputFacet_.setFrameCountUnchecked(frameCount);
+    auto status = kernel.processAndRender(timestamp, frameCount, 0, buffer_.mutableAudioBufferList(),
+                                          realtimeEventListHead, input != nullptr ? pullInputBlock_ : nil);
+    input_ = nullptr;
+    if (status != noErr) {
+      return status;
+    }
+
+    if (ditherEnabled_) {
+      SampleConversion::interleave(sampleType_, outputFacet_.busBuffers(), output, frameCount, dither_);
+    } else {
+      SampleConversion::interleave(sampleType_, outputFacet_.busBuffers(), output, frameCount);
+    }
+
+    return noErr;
+  }
+
+private:
+
+  AUAudioUnitStatus decodeInput(AUAudioFrameCount frameCount, AudioBufferList* inputData) noexcept {
+    if (input_ == nullptr) {
+      return kAudioUnitErr_NoConnection;
+    }
+
+    inputFacet_.setBufferListUnchecked(inputData);
+    SampleConversion::deinterleave(inputSampleType_, input_, inputFacet_.busBuffers(), frameCount);
+    return noErr;
+  }
+
+  SampleBuffer buffer_{};
+  BufferFacet outputFacet_{};
+  BufferFacet inputFacet_{};
+  AURenderPullInputBlock pullInputBlock_;
+  SampleConversion::TPDFDither dither_{};
+  SampleConversion::SampleType sampleType_{SampleConversion::SampleType::float32};
+  SampleConversion::SampleType inputSampleType_{SampleConversion::SampleType::float32};
+  const void* input_{nullptr};
+  bool ditherEnabled_{false};
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,378 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <array>
+#import <atomic>
+#import <cassert>
+#import <cmath>
+#import <cstdint>
+#import <limits>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/Biquad.hpp"
+#import "DSPHeaders/BusBuffers.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Level and loudness meter to run from a kernel's `doRendering`, with results read from another thread (e.g. a UI timer).
+
+ The render thread gives each rendered block to `process`. The meter works in 100 ms steps, and at the end of each
+ step it publishes a new `Readings` value:
+
+ - sample peak of each channel since the previous readings, plus the largest peak since the last reset
+ - RMS level of each channel over the last 400 ms
+ - momentary (400 ms), short-term (3 s), and gated integrated loudness in LUFS as defined by ITU-R BS.1770, with the
+ K-weighting done by two `Biquad` filters per channel
+ - correlation of the first two channels over the last 400 ms (+1 is mono, 0 is unrelated, -1 is out of phase)
+
+ The peak and power sums for a block are made with loops that keep four running values so that the compiler can
+ vectorize them. For the integrated loudness, the 400 ms gating blocks are kept in a fixed histogram of 0.1 LU bins
+ instead of a list that would grow without end, so the relative gate has a resolution of 0.1 LU.
+
+ Readings move to the reader through a triple buffer: the render thread fills a spare slot and swaps it with the
+ middle one using a single atomic exchange, and the reader does the same to pick up the newest one. Neither side ever
+ waits for the other, and there is no allocation after construction. There must only be one reading thread.
+ */
+class Meter {
+public:
+
+  /// The level reported for silence.
+  inline static constexpr AUValue Silence = -std::numeric_limits<AUValue>::infinity();
+
+  /// Lowest loudness in LUFS of a gating block that counts towards the integrated loudness.
+  inline static constexpr double AbsoluteGate = -70.0;
+
+  /// Gating blocks more than this many LU below the ungated loudness do not count towards the integrated loudness.
+  inline static constexpr double RelativeGate = 10.0;
+
+  /// Results of the metering.
+  struct Readings {
+    /// Number of channels being metered
+    size_t channelCount{0};
+    /// Largest sample magnitude of each channel since the previous readings (dBFS)
+    std::array<AUValue, BusBuffers::MaxChannelCount> peak{};
+    /// Largest sample magnitude of each channel since the meter was reset (dBFS)
+    std::array<AUValue, BusBuffers::MaxChannelCount> peakHold{};
+    /// RMS level of each channel over the last 400 ms (dBFS)
+    std::array<AUValue, BusBuffers::MaxChannelCount> rms{};
+    /// Loudness over the last 400 ms (LUFS)
+    AUValue momentary{Silence};
+    /// Loudness over the last 3 s (LUFS)
+    AUValue shortTerm{Silence};
+    /// Gated loudness since the meter was reset (LUFS)
+    AUValue integrated{Silence};
+    /// Correlation of the first two channels over the last 400 ms
+    AUValue correlation{0.0};
+    /// Number of readings published since the meter was reset
+    uint64_t count{0};
+  };
+
+  /**
+   Obtain the coefficients of the first K-weighting stage, a high shelf that models the acoustic effect of the head.
+
+   @param sampleRate the sample rate being used
+   @returns filter coefficients
+   */
+  static Biquad::Coefficients<double> kWeightingShelf(double sampleRate) noexcept
+  {
+    constexpr double frequency = 1681.974450955533;
+    constexpr double gain = 3.999843853973347;
+    constexpr double q = 0.7071752369554196;
+    auto k = std::tan(M_PI * frequency / sampleRate);
+    auto vh = std::pow(10.0, gain / 20.0);
+    auto vb = std::pow(vh, 0.4996667741545416);
+    auto scale = 1.0 / (1.0 + k / q + k * k);
+    return {(vh + vb * k / q + k * k) * scale, 2.0 * (k * k - vh) * scale, (vh - vb * k / q + k * k) * scale,
+      2.0 * (k * k - 1.0) * scale, (1.0 - k / q + k * k) * scale};
+  }
+
+  /**
+   Obtain the coefficients of the second K-weighting stage, the RLB high-pass filter.
+
+   @param sampleRate the sample rate being used
+   @returns filter coefficients
+   */
+  static Biquad::Coefficients<double> kWeightingHighPass(double sampleRate) noexcept
+  {
+    constexpr double frequency = 38.13547087602444;
+    constexpr double q = 0.5003270373238773;
+    auto k = std::tan(M_PI * frequency / sampleRate);
+    auto scale = 1.0 / (1.0 + k / q + k * k);
+    return {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) * scale, (1.0 - k / q + k * k) * scale};
+  }
+
+  /// Construct a new instance. Use `setRenderingFormat` before processing any samples.
+  Meter() noexcept { channelWeights_.fill(1.0); }
+
+  /**
+   Set up for rendering and reset the meter. Does not allocate.
+
+   @param sampleRate the sample rate of the samples to meter
+   @param channelCount the number of channels to meter
+   */
+  void setRenderingFormat(double sampleRate, size_t channelCount) noexcept
+  {
+    assert(channelCount <= BusBuffers::MaxChannelCount);
+    channelCount_ = channelCount;
+    stepFrames_ = std::max<AUAudioFrameCount>(1, AUAudioFrameCount(std::round(sampleRate * 0.1)));
+    auto shelf = kWeightingShelf(sampleRate);
+    auto highPass = kWeightingHighPass(sampleRate);
+    for (size_t channel = 0; channel < BusBuffers::MaxChannelCount; ++channel) {
+      shelves_[channel].setCoefficients(shelf);
+      highPasses_[channel].setCoefficients(highPass);
+    }
+    reset();
+  }
+
+  /**
+   Set the weight of a channel in the loudness sum. BS.1770 uses 1.0 for the left, right, and center channels, 1.41 for
+   the surround channels, and 0.0 for the LFE channel. All channels start with 1.0.
+
+   @param channel the channel to change
+   @param weight the new weight
+   */
+  void setChannelWeight(size_t channel, AUValue weight) noexcept { channelWeights_.at(channel) = weight; }
+
+  /**
+   Clear all measurements, including the integrated loudness. Must be called from the render thread (or when not
+   rendering) -- other threads should use `requestReset`.
+   */
+  void reset() noexcept
+  {
+    for (size_t channel = 0; channel < BusBuffers::MaxChannelCount; ++channel) {
+      shelves_[channel].reset();
+      highPasses_[channel].reset();
+    }
+    steps_.fill(Step{});
+    stepIndex_ = 0;
+    current_ = Step{};
+    stepRemaining_ = stepFrames_;
+    peaks_.fill(0.0);
+    peakHolds_.fill(0.0);
+    histogram_.fill(Bin{});
+    published_ = 0;
+  }
+
+  /**
+   Ask the render thread to reset the meter at the start of its next `process` call. Safe to call from any thread.
+   */
+  void requestReset() noexcept { resetRequested_.store(true, std::memory_order_release); }
+
+  /**
+   Meter a block of samples. Only to be called from the render thread.
+
+   @param ins the samples to meter
+   @param frameCount the number of frames in the block
+   */
+  void process(BusBuffers ins, AUAudioFrameCount frameCount) noexcept
+  {
+    if (resetRequested_.exchange(false, std::memory_order_acquire)) reset();
+    auto channelCount = std::min(ins.size(), channelCount_);
+    AUAudioFrameCount offset = 0;
+    while (offset < frameCount) {
+      auto count = std::min(frameCount - offset, stepRemaining_);
+      accumulate(ins, channelCount, offset, count);
+      offset += count;
+      stepRemaining_ -= count;
+      if (stepRemaining_ == 0) {
+        finishStep(channelCount);
+        stepRemaining_ = stepFrames_;
+      }
+    }
+  }
+
+  /**
+   Obtain the newest readings. Only one thread may call this.
+
+   @param readings where to store the readings. Left unchanged if there is nothing new.
+   @returns true if there were new readings since the last call
+   */
+  bool readings(Readings& readings) noexcept
+  {
+    if ((middle_.load(std::memory_order_relaxed) & Fresh) == 0) return false;
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & SlotMask;
+    readings = slots_[front_];
+    return true;
+  }
+
+private:
+
+  inline static constexpr size_t Fresh = 4;
+  inline static constexpr size_t SlotMask = 3;
+
+  /// Momentary loudness covers 4 steps, short-term loudness 30.
+  inline static constexpr size_t MomentarySteps = 4;
+  inline static constexpr size_t ShortTermSteps = 30;
+
+  /// Integrated loudness histogram spans [-70, +10) LUFS in 0.1 LU bins.
+  inline static constexpr double BinsPerLU = 10.0;
+  inline static constexpr size_t BinCount = 800;
+
+  /// Sums for one 100 ms step.
+  struct Step {
+    double loudnessPower{0.0};
+    std::array<double, BusBuffers::MaxChannelCount> power{};
+    double crossPower{0.0};
+  };
+
+  /// Gating blocks in one histogram bin.
+  struct Bin {
+    uint64_t count{0};
+    double power{0.0};
+  };
+
+  static double toDecibels(double power) noexcept { return 10.0 * std::log10(power); }
+  static double toLoudness(double power) noexcept { return -0.691 + 10.0 * std::log10(power); }
+
+  void accumulate(BusBuffers ins, size_t channelCount, AUAudioFrameCount offset, AUAudioFrameCount count) noexcept
+  {
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      const AUValue* samples = ins[channel] + offset;
+
+      // Four running peaks and sums so that the loop vectorizes without reordering floating-point additions.
+      AUValue peaks[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      AUValue sums[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      AUAudioFrameCount frame = 0;
+      for (; frame + 4 <= count; frame += 4) {
+        for (size_t lane = 0; lane < 4; ++lane) {
+          auto sample = samples[frame + lane];
+          peaks[lane] = std::max(peaks[lane], std::abs(sample));
+          sums[lane] += sample * sample;
+        }
+      }
+      for (; frame < count; ++frame) {
+        peaks[0] = std::max(peaks[0], std::abs(samples[frame]));
+        sums[0] += samples[frame] * samples[frame];
+      }
+      peaks_[channel] = std::max({peaks_[channel], peaks[0], peaks[1], peaks[2], peaks[3]});
+      current_.power[channel] += double((sums[0] + sums[1]) + (sums[2] + sums[3]));
+
+      // K-weighting needs the full precision of the filter state, so it runs in double.
+      auto& shelf = shelves_[channel];
+      auto& highPass = highPasses_[channel];
+      double weighted = 0.0;
+      for (frame = 0; frame < count; ++frame) {
+        auto value = highPass.transform(shelf.transform(samples[frame]));
+        weighted += value * value;
+      }
+      current_.loudnessPower += channelWeights_[channel] * weighted;
+    }
+
+    if (channelCount > 1) {
+      const AUValue* left = ins[0] + offset;
+      const AUValue* right = ins[1] + offset;
+      AUValue sums[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+      AUAudioFrameCount frame = 0;
+      for (; frame + 4 <= count; frame += 4) {
+        for (size_t lane = 0; lane < 4; ++lane) sums[lane] += left[frame + lane] * right[frame + lane];
+      }
+      for (; frame < count; ++frame) sums[0] += left[frame] * right[frame];
+      current_.crossPower += double((sums[0] + sums[1]) + (sums[2] + sums[3]));
+    }
+  }
+
+  void finishStep(size_t channelCount) noexcept
+  {
+    steps_[stepIndex_] = current_;
+    stepIndex_ = (stepIndex_ + 1) % ShortTermSteps;
+    current_ = Step{};
+
+    Step momentary = sumSteps(MomentarySteps);
+    Step shortTerm = sumSteps(ShortTermSteps);
+    auto momentaryFrames = double(MomentarySteps * stepFrames_);
+    auto gatingPower = momentary.loudnessPower / momentaryFrames;
+    // Gating blocks only start once there is a full 400 ms of samples.
+    if (published_ + 1 >= MomentarySteps) addGatingBlock(gatingPower);
+
+    auto& readings = slots_[back_];
+    readings.channelCount = channelCount;
+    for (size_t channel = 0; channel < BusBuffers::MaxChannelCount; ++channel) {
+      auto peak = channel < channelCount ? peaks_[channel] : 0.0f;
+      peakHolds_[channel] = std::max(peakHolds_[channel], peak);
+      readings.peak[channel] = AUValue(20.0 * std::log10(peak));
+      readings.peakHold[channel] = AUValue(20.0 * std::log10(peakHolds_[channel]));
+      readings.rms[channel] = AUValue(toDecibels(momentary.power[channel] / momentaryFrames));
+    }
+    peaks_.fill(0.0);
+
+    readings.momentary = AUValue(toLoudness(gatingPower));
+    readings.shortTerm = AUValue(toLoudness(shortTerm.loudnessPower / double(ShortTermSteps * stepFrames_)));
+    readings.integrated = integratedLoudness();
+    auto energy = momentary.power[0] * momentary.power[1];
+    readings.correlation = energy > 0.0 ? AUValue(momentary.crossPower / std::sqrt(energy)) : 0.0f;
+    readings.count = ++published_;
+
+    back_ = middle_.exchange(back_ | Fresh, std::memory_order_acq_rel) & SlotMask;
+  }
+
+  Step sumSteps(size_t count) const noexcept
+  {
+    Step sum;
+    for (size_t step = 0; step < count; ++step) {
+      const auto& entry = steps_[(stepIndex_ + ShortTermSteps - 1 - step) % ShortTermSteps];
+      sum.loudnessPower += entry.loudnessPower;
+      for (size_t channel = 0; channel < BusBuffers::MaxChannelCount; ++channel) {
+        sum.power[channel] += entry.power[channel];
+      }
+      sum.crossPower += entry.crossPower;
+    }
+    return sum;
+  }
+
+  void addGatingBlock(double power) noexcept
+  {
+    auto loudness = toLoudness(power);
+    if (!(loudness > AbsoluteGate)) return;
+    auto bin = std::min(size_t((loudness - AbsoluteGate) * BinsPerLU), BinCount - 1);
+    histogram_[bin].count += 1;
+    histogram_[bin].power += power;
+  }
+
+  AUValue integratedLoudness() const noexcept
+  {
+    uint64_t count = 0;
+    double power = 0.0;
+    for (const auto& bin : histogram_) {
+      count += bin.count;
+      power += bin.power;
+    }
+    if (count == 0) return Silence;
+
+    auto gate = toLoudness(power / double(count)) - RelativeGate;
+    auto first = size_t(std::clamp((gate - AbsoluteGate) * BinsPerLU, 0.0, double(BinCount)));
+    count = 0;
+    power = 0.0;
+    for (size_t bin = first; bin < BinCount; ++bin) {
+      count += histogram_[bin].count;
+      power += histogram_[bin].power;
+    }
+    return count > 0 ? AUValue(toLoudness(power / double(count))) : Silence;
+  }
+
+  size_t channelCount_{0};
+  AUAudioFrameCount stepFrames_{4'800};
+  AUAudioFrameCount stepRemaining_{4'800};
+  std::array<AUValue, BusBuffers::MaxChannelCount> channelWeights_{};
+  std::array<Biquad::Direct<double>, BusBuffers::MaxChannelCount> shelves_{};
+  std::array<Biquad::Direct<double>, BusBuffers::MaxChannelCount> highPasses_{};
+
+  std::array<Step, ShortTermSteps> steps_{};
+  size_t stepIndex_{0};
+  Step current_{};
+  std::array<AUValue, BusBuffers::MaxChannelCount> peaks_{};
+  std::array<AUValue, BusBuffers::MaxChannelCount> peakHolds_{};
+  std::array<Bin, BinCount> histogram_{};
+  uint64_t published_{0};
+
+  std::array<Readings, 3> slots_{};
+  size_t back_{0};
+  size_t front_{1};
+  std::atomic<size_t> middle_{2};
+  std::atomic<bool> resetRequested_{false};
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,271 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cassert>
+#import <cmath>
+#import <utility>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/PercentageParameter.hpp"
+
+/**
+ Block operations for mixing the samples of `BusBuffers` collections. Each operation works on one channel at a time with
+ simple loops over contiguous samples which the compiler can vectorize. Sources and destinations may be the same
+ buffers (in-place rendering), but they must not partially overlap.
+
+ When channel counts differ, only the channels common to both collections are processed. The `Reference` namespace
+ holds straightforward per-frame versions of each operation that serve as the definition of correct behavior.
+ */
+namespace DSPHeaders::Mixer {
+
+/**
+ Obtain the left and right gains for a constant-power (sin/cos) pan law.
+
+ @param pan the pan position in range [-1, +1] where -1 is full left and +1 is full right
+ @returns pair of left and right gains
+ */
+inline std::pair<AUValue, AUValue> panGains(AUValue pan) noexcept {
+  auto theta = (std::clamp(pan, AUValue(-1.0), AUValue(1.0)) + AUValue(1.0)) * AUValue(M_PI / 4.0);
+  return {std::cos(theta), std::sin(theta)};
+}
+
+/**
+ Scale the samples of a bus in place.
+
+ @param bus the buffers to modify
+ @param gain the value to multiply with
+ @param frameCount the number of frames to process
+ */
+inline void scale(BusBuffers bus, AUValue gain, AUAudioFrameCount frameCount) noexcept {
+  for (size_t channel = 0; channel < bus.size(); ++channel) {
+    AUValue* samples = bus[channel];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      samples[frame] *= gain;
+    }
+  }
+}
+
+/**
+ Copy samples from one bus to another, scaling them along the way.
+
+ @param source the buffers to read from
+ @param destination the buffers to write to
+ @param gain the value to multiply with
+ @param frameCount the number of frames to process
+ */
+inline void scaledCopy(BusBuffers source, BusBuffers destination, AUValue gain, AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min(source.size(), destination.size());
+  for (size_t channel = 0; channel < channelCount; ++channel) {
+    const AUValue* in = source[channel];
+    AUValue* out = destination[channel];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      out[frame] = in[frame] * gain;
+    }
+  }
+}
+
+/**
+ Add scaled samples from one bus to the samples of another.
+
+ @param source the buffers to read from
+ @param destination the buffers to add to
+ @param gain the value to multiply the source samples with
+ @param frameCount the number of frames to process
+ */
+inline void multiplyAccumulate(BusBuffers source, BusBuffers destination, AUValue gain,
+                               AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min(source.size(), destination.size());
+  for (size_t channel = 0; channel < channelCount; ++channel) {
+    const AUValue* in = source[channel];
+    AUValue* out = destination[channel];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      out[frame] += in[frame] * gain;
+    }
+  }
+}
+
+/**
+ Write panned samples into a stereo bus using a constant-power pan law. A mono source is panned across both output
+ channels; with a stereo source the pan acts as a balance control on the left and right channels.
+
+ @param source the buffers to read from (mono or stereo)
+ @param destination the stereo buffers to write to. Either channel may be a source buffer.
+ @param pan the pan position in range [-1, +1]
+ @param frameCount the number of frames to process
+ */
+inline void constantPowerPan(BusBuffers source, BusBuffers destination, AUValue pan,
+                             AUAudioFrameCount frameCount) noexcept {
+  assert(destination.isStereo() && source.isValid());
+  auto [leftGain, rightGain] = panGains(pan);
+  const AUValue* leftIn = source[0];
+  const AUValue* rightIn = source.isStereo() ? source[1] : source[0];
+  AUValue* leftOut = destination[0];
+  AUValue* rightOut = destination[1];
+
+  // Read both inputs before writing either output so that any source buffer may also be a destination buffer.
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    auto left = leftIn[frame];
+    auto right = rightIn[frame];
+    leftOut[frame] = left * leftGain;
+    rightOut[frame] = right * rightGain;
+  }
+}
+
+/**
+ Mix dry and wet buffers into a destination according to a wet/dry percentage. When the mix parameter is ramping, the
+ ramped frames are processed one frame at a time so that all channels see the same mix value; the rest of the frames
+ are processed in blocks.
+
+ @param dry the buffers with the unprocessed samples
+ @param wet the buffers with the processed samples
+ @param destination the buffers to write to (may be the same as `dry` or `wet`)
+ @param mix the wet percentage. A value of 0% gives all dry, 100% all wet.
+ @param frameCount the number of frames to process
+ */
+template <typename T>
+void crossfade(BusBuffers dry, BusBuffers wet, BusBuffers destination, Parameters::PercentageParameter<T>& mix,
+               AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min({dry.size(), wet.size(), destination.size()});
+  AUAudioFrameCount frame = 0;
+  for (; frame < frameCount && mix.isRamping(); ++frame) {
+    auto amount = AUValue(mix.frameValue());
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      auto drySample = dry[channel][frame];
+      destination[channel][frame] = drySample + amount * (wet[channel][frame] - drySample);
+    }
+  }
+
+  auto amount = AUValue(mix.normalized());
+  for (size_t channel = 0; channel < channelCount; ++channel) {
+    const AUValue* drySamples = dry[channel];
+    const AUValue* wetSamples = wet[channel];
+    AUValue* out = destination[channel];
+    for (AUAudioFrameCount index = frame; index < frameCount; ++index) {
+      out[index] = drySamples[index] + amount * (wetSamples[index] - drySamples[index]);
+    }
+  }
+}
+
+/**
+ Scale the samples of a bus in place, using one gain for even (0 (L), 2, 4...) channels and another for odd
+ (1 (R), 3, 5...) channels.
+
+ @param bus the buffers to modify
+ @param evenGain the gain for even channels
+ @param oddGain the gain for odd channels
+ @param frameCount the number of frames to process
+ */
+inline void scaleAlternating(BusBuffers bus, AUValue evenGain, AUValue oddGain, AUAudioFrameCount frameCount) noexcept {
+  for (size_t channel = 0; channel < bus.size(); ++channel) {
+    auto gain = (channel % 2) ? oddGain : evenGain;
+    AUValue* samples = bus[channel];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      samples[frame] *= gain;
+    }
+  }
+}
+
+/**
+ Add scaled samples from one bus to another, using one gain for even (0 (L), 2, 4...) channels and another for odd
+ (1 (R), 3, 5...) channels.
+
+ @param source the buffers to read from
+ @param destination the buffers to add to
+ @param evenGain the gain for even channels
+ @param oddGain the gain for odd channels
+ @param frameCount the number of frames to process
+ */
+inline void multiplyAccumulateAlternating(BusBuffers source, BusBuffers destination, AUValue evenGain, AUValue oddGain,
+                                          AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min(source.size(), destination.size());
+  for (size_t channel = 0; channel < channelCount; ++channel) {
+    auto gain = (channel % 2) ? oddGain : evenGain;
+    const AUValue* in = source[channel];
+    AUValue* out = destination[channel];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      out[frame] += in[frame] * gain;
+    }
+  }
+}
+
+/**
+ Scalar, per-frame implementations of the above operations.
+ */
+namespace Reference {
+
+inline void scale(BusBuffers bus, AUValue gain, AUAudioFrameCount frameCount) noexcept {
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < bus.size(); ++channel) {
+      bus[channel][frame] *= gain;
+    }
+  }
+}
+
+inline void scaledCopy(BusBuffers source, BusBuffers destination, AUValue gain, AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min(source.size(), destination.size());
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      destination[channel][frame] = source[channel][frame] * gain;
+    }
+  }
+}
+
+inline void multiplyAccumulate(BusBuffers source, BusBuffers destination, AUValue gain,
+                               AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min(source.size(), destination.size());
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      destination[channel][frame] += source[channel][frame] * gain;
+    }
+  }
+}
+
+inline void constantPowerPan(BusBuffers source, BusBuffers destination, AUValue pan,
+                             AUAudioFrameCount frameCount) noexcept {
+  auto [leftGain, rightGain] = panGains(pan);
+  size_t rightChannel = source.isStereo() ? 1 : 0;
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    auto left = source[0][frame];
+    auto right = source[rightChannel][frame];
+    destination[0][frame] = left * leftGain;
+    destination[1][frame] = right * rightGain;
+  }
+}
+
+template <typename T>
+void crossfade(BusBuffers dry, BusBuffers wet, BusBuffers destination, Parameters::PercentageParameter<T>& mix,
+               AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min({dry.size(), wet.size(), destination.size()});
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    auto amount = AUValue(mix.frameValue());
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      destination[channel][frame] = dry[channel][frame] * (1.0f - amount) + wet[channel][frame] * amount;
+    }
+  }
+}
+
+inline void scaleAlternating(BusBuffers bus, AUValue evenGain, AUValue oddGain, AUAudioFrameCount frameCount) noexcept {
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < bus.size(); ++channel) {
+      bus[channel][frame] *= (channel % 2) ? oddGain : evenGain;
+    }
+  }
+}
+
+inline void multiplyAccumulateAlternating(BusBuffers source, BusBuffers destination, AUValue evenGain, AUValue oddGain,
+                                          AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = std::min(source.size(), destination.size());
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      destination[channel][frame] += source[channel][frame] * ((channel % 2) ? oddGain : evenGain);
+    }
+  }
+}
+
+} // end namespace Reference
+
+} // end namespace DSPHeaders::Mixer
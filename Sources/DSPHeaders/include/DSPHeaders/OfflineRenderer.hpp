@@ -0,0 +1,245 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <chrono>
+#import <condition_variable>
+#import <exception>
+#import <mutex>
+#import <optional>
+#import <string>
+#import <thread>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+#import <AVFoundation/AVFoundation.h>
+
+#import "DSPHeaders/FormatAdapter.hpp"
+#import "DSPHeaders/ParameterAutomation.hpp"
+#import "DSPHeaders/WaveFile.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Renders a WAVE file through an `EventProcessor` kernel as fast as possible, writing the result to another WAVE file.
+ Used for regression rendering and for measuring how many times faster than real time a kernel runs.
+
+ The input file is memory-mapped and converted straight into the kernel's input buffer by a `FormatAdapter`. Output
+ samples are gathered into one of two staging buffers while a separate thread writes the other one to disk, so file
+ writes overlap with rendering. Parameter changes can be given as a `ParameterAutomation` instance.
+
+ An instance keeps its adapter and staging buffers between renders, so rendering many files with the same instance
+ only allocates when the format grows. Instances are not thread-safe; use one per thread.
+
+ File problems throw `std::runtime_error`, as do a format the kernel does not support and a kernel render call that
+ returns an error.
+ */
+class OfflineRenderer {
+public:
+
+  /// Settings for a render.
+  struct Options {
+    /// The number of frames to render in one `processAndRender` call
+    AUAudioFrameCount blockSize{512};
+    /// The number of blocks to gather before handing them off to the writer thread
+    size_t blocksPerWrite{64};
+    /// The sample type of the output file. If not set, use the sample type of the input file.
+    std::optional<SampleConversion::SampleType> outputSampleType{};
+    /// If true apply TPDF dither when writing integer samples
+    bool dither{false};
+  };
+
+  /// Summary of a render.
+  struct Result {
+    /// The number of frames rendered
+    AUAudioFrameCount frameCount{0};
+    /// The duration of the audio that was rendered
+    double audioSeconds{0.0};
+    /// The wall-clock time taken by the render, including file I/O
+    double elapsedSeconds{0.0};
+
+    /// @returns how many times faster than real time the render was
+    double realtimeFactor() const noexcept { return elapsedSeconds > 0.0 ? audioSeconds / elapsedSeconds : 0.0; }
+  };
+
+  /**
+   Construct new instance with default settings.
+   */
+  OfflineRenderer() : OfflineRenderer(Options{}) {}
+
+  /**
+   Construct new instance.
+
+   @param options the render settings
+   */
+  explicit OfflineRenderer(const Options& options) : options_{options} {
+    options_.blockSize = std::max<AUAudioFrameCount>(options_.blockSize, 1);
+    options_.blocksPerWrite = std::max<size_t>(options_.blocksPerWrite, 1);
+  }
+
+  /// @returns the render settings
+  const Options& options() const noexcept { return options_; }
+
+  /**
+   Render a file through a kernel. The kernel is configured for the format of the input file, and `renderingStopped`
+   is called on it when done, so the same kernel can be used for another render afterwards.
+
+   @param kernel the `EventProcessor` kernel to render with
+   @param input the file to render
+   @param outputPath the location of the file to write
+   @param automation the parameter changes to apply during the render
+   @returns summary of the render
+   */
+  template <typename Kernel>
+  Result render(Kernel& kernel, const WaveFileReader& input, const std::string& outputPath,
+                ParameterAutomation& automation) {
+    auto blockSize = options_.blockSize;
+    auto outputType = options_.outputSampleType.value_or(input.sampleType());
+    AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:input.sampleRate()
+                                                                           channels:input.channelCount()];
+    if (kernel.setRenderingFormat(1, format, blockSize) != noErr ||
+        adapter_.setRenderingFormat(format, input.sampleType(), outputType, blockSize) != noErr) {
+      throw std::runtime_error("unsupported channel count " + std::to_string(input.channelCount()));
+    }
+    adapter_.setDitherEnabled(options_.dither);
+
+    auto startTime = std::chrono::steady_clock::now();
+    AUAudioFrameCount position = 0;
+    try {
+      WaveFileWriter file{outputPath, input.sampleRate(), input.channelCount(), outputType};
+      StagingWriter staging{file, staging_, adapter_.bytesPerFrame(), size_t(blockSize) * options_.blocksPerWrite};
+      AudioTimeStamp timestamp = AudioTimeStamp();
+      while (position < input.frameCount()) {
+        auto frameCount = std::min(blockSize, input.frameCount() - position);
+        timestamp.mSampleTime = position;
+        auto events = automation.eventsFor(AUEventSampleTime(position), frameCount);
+        auto status = adapter_.render(kernel, &timestamp, frameCount, events, input.frames(position),
+                                      staging.reserve(frameCount));
+        if (status != noErr) {
+          throw std::runtime_error("render failed with status " + std::to_string(status));
+        }
+        position += frameCount;
+      }
+      staging.finish();
+      file.close();
+    } catch (...) {
+      kernel.renderingStopped();
+      throw;
+    }
+
+    kernel.renderingStopped();
+
+    Result result;
+    result.frameCount = position;
+    result.audioSeconds = double(position) / input.sampleRate();
+    result.elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    return result;
+  }
+
+private:
+  using StagingBuffers = std::vector<uint8_t>[2];
+
+  /**
+   Gathers output frames into one of two buffers. When a buffer is full, it is handed to a thread that writes it to
+   the file while the other buffer is filled.
+   */
+  class StagingWriter {
+  public:
+    StagingWriter(WaveFileWriter& file, StagingBuffers& buffers, size_t bytesPerFrame, size_t capacity)
+    : file_{file}, buffers_{buffers}, bytesPerFrame_{bytesPerFrame}, capacity_{capacity}, thread_{}
+    {
+      for (auto& buffer : buffers_) {
+        if (buffer.size() < capacity_ * bytesPerFrame_) buffer.resize(capacity_ * bytesPerFrame_);
+      }
+      thread_ = std::thread([this]() { run(); });
+    }
+
+    ~StagingWriter() noexcept { stop(); }
+
+    /**
+     Obtain space for the given number of frames in the buffer being filled. Throws any error from the writer thread.
+
+     @param frameCount the number of frames to hold. Must not be larger than the capacity.
+     @returns pointer to the space for the frames
+     */
+    void* reserve(AUAudioFrameCount frameCount) {
+      if (used_ + frameCount > capacity_) {
+        flush();
+        if (error_) std::rethrow_exception(error_);
+      }
+      auto ptr = buffers_[current_].data() + used_ * bytesPerFrame_;
+      used_ += frameCount;
+      return ptr;
+    }
+
+    /**
+     Write out any remaining frames and stop the writer thread. Throws any error from the writer thread.
+     */
+    void finish() {
+      flush();
+      stop();
+      if (error_) std::rethrow_exception(error_);
+    }
+
+  private:
+
+    void flush() noexcept {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this]() { return pendingFrames_ == 0; });
+      if (used_ == 0 || error_) return;
+      pending_ = current_;
+      pendingFrames_ = used_;
+      current_ = 1 - current_;
+      used_ = 0;
+      condition_.notify_all();
+    }
+
+    void stop() noexcept {
+      if (!thread_.joinable()) return;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_ = true;
+      }
+      condition_.notify_all();
+      thread_.join();
+    }
+
+    void run() noexcept {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (true) {
+        condition_.wait(lock, [this]() { return pendingFrames_ > 0 || done_; });
+        if (pendingFrames_ == 0) return;
+        lock.unlock();
+        try {
+          file_.write(buffers_[pending_].data(), AUAudioFrameCount(pendingFrames_));
+        } catch (...) {
+          error_ = std::current_exception();
+        }
+        lock.lock();
+        pendingFrames_ = 0;
+        condition_.notify_all();
+      }
+    }
+
+    WaveFileWriter& file_;
+    StagingBuffers& buffers_;
+    size_t bytesPerFrame_;
+    size_t capacity_;
+    size_t current_{0};
+    size_t used_{0};
+    size_t pending_{0};
+    size_t pendingFrames_{0};
+    bool done_{false};
+    std::exception_ptr error_{};
+    std::mutex mutex_{};
+    std::condition_variable condition_{};
+    std::thread thread_;
+  };
+
+  Options options_;
+  FormatAdapter adapter_{};
+  StagingBuffers staging_{};
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,287 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cmath>
+#import <stdexcept>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/DSP.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Runs a nonlinear kernel (waveshaper, saturator, etc.) at 2, 4, or 8 times the rendering sample rate so that the
+ harmonics it creates do not alias back into the audible band.
+
+ The rate changes are done by a cascade of polyphase half-band FIR stages, each of which doubles (or halves) the rate.
+ Half of the taps of a half-band filter are zero, so each stage is split into its two polyphase branches: one is a
+ short FIR and the other is just a delay. The first stage, which has to keep the full audio band, has the longest
+ filter, and the later stages can be much shorter since the signal they see is already band limited. The filters are
+ linear phase, so the processing adds a fixed delay, given by `latency`, which should be reported to the host (an
+ `AudioRenderer` can return it from its `latency` method for `FilterAudioUnit`).
+
+ Each FIR is applied a tap at a time across a whole block of samples, so the inner loops have no dependencies between
+ iterations and are vectorized by the compiler.
+
+ All storage is allocated in `setRenderingFormat` -- nothing allocates while rendering. To use in an `EventProcessor`
+ kernel, call `setRenderingFormat` from the kernel's `setRenderingFormat` and `process` or `processSamples` from its
+ `doRendering`.
+ */
+class Oversampler {
+public:
+
+  /**
+   Construct a new instance.
+
+   @param factor the oversampling factor to use: 1 (no oversampling), 2, 4, or 8
+   @throws std::invalid_argument if the factor is not supported
+   */
+  explicit Oversampler(size_t factor = 2) : factor_{factor}
+  {
+    if (factor != 1 && factor != 2 && factor != 4 && factor != 8) {
+      throw std::invalid_argument("oversampling factor must be 1, 2, 4, or 8");
+    }
+    static constexpr size_t stageHalfLengths[] = {16, 6, 4};
+    for (size_t rate = 1, stage = 0; rate < factor; rate *= 2, ++stage) {
+      stages_.emplace_back(stageHalfLengths[stage]);
+    }
+  }
+
+  /// @returns the oversampling factor
+  size_t factor() const noexcept { return factor_; }
+
+  /// @returns the delay in frames at the rendering rate that is added by the up and down sampling
+  double latency() const noexcept
+  {
+    double latency = 0.0;
+    double rate = 1.0;
+    for (const auto& stage : stages_) {
+      latency += stage.delay() / rate;
+      rate *= 2.0;
+    }
+    return latency;
+  }
+
+  /**
+   Allocate storage for rendering, and reset the filters.
+
+   @param channelCount the number of channels to process
+   @param maxFramesToRender the maximum number of frames at the rendering rate in a `process` call
+   */
+  void setRenderingFormat(size_t channelCount, AUAudioFrameCount maxFramesToRender)
+  {
+    assert(channelCount <= BusBuffers::MaxChannelCount);
+    channelCount_ = channelCount;
+    maxFramesToRender_ = maxFramesToRender;
+    size_t frames = maxFramesToRender;
+    for (auto& stage : stages_) {
+      stage.setRenderingFormat(channelCount, frames);
+      frames *= 2;
+    }
+    buffers_[0].assign(channelCount, std::vector<AUValue>(frames, 0.0));
+    buffers_[1].assign(channelCount, std::vector<AUValue>(frames, 0.0));
+  }
+
+  /**
+   Clear the filter histories.
+   */
+  void reset() noexcept
+  {
+    for (auto& stage : stages_) stage.reset();
+  }
+
+  /**
+   Process a block of samples. The samples are upsampled, given to `proc` to work on in place at the higher rate, and
+   then downsampled into `outs`.
+
+   @param ins the samples to process
+   @param outs storage for the results. May be the same as `ins`.
+   @param frameCount the number of frames to process
+   @param proc the function to call with the upsampled samples, as `proc(BusBuffers buffers, AUAudioFrameCount count)`
+   */
+  template <typename Proc>
+  void process(BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount, Proc&& proc) noexcept
+  {
+    assert(frameCount <= maxFramesToRender_);
+    auto channelCount = std::min(outs.size(), channelCount_);
+    if (stages_.empty()) {
+      for (size_t channel = 0; channel < channelCount; ++channel) {
+        if (ins[channel] != outs[channel]) std::copy(ins[channel], ins[channel] + frameCount, outs[channel]);
+      }
+      proc(outs, frameCount);
+      return;
+    }
+
+    // Each stage writes into the buffer that the previous stage did not.
+    BusBuffers::ChannelPointers upsampled{channelCount};
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      const AUValue* source = ins[channel];
+      size_t count = frameCount;
+      for (size_t stage = 0; stage < stages_.size(); ++stage) {
+        AUValue* destination = buffers_[stage % 2][channel].data();
+        stages_[stage].upsample(channel, source, destination, count);
+        source = destination;
+        count *= 2;
+      }
+      upsampled[channel] = const_cast<AUValue*>(source);
+    }
+
+    proc(BusBuffers(upsampled), AUAudioFrameCount(frameCount * factor_));
+
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      const AUValue* source = upsampled[channel];
+      size_t count = frameCount * factor_ / 2;
+      for (size_t stage = stages_.size(); stage-- > 0; ) {
+        AUValue* destination = stage == 0 ? outs[channel] : buffers_[(stage + 1) % 2][channel].data();
+        stages_[stage].downsample(channel, source, destination, count);
+        source = destination;
+        count /= 2;
+      }
+    }
+  }
+
+  /**
+   Process a block of samples with a function that works on one sample at a time, such as a waveshaper.
+
+   @param ins the samples to process
+   @param outs storage for the results. May be the same as `ins`.
+   @param frameCount the number of frames to process
+   @param proc the function to call for each upsampled sample, as `AUValue proc(AUValue sample)`
+   */
+  template <typename Proc>
+  void processSamples(BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount, Proc&& proc) noexcept
+  {
+    process(ins, outs, frameCount, [&proc](BusBuffers buffers, AUAudioFrameCount count) {
+      for (size_t channel = 0; channel < buffers.size(); ++channel) {
+        AUValue* samples = buffers[channel];
+        for (AUAudioFrameCount frame = 0; frame < count; ++frame) {
+          samples[frame] = proc(samples[frame]);
+        }
+      }
+    });
+  }
+
+private:
+
+  /**
+   One half-band stage that doubles or halves the sample rate. The filter has `4 * halfLength - 1` taps and its center
+   tap is 0.5. The other non-zero taps are at odd offsets from the center, which puts them all in the same polyphase
+   branch.
+   */
+  class Stage {
+  public:
+
+    explicit Stage(size_t halfLength) : taps_(2 * halfLength), history_{2 * halfLength - 1}
+    {
+      // Kaiser-windowed sinc for the taps at odd offsets from the center.
+      constexpr double beta = 8.0;
+      auto center = double(history_);
+      double sum = 0.0;
+      for (size_t index = 0; index < taps_.size(); ++index) {
+        auto offset = double(2 * index) - center;
+        auto value = DSP::kaiserSinc(offset, 0.5, center + 1.0, beta);
+        taps_[index] = AUValue(value);
+        sum += value;
+      }
+
+      // Scale so that the branch sums to 0.5, giving unity gain at DC for the whole filter.
+      for (auto& tap : taps_) tap = AUValue(double(tap) * 0.5 / sum);
+    }
+
+    /// @returns the delay in samples at the higher rate of the stage
+    double delay() const noexcept { return double(history_); }
+
+    void setRenderingFormat(size_t channelCount, size_t maxInputFrames)
+    {
+      upInput_.assign(channelCount, std::vector<AUValue>(history_ + maxInputFrames, 0.0));
+      downEven_.assign(channelCount, std::vector<AUValue>(history_ + maxInputFrames, 0.0));
+      downOdd_.assign(channelCount, std::vector<AUValue>(history_ + maxInputFrames, 0.0));
+      branch_.assign(maxInputFrames, 0.0);
+    }
+
+    void reset() noexcept
+    {
+      for (auto& buffer : upInput_) std::fill(buffer.begin(), buffer.end(), 0.0f);
+      for (auto& buffer : downEven_) std::fill(buffer.begin(), buffer.end(), 0.0f);
+      for (auto& buffer : downOdd_) std::fill(buffer.begin(), buffer.end(), 0.0f);
+    }
+
+    /**
+     Double the sample rate of `count` samples, writing `2 * count` samples to `output`.
+     */
+    void upsample(size_t channel, const AUValue* input, AUValue* output, size_t count) noexcept
+    {
+      AUValue* buffer = upInput_[channel].data();
+      std::copy(input, input + count, buffer + history_);
+
+      // Even outputs come from the FIR branch (with a gain of 2 to make up for the inserted zeros) and odd outputs
+      // are the input delayed by half the filter length.
+      std::fill(branch_.begin(), branch_.begin() + ptrdiff_t(count), 0.0f);
+      applyBranch(buffer, count, 2.0f);
+      const AUValue* delayed = buffer + history_ - (taps_.size() / 2 - 1);
+      for (size_t index = 0; index < count; ++index) {
+        output[2 * index] = branch_[index];
+        output[2 * index + 1] = delayed[index];
+      }
+
+      std::copy(buffer + count, buffer + count + history_, buffer);
+    }
+
+    /**
+     Halve the sample rate of `2 * count` samples, writing `count` samples to `output`.
+     */
+    void downsample(size_t channel, const AUValue* input, AUValue* output, size_t count) noexcept
+    {
+      AUValue* even = downEven_[channel].data();
+      AUValue* odd = downOdd_[channel].data();
+      for (size_t index = 0; index < count; ++index) {
+        even[history_ + index] = input[2 * index];
+        odd[history_ + index] = input[2 * index + 1];
+      }
+
+      std::fill(branch_.begin(), branch_.begin() + ptrdiff_t(count), 0.0f);
+      applyBranch(even, count, 1.0f);
+      const AUValue* delayed = odd + history_ - taps_.size() / 2;
+      for (size_t index = 0; index < count; ++index) {
+        output[index] = branch_[index] + 0.5f * delayed[index];
+      }
+
+      std::copy(even + count, even + count + history_, even);
+      std::copy(odd + count, odd + count + history_, odd);
+    }
+
+  private:
+
+    void applyBranch(const AUValue* buffer, size_t count, AUValue gain) noexcept
+    {
+      AUValue* __restrict sum = branch_.data();
+      for (size_t tap = 0; tap < taps_.size(); ++tap) {
+        auto weight = taps_[tap] * gain;
+        const AUValue* __restrict source = buffer + history_ - tap;
+        for (size_t index = 0; index < count; ++index) {
+          sum[index] += weight * source[index];
+        }
+      }
+    }
+
+    std::vector<AUValue> taps_;
+    size_t history_;
+    std::vector<std::vector<AUValue>> upInput_{};
+    std::vector<std::vector<AUValue>> downEven_{};
+    std::vector<std::vector<AUValue>> downOdd_{};
+    std::vector<AUValue> branch_{};
+  };
+
+  size_t factor_;
+  std::vector<Stage> stages_{};
+  std::vector<std::vector<AUValue>> buffers_[2]{};
+  size_t channelCount_{0};
+  AUAudioFrameCount maxFramesToRender_{0};
+};
+
+} // end namespace DSPHeaders
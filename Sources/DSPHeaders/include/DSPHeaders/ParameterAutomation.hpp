@@ -0,0 +1,131 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cstdint>
+#import <istream>
+#import <limits>
+#import <sstream>
+#import <stdexcept>
+#import <string>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+namespace DSPHeaders {
+
+/**
+ A list of parameter changes at given sample times, used to automate parameters when rendering offline. For each block
+ to render, `eventsFor` provides the changes that fall within the block as a linked list of `AURenderEvent` values,
+ just as a host would give them to `EventProcessor::processAndRender`.
+
+ An automation script is plain text with one change per line:
+
+     <sample time> <parameter address> <value> [<ramp duration in samples>]
+
+ Blank lines and text after a `#` are ignored. Sample times, addresses, and durations may not be negative, and nothing
+ else may follow the fields on a line.
+ */
+class ParameterAutomation {
+public:
+
+  ParameterAutomation() = default;
+
+  /**
+   Create from an automation script.
+
+   @param script the stream to read from
+   @returns new instance
+   @throws std::runtime_error if a line cannot be parsed
+   */
+  static ParameterAutomation parse(std::istream& script) {
+    ParameterAutomation automation;
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(script, line)) {
+      ++lineNumber;
+      line = line.substr(0, line.find('#'));
+      if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+      // Read integers as signed so that negative values are rejected instead of wrapping around.
+      std::istringstream fields{line};
+      AUEventSampleTime when;
+      int64_t address;
+      AUValue value;
+      int64_t duration = 0;
+      auto valid = bool(fields >> when >> address >> value) && when >= 0 && address >= 0;
+      if (valid && !(fields >> std::ws).eof()) {
+        valid = bool(fields >> duration) && duration >= 0 && duration <= std::numeric_limits<AUAudioFrameCount>::max();
+      }
+      if (!valid || !(fields >> std::ws).eof()) {
+        throw std::runtime_error("invalid automation at line " + std::to_string(lineNumber));
+      }
+      automation.add(when, AUParameterAddress(address), value, AUAudioFrameCount(duration));
+    }
+    return automation;
+  }
+
+  /**
+   Add a parameter change.
+
+   @param when the sample time of the change
+   @param address the address of the parameter to change
+   @param value the new value for the parameter
+   @param duration the number of samples to ramp over (0 for an immediate change)
+   */
+  void add(AUEventSampleTime when, AUParameterAddress address, AUValue value, AUAudioFrameCount duration = 0) {
+    AURenderEvent event{};
+    event.parameter.eventType = duration > 0 ? AURenderEventParameterRamp : AURenderEventParameter;
+    event.parameter.eventSampleTime = when;
+    event.parameter.parameterAddress = address;
+    event.parameter.value = value;
+    event.parameter.rampDurationSampleFrames = duration;
+
+    // Keep events in time order, with later additions after earlier ones at the same time.
+    auto pos = std::upper_bound(events_.begin(), events_.end(), when,
+                                [](AUEventSampleTime lhs, const AURenderEvent& rhs) {
+      return lhs < rhs.head.eventSampleTime;
+    });
+    events_.insert(pos, event);
+    block_.reserve(events_.size());
+  }
+
+  /// @returns the number of parameter changes
+  size_t size() const noexcept { return events_.size(); }
+
+  /// @returns true if there are no parameter changes
+  bool empty() const noexcept { return events_.empty(); }
+
+  /**
+   Obtain the parameter changes for a block of samples. The returned list is valid until the next call.
+
+   @param start the sample time of the first sample in the block
+   @param frameCount the number of samples in the block
+   @returns pointer to the first event in the block or nullptr if there are none
+   */
+  const AURenderEvent* eventsFor(AUEventSampleTime start, AUAudioFrameCount frameCount) noexcept {
+    auto end = start + AUEventSampleTime(frameCount);
+    auto first = std::lower_bound(events_.begin(), events_.end(), start,
+                                  [](const AURenderEvent& lhs, AUEventSampleTime rhs) {
+      return lhs.head.eventSampleTime < rhs;
+    });
+
+    block_.clear();
+    for (auto pos = first; pos != events_.end() && pos->head.eventSampleTime < end; ++pos) {
+      block_.push_back(*pos);
+    }
+
+    for (size_t index = 0; index < block_.size(); ++index) {
+      block_[index].head.next = index + 1 < block_.size() ? &block_[index + 1] : nullptr;
+    }
+
+    return block_.empty() ? nullptr : block_.data();
+  }
+
+private:
+  std::vector<AURenderEvent> events_{};
+  std::vector<AURenderEvent> block_{};
+};
+
+} // end namespace DSPHeaders
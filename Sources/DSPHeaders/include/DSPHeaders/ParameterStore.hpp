@@ -0,0 +1,141 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <array>
+#import <atomic>
+#import <cassert>
+#import <cstdint>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+namespace DSPHeaders {
+
+/**
+ Lock-free mailbox for parameter values that are changed on one or more non-render threads (UI, host automation via
+ `AUParameterTree`) and consumed on the render thread. Each parameter address has an atomic value slot and a bit in a
+ dirty mask. Setting a value stores it in its slot and then marks the slot as dirty. The render thread then calls
+ `drain` at the start of a render cycle to visit only those parameters that changed since the last drain.
+
+ There are no locks and no memory allocations in any of the methods, so all are safe to call from the render thread.
+ The cost of a `drain` is one atomic exchange per 64 parameters plus the work for each changed parameter.
+
+ Parameter addresses must be in the range [0, N).
+ */
+template <size_t N>
+class ParameterStore {
+public:
+  static_assert(N > 0, "ParameterStore must hold at least one parameter");
+
+  /// The number of parameters held by the store
+  inline static constexpr size_t Capacity = N;
+
+  /**
+   Construct new instance with all parameter values set to zero and nothing marked as dirty.
+   */
+  ParameterStore() noexcept {
+    for (auto& slot : slots_) slot.store(0.0, std::memory_order_relaxed);
+    for (auto& mask : dirty_) mask.store(0, std::memory_order_relaxed);
+  }
+
+  ParameterStore(const ParameterStore&) = delete;
+  ParameterStore& operator =(const ParameterStore&) = delete;
+
+  /**
+   Set a new parameter value and flag it as changed. Safe to call from any thread.
+
+   @param address the address of the parameter to change
+   @param value the new value to use
+   */
+  void set(AUParameterAddress address, AUValue value) noexcept {
+    assert(address < N);
+    slots_[address].store(value, std::memory_order_relaxed);
+    // The release here makes the above store visible to the thread that acquires the dirty bit in `drain`.
+    dirty_[wordIndex(address)].fetch_or(bitMask(address), std::memory_order_release);
+  }
+
+  /**
+   Set a parameter value without flagging it as changed. Use this to establish initial values before rendering
+   starts, or to record a value that the render thread has already applied.
+
+   @param address the address of the parameter to change
+   @param value the new value to use
+   */
+  void store(AUParameterAddress address, AUValue value) noexcept {
+    assert(address < N);
+    slots_[address].store(value, std::memory_order_relaxed);
+  }
+
+  /**
+   Obtain the last value given for a parameter. Safe to call from any thread.
+
+   @param address the address of the parameter to fetch
+   @returns the last value set for the parameter
+   */
+  AUValue get(AUParameterAddress address) const noexcept {
+    assert(address < N);
+    return slots_[address].load(std::memory_order_acquire);
+  }
+
+  /**
+   Copy out the current values of all of the parameters. Each value is read atomically, but the collection as a whole
+   is not a consistent snapshot if there are concurrent writers.
+
+   @param values the container to fill
+   */
+  void snapshot(std::array<AUValue, N>& values) const noexcept {
+    for (size_t index = 0; index < N; ++index) {
+      values[index] = slots_[index].load(std::memory_order_acquire);
+    }
+  }
+
+  /// @returns true if there is at least one parameter that has changed since the last `drain`
+  bool hasChanges() const noexcept {
+    for (const auto& mask : dirty_) {
+      if (mask.load(std::memory_order_relaxed) != 0) return true;
+    }
+    return false;
+  }
+
+  /**
+   Visit all parameters that have changed since the last call, clearing their dirty flags. Meant to be called from
+   the render thread at the start of a render cycle. A parameter that is set again while the drain is in progress will
+   either be seen in this drain or the next one -- never lost.
+
+   @param proc the function to call with each changed parameter address and its latest value
+   @returns the number of changed parameters visited
+   */
+  template <typename Proc>
+  size_t drain(Proc&& proc) noexcept {
+    size_t count = 0;
+    for (size_t word = 0; word < WordCount; ++word) {
+      auto bits = dirty_[word].exchange(0, std::memory_order_acquire);
+      while (bits != 0) {
+        auto address = word * BitsPerWord + size_t(__builtin_ctzll(bits));
+        bits &= bits - 1;
+        proc(AUParameterAddress(address), slots_[address].load(std::memory_order_relaxed));
+        ++count;
+      }
+    }
+    return count;
+  }
+
+private:
+  using MaskType = uint64_t;
+
+  inline static constexpr size_t BitsPerWord = 64;
+  inline static constexpr size_t WordCount = (N + BitsPerWord - 1) / BitsPerWord;
+
+  static constexpr size_t wordIndex(AUParameterAddress address) noexcept { return size_t(address) / BitsPerWord; }
+  static constexpr MaskType bitMask(AUParameterAddress address) noexcept {
+    return MaskType(1) << (size_t(address) % BitsPerWord);
+  }
+
+  static_assert(std::atomic<AUValue>::is_always_lock_free, "atomic AUValue must be lock-free");
+  static_assert(std::atomic<MaskType>::is_always_lock_free, "atomic mask must be lock-free");
+
+  std::array<std::atomic<AUValue>, N> slots_;
+  alignas(64) std::array<std::atomic<MaskType>, WordCount> dirty_;
+};
+
+} // end namespace DSPHeaders
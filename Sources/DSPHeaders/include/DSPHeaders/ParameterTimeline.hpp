@@ -0,0 +1,206 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+namespace DSPHeaders {
+
+/**
+ Holds the parameter events of one render cycle, grouped by parameter address and ordered by time. This allows a kernel
+ to render an entire block in one pass with per-sample parameter curves instead of having `EventProcessor` split the
+ block at each parameter event.
+
+ During rendering the kernel calls `render` once per `doRendering` call for each parameter it wants per-sample values
+ for. This applies the parameter's events to a `RampingParameter` (or similar class with `set` and `frameValue`
+ methods) at their exact sample offsets and records the resulting per-sample values.
+
+ Several events for the same parameter at the same sample offset are merged, with the last one winning. An event that
+ arrives while a ramp is in progress starts a new ramp from the current ramp value.
+
+ All storage is reserved in `reserve` -- nothing here allocates while rendering.
+ */
+class ParameterTimeline {
+public:
+
+  /// The default number of parameter events that can be held for one render cycle.
+  inline static constexpr size_t DefaultCapacity = 512;
+
+  ParameterTimeline() = default;
+
+  /**
+   Allocate space for the given number of events. Must be called before rendering begins.
+
+   @param capacity the maximum number of parameter events to hold per render cycle
+   */
+  void reserve(size_t capacity) {
+    segments_.reserve(capacity);
+    groups_.reserve(capacity);
+  }
+
+  /// @returns the maximum number of events that can be held without allocating
+  size_t capacity() const noexcept { return segments_.capacity(); }
+
+  /**
+   Start a new render cycle, forgetting any events from the previous one.
+   */
+  void beginBlock() noexcept {
+    segments_.clear();
+    groups_.clear();
+    position_ = 0;
+  }
+
+  /**
+   Add a parameter event to the timeline.
+
+   @param event the event to add
+   @param offset the sample offset of the event from the start of the render cycle
+   @returns false if there is no more space for the event, in which case the caller must process it some other way
+   */
+  bool add(const AUParameterEvent& event, AUAudioFrameCount offset) noexcept {
+    if (segments_.size() == segments_.capacity()) return false;
+    segments_.push_back({event.parameterAddress, event.value, event.rampDurationSampleFrames, offset,
+      segments_.size()});
+    return true;
+  }
+
+  /**
+   Finish adding events. Sorts the events by address and then by time, merging events for the same parameter and time.
+   Ties are broken by arrival order so that the sort is stable without `std::stable_sort`, which may allocate a
+   temporary buffer on the render thread.
+   */
+  void finalize() noexcept {
+    std::sort(segments_.begin(), segments_.end(), isBefore);
+
+    // Merge events with the same address and offset, keeping the latest one.
+    size_t last = 0;
+    for (size_t index = 1; index < segments_.size(); ++index) {
+      const auto& next = segments_[index];
+      if (segments_[last].address != next.address || segments_[last].offset != next.offset) {
+        ++last;
+      }
+      if (last != index) {
+        segments_[last] = next;
+      }
+    }
+    if (!segments_.empty()) segments_.resize(last + 1);
+
+    for (size_t index = 0; index < segments_.size(); ++index) {
+      if (groups_.empty() || groups_.back().address != segments_[index].address) {
+        groups_.push_back({segments_[index].address, index, index, index});
+      }
+      groups_.back().end = index + 1;
+    }
+  }
+
+  /// @returns true if there are no parameter events in the current render cycle
+  bool empty() const noexcept { return segments_.empty(); }
+
+  /// @returns the number of events held after merging
+  size_t size() const noexcept { return segments_.size(); }
+
+  /// @returns true if there are events for the given parameter address in the current render cycle
+  bool hasEvents(AUParameterAddress address) const noexcept { return findGroup(address) != nullptr; }
+
+  /**
+   Generate per-sample values for a parameter, starting at the current position in the render cycle and continuing for
+   `frameCount` samples. Events for the parameter that fall within the span are applied to `param` at their sample
+   offsets. This should only be called once per parameter per `doRendering` call.
+
+   @param address the address of the parameter to render
+   @param param the parameter instance that holds the parameter state. Must support `set(value, duration)` and
+   `frameValue()`
+   @param curve storage for the per-sample values. Must hold at least `frameCount` values.
+   @param frameCount the number of samples to generate
+   */
+  template <typename Param, typename ValueType>
+  void render(AUParameterAddress address, Param& param, ValueType* curve, AUAudioFrameCount frameCount) noexcept {
+    auto group = findGroup(address);
+    AUAudioFrameCount frame = 0;
+    if (group != nullptr) {
+      auto end = position_ + frameCount;
+      while (group->cursor < group->end && segments_[group->cursor].offset < end) {
+        const auto& segment = segments_[group->cursor++];
+        auto offset = std::max(segment.offset, position_) - position_;
+        for (; frame < offset; ++frame) curve[frame] = param.frameValue();
+        param.set(segment.value, segment.duration);
+      }
+    }
+    for (; frame < frameCount; ++frame) curve[frame] = param.frameValue();
+  }
+
+  /**
+   Move the current position in the render cycle forward. This is done by `EventProcessor` after each `doRendering`
+   call.
+
+   @param frameCount the number of samples rendered
+   */
+  void advance(AUAudioFrameCount frameCount) noexcept { position_ += frameCount; }
+
+  /**
+   Finish the render cycle. Any events that were not consumed by a `render` call are given to the supplied function in
+   time order for each parameter.
+
+   @param proc the function to call with each unconsumed event
+   */
+  template <typename Proc>
+  void endBlock(Proc&& proc) noexcept {
+    for (auto& group : groups_) {
+      for (; group.cursor < group.end; ++group.cursor) {
+        const auto& segment = segments_[group.cursor];
+        AUParameterEvent event{};
+        event.eventType = segment.duration > 0 ? AURenderEventParameterRamp : AURenderEventParameter;
+        event.parameterAddress = segment.address;
+        event.value = segment.value;
+        event.rampDurationSampleFrames = segment.duration;
+        proc(event);
+      }
+    }
+  }
+
+private:
+
+  struct Segment {
+    AUParameterAddress address;
+    AUValue value;
+    AUAudioFrameCount duration;
+    AUAudioFrameCount offset;
+    size_t sequence;
+  };
+
+  struct Group {
+    AUParameterAddress address;
+    size_t begin;
+    size_t end;
+    size_t cursor;
+  };
+
+  static bool isBefore(const Segment& lhs, const Segment& rhs) noexcept {
+    if (lhs.address != rhs.address) return lhs.address < rhs.address;
+    if (lhs.offset != rhs.offset) return lhs.offset < rhs.offset;
+    return lhs.sequence < rhs.sequence;
+  }
+
+  Group* findGroup(AUParameterAddress address) noexcept {
+    for (auto& group : groups_) {
+      if (group.address == address) return &group;
+    }
+    return nullptr;
+  }
+
+  const Group* findGroup(AUParameterAddress address) const noexcept {
+    for (const auto& group : groups_) {
+      if (group.address == address) return &group;
+    }
+    return nullptr;
+  }
+
+  std::vector<Segment> segments_{};
+  std::vector<Group> groups_{};
+  AUAudioFrameCount position_{0};
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,309 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <memory>
+#import <stdexcept>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/FFT.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Convolves a mono stream of samples with an impulse response (IR) without adding any latency. The IR is broken up into
+ partitions:
+
+ - the first `blockSize` taps are applied directly in the time domain, so the output for a sample is available at once
+ - the rest of the IR is applied in the frequency domain by one or more stages using the uniformly-partitioned
+ overlap-save method. Each stage has a block size and holds a frequency-domain delay line (FDL) with the spectra of its
+ past input blocks, and when a block of input is complete it multiplies-and-accumulates the FDL with the spectra of its
+ IR partitions and transforms the sum back into the stage's next block of output.
+
+ A stage with block size S takes S samples to produce its output, so it can only handle IR taps that are at least S
+ samples in. With `Options::maxBlockSize` equal to `Options::blockSize` there is one stage and the partitioning is
+ uniform. Otherwise the block size grows by a factor of 4 from one stage to the next (up to `maxBlockSize`) as soon as
+ the IR offset allows, which greatly reduces the work for long IRs. Note that a stage does all of its work in the call
+ that completes its block, so larger stages make for a less even load from one render call to the next.
+
+ All storage is allocated by `setImpulseResponse` -- `process` does not allocate. To use in an `EventProcessor`
+ kernel, hold one instance per channel, load the IR in `setRenderingFormat` (or off the render thread), and call
+ `process` for each channel in `doRendering`.
+ */
+class PartitionedConvolver {
+public:
+
+  /// Configuration of the partitioning.
+  struct Options {
+    /// The size of the time-domain head and of the smallest partition. Must be a power of 2.
+    size_t blockSize{64};
+    /// The size of the largest partition. Must be a power of 2 that is not less than `blockSize`.
+    size_t maxBlockSize{4096};
+  };
+
+  PartitionedConvolver() : options_{} {}
+
+  /**
+   Construct a new instance that will use the given partitioning.
+
+   @param options the partitioning configuration to use
+   */
+  explicit PartitionedConvolver(const Options& options) : options_{options} {}
+
+  /**
+   Install a new impulse response, replacing any previous one and clearing all history. Allocates memory, so this must
+   not be done while rendering.
+
+   @param taps the impulse response
+   @param length the number of taps in the impulse response
+   @throws std::invalid_argument if the `Options` values are not valid
+   */
+  void setImpulseResponse(const AUValue* taps, size_t length)
+  {
+    auto blockSize = options_.blockSize;
+    auto maxBlockSize = options_.maxBlockSize;
+    if (blockSize < 2 || (blockSize & (blockSize - 1)) != 0 || maxBlockSize < blockSize ||
+        (maxBlockSize & (maxBlockSize - 1)) != 0) {
+      throw std::invalid_argument("convolver block sizes must be powers of 2 with blockSize <= maxBlockSize");
+    }
+
+    length_ = length;
+    head_.assign(taps, taps + std::min(length, blockSize));
+    headInput_.assign(2 * blockSize - 1, 0.0);
+    accumulator_.assign(blockSize, 0.0);
+    stages_.clear();
+    position_ = 0;
+
+    // Cover the rest of the IR with stages. Each stage gets just enough partitions to bring the offset up to the block
+    // size of the next stage, and the last stage gets the remainder.
+    size_t offset = std::min(length, blockSize);
+    size_t stageSize = blockSize;
+    while (offset < length) {
+      auto nextSize = std::min(stageSize * 4, maxBlockSize);
+      size_t partitionCount = (length - offset + stageSize - 1) / stageSize;
+      if (nextSize > stageSize) {
+        partitionCount = std::min(partitionCount, (nextSize - offset + stageSize - 1) / stageSize);
+      }
+      stages_.push_back(std::make_unique<Stage>(taps + offset, std::min(length - offset, partitionCount * stageSize),
+                                                stageSize, offset / stageSize));
+      offset += partitionCount * stageSize;
+      stageSize = nextSize;
+    }
+  }
+
+  /**
+   Forget all past input samples. Does not allocate.
+   */
+  void reset() noexcept
+  {
+    std::fill(headInput_.begin(), headInput_.end(), 0.0f);
+    for (auto& stage : stages_) stage->reset();
+    position_ = 0;
+  }
+
+  /// @returns the number of taps in the impulse response
+  size_t length() const noexcept { return length_; }
+
+  /// @returns the number of frequency-domain stages
+  size_t stageCount() const noexcept { return stages_.size(); }
+
+  /**
+   Obtain the block size of a frequency-domain stage.
+
+   @param index the stage to query
+   @returns the block size of the stage
+   */
+  size_t stageBlockSize(size_t index) const noexcept { return stages_[index]->blockSize(); }
+
+  /**
+   Obtain the number of IR partitions handled by a frequency-domain stage.
+
+   @param index the stage to query
+   @returns the number of partitions in the stage
+   */
+  size_t stagePartitionCount(size_t index) const noexcept { return stages_[index]->partitionCount(); }
+
+  /**
+   Convolve samples with the impulse response. The output is the convolution only (100% wet). Until an impulse
+   response is installed the output is silence.
+
+   @param input the samples to convolve
+   @param output storage for the results. May be the same as `input`.
+   @param frameCount the number of samples to process
+   */
+  void process(const AUValue* input, AUValue* output, AUAudioFrameCount frameCount) noexcept
+  {
+    if (headInput_.empty()) {
+      std::fill(output, output + frameCount, 0.0f);
+      return;
+    }
+
+    auto blockSize = options_.blockSize;
+    auto history = blockSize - 1;
+    while (frameCount > 0) {
+      // Work in chunks that do not cross the block boundary of the smallest stage.
+      auto chunk = std::min(size_t(frameCount), blockSize - position_);
+
+      std::copy(input, input + chunk, headInput_.begin() + ptrdiff_t(history));
+      for (auto& stage : stages_) stage->write(input, chunk);
+
+      std::fill(accumulator_.begin(), accumulator_.begin() + ptrdiff_t(chunk), 0.0f);
+      applyHead(chunk);
+      for (auto& stage : stages_) stage->read(accumulator_.data(), chunk);
+      std::copy(accumulator_.begin(), accumulator_.begin() + ptrdiff_t(chunk), output);
+
+      // Keep the last `history` input samples for the next chunk.
+      std::copy(headInput_.begin() + ptrdiff_t(chunk), headInput_.begin() + ptrdiff_t(chunk + history),
+                headInput_.begin());
+
+      for (auto& stage : stages_) stage->update();
+
+      position_ = (position_ + chunk) & (blockSize - 1);
+      input += chunk;
+      output += chunk;
+      frameCount -= AUAudioFrameCount(chunk);
+    }
+  }
+
+private:
+
+  /**
+   One uniformly-partitioned frequency-domain stage.
+   */
+  class Stage {
+  public:
+
+    /**
+     Construct a new stage.
+
+     @param taps the IR taps handled by the stage
+     @param length the number of taps
+     @param blockSize the partition size of the stage
+     @param delay the number of blocks from the start of the IR to the first tap of the stage
+     */
+    Stage(const AUValue* taps, size_t length, size_t blockSize, size_t delay) :
+    blockSize_{blockSize}, binCount_{blockSize + 1}, skip_{delay - 1},
+    partitionCount_{(length + blockSize - 1) / blockSize}, slotCount_{skip_ + partitionCount_},
+    fft_{2 * blockSize}, input_(2 * blockSize, 0.0), output_(blockSize, 0.0), time_(2 * blockSize, 0.0),
+    fdlReal_(slotCount_ * binCount_, 0.0), fdlImag_(slotCount_ * binCount_, 0.0),
+    irReal_(partitionCount_ * binCount_), irImag_(partitionCount_ * binCount_),
+    sumReal_(binCount_), sumImag_(binCount_)
+    {
+      for (size_t partition = 0; partition < partitionCount_; ++partition) {
+        auto start = partition * blockSize;
+        auto count = std::min(blockSize, length - start);
+        std::fill(time_.begin(), time_.end(), 0.0f);
+        std::copy(taps + start, taps + start + count, time_.begin());
+        fft_.forward(time_.data(), irReal_.data() + partition * binCount_, irImag_.data() + partition * binCount_);
+      }
+    }
+
+    size_t blockSize() const noexcept { return blockSize_; }
+
+    size_t partitionCount() const noexcept { return partitionCount_; }
+
+    void reset() noexcept {
+      std::fill(input_.begin(), input_.end(), 0.0f);
+      std::fill(output_.begin(), output_.end(), 0.0f);
+      std::fill(fdlReal_.begin(), fdlReal_.end(), 0.0f);
+      std::fill(fdlImag_.begin(), fdlImag_.end(), 0.0f);
+      fill_ = 0;
+      current_ = 0;
+    }
+
+    /// Add input samples to the current block.
+    void write(const AUValue* input, size_t count) noexcept {
+      std::copy(input, input + count, input_.begin() + ptrdiff_t(blockSize_ + fill_));
+    }
+
+    /// Add the stage output for the current block position to the given samples.
+    void read(AUValue* __restrict output, size_t count) noexcept {
+      const AUValue* __restrict source = output_.data() + fill_;
+      for (size_t index = 0; index < count; ++index) {
+        output[index] += source[index];
+      }
+      fill_ += count;
+    }
+
+    /// Generate the next block of output if the current block of input is complete.
+    void update() noexcept {
+      if (fill_ < blockSize_) return;
+      fill_ = 0;
+
+      // Transform the last two blocks of input into the newest FDL slot, and move the last block to the front.
+      current_ = current_ == 0 ? slotCount_ - 1 : current_ - 1;
+      fft_.forward(input_.data(), fdlReal_.data() + current_ * binCount_, fdlImag_.data() + current_ * binCount_);
+      std::copy(input_.begin() + ptrdiff_t(blockSize_), input_.end(), input_.begin());
+
+      std::fill(sumReal_.begin(), sumReal_.end(), 0.0f);
+      std::fill(sumImag_.begin(), sumImag_.end(), 0.0f);
+      for (size_t partition = 0; partition < partitionCount_; ++partition) {
+        auto slot = current_ + skip_ + partition;
+        if (slot >= slotCount_) slot -= slotCount_;
+        multiplyAccumulate(fdlReal_.data() + slot * binCount_, fdlImag_.data() + slot * binCount_,
+                           irReal_.data() + partition * binCount_, irImag_.data() + partition * binCount_);
+      }
+
+      // The second half of the circular convolution is the linear convolution of the last block of input.
+      fft_.inverse(sumReal_.data(), sumImag_.data(), time_.data());
+      std::copy(time_.begin() + ptrdiff_t(blockSize_), time_.end(), output_.begin());
+    }
+
+  private:
+
+    void multiplyAccumulate(const AUValue* __restrict xr, const AUValue* __restrict xi, const AUValue* __restrict hr,
+                            const AUValue* __restrict hi) noexcept {
+      AUValue* __restrict yr = sumReal_.data();
+      AUValue* __restrict yi = sumImag_.data();
+      for (size_t bin = 0; bin < binCount_; ++bin) {
+        yr[bin] += xr[bin] * hr[bin] - xi[bin] * hi[bin];
+        yi[bin] += xr[bin] * hi[bin] + xi[bin] * hr[bin];
+      }
+    }
+
+    size_t blockSize_;
+    size_t binCount_;
+    size_t skip_;
+    size_t partitionCount_;
+    size_t slotCount_;
+    RealFFT fft_;
+    std::vector<AUValue> input_;
+    std::vector<AUValue> output_;
+    std::vector<AUValue> time_;
+    std::vector<AUValue> fdlReal_;
+    std::vector<AUValue> fdlImag_;
+    std::vector<AUValue> irReal_;
+    std::vector<AUValue> irImag_;
+    std::vector<AUValue> sumReal_;
+    std::vector<AUValue> sumImag_;
+    size_t fill_{0};
+    size_t current_{0};
+  };
+
+  void applyHead(size_t chunk) noexcept
+  {
+    // Each tap is applied to the whole chunk so that the inner loop has no dependencies between iterations.
+    auto history = options_.blockSize - 1;
+    AUValue* __restrict sum = accumulator_.data();
+    for (size_t tap = 0; tap < head_.size(); ++tap) {
+      auto weight = head_[tap];
+      const AUValue* __restrict source = headInput_.data() + history - tap;
+      for (size_t index = 0; index < chunk; ++index) {
+        sum[index] += weight * source[index];
+      }
+    }
+  }
+
+  Options options_;
+  size_t length_{0};
+  std::vector<AUValue> head_{};
+  std::vector<AUValue> headInput_{};
+  std::vector<AUValue> accumulator_{};
+  std::vector<std::unique_ptr<Stage>> stages_{};
+  size_t position_{0};
+};
+
+} // end namespace DSPHeaders
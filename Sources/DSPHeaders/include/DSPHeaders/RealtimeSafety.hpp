@@ -0,0 +1,105 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <array>
+#import <atomic>
+#import <cstddef>
+
+namespace DSPHeaders {
+
+/**
+ Debug aid that checks the promise that nothing allocates memory or takes a lock while rendering.
+
+ A thread is considered to be rendering while a `RealtimeSafety::Scope` instance exists on it. `EventProcessor` creates
+ one for the duration of `processAndRender` when `DSP_HEADERS_REALTIME_SAFETY_CHECKS` is defined. Code that can detect
+ an unsafe operation -- such as the `malloc` and `pthread_mutex_lock` interposers in `RealtimeSafetyInterposers.hpp` --
+ reports it with `note`. Operations reported on a rendering thread are counted, and given to an optional handler which can log
+ them, stop in a debugger, etc.
+
+ Use `RealtimeSafety::Suspend` to allow unsafe operations for a while, such as when test code records what it sees.
+ */
+class RealtimeSafety {
+public:
+
+  /// The kinds of operations that are not safe to do while rendering.
+  enum struct Violation { allocation = 0, deallocation, lock };
+
+  /// Function to call when a violation is noted on a rendering thread.
+  using Handler = void (*)(Violation violation);
+
+  /// Marks the current thread as rendering for the lifetime of the instance. Scopes may be nested.
+  class Scope {
+  public:
+    Scope() noexcept { ++depth_; }
+    ~Scope() noexcept { --depth_; }
+    Scope(const Scope&) = delete;
+    Scope& operator =(const Scope&) = delete;
+  };
+
+  /// Ignores violations on the current thread for the lifetime of the instance.
+  class Suspend {
+  public:
+    Suspend() noexcept { ++suspended_; }
+    ~Suspend() noexcept { --suspended_; }
+    Suspend(const Suspend&) = delete;
+    Suspend& operator =(const Suspend&) = delete;
+  };
+
+  /// @returns true if the current thread is rendering
+  static bool isRendering() noexcept { return depth_ > 0 && suspended_ == 0; }
+
+  /**
+   Report an operation that is not safe while rendering. Does nothing if the current thread is not rendering.
+
+   @param violation the kind of operation being done
+   */
+  static void note(Violation violation) noexcept {
+    if (!isRendering()) return;
+    counts_[size_t(violation)].fetch_add(1, std::memory_order_relaxed);
+    auto handler = handler_.load(std::memory_order_acquire);
+    if (handler != nullptr) {
+      // The handler is free to do unsafe things without reporting itself.
+      Suspend suspend;
+      handler(violation);
+    }
+  }
+
+  /**
+   Install a function to call for each violation.
+
+   @param handler the function to call or nullptr to only count violations
+   @returns the previous handler
+   */
+  static Handler setHandler(Handler handler) noexcept { return handler_.exchange(handler); }
+
+  /**
+   Obtain the number of violations of a given kind seen since the last `resetCounts`.
+
+   @param violation the kind of violation to report on
+   @returns the count of violations
+   */
+  static size_t count(Violation violation) noexcept {
+    return counts_[size_t(violation)].load(std::memory_order_relaxed);
+  }
+
+  /// @returns the number of violations of all kinds since the last `resetCounts`
+  static size_t totalCount() noexcept {
+    size_t total = 0;
+    for (const auto& count : counts_) total += count.load(std::memory_order_relaxed);
+    return total;
+  }
+
+  /// Reset all violation counts to zero.
+  static void resetCounts() noexcept {
+    for (auto& count : counts_) count.store(0, std::memory_order_relaxed);
+  }
+
+private:
+  inline static thread_local int depth_ = 0;
+  inline static thread_local int suspended_ = 0;
+  inline static std::array<std::atomic<size_t>, 3> counts_{};
+  inline static std::atomic<Handler> handler_{nullptr};
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,257 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <atomic>
+#import <cerrno>
+#import <cstddef>
+#import <cstring>
+
+#import <pthread.h>
+
+#import "DSPHeaders/RealtimeSafety.hpp"
+
+/**
+ Interposers that report C allocations and mutex locks to `RealtimeSafety::note`, so that anything that allocates or
+ locks while a thread is rendering is caught, not just code that reports itself.
+
+ Unlike the other headers here, this one *defines* functions with external linkage. Include it in exactly one source
+ file of exactly one image: a test target, or the `AUv3-DSP-RealtimeSafety` library that is built from it for loading
+ ahead of a host. It is not part of `DSPHeaders.mm`.
+
+ - Linux: `malloc`, `calloc`, `realloc`, `free`, `posix_memalign`, `aligned_alloc`, `memalign`, `valloc`, and
+ `pthread_mutex_lock` are replaced with wrappers that forward to the next definition found with `dlsym(RTLD_NEXT, ...)`.
+ They take effect when compiled into the executable or when the library is loaded with `LD_PRELOAD`. Other entry points,
+ such as `pvalloc`, `reallocarray`, or `pthread_mutex_timedlock`, are not reported.
+ - Apple: the functions of the default malloc zone are replaced when the image loads. This works from any image,
+ including an XCTest bundle. `pthread_mutex_lock` is replaced with `DYLD_INTERPOSE`, which dyld only honors for
+ libraries present at launch, such as one given in `DYLD_INSERT_LIBRARIES`.
+
+ When loaded ahead of a host, the interposers share `RealtimeSafety` state with the host through its inline (weak)
+ variables, so the host must export them. Code in a shared library or plugin does so by default.
+ */
+
+#if defined(__linux__)
+
+#import <dlfcn.h>
+
+namespace DSPHeaders::RealtimeSafetyInterposers {
+
+/// Storage handed out while `dlsym` looks up the real functions, since it may allocate. Never reused, so it is zeroed.
+alignas(alignof(std::max_align_t)) inline char bootstrap[4'096];
+inline std::atomic<size_t> bootstrapUsed{0};
+inline thread_local bool resolving = false;
+
+inline void* bootstrapAllocate(size_t size) noexcept {
+  constexpr size_t alignment = alignof(std::max_align_t);
+  size = (size + alignment - 1) & ~(alignment - 1);
+  auto offset = bootstrapUsed.fetch_add(size);
+  return offset + size <= sizeof(bootstrap) ? bootstrap + offset : nullptr;
+}
+
+inline bool isBootstrap(const void* ptr) noexcept {
+  auto address = static_cast<const char*>(ptr);
+  return address >= bootstrap && address < bootstrap + sizeof(bootstrap);
+}
+
+/**
+ Obtain the definition of a function that follows this one in the lookup order.
+
+ @param cache where to keep the result
+ @param name the name of the function to find
+ @returns the function or nullptr if it is still being looked up on this thread
+ */
+template <typename Function>
+Function next(std::atomic<Function>& cache, const char* name) noexcept {
+  auto function = cache.load(std::memory_order_acquire);
+  if (function != nullptr || resolving) return function;
+  resolving = true;
+  function = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+  resolving = false;
+  cache.store(function, std::memory_order_release);
+  return function;
+}
+
+} // end namespace DSPHeaders::RealtimeSafetyInterposers
+
+extern "C" {
+
+void* malloc(size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void* (*)(size_t)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "malloc");
+  if (function == nullptr) return RealtimeSafetyInterposers::bootstrapAllocate(size);
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void* (*)(size_t, size_t)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "calloc");
+  if (function == nullptr) return RealtimeSafetyInterposers::bootstrapAllocate(count * size);
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void* (*)(void*, size_t)> real{nullptr};
+  if (RealtimeSafetyInterposers::isBootstrap(ptr)) {
+    // Move out of the bootstrap storage, copying no more than what remains of it.
+    auto moved = malloc(size);
+    auto available = size_t(RealtimeSafetyInterposers::bootstrap + sizeof(RealtimeSafetyInterposers::bootstrap) -
+                            static_cast<char*>(ptr));
+    if (moved != nullptr) std::memcpy(moved, ptr, size < available ? size : available);
+    return moved;
+  }
+  auto function = RealtimeSafetyInterposers::next(real, "realloc");
+  if (function == nullptr) return nullptr;
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(ptr, size);
+}
+
+void free(void* ptr) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void (*)(void*)> real{nullptr};
+  if (ptr == nullptr || RealtimeSafetyInterposers::isBootstrap(ptr)) return;
+  auto function = RealtimeSafetyInterposers::next(real, "free");
+  if (function == nullptr) return;
+  RealtimeSafety::note(RealtimeSafety::Violation::deallocation);
+  function(ptr);
+}
+
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<int (*)(void**, size_t, size_t)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "posix_memalign");
+  if (function == nullptr) return ENOMEM;
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(ptr, alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void* (*)(size_t, size_t)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "aligned_alloc");
+  if (function == nullptr) return nullptr;
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(alignment, size);
+}
+
+void* memalign(size_t alignment, size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void* (*)(size_t, size_t)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "memalign");
+  if (function == nullptr) return nullptr;
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(alignment, size);
+}
+
+void* valloc(size_t size) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<void* (*)(size_t)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "valloc");
+  if (function == nullptr) return nullptr;
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return function(size);
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept {
+  using namespace DSPHeaders;
+  static std::atomic<int (*)(pthread_mutex_t*)> real{nullptr};
+  auto function = RealtimeSafetyInterposers::next(real, "pthread_mutex_lock");
+  if (function == nullptr) return EAGAIN;
+  RealtimeSafety::note(RealtimeSafety::Violation::lock);
+  return function(mutex);
+}
+
+} // end extern "C"
+
+#elif defined(__APPLE__)
+
+#import <mach/mach.h>
+#import <mach-o/dyld-interposing.h>
+#import <malloc/malloc.h>
+
+namespace DSPHeaders::RealtimeSafetyInterposers {
+
+/// The default zone as it was before its functions were replaced.
+inline malloc_zone_t original{};
+
+inline void* zoneMalloc(malloc_zone_t* zone, size_t size) {
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return original.malloc(zone, size);
+}
+
+inline void* zoneCalloc(malloc_zone_t* zone, size_t count, size_t size) {
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return original.calloc(zone, count, size);
+}
+
+inline void* zoneValloc(malloc_zone_t* zone, size_t size) {
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return original.valloc(zone, size);
+}
+
+inline void* zoneRealloc(malloc_zone_t* zone, void* ptr, size_t size) {
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return original.realloc(zone, ptr, size);
+}
+
+inline void* zoneMemalign(malloc_zone_t* zone, size_t alignment, size_t size) {
+  RealtimeSafety::note(RealtimeSafety::Violation::allocation);
+  return original.memalign(zone, alignment, size);
+}
+
+inline void zoneFree(malloc_zone_t* zone, void* ptr) {
+  if (ptr != nullptr) RealtimeSafety::note(RealtimeSafety::Violation::deallocation);
+  original.free(zone, ptr);
+}
+
+inline void zoneFreeDefiniteSize(malloc_zone_t* zone, void* ptr, size_t size) {
+  if (ptr != nullptr) RealtimeSafety::note(RealtimeSafety::Violation::deallocation);
+  original.free_definite_size(zone, ptr, size);
+}
+
+/**
+ Replace the functions of the default malloc zone with ones that report to `RealtimeSafety`. The zone is kept in
+ read-only memory, so it is made writable for the change.
+ */
+inline void installZoneHooks() noexcept {
+  vm_address_t* zones = nullptr;
+  unsigned int zoneCount = 0;
+  if (malloc_get_all_zones(mach_task_self(), nullptr, &zones, &zoneCount) != KERN_SUCCESS || zoneCount == 0) return;
+
+  auto zone = reinterpret_cast<malloc_zone_t*>(zones[0]);
+  auto address = reinterpret_cast<vm_address_t>(zone);
+  if (vm_protect(mach_task_self(), address, sizeof(malloc_zone_t), 0, VM_PROT_READ | VM_PROT_WRITE) != KERN_SUCCESS) {
+    return;
+  }
+
+  original = *zone;
+  zone->malloc = zoneMalloc;
+  zone->calloc = zoneCalloc;
+  zone->valloc = zoneValloc;
+  zone->realloc = zoneRealloc;
+  zone->free = zoneFree;
+  if (zone->version >= 5 && original.memalign != nullptr) zone->memalign = zoneMemalign;
+  if (zone->version >= 6 && original.free_definite_size != nullptr) zone->free_definite_size = zoneFreeDefiniteSize;
+  vm_protect(mach_task_self(), address, sizeof(malloc_zone_t), 0, VM_PROT_READ);
+}
+
+/// Calls from this image are not interposed, so this reaches the real `pthread_mutex_lock`.
+inline int checkedMutexLock(pthread_mutex_t* mutex) {
+  RealtimeSafety::note(RealtimeSafety::Violation::lock);
+  return pthread_mutex_lock(mutex);
+}
+
+} // end namespace DSPHeaders::RealtimeSafetyInterposers
+
+__attribute__((constructor)) static void installRealtimeSafetyZoneHooks() {
+  DSPHeaders::RealtimeSafetyInterposers::installZoneHooks();
+}
+
+DYLD_INTERPOSE(DSPHeaders::RealtimeSafetyInterposers::checkedMutexLock, pthread_mutex_lock)
+
+#endif
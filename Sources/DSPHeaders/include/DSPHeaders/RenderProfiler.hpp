@@ -0,0 +1,259 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <array>
+#import <atomic>
+#import <cstdint>
+#import <vector>
+
+#if defined(__APPLE__)
+#import <mach/mach_time.h>
+#elif defined(__x86_64__)
+#import <chrono>
+#import <thread>
+#import <x86intrin.h>
+#else
+#import <time.h>
+#endif
+
+#import <AudioToolbox/AudioToolbox.h>
+
+namespace DSPHeaders {
+
+/**
+ Records how long render calls take so that one can see how close a kernel is to its real-time deadline.
+
+ The render thread calls `record` after each timed call. This stores the elapsed time, the frame count, and the kind
+ of call in a single atomic word in a fixed-size ring, so recording never blocks, never allocates, and costs one clock
+ read and one relaxed store. Another thread periodically calls `collect` to move the new records into histograms of
+ *load* -- the elapsed time of a call divided by the duration of the audio it rendered -- and then reads the results
+ with `statistics`. If the ring wraps before `collect` is called, the oldest records are lost and counted as dropped.
+
+ `EventProcessor` uses a profiler if the kernel defines a `renderProfiler()` method that returns a reference to one.
+ Kernels without that method pay nothing.
+ */
+class RenderProfiler {
+public:
+
+  /// The kind of call being timed.
+  enum struct Kind { processAndRender = 0, doRendering = 1 };
+
+  /// Timestamp in platform clock ticks.
+  using Ticks = uint64_t;
+
+  /// The number of records held in the ring. A power of 2.
+  inline static constexpr size_t DefaultCapacity = 4096;
+
+  /// The number of histogram buckets per 100% load. Loads of `MaxLoad` or more go into the last bucket.
+  inline static constexpr size_t BucketsPerUnitLoad = 200;
+  inline static constexpr size_t MaxLoad = 4;
+  inline static constexpr size_t BucketCount = BucketsPerUnitLoad * MaxLoad + 1;
+
+  /// Summary of the records collected so far for one kind of call.
+  struct Statistics {
+    /// Number of calls
+    size_t count{0};
+    /// Number of calls that took longer than the duration of the audio they rendered
+    size_t overBudgetCount{0};
+    /// Median load (resolution is 1 / `BucketsPerUnitLoad`)
+    double p50Load{0.0};
+    /// 99th percentile load (resolution is 1 / `BucketsPerUnitLoad`)
+    double p99Load{0.0};
+    /// Largest load seen
+    double maxLoad{0.0};
+    /// Average elapsed time of a call
+    double meanNanoseconds{0.0};
+    /// Largest elapsed time of a call
+    double maxNanoseconds{0.0};
+  };
+
+  /**
+   Construct new instance.
+
+   @param capacity the number of records to hold before the ring wraps. Rounded up to a power of 2.
+   */
+  explicit RenderProfiler(size_t capacity = DefaultCapacity) : ring_(roundUpPowerOf2(capacity)) {
+    mask_ = ring_.size() - 1;
+    for (auto& slot : ring_) slot.store(0, std::memory_order_relaxed);
+  }
+
+  RenderProfiler(const RenderProfiler&) = delete;
+  RenderProfiler& operator =(const RenderProfiler&) = delete;
+
+  /**
+   Set the sample rate used to convert frame counts into a time budget. Not safe to call while rendering.
+
+   @param sampleRate the sample rate of the audio being rendered
+   */
+  void setSampleRate(double sampleRate) noexcept { sampleRate_ = sampleRate; }
+
+  /// @returns the current sample rate
+  double sampleRate() const noexcept { return sampleRate_; }
+
+  /// @returns the current time in clock ticks. This is `mach_absolute_time` on Apple platforms, the time stamp counter
+  /// on other x86-64 platforms, and `CLOCK_MONOTONIC_RAW` nanoseconds elsewhere.
+  static Ticks now() noexcept {
+#if defined(__APPLE__)
+    return mach_absolute_time();
+#elif defined(__x86_64__)
+    return __rdtsc();
+#else
+    timespec spec;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &spec);
+    return Ticks(spec.tv_sec) * 1'000'000'000 + Ticks(spec.tv_nsec);
+#endif
+  }
+
+  /// @returns the number of nanoseconds in one clock tick
+  static double nanosecondsPerTick() noexcept {
+#if defined(__APPLE__)
+    mach_timebase_info_data_t info;
+    mach_timebase_info(&info);
+    return double(info.numer) / double(info.denom);
+#elif defined(__x86_64__)
+    // Calibrate the time stamp counter against the steady clock once.
+    static const double period = []() {
+      auto clockStart = std::chrono::steady_clock::now();
+      auto tickStart = __rdtsc();
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      auto ticks = double(__rdtsc() - tickStart);
+      auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - clockStart).count();
+      return elapsed / ticks;
+    }();
+    return period;
+#else
+    return 1.0;
+#endif
+  }
+
+  /**
+   Record the end of a timed call. Only one thread may call this at a time.
+
+   @param kind the kind of call that was timed
+   @param start the value from `now()` that was taken at the start of the call
+   @param frameCount the number of frames rendered by the call
+   */
+  void record(Kind kind, Ticks start, AUAudioFrameCount frameCount) noexcept {
+    auto elapsed = std::min<Ticks>(now() - start, ElapsedMask);
+    auto word = elapsed << ElapsedShift | Ticks(std::min<AUAudioFrameCount>(frameCount, FrameMask)) << FrameShift |
+    Ticks(kind);
+    auto index = writeIndex_.load(std::memory_order_relaxed);
+    ring_[index & mask_].store(word, std::memory_order_relaxed);
+    writeIndex_.store(index + 1, std::memory_order_release);
+  }
+
+  /**
+   Move any new records from the ring into the histograms. Call from any thread but the render thread.
+
+   @returns the number of records collected
+   */
+  size_t collect() noexcept {
+    auto end = writeIndex_.load(std::memory_order_acquire);
+    if (end - readIndex_ > ring_.size()) {
+      dropped_ += end - readIndex_ - ring_.size();
+      readIndex_ = end - ring_.size();
+    }
+
+    size_t count = 0;
+    auto tickPeriod = nanosecondsPerTick();
+    for (; readIndex_ < end; ++readIndex_, ++count) {
+      auto word = ring_[readIndex_ & mask_].load(std::memory_order_relaxed);
+      auto& accumulator = accumulators_[word & KindMask];
+      auto frameCount = (word >> FrameShift) & FrameMask;
+      auto nanoseconds = double(word >> ElapsedShift) * tickPeriod;
+      auto budget = double(frameCount) / sampleRate_ * 1.0e9;
+      auto load = budget > 0.0 ? nanoseconds / budget : 0.0;
+      accumulator.add(load, nanoseconds);
+    }
+
+    return count;
+  }
+
+  /**
+   Obtain the summary of the records collected so far.
+
+   @param kind the kind of call to report on
+   @returns the statistics for the call
+   */
+  Statistics statistics(Kind kind) const noexcept { return accumulators_[size_t(kind)].statistics(); }
+
+  /// @returns the number of records lost because `collect` was not called often enough
+  size_t droppedCount() const noexcept { return dropped_; }
+
+  /**
+   Forget everything that has been collected. Does not touch records that have not yet been collected.
+   */
+  void reset() noexcept {
+    for (auto& accumulator : accumulators_) accumulator = Accumulator{};
+    dropped_ = 0;
+  }
+
+private:
+
+  struct Accumulator {
+    void add(double load, double nanoseconds) noexcept {
+      ++count;
+      if (load > 1.0) ++overBudgetCount;
+      maxLoad = std::max(maxLoad, load);
+      maxNanoseconds = std::max(maxNanoseconds, nanoseconds);
+      totalNanoseconds += nanoseconds;
+      auto bucket = std::min(size_t(load * BucketsPerUnitLoad), BucketCount - 1);
+      ++histogram[bucket];
+    }
+
+    double percentile(double fraction) const noexcept {
+      auto target = size_t(fraction * double(count - 1));
+      size_t seen = 0;
+      for (size_t bucket = 0; bucket < BucketCount; ++bucket) {
+        seen += histogram[bucket];
+        if (seen > target) return std::min(double(bucket + 1) / BucketsPerUnitLoad, maxLoad);
+      }
+      return maxLoad;
+    }
+
+    Statistics statistics() const noexcept {
+      Statistics stats;
+      stats.count = count;
+      if (count == 0) return stats;
+      stats.overBudgetCount = overBudgetCount;
+      stats.p50Load = percentile(0.50);
+      stats.p99Load = percentile(0.99);
+      stats.maxLoad = maxLoad;
+      stats.meanNanoseconds = totalNanoseconds / double(count);
+      stats.maxNanoseconds = maxNanoseconds;
+      return stats;
+    }
+
+    std::array<size_t, BucketCount> histogram{};
+    size_t count{0};
+    size_t overBudgetCount{0};
+    double maxLoad{0.0};
+    double maxNanoseconds{0.0};
+    double totalNanoseconds{0.0};
+  };
+
+  // Layout of a record word: 32 bits of elapsed ticks, 24 bits of frame count, 8 bits of kind.
+  inline static constexpr size_t ElapsedShift = 32;
+  inline static constexpr Ticks ElapsedMask = 0xFFFFFFFF;
+  inline static constexpr size_t FrameShift = 8;
+  inline static constexpr Ticks FrameMask = 0xFFFFFF;
+  inline static constexpr Ticks KindMask = 0x01;
+
+  static size_t roundUpPowerOf2(size_t value) noexcept {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+  std::vector<std::atomic<Ticks>> ring_;
+  size_t mask_;
+  alignas(64) std::atomic<size_t> writeIndex_{0};
+  alignas(64) size_t readIndex_{0};
+  size_t dropped_{0};
+  double sampleRate_{44100.0};
+  std::array<Accumulator, 2> accumulators_{};
+};
+
+} // end namespace DSPHeaders
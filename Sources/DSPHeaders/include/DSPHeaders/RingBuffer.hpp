@@ -0,0 +1,181 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <atomic>
+#import <vector>
+
+namespace DSPHeaders {
+
+/**
+ Lock-free ring buffer that moves blocks of multichannel samples from one producer thread to one consumer thread, such
+ as from a kernel's `doRendering` to a scope or spectrum analyzer in the UI. Neither side ever blocks, waits, or
+ allocates after construction.
+
+ Frames are pushed and popped in blocks using any collection of channel pointers with `size()` and `operator[]`, such
+ as `BusBuffers`. Samples are held per channel, and the capacity is rounded up to a power of 2 so that positions wrap
+ with a mask as in `DelayBuffer`. The read and write positions are counters that never wrap, each on its own cache
+ line so that the two threads do not fight over one line while they work.
+
+ What happens when the producer gets too far ahead depends on the `Overflow` setting given to the constructor:
+
+ - `dropNewest` -- `push` only writes as many frames as there is space for. Nothing that is in the buffer is ever
+ lost, which suits recorders and analyzers that must see every sample.
+ - `overwriteOldest` -- `push` always writes everything and the consumer skips over whatever was overwritten before
+ it could be read, which suits scopes that only care about the latest samples. To spot a push that overwrites samples
+ while `pop` is copying them, the producer announces each push before writing it, and `pop` checks that announcement
+ after copying, copying again if it must.
+
+ Samples are stored as relaxed atomics so that an overwrite during a `pop` is well-defined. On arm64 and x86-64 these
+ are plain loads and stores.
+ */
+template <typename T>
+class RingBuffer {
+public:
+
+  /// What `push` does when the consumer has not made room for new frames.
+  enum struct Overflow {
+    dropNewest,
+    overwriteOldest
+  };
+
+  /**
+   Construct a new buffer. This allocates all of the storage that will ever be used.
+
+   @param channelCount the number of channels in each frame
+   @param capacity the minimum number of frames to hold. The actual capacity is the next power of 2.
+   @param overflow what to do when there is no room for a push
+   */
+  RingBuffer(size_t channelCount, size_t capacity, Overflow overflow = Overflow::dropNewest) :
+  channelCount_{channelCount}, capacity_{roundUpPowerOf2(capacity)}, mask_{capacity_ - 1}, overflow_{overflow},
+  storage_(channelCount_ * capacity_)
+  {
+    for (auto& sample : storage_) sample.store(T{0}, std::memory_order_relaxed);
+  }
+
+  /// @returns the number of channels in each frame
+  size_t channelCount() const noexcept { return channelCount_; }
+
+  /// @returns the number of frames that the buffer can hold. Always a power of 2.
+  size_t capacity() const noexcept { return capacity_; }
+
+  /// @returns the number of frames that the consumer could pop. Only meaningful on the consumer thread.
+  size_t available() const noexcept {
+    return std::min(writeIndex_.load(std::memory_order_acquire) - readIndex_.load(std::memory_order_relaxed),
+                    capacity_);
+  }
+
+  /**
+   Add frames to the end of the buffer. Only one thread may call this.
+
+   @param channels the samples to add. Channels beyond `channelCount` are ignored, and missing ones are written as
+   zeros.
+   @param frameCount the number of frames to add
+   @returns the number of frames added. This is always `frameCount` with `Overflow::overwriteOldest`.
+   */
+  template <typename Channels>
+  size_t push(const Channels& channels, size_t frameCount) noexcept {
+    auto write = writeIndex_.load(std::memory_order_relaxed);
+    size_t skip = 0;
+    if (overflow_ == Overflow::dropNewest) {
+      frameCount = std::min(frameCount, capacity_ - (write - readIndex_.load(std::memory_order_acquire)));
+    } else {
+      // Only the last `capacity_` frames of a huge push can survive.
+      skip = frameCount > capacity_ ? frameCount - capacity_ : 0;
+      claimIndex_.store(write + frameCount, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    auto begin = write + skip;
+    auto count = frameCount - skip;
+    for (size_t channel = 0; channel < channelCount_; ++channel) {
+      auto* ring = storage_.data() + channel * capacity_;
+      auto position = begin & mask_;
+      auto first = std::min(count, capacity_ - position);
+      if (channel < size_t(channels.size())) {
+        const T* samples = channels[channel] + skip;
+        for (size_t frame = 0; frame < first; ++frame) ring[position + frame].store(samples[frame], Relaxed);
+        for (size_t frame = first; frame < count; ++frame) ring[frame - first].store(samples[frame], Relaxed);
+      } else {
+        for (size_t frame = 0; frame < first; ++frame) ring[position + frame].store(T{0}, Relaxed);
+        for (size_t frame = first; frame < count; ++frame) ring[frame - first].store(T{0}, Relaxed);
+      }
+    }
+
+    writeIndex_.store(write + frameCount, std::memory_order_release);
+    return frameCount;
+  }
+
+  /**
+   Remove frames from the front of the buffer. Only one thread may call this. With `Overflow::overwriteOldest`, the
+   frame count should be well below the capacity so that the producer cannot keep overwriting the frames being copied.
+
+   @param channels where to store the samples. Channels beyond `channelCount` are left alone.
+   @param frameCount the maximum number of frames to remove
+   @returns the number of frames removed
+   */
+  template <typename Channels>
+  size_t pop(const Channels& channels, size_t frameCount) noexcept {
+    auto read = readIndex_.load(std::memory_order_relaxed);
+    while (true) {
+      auto write = writeIndex_.load(std::memory_order_acquire);
+      if (write - read > capacity_) {
+        dropped_ += write - read - capacity_;
+        read = write - capacity_;
+      }
+
+      auto count = std::min(frameCount, write - read);
+      auto position = read & mask_;
+      auto first = std::min(count, capacity_ - position);
+      for (size_t channel = 0; channel < std::min(channelCount_, size_t(channels.size())); ++channel) {
+        const auto* ring = storage_.data() + channel * capacity_;
+        T* samples = channels[channel];
+        for (size_t frame = 0; frame < first; ++frame) samples[frame] = ring[position + frame].load(Relaxed);
+        for (size_t frame = first; frame < count; ++frame) samples[frame] = ring[frame - first].load(Relaxed);
+      }
+
+      if (overflow_ == Overflow::overwriteOldest) {
+        // Any push that wrote over what was just copied has announced itself by now.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto claimed = claimIndex_.load(std::memory_order_relaxed);
+        if (claimed - read > capacity_) {
+          dropped_ += claimed - read - capacity_;
+          read = claimed - capacity_;
+          continue;
+        }
+      }
+
+      readIndex_.store(read + count, std::memory_order_release);
+      return count;
+    }
+  }
+
+  /// @returns the number of frames that the consumer skipped because they were overwritten. Consumer thread only.
+  size_t droppedCount() const noexcept { return dropped_; }
+
+private:
+  inline static constexpr auto Relaxed = std::memory_order_relaxed;
+
+  static size_t roundUpPowerOf2(size_t value) noexcept {
+    size_t result = 1;
+    while (result < value) result <<= 1;
+    return result;
+  }
+
+  const size_t channelCount_;
+  const size_t capacity_;
+  const size_t mask_;
+  const Overflow overflow_;
+  std::vector<std::atomic<T>> storage_;
+
+  // Written by the producer
+  alignas(64) std::atomic<size_t> writeIndex_{0};
+  std::atomic<size_t> claimIndex_{0};
+
+  // Written by the consumer
+  alignas(64) std::atomic<size_t> readIndex_{0};
+  size_t dropped_{0};
+};
+
+} // end namespace DSPHeaders
@@ -2,6 +2,9 @@
 
 #pragma once
 
+#import <algorithm>
+#import <cstddef>
+#import <stdexcept>
 #import <string>
 
 #import <os/log.h>
@@ -9,44 +12,89 @@
 #import <AudioUnit/AudioUnit.h>
 #import <AVFoundation/AVFoundation.h>
 
+#import "DSPHeaders/AlignedArena.hpp"
 #import "DSPHeaders/BufferFacet.hpp"
 
 namespace DSPHeaders {
 
 /**
- Maintains a buffer of PCM samples which can be used to save samples from an upstream node. Internally uses an
- `AVAudioPCMBuffer` to deal with specifics involving the audio format.
+ Maintains a buffer of PCM samples which can be used to save samples from an upstream node. Holds one non-interleaved
+ `AUValue` buffer per channel of the format, along with the `AudioBufferList` that describes them. All of this lives in
+ an `AlignedArena`, either one owned by the buffer or one shared with other buffers (see `EventProcessor`), so each
+ channel starts on a cache-line boundary.
  */
 struct SampleBuffer {
 
   SampleBuffer() noexcept {}
 
   /**
-   Set the format of the buffer to use.
-   
+   Obtain the number of arena bytes needed to hold a buffer.
+
+   @param channelCount the number of channels in the buffer
+   @param maxFrames the maximum number of frames to hold
+   @returns the number of bytes needed
+   */
+  static size_t arenaSize(AUAudioChannelCount channelCount, AUAudioFrameCount maxFrames) noexcept {
+    return AlignedArena::alignedSize(bufferListSize(channelCount)) +
+    channelCount * AlignedArena::alignedSize(maxFrames * sizeof(AUValue));
+  }
+
+  /**
+   Set the format of the buffer to use. Memory comes from an arena owned by this buffer.
+
+   @param format the format of the samples
+   @param maxFrames the maximum number of frames to be found in the upstream output
+   */
+  void allocate(AVAudioFormat* format, AUAudioFrameCount maxFrames)
+  {
+    ownArena_.reserve(arenaSize([format channelCount], maxFrames));
+    allocate(format, maxFrames, ownArena_);
+  }
+
+  /**
+   Set the format of the buffer to use. Memory comes from the given arena, which must have space for `arenaSize`
+   bytes and must outlive the use of this buffer.
+
    @param format the format of the samples
    @param maxFrames the maximum number of frames to be found in the upstream output
+   @param arena the arena to take memory from
    */
-  void allocate(AVAudioFormat* format, AUAudioFrameCount maxFrames) noexcept
+  void allocate(AVAudioFormat* format, AUAudioFrameCount maxFrames, AlignedArena& arena)
   {
+    AUAudioChannelCount channelCount = [format channelCount];
+    auto bufferList = reinterpret_cast<AudioBufferList*>(arena.take<std::byte>(bufferListSize(channelCount)));
+    if (bufferList == nullptr) {
+      throw std::runtime_error("arena too small for SampleBuffer");
+    }
+
+    bufferList->mNumberBuffers = channelCount;
+    for (AUAudioChannelCount channel = 0; channel < channelCount; ++channel) {
+      auto& buffer = bufferList->mBuffers[channel];
+      buffer.mNumberChannels = 1;
+      buffer.mDataByteSize = UInt32(maxFrames * sizeof(AUValue));
+      buffer.mData = arena.take<AUValue>(maxFrames);
+      if (buffer.mData == nullptr) {
+        throw std::runtime_error("arena too small for SampleBuffer");
+      }
+    }
+
     maxFramesToRender_ = maxFrames;
-    buffer_ = [[AVAudioPCMBuffer alloc] initWithPCMFormat: format frameCapacity: maxFrames];
-    mutableAudioBufferList_ = buffer_.mutableAudioBufferList;
+    mutableAudioBufferList_ = bufferList;
   }
-  
+
   /**
    Forget any allocated buffer.
    */
   void release()
   {
-    if (buffer_ == nullptr) {
-      throw std::runtime_error("buffer_ == nullptr");
+    if (mutableAudioBufferList_ == nullptr) {
+      throw std::runtime_error("mutableAudioBufferList_ == nullptr");
     }
 
-    buffer_ = nullptr;
     mutableAudioBufferList_ = nullptr;
+    ownArena_.release();
   }
-  
+
   /**
    Obtain samples from an upstream node. Output is stored in internal buffer.
    
@@ -100,8 +148,13 @@ struct SampleBuffer {
   }
 
 private:
-  AUAudioFrameCount maxFramesToRender_;
-  AVAudioPCMBuffer* buffer_{nullptr};
+
+  static size_t bufferListSize(AUAudioChannelCount channelCount) noexcept {
+    return offsetof(AudioBufferList, mBuffers) + sizeof(AudioBuffer) * std::max<AUAudioChannelCount>(channelCount, 1);
+  }
+
+  AlignedArena ownArena_{};
+  AUAudioFrameCount maxFramesToRender_{0};
   AudioBufferList* mutableAudioBufferList_{nullptr};
 };
 
@@ -0,0 +1,295 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <array>
+#import <cmath>
+#import <cstdint>
+#import <cstring>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+
+/**
+ Conversions between the non-interleaved float samples that kernels render with and the interleaved float and integer
+ sample formats found in files and some hosts. Each conversion is done in one pass: integer samples are decoded while
+ they are deinterleaved, and encoded (with optional dither) while they are interleaved.
+
+ Interleaved data has the samples of each frame stored together, channel 0 first. Integer samples are signed, little
+ endian, and 24-bit samples are packed into 3 bytes. Loops for 1, 2, 4, 6, and 8 channels are specialized with the
+ channel count as a compile-time constant so that the compiler can unroll and vectorize them.
+ */
+namespace DSPHeaders::SampleConversion {
+
+/// The external sample formats that are supported.
+enum struct SampleType { float32, int16, int24, int32 };
+
+/**
+ Codecs that read and write one sample of a given format. Encoding takes a dither value in LSB units that is added to
+ the scaled sample before rounding.
+ */
+namespace Codec {
+
+/// Round to the nearest integer, with halves away from zero. Unlike `std::lrint` this is inlined and vectorizable.
+inline int32_t round(AUValue value) noexcept { return int32_t(value + (value < 0.0f ? -0.5f : 0.5f)); }
+
+struct Float32 {
+  inline static constexpr size_t Size = 4;
+  inline static constexpr bool Dithered = false;
+
+  static AUValue decode(const uint8_t* ptr) noexcept {
+    float value;
+    memcpy(&value, ptr, Size);
+    return value;
+  }
+
+  static void encode(AUValue value, AUValue, uint8_t* ptr) noexcept { memcpy(ptr, &value, Size); }
+};
+
+struct Int16 {
+  inline static constexpr size_t Size = 2;
+  inline static constexpr bool Dithered = true;
+
+  static AUValue decode(const uint8_t* ptr) noexcept {
+    int16_t value;
+    memcpy(&value, ptr, Size);
+    return AUValue(value) * (1.0f / 32768.0f);
+  }
+
+  static void encode(AUValue value, AUValue dither, uint8_t* ptr) noexcept {
+    auto scaled = std::clamp(value * 32768.0f + dither, -32768.0f, 32767.0f);
+    auto sample = int16_t(round(scaled));
+    memcpy(ptr, &sample, Size);
+  }
+};
+
+struct Int24 {
+  inline static constexpr size_t Size = 3;
+  inline static constexpr bool Dithered = true;
+
+  static AUValue decode(const uint8_t* ptr) noexcept {
+    // Assemble in the top 24 bits and shift back down to sign-extend.
+    auto bits = uint32_t(ptr[0]) << 8 | uint32_t(ptr[1]) << 16 | uint32_t(ptr[2]) << 24;
+    return AUValue(int32_t(bits) >> 8) * (1.0f / 8388608.0f);
+  }
+
+  static void encode(AUValue value, AUValue dither, uint8_t* ptr) noexcept {
+    auto scaled = std::clamp(value * 8388608.0f + dither, -8388608.0f, 8388607.0f);
+    auto sample = uint32_t(round(scaled));
+    ptr[0] = uint8_t(sample);
+    ptr[1] = uint8_t(sample >> 8);
+    ptr[2] = uint8_t(sample >> 16);
+  }
+};
+
+struct Int32 {
+  inline static constexpr size_t Size = 4;
+  inline static constexpr bool Dithered = true;
+
+  static AUValue decode(const uint8_t* ptr) noexcept {
+    int32_t value;
+    memcpy(&value, ptr, Size);
+    return AUValue(double(value) * (1.0 / 2147483648.0));
+  }
+
+  static void encode(AUValue value, AUValue dither, uint8_t* ptr) noexcept {
+    // A float cannot hold all 32-bit integers, so scale and clamp in double precision.
+    auto scaled = std::clamp(double(value) * 2147483648.0 + double(dither), -2147483648.0, 2147483647.0);
+    auto sample = int32_t(scaled + (scaled < 0.0 ? -0.5 : 0.5));
+    memcpy(ptr, &sample, Size);
+  }
+};
+
+} // end namespace Codec
+
+/// Dither source that does nothing.
+struct NoDither {
+  AUValue operator()() noexcept { return 0.0; }
+};
+
+/**
+ Source of triangular probability density function (TPDF) dither. Each value is the difference of two uniform random
+ values, giving noise in the range (-1, +1) LSB that decorrelates the quantization error from the signal. Uses one step
+ of a small xorshift generator per value, taking the two uniform values from its upper and lower 16 bits, so it is cheap
+ and safe to use on the render thread.
+ */
+class TPDFDither {
+public:
+
+  /**
+   Construct new instance.
+
+   @param seed the starting state of the random number generator. Must not be zero.
+   */
+  explicit TPDFDither(uint32_t seed = 0x9E3779B9) noexcept : state_{seed != 0 ? seed : 1} {}
+
+  /// @returns the next dither value in LSB units
+  AUValue operator()() noexcept {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return AUValue(int32_t(state_ >> 16) - int32_t(state_ & 0xFFFF)) * (1.0f / 65536.0f);
+  }
+
+private:
+
+  uint32_t state_;
+};
+
+/// @returns the number of bytes in one sample of the given type
+inline constexpr size_t bytesPerSample(SampleType type) noexcept {
+  switch (type) {
+    case SampleType::float32: return Codec::Float32::Size;
+    case SampleType::int16: return Codec::Int16::Size;
+    case SampleType::int24: return Codec::Int24::Size;
+    case SampleType::int32: return Codec::Int32::Size;
+  }
+  return 0;
+}
+
+namespace Detail {
+
+template <typename C, size_t N>
+void deinterleave(const uint8_t* in, BusBuffers out, AUAudioFrameCount frameCount) noexcept {
+  std::array<AUValue*, N> channels;
+  for (size_t channel = 0; channel < N; ++channel) channels[channel] = out[channel];
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < N; ++channel) {
+      channels[channel][frame] = C::decode(in);
+      in += C::Size;
+    }
+  }
+}
+
+template <typename C>
+void deinterleave(const uint8_t* in, BusBuffers out, AUAudioFrameCount frameCount) noexcept {
+  auto channelCount = out.size();
+  for (size_t channel = 0; channel < channelCount; ++channel) {
+    AUValue* samples = out[channel];
+    const uint8_t* ptr = in + channel * C::Size;
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      samples[frame] = C::decode(ptr);
+      ptr += channelCount * C::Size;
+    }
+  }
+}
+
+template <typename C, size_t N, typename D>
+void interleave(BusBuffers in, uint8_t* out, AUAudioFrameCount frameCount, D& dither) noexcept {
+  std::array<const AUValue*, N> channels;
+  for (size_t channel = 0; channel < N; ++channel) channels[channel] = in[channel];
+
+  // Work with a local copy of the dither state -- writes through `out` could otherwise alias it.
+  auto localDither{dither};
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < N; ++channel) {
+      if constexpr (C::Dithered) {
+        C::encode(channels[channel][frame], localDither(), out);
+      } else {
+        C::encode(channels[channel][frame], 0.0, out);
+      }
+      out += C::Size;
+    }
+  }
+  dither = localDither;
+}
+
+template <typename C, typename D>
+void interleave(BusBuffers in, uint8_t* out, AUAudioFrameCount frameCount, D& dither) noexcept {
+  auto channelCount = in.size();
+  auto localDither{dither};
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      if constexpr (C::Dithered) {
+        C::encode(in[channel][frame], localDither(), out);
+      } else {
+        C::encode(in[channel][frame], 0.0, out);
+      }
+      out += C::Size;
+    }
+  }
+  dither = localDither;
+}
+
+} // end namespace Detail
+
+/**
+ Decode interleaved samples into non-interleaved float buffers.
+
+ @param in pointer to the interleaved samples. Must hold `frameCount * out.size()` samples.
+ @param out the buffers to write to. The channel count of the interleaved data is taken from this.
+ @param frameCount the number of frames to convert
+ */
+template <typename C>
+void deinterleave(const void* in, BusBuffers out, AUAudioFrameCount frameCount) noexcept {
+  auto bytes = static_cast<const uint8_t*>(in);
+  switch (out.size()) {
+    case 1: Detail::deinterleave<C, 1>(bytes, out, frameCount); break;
+    case 2: Detail::deinterleave<C, 2>(bytes, out, frameCount); break;
+    case 4: Detail::deinterleave<C, 4>(bytes, out, frameCount); break;
+    case 6: Detail::deinterleave<C, 6>(bytes, out, frameCount); break;
+    case 8: Detail::deinterleave<C, 8>(bytes, out, frameCount); break;
+    default: Detail::deinterleave<C>(bytes, out, frameCount); break;
+  }
+}
+
+/**
+ Encode non-interleaved float buffers into interleaved samples.
+
+ @param in the buffers to read from. The channel count of the interleaved data is taken from this.
+ @param out pointer to the interleaved storage. Must hold `frameCount * in.size()` samples.
+ @param frameCount the number of frames to convert
+ @param dither the source of dither values. Ignored when encoding float samples.
+ */
+template <typename C, typename D = NoDither>
+void interleave(BusBuffers in, void* out, AUAudioFrameCount frameCount, D&& dither = D{}) noexcept {
+  auto bytes = static_cast<uint8_t*>(out);
+  switch (in.size()) {
+    case 1: Detail::interleave<C, 1>(in, bytes, frameCount, dither); break;
+    case 2: Detail::interleave<C, 2>(in, bytes, frameCount, dither); break;
+    case 4: Detail::interleave<C, 4>(in, bytes, frameCount, dither); break;
+    case 6: Detail::interleave<C, 6>(in, bytes, frameCount, dither); break;
+    case 8: Detail::interleave<C, 8>(in, bytes, frameCount, dither); break;
+    default: Detail::interleave<C>(in, bytes, frameCount, dither); break;
+  }
+}
+
+/**
+ Decode interleaved samples of a type only known at runtime into non-interleaved float buffers.
+
+ @param type the type of the interleaved samples
+ @param in pointer to the interleaved samples
+ @param out the buffers to write to
+ @param frameCount the number of frames to convert
+ */
+inline void deinterleave(SampleType type, const void* in, BusBuffers out, AUAudioFrameCount frameCount) noexcept {
+  switch (type) {
+    case SampleType::float32: deinterleave<Codec::Float32>(in, out, frameCount); break;
+    case SampleType::int16: deinterleave<Codec::Int16>(in, out, frameCount); break;
+    case SampleType::int24: deinterleave<Codec::Int24>(in, out, frameCount); break;
+    case SampleType::int32: deinterleave<Codec::Int32>(in, out, frameCount); break;
+  }
+}
+
+/**
+ Encode non-interleaved float buffers into interleaved samples of a type only known at runtime.
+
+ @param type the type of the interleaved samples
+ @param in the buffers to read from
+ @param out pointer to the interleaved storage
+ @param frameCount the number of frames to convert
+ @param dither the source of dither values. Ignored when encoding float samples.
+ */
+template <typename D = NoDither>
+void interleave(SampleType type, BusBuffers in, void* out, AUAudioFrameCount frameCount, D&& dither = D{}) noexcept {
+  switch (type) {
+    case SampleType::float32: interleave<Codec::Float32>(in, out, frameCount, dither); break;
+    case SampleType::int16: interleave<Codec::Int16>(in, out, frameCount, dither); break;
+    case SampleType::int24: interleave<Codec::Int24>(in, out, frameCount, dither); break;
+    case SampleType::int32: interleave<Codec::Int32>(in, out, frameCount, dither); break;
+  }
+}
+
+} // end namespace DSPHeaders::SampleConversion
@@ -0,0 +1,287 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cmath>
+#import <stdexcept>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/DSP.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Streaming sample rate converter for any ratio of input and output rates, using windowed sinc interpolation.
+
+ The interpolation filter is held in a table of `phaseCount` rows of `tapCount` coefficients, one row for each of a
+ set of evenly-spaced fractional positions between two input samples. Coefficients for a position between two rows are
+ linearly interpolated from the table. When converting to a lower rate, the filter cutoff is lowered to the output
+ Nyquist frequency and the number of taps is raised by the same factor to keep the same transition steepness.
+
+ Samples are read straight from the given input buffers -- only the last `tapCount` samples of each channel are kept
+ between calls, along with the first few of the next block for windows that straddle the two. The coefficients for an
+ output frame are made once and then applied to every channel with a dot product that uses several running sums, so
+ the compiler can vectorize it.
+
+ There are two ways to drive a converter:
+
+ - pull -- ask for a fixed number of output frames with `render`, after supplying the number of input frames given by
+ `inputFramesFor`. This suits an `EventProcessor` kernel that must produce a fixed block of frames.
+ - push -- give any number of input frames to `process`, which returns the number of output frames it made.
+
+ The output is delayed by `latency` input frames. All storage is allocated in the constructor.
+ */
+class SampleRateConverter {
+public:
+
+  /// Quality presets, trading conversion accuracy for processing cost.
+  enum struct Quality {
+    /// 16 taps, about 75 dB signal-to-noise ratio
+    draft,
+    /// 32 taps, about 85 dB signal-to-noise ratio
+    normal,
+    /// 64 taps, about 110 dB signal-to-noise ratio
+    high
+  };
+
+  /**
+   Construct a new converter.
+
+   @param channelCount the number of channels to convert
+   @param inputSampleRate the sample rate of the input samples
+   @param outputSampleRate the sample rate of the output samples
+   @param quality the quality preset to use
+   @throws std::invalid_argument if a sample rate is not positive or there are too many channels
+   */
+  SampleRateConverter(size_t channelCount, double inputSampleRate, double outputSampleRate,
+                      Quality quality = Quality::normal) :
+  channelCount_{channelCount}, inputSampleRate_{inputSampleRate}, outputSampleRate_{outputSampleRate},
+  quality_{quality}, step_{inputSampleRate / outputSampleRate}
+  {
+    if (!(inputSampleRate > 0.0) || !(outputSampleRate > 0.0)) {
+      throw std::invalid_argument("sample rates must be positive");
+    }
+    if (channelCount > BusBuffers::MaxChannelCount) throw std::invalid_argument("too many channels");
+
+    const auto& preset = presets_[size_t(quality)];
+    auto ratio = std::min(1.0, outputSampleRate / inputSampleRate);
+    tapCount_ = size_t(std::ceil(double(preset.tapCount) / ratio / 4.0)) * 4;
+    phaseCount_ = preset.phaseCount;
+    buildTable(preset.rolloff * ratio, preset.beta);
+
+    edges_.assign(channelCount, std::vector<AUValue>(2 * tapCount_ - 1, 0.0));
+    coefficients_.assign(tapCount_, 0.0);
+    reset();
+  }
+
+  /// @returns the sample rate of the input samples
+  double inputSampleRate() const noexcept { return inputSampleRate_; }
+
+  /// @returns the sample rate of the output samples
+  double outputSampleRate() const noexcept { return outputSampleRate_; }
+
+  /// @returns the quality preset in use
+  Quality quality() const noexcept { return quality_; }
+
+  /// @returns the number of input samples used to make each output sample
+  size_t tapCount() const noexcept { return tapCount_; }
+
+  /// @returns the delay of the output in input frames
+  double latency() const noexcept { return double(tapCount_ / 2); }
+
+  /**
+   Forget all past input samples.
+   */
+  void reset() noexcept
+  {
+    for (auto& edge : edges_) std::fill(edge.begin(), edge.end(), 0.0f);
+    start_ = 1 - ptrdiff_t(tapCount_);
+    fraction_ = 0.0;
+  }
+
+  /**
+   Obtain the number of input frames that must be given to `render` to make the given number of output frames.
+
+   @param outputFrameCount the number of output frames wanted
+   @returns the number of input frames to supply
+   */
+  AUAudioFrameCount inputFramesFor(AUAudioFrameCount outputFrameCount) const noexcept
+  {
+    if (outputFrameCount == 0) return 0;
+
+    // Step through the positions the same way that `process` does so that the two always agree.
+    auto start = start_;
+    auto fraction = fraction_;
+    for (AUAudioFrameCount frame = 1; frame < outputFrameCount; ++frame) {
+      fraction += step_;
+      auto whole = std::floor(fraction);
+      start += ptrdiff_t(whole);
+      fraction -= whole;
+    }
+    return AUAudioFrameCount(std::max<ptrdiff_t>(0, start + ptrdiff_t(tapCount_)));
+  }
+
+  /**
+   Obtain the most output frames that `process` can make from the given number of input frames.
+
+   @param inputFrameCount the number of input frames
+   @returns the largest possible number of output frames
+   */
+  AUAudioFrameCount maxOutputFramesFor(AUAudioFrameCount inputFrameCount) const noexcept
+  {
+    return AUAudioFrameCount(std::ceil(double(inputFrameCount) / step_)) + 1;
+  }
+
+  /**
+   Make a fixed number of output frames. The input must hold exactly `inputFramesFor(outputFrameCount)` frames.
+
+   @param ins the input samples
+   @param outs storage for the output samples
+   @param outputFrameCount the number of output frames to make
+   */
+  void render(BusBuffers ins, BusBuffers outs, AUAudioFrameCount outputFrameCount) noexcept
+  {
+    [[maybe_unused]] auto made = process(ins, inputFramesFor(outputFrameCount), outs, outputFrameCount);
+    assert(made == outputFrameCount);
+  }
+
+  /**
+   Convert all of the given input frames, making as many output frames as they allow.
+
+   @param ins the input samples
+   @param inputFrameCount the number of input frames
+   @param outs storage for the output samples
+   @param outputCapacity the number of frames that `outs` can hold. Must be at least
+   `maxOutputFramesFor(inputFrameCount)` unless the input comes from `inputFramesFor`.
+   @returns the number of output frames made
+   */
+  AUAudioFrameCount process(BusBuffers ins, AUAudioFrameCount inputFrameCount, BusBuffers outs,
+                            AUAudioFrameCount outputCapacity) noexcept
+  {
+    auto channelCount = std::min({ins.size(), outs.size(), channelCount_});
+    auto taps = ptrdiff_t(tapCount_);
+    auto available = ptrdiff_t(inputFrameCount);
+
+    // Place the start of the block after the saved history for windows that need both.
+    auto head = std::min<ptrdiff_t>(taps - 1, available);
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      std::copy(ins[channel], ins[channel] + head, edges_[channel].begin() + taps);
+    }
+
+    AUAudioFrameCount made = 0;
+    while (made < outputCapacity && start_ + taps <= available) {
+      makeCoefficients();
+      for (size_t channel = 0; channel < channelCount; ++channel) {
+        const AUValue* window = start_ < 0 ? edges_[channel].data() + taps + start_ : ins[channel] + start_;
+        outs[channel][made] = dot(window);
+      }
+      ++made;
+      fraction_ += step_;
+      auto whole = std::floor(fraction_);
+      start_ += ptrdiff_t(whole);
+      fraction_ -= whole;
+    }
+
+    // Keep the last `tapCount` input samples as history for the next block.
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      auto history = edges_[channel].data();
+      if (available >= taps) {
+        std::copy(ins[channel] + available - taps, ins[channel] + available, history);
+      } else {
+        std::copy(history + available, history + taps, history);
+        std::copy(ins[channel], ins[channel] + available, history + taps - available);
+      }
+    }
+
+    assert(start_ - available >= -taps);
+    start_ -= available;
+    return made;
+  }
+
+private:
+
+  struct Preset {
+    size_t tapCount;
+    size_t phaseCount;
+    double rolloff;
+    double beta;
+  };
+
+  inline static constexpr Preset presets_[] = {
+    {16, 128, 0.85, 6.0},
+    {32, 256, 0.90, 8.0},
+    {64, 512, 0.95, 10.0}
+  };
+
+  void buildTable(double cutoff, double beta)
+  {
+    // Row `phase` holds the coefficients for the position `phase / phaseCount` between two input samples. There is one
+    // extra row so that each row has a next one to interpolate towards.
+    std::vector<double> rows((phaseCount_ + 1) * tapCount_);
+    auto half = double(tapCount_ / 2);
+    for (size_t phase = 0; phase <= phaseCount_; ++phase) {
+      auto position = half - 1.0 + double(phase) / double(phaseCount_);
+      double sum = 0.0;
+      for (size_t tap = 0; tap < tapCount_; ++tap) {
+        auto value = DSP::kaiserSinc(position - double(tap), cutoff, half, beta);
+        rows[phase * tapCount_ + tap] = value;
+        sum += value;
+      }
+      for (size_t tap = 0; tap < tapCount_; ++tap) rows[phase * tapCount_ + tap] /= sum;
+    }
+
+    table_.resize(phaseCount_ * tapCount_);
+    deltas_.resize(phaseCount_ * tapCount_);
+    for (size_t index = 0; index < table_.size(); ++index) {
+      table_[index] = AUValue(rows[index]);
+      deltas_[index] = AUValue(rows[index + tapCount_] - rows[index]);
+    }
+  }
+
+  void makeCoefficients() noexcept
+  {
+    auto position = fraction_ * double(phaseCount_);
+    auto phase = std::min(size_t(position), phaseCount_ - 1);
+    auto blend = AUValue(position - double(phase));
+    const AUValue* __restrict row = table_.data() + phase * tapCount_;
+    const AUValue* __restrict delta = deltas_.data() + phase * tapCount_;
+    AUValue* __restrict coefficients = coefficients_.data();
+    for (size_t tap = 0; tap < tapCount_; ++tap) {
+      coefficients[tap] = row[tap] + blend * delta[tap];
+    }
+  }
+
+  AUValue dot(const AUValue* __restrict window) const noexcept
+  {
+    // Four independent sums so that the loop can be vectorized without changing the order of the additions.
+    const AUValue* __restrict coefficients = coefficients_.data();
+    AUValue sums[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (size_t tap = 0; tap < tapCount_; tap += 4) {
+      sums[0] += window[tap + 0] * coefficients[tap + 0];
+      sums[1] += window[tap + 1] * coefficients[tap + 1];
+      sums[2] += window[tap + 2] * coefficients[tap + 2];
+      sums[3] += window[tap + 3] * coefficients[tap + 3];
+    }
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+  }
+
+  size_t channelCount_;
+  double inputSampleRate_;
+  double outputSampleRate_;
+  Quality quality_;
+  double step_;
+  size_t tapCount_{0};
+  size_t phaseCount_{0};
+  std::vector<AUValue> table_{};
+  std::vector<AUValue> deltas_{};
+  std::vector<AUValue> coefficients_{};
+  std::vector<std::vector<AUValue>> edges_{};
+  ptrdiff_t start_{0};
+  double fraction_{0.0};
+};
+
+} // end namespace DSPHeaders
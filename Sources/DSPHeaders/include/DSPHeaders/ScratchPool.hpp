@@ -0,0 +1,88 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <cassert>
+#import <cstddef>
+
+#import "DSPHeaders/AlignedArena.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Temporary storage for a kernel's intermediate results (LFO blocks, modulation curves, filter stages) that only need
+ to live for one `doRendering` call. The pool is a view onto a region of memory allocated up front -- in
+ `EventProcessor` it is part of the same arena as the sample buffers -- and pieces are handed out with a bump pointer.
+ `EventProcessor` resets the pool before every `doRendering` call, so pieces must not be held onto between calls.
+
+ Pieces are aligned to `AlignedArena::Alignment` but are not cleared when handed out. Running out of space is a
+ programming error: it asserts in debug builds and returns nullptr otherwise.
+ */
+class ScratchPool {
+public:
+
+  /**
+   Obtain the number of pool bytes used by a piece holding `count` values of type T. Kernels use this to say how much
+   scratch space they need.
+
+   @param count the number of values
+   @returns the number of bytes used in the pool
+   */
+  template <typename T>
+  static constexpr size_t bytesFor(size_t count) noexcept { return AlignedArena::alignedSize(count * sizeof(T)); }
+
+  ScratchPool() noexcept = default;
+
+  /**
+   Set the memory to hand out. Forgets any pieces handed out so far.
+
+   @param storage the start of the memory. Must be aligned to `AlignedArena::Alignment`.
+   @param capacity the number of bytes available
+   */
+  void assign(std::byte* storage, size_t capacity) noexcept {
+    storage_ = storage;
+    capacity_ = storage != nullptr ? capacity : 0;
+    used_ = 0;
+    highWaterMark_ = 0;
+  }
+
+  /**
+   Obtain a piece of the pool for `count` values of type T.
+
+   @param count the number of values to hold
+   @returns pointer to the first value, or nullptr if the pool does not have enough space left
+   */
+  template <typename T>
+  T* take(size_t count) noexcept {
+    static_assert(alignof(T) <= AlignedArena::Alignment, "type alignment is larger than pool alignment");
+    auto size = bytesFor<T>(count);
+    assert(size <= capacity_ - used_ && "scratch pool overflow -- increase the kernel's scratchSize");
+    if (size > capacity_ - used_) return nullptr;
+    auto ptr = storage_ + used_;
+    used_ += size;
+    if (used_ > highWaterMark_) highWaterMark_ = used_;
+    return reinterpret_cast<T*>(ptr);
+  }
+
+  /**
+   Forget all pieces handed out so far. Done by `EventProcessor` before each `doRendering` call.
+   */
+  void reset() noexcept { used_ = 0; }
+
+  /// @returns the number of bytes in the pool
+  size_t capacity() const noexcept { return capacity_; }
+
+  /// @returns the number of bytes handed out since the last reset
+  size_t size() const noexcept { return used_; }
+
+  /// @returns the largest number of bytes that was ever handed out between resets
+  size_t highWaterMark() const noexcept { return highWaterMark_; }
+
+private:
+  std::byte* storage_{nullptr};
+  size_t capacity_{0};
+  size_t used_{0};
+  size_t highWaterMark_{0};
+};
+
+} // end namespace DSPHeaders
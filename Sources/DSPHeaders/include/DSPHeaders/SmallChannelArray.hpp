@@ -0,0 +1,78 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <array>
+#import <cassert>
+
+namespace DSPHeaders {
+
+/**
+ Fixed-capacity array with a variable size that keeps its elements inline. Used to hold per-channel values (such as
+ sample pointers) without any heap allocation, so that a copy is just a copy of the inline storage. This makes it cheap
+ to pass collections of channel pointers by value and lets the compiler treat them as loop-invariant locals.
+
+ The size can never exceed the `Capacity` template parameter.
+ */
+template <typename T, size_t Capacity>
+class SmallChannelArray {
+public:
+  using value_type = T;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  /// Construct an empty instance.
+  SmallChannelArray() noexcept : storage_{}, size_{0} {}
+
+  /**
+   Construct an instance with the given number of value-initialized elements.
+
+   @param size the number of elements to hold
+   */
+  explicit SmallChannelArray(size_t size) noexcept : storage_{}, size_{0} { resize(size); }
+
+  /// @returns the maximum number of elements that can be held
+  static constexpr size_t capacity() noexcept { return Capacity; }
+
+  /**
+   Change the number of elements held. Any new elements are value-initialized. Never allocates.
+
+   @param size the new number of elements. Must not be greater than the capacity.
+   */
+  void resize(size_t size) noexcept {
+    assert(size <= Capacity);
+    size = std::min(size, Capacity);
+    for (size_t index = size_; index < size; ++index) storage_[index] = T{};
+    size_ = size;
+  }
+
+  /// @returns the number of elements held
+  size_t size() const noexcept { return size_; }
+
+  /// @returns true if there are no elements
+  bool empty() const noexcept { return size_ == 0; }
+
+  /// @returns reference to the element at the given index
+  T& operator[](size_t index) noexcept { assert(index < size_); return storage_[index]; }
+
+  /// @returns reference to the element at the given index
+  const T& operator[](size_t index) const noexcept { assert(index < size_); return storage_[index]; }
+
+  /// @returns pointer to the first element
+  T* data() noexcept { return storage_.data(); }
+
+  /// @returns pointer to the first element
+  const T* data() const noexcept { return storage_.data(); }
+
+  iterator begin() noexcept { return storage_.data(); }
+  iterator end() noexcept { return storage_.data() + size_; }
+  const_iterator begin() const noexcept { return storage_.data(); }
+  const_iterator end() const noexcept { return storage_.data() + size_; }
+
+private:
+  std::array<T, Capacity> storage_;
+  size_t size_;
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,271 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cmath>
+#import <stdexcept>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/DSP.hpp"
+#import "DSPHeaders/FFT.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Streaming short-time Fourier transform (STFT) framework for spectral effects such as phase vocoders, spectral freezes,
+ and pitch shifters. It does the analysis and synthesis, and a function supplied to `process` changes the bins in
+ between.
+
+ Every `hopSize()` samples, the last `fftSize()` input samples of each channel are multiplied by a Hann window and
+ transformed with a `RealFFT`. The function is called with the spectrum of each channel in turn, which it may change in
+ place. The spectrum is then transformed back, multiplied by the Hann window again, and added to the output at its
+ place in time (weighted overlap-add). Since the square of a Hann window sums to a constant when the hop is at most a
+ third of the window, the result is scaled so that a function that does nothing gives back the input exactly, delayed
+ by `latency()` samples.
+
+ With `Form::polar` the bins are handed to the function as magnitudes and phases, which is what phase vocoders work
+ with. The conversions both ways use `DSP::fastAtan2` and `DSP::fastSinCos` in loops that can be vectorized. With
+ `Form::rectangular` the function gets the real and imaginary parts and no conversions are done.
+
+ All storage is allocated in the constructor and `setRenderingFormat`. `process` does not allocate.
+ */
+class SpectralProcessor {
+public:
+
+  /// How bins are given to the processing function.
+  enum struct Form {
+    rectangular,
+    polar
+  };
+
+  /// The spectrum of one channel at one moment, given to the processing function.
+  struct Frame {
+    /// The channel being processed
+    size_t channel;
+    /// The number of bins, from DC through Nyquist
+    size_t binCount;
+    /// Real parts of the bins (only with `Form::rectangular`)
+    AUValue* re;
+    /// Imaginary parts of the bins (only with `Form::rectangular`)
+    AUValue* im;
+    /// Magnitudes of the bins (only with `Form::polar`)
+    AUValue* magnitude;
+    /// Phases of the bins in radians (only with `Form::polar`)
+    AUValue* phase;
+  };
+
+  /**
+   Construct a new processor. The defaults are those of Will Pirkle's `PhaseVocoder`: 4096 samples with 75% overlap.
+
+   @param fftSize the number of samples in each transform. Must be a power of 2 that is at least 4.
+   @param hopSize the number of samples between transforms. Must divide `fftSize` and be at most a third of it.
+   @param form how bins are given to the processing function
+   @throws std::invalid_argument if `fftSize` or `hopSize` is not valid
+   */
+  explicit SpectralProcessor(size_t fftSize = 4'096, size_t hopSize = 1'024, Form form = Form::rectangular) :
+  fft_{fftSize}, hopSize_{hopSize}, form_{form}, analysisWindow_{makeWindow(Window::hann, fftSize)},
+  synthesisWindow_(fftSize), time_(fftSize), re_(fft_.binCount()), im_(fft_.binCount()),
+  magnitude_(fft_.binCount()), phase_(fft_.binCount())
+  {
+    if (hopSize == 0 || fftSize % hopSize != 0 || fftSize / hopSize < 3) {
+      throw std::invalid_argument("hop size must divide the FFT size and be at most a third of it");
+    }
+
+    // Fold the overlap-add normalization into the synthesis window.
+    double sum = 0.0;
+    for (auto value : analysisWindow_) sum += value * value;
+    auto scale = double(hopSize) / sum;
+    for (size_t index = 0; index < fftSize; ++index) {
+      synthesisWindow_[index] = AUValue(analysisWindow_[index] * scale);
+    }
+  }
+
+  /**
+   Set up for rendering and reset. This allocates, so it must not run on the render thread.
+
+   @param sampleRate the sample rate being used
+   @param channelCount the number of channels to process
+   */
+  void setRenderingFormat(double sampleRate, size_t channelCount)
+  {
+    sampleRate_ = sampleRate;
+    channelCount_ = channelCount;
+    inputs_.assign(channelCount, std::vector<AUValue>(fft_.size()));
+    sums_.assign(channelCount, std::vector<AUValue>(fft_.size()));
+    outputs_.assign(channelCount, std::vector<AUValue>(hopSize_));
+    reset();
+  }
+
+  /// @returns the number of samples in each transform
+  size_t fftSize() const noexcept { return fft_.size(); }
+
+  /// @returns the number of samples between transforms
+  size_t hopSize() const noexcept { return hopSize_; }
+
+  /// @returns the number of bins in a spectrum
+  size_t binCount() const noexcept { return fft_.binCount(); }
+
+  /// @returns how bins are given to the processing function
+  Form form() const noexcept { return form_; }
+
+  /**
+   Obtain the number of samples that the output is delayed from the input. This is a full transform: a hop of output
+   is not finished until the transform that starts with it has been done, which needs the `fftSize()` samples after
+   the start of that hop.
+
+   @returns the delay in samples
+   */
+  AUAudioFrameCount latency() const noexcept { return AUAudioFrameCount(fft_.size()); }
+
+  /**
+   Obtain the center frequency of a bin.
+
+   @param bin the bin to report on
+   @returns frequency in Hz
+   */
+  double binFrequency(size_t bin) const noexcept { return double(bin) * sampleRate_ / double(fft_.size()); }
+
+  /**
+   Clear all input and output history.
+   */
+  void reset() noexcept
+  {
+    for (size_t channel = 0; channel < channelCount_; ++channel) {
+      std::fill(inputs_[channel].begin(), inputs_[channel].end(), 0.0f);
+      std::fill(sums_[channel].begin(), sums_[channel].end(), 0.0f);
+      std::fill(outputs_[channel].begin(), outputs_[channel].end(), 0.0f);
+    }
+    filled_ = fft_.size() - hopSize_;
+  }
+
+  /**
+   Process a block of samples.
+
+   @param ins the samples to process
+   @param outs storage for the results. May be the same as `ins`. Channels beyond those being processed are zeroed.
+   @param frameCount the number of frames to process
+   @param proc the function to call with each spectrum, as `proc(Frame& frame)`
+   */
+  template <typename Proc>
+  void process(BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount, Proc&& proc) noexcept
+  {
+    auto channelCount = std::min({ins.size(), outs.size(), channelCount_});
+    auto fftSize = fft_.size();
+    auto start = fftSize - hopSize_;
+    AUAudioFrameCount offset = 0;
+    while (offset < frameCount) {
+      auto count = std::min(size_t(frameCount - offset), fftSize - filled_);
+      for (size_t channel = 0; channel < channelCount; ++channel) {
+        // Take the input before writing the output in case they share storage.
+        std::copy(ins[channel] + offset, ins[channel] + offset + count, inputs_[channel].begin() + ptrdiff_t(filled_));
+        auto output = outputs_[channel].begin() + ptrdiff_t(filled_ - start);
+        std::copy(output, output + ptrdiff_t(count), outs[channel] + offset);
+      }
+
+      filled_ += count;
+      offset += AUAudioFrameCount(count);
+      if (filled_ == fftSize) {
+        for (size_t channel = 0; channel < channelCount; ++channel) transformChannel(channel, proc);
+        filled_ = start;
+      }
+    }
+
+    // Channels that are not processed get silence rather than whatever was in the buffer.
+    for (size_t channel = channelCount; channel < outs.size(); ++channel) {
+      std::fill(outs[channel], outs[channel] + frameCount, 0.0f);
+    }
+  }
+
+private:
+
+  template <typename Proc>
+  void transformChannel(size_t channel, Proc& proc) noexcept
+  {
+    auto fftSize = fft_.size();
+    auto binCount = fft_.binCount();
+    auto& input = inputs_[channel];
+    auto& sum = sums_[channel];
+
+    {
+      const auto* __restrict samples = input.data();
+      const auto* __restrict window = analysisWindow_.data();
+      auto* __restrict time = time_.data();
+      for (size_t index = 0; index < fftSize; ++index) time[index] = samples[index] * window[index];
+    }
+
+    fft_.forward(time_.data(), re_.data(), im_.data());
+    Frame frame{channel, binCount, re_.data(), im_.data(), magnitude_.data(), phase_.data()};
+    if (form_ == Form::polar) {
+      toPolar();
+      proc(frame);
+      toRectangular();
+    } else {
+      proc(frame);
+    }
+    fft_.inverse(re_.data(), im_.data(), time_.data());
+
+    {
+      const auto* __restrict time = time_.data();
+      const auto* __restrict window = synthesisWindow_.data();
+      auto* __restrict accumulator = sum.data();
+      for (size_t index = 0; index < fftSize; ++index) accumulator[index] += time[index] * window[index];
+    }
+
+    // The first hop of the sum is complete. Move it to the output and slide everything along for the next transform.
+    std::copy(sum.begin(), sum.begin() + ptrdiff_t(hopSize_), outputs_[channel].begin());
+    std::copy(sum.begin() + ptrdiff_t(hopSize_), sum.end(), sum.begin());
+    std::fill(sum.end() - ptrdiff_t(hopSize_), sum.end(), 0.0f);
+    std::copy(input.begin() + ptrdiff_t(hopSize_), input.end(), input.begin());
+  }
+
+  void toPolar() noexcept
+  {
+    const auto* __restrict re = re_.data();
+    const auto* __restrict im = im_.data();
+    auto* __restrict magnitude = magnitude_.data();
+    auto* __restrict phase = phase_.data();
+    for (size_t bin = 0; bin < fft_.binCount(); ++bin) {
+      magnitude[bin] = std::sqrt(re[bin] * re[bin] + im[bin] * im[bin]);
+      phase[bin] = DSP::fastAtan2(im[bin], re[bin]);
+    }
+  }
+
+  void toRectangular() noexcept
+  {
+    auto* __restrict re = re_.data();
+    auto* __restrict im = im_.data();
+    const auto* __restrict magnitude = magnitude_.data();
+    const auto* __restrict phase = phase_.data();
+    for (size_t bin = 0; bin < fft_.binCount(); ++bin) {
+      AUValue sine;
+      AUValue cosine;
+      DSP::fastSinCos(phase[bin], sine, cosine);
+      re[bin] = magnitude[bin] * cosine;
+      im[bin] = magnitude[bin] * sine;
+    }
+  }
+
+  RealFFT fft_;
+  size_t hopSize_;
+  Form form_;
+  std::vector<AUValue> analysisWindow_;
+  std::vector<AUValue> synthesisWindow_;
+  std::vector<AUValue> time_;
+  std::vector<AUValue> re_;
+  std::vector<AUValue> im_;
+  std::vector<AUValue> magnitude_;
+  std::vector<AUValue> phase_;
+
+  double sampleRate_{48'000.0};
+  size_t channelCount_{0};
+  size_t filled_{0};
+  std::vector<std::vector<AUValue>> inputs_{};
+  std::vector<std::vector<AUValue>> sums_{};
+  std::vector<std::vector<AUValue>> outputs_{};
+};
+
+} // end namespace DSPHeaders
@@ -0,0 +1,333 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cmath>
+#import <memory>
+#import <stdexcept>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/FFT.hpp"
+#import "DSPHeaders/RingBuffer.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Spectrum analyzer whose results are meant for display. The render thread hands samples over with `push`, which only
+ copies them into a `RingBuffer`. All of the work happens in `update`, which is called from another thread -- say,
+ once per display frame -- and which leaves per-channel levels and peaks in dB for a set of log-spaced frequency
+ buckets.
+
+ Each `update` takes the samples that have arrived and runs a windowed `RealFFT` every `hopSize()` samples, so that
+ successive transforms overlap. Bin powers are smoothed with an exponential average, and each display bucket shows the
+ largest average power among the bins that fall inside it. The bins for each bucket are worked out in
+ `setRenderingFormat`, so an update only walks precomputed index tables. Buckets at low frequencies that are narrower
+ than a bin show the nearest bin. Each bucket also has a peak that holds for a while and then falls at a fixed rate.
+
+ To keep the cost of an update bounded, it runs at most `setMaxTransformsPerUpdate` transforms. If more samples are
+ waiting than that, the older ones are skipped. The ring buffer overwrites its oldest samples if updates stop for a
+ while, so the render thread never waits.
+
+ Levels are scaled so that a sine wave with an amplitude of 1.0 reads 0 dB when it falls in the center of a bin.
+
+ `push` must only be called from one thread (the render thread), and everything else from a single analysis thread.
+ `setRenderingFormat` must not run at the same time as either.
+ */
+class SpectrumAnalyzer {
+public:
+
+  /// The level reported for no signal at all.
+  inline static constexpr AUValue MinimumLevel = -200.0;
+
+  /**
+   Construct a new analyzer.
+
+   @param fftSize the number of samples in each transform. Must be a power of 2 that is at least 4.
+   @param window the window to apply to the samples of each transform
+   @param overlap the number of transforms that cover each sample. The hop size is `fftSize / overlap`. Use at least 2
+   with `Window::hann` and 4 with `Window::blackmanHarris` so that every sample counts equally.
+   @throws std::invalid_argument if `fftSize` or `overlap` is not valid
+   */
+  explicit SpectrumAnalyzer(size_t fftSize = 4'096, Window window = Window::hann, size_t overlap = 2) :
+  fft_{fftSize}, window_{makeWindow(window, fftSize)}, hopSize_{overlap > 0 ? fftSize / overlap : 0},
+  overlap_{overlap}, scratch_(fftSize), re_(fft_.binCount()), im_(fft_.binCount())
+  {
+    if (overlap == 0 || fftSize % overlap != 0) throw std::invalid_argument("overlap must divide the FFT size");
+    double sum = 0.0;
+    for (auto value : window_) sum += value;
+    scale_ = AUValue(4.0 / (sum * sum));
+  }
+
+  /**
+   Set up for a sample rate and a number of channels. This allocates, so it must not run on the render thread.
+
+   @param sampleRate the sample rate of the samples that will be pushed
+   @param channelCount the number of channels to analyze
+   @param bucketCount the number of display buckets
+   @param minFrequency the lowest frequency shown by the buckets
+   @param maxFrequency the highest frequency shown by the buckets. Limited to the Nyquist frequency.
+   */
+  void setRenderingFormat(double sampleRate, size_t channelCount, size_t bucketCount = 128, double minFrequency = 20.0,
+                          double maxFrequency = 20'000.0)
+  {
+    sampleRate_ = sampleRate;
+    channelCount_ = channelCount;
+    ring_ = std::make_unique<RingBuffer<AUValue>>(channelCount, std::max(4 * fft_.size(), size_t(sampleRate / 8)),
+                                                  RingBuffer<AUValue>::Overflow::overwriteOldest);
+    staging_.assign(channelCount, std::vector<AUValue>(hopSize_));
+    stagingPointers_.clear();
+    for (auto& channel : staging_) stagingPointers_.push_back(channel.data());
+    history_.assign(channelCount, std::vector<AUValue>(fft_.size()));
+    averages_.assign(channelCount, std::vector<AUValue>(fft_.binCount()));
+    bucketPowers_.assign(channelCount, std::vector<AUValue>(bucketCount));
+    peakPowers_.assign(channelCount, std::vector<AUValue>(bucketCount));
+    holdCounts_.assign(channelCount, std::vector<size_t>(bucketCount));
+    levels_.assign(channelCount, std::vector<AUValue>(bucketCount, MinimumLevel));
+    peaks_.assign(channelCount, std::vector<AUValue>(bucketCount, MinimumLevel));
+    makeBuckets(bucketCount, minFrequency, std::min(maxFrequency, sampleRate / 2.0));
+    maxTransformsPerUpdate_ = 2 * size_t(std::ceil(sampleRate / double(hopSize_) / 60.0));
+    updateTimeConstants();
+  }
+
+  /**
+   Set how long the bin powers take to settle after a change: the time constant of their exponential average.
+
+   @param milliseconds the time constant. Zero turns averaging off.
+   */
+  void setAveragingTime(double milliseconds) noexcept {
+    averagingTime_ = milliseconds;
+    updateTimeConstants();
+  }
+
+  /**
+   Set how the bucket peaks behave.
+
+   @param holdMilliseconds how long a peak holds before falling
+   @param decayDecibelsPerSecond how fast a peak falls after holding
+   */
+  void setPeakHold(double holdMilliseconds, double decayDecibelsPerSecond) noexcept {
+    holdTime_ = holdMilliseconds;
+    peakDecayRate_ = decayDecibelsPerSecond;
+    updateTimeConstants();
+  }
+
+  /**
+   Set the most transforms that one `update` will run for each channel. The default from `setRenderingFormat` is
+   twice what a 60 Hz display needs.
+
+   @param count the maximum number of transforms
+   */
+  void setMaxTransformsPerUpdate(size_t count) noexcept { maxTransformsPerUpdate_ = std::max<size_t>(count, 1); }
+
+  /// @returns the number of samples in each transform
+  size_t fftSize() const noexcept { return fft_.size(); }
+
+  /// @returns the number of samples between the starts of successive transforms
+  size_t hopSize() const noexcept { return hopSize_; }
+
+  /// @returns the number of channels being analyzed
+  size_t channelCount() const noexcept { return channelCount_; }
+
+  /// @returns the number of display buckets
+  size_t bucketCount() const noexcept { return bucketFrequencies_.size(); }
+
+  /// @returns the center frequency of each display bucket
+  const std::vector<AUValue>& bucketFrequencies() const noexcept { return bucketFrequencies_; }
+
+  /**
+   Hand over samples to analyze. Only copies them. Safe to call from the render thread. Samples pushed before
+   `setRenderingFormat` are ignored.
+
+   @param ins the samples to analyze
+   @param frameCount the number of frames in the block
+   */
+  void push(BusBuffers ins, AUAudioFrameCount frameCount) noexcept { if (ring_) ring_->push(ins, frameCount); }
+
+  /**
+   Analyze the samples that have arrived since the last update. Does not allocate.
+
+   @returns the number of transforms run for each channel
+   */
+  size_t update() noexcept
+  {
+    if (!ring_) return 0;
+    auto hops = ring_->available() / hopSize_;
+    auto skip = hops > maxTransformsPerUpdate_ ? hops - maxTransformsPerUpdate_ : 0;
+    size_t transforms = 0;
+    for (size_t hop = 0; hop < hops; ++hop) {
+      auto popped = ring_->pop(stagingPointers_, hopSize_);
+      if (popped < hopSize_) {
+        // Never analyze what is left in the staging area from the last hop.
+        for (auto& channel : staging_) std::fill(channel.begin() + ptrdiff_t(popped), channel.end(), 0.0f);
+      }
+      // Hops that are too old to be part of any transform that will run do not need to go into the history.
+      if (hop + overlap_ <= skip) continue;
+      for (size_t channel = 0; channel < channelCount_; ++channel) {
+        auto& history = history_[channel];
+        std::copy(history.begin() + ptrdiff_t(hopSize_), history.end(), history.begin());
+        std::copy(staging_[channel].begin(), staging_[channel].end(), history.end() - ptrdiff_t(hopSize_));
+        if (hop >= skip) analyze(channel);
+      }
+      if (hop >= skip) ++transforms;
+    }
+
+    if (transforms > 0) {
+      for (size_t channel = 0; channel < channelCount_; ++channel) {
+        toDecibels(bucketPowers_[channel], levels_[channel]);
+        toDecibels(peakPowers_[channel], peaks_[channel]);
+      }
+    }
+
+    return transforms;
+  }
+
+  /**
+   Obtain the levels of the display buckets for a channel as of the last `update`.
+
+   @param channel the channel to report on
+   @returns the level in dB of each bucket
+   */
+  const std::vector<AUValue>& levels(size_t channel) const noexcept { return levels_[channel]; }
+
+  /**
+   Obtain the held peak levels of the display buckets for a channel as of the last `update`.
+
+   @param channel the channel to report on
+   @returns the peak level in dB of each bucket
+   */
+  const std::vector<AUValue>& peaks(size_t channel) const noexcept { return peaks_[channel]; }
+
+  /**
+   Forget all analysis results and samples that have not been analyzed. Call from the analysis thread.
+   */
+  void reset() noexcept
+  {
+    if (!ring_) return;
+    while (ring_->available() > 0) ring_->pop(stagingPointers_, hopSize_);
+    for (size_t channel = 0; channel < channelCount_; ++channel) {
+      std::fill(history_[channel].begin(), history_[channel].end(), 0.0f);
+      std::fill(averages_[channel].begin(), averages_[channel].end(), 0.0f);
+      std::fill(bucketPowers_[channel].begin(), bucketPowers_[channel].end(), 0.0f);
+      std::fill(peakPowers_[channel].begin(), peakPowers_[channel].end(), 0.0f);
+      std::fill(holdCounts_[channel].begin(), holdCounts_[channel].end(), 0);
+      std::fill(levels_[channel].begin(), levels_[channel].end(), MinimumLevel);
+      std::fill(peaks_[channel].begin(), peaks_[channel].end(), MinimumLevel);
+    }
+  }
+
+private:
+
+  void makeBuckets(size_t bucketCount, double minFrequency, double maxFrequency)
+  {
+    auto binWidth = sampleRate_ / double(fft_.size());
+    auto ratio = maxFrequency / minFrequency;
+    bucketFrequencies_.resize(bucketCount);
+    bucketFirstBins_.resize(bucketCount);
+    bucketEndBins_.resize(bucketCount);
+    for (size_t bucket = 0; bucket < bucketCount; ++bucket) {
+      auto low = minFrequency * std::pow(ratio, double(bucket) / double(bucketCount));
+      auto high = minFrequency * std::pow(ratio, double(bucket + 1) / double(bucketCount));
+      auto center = std::sqrt(low * high);
+      auto first = size_t(std::ceil(low / binWidth));
+      auto end = size_t(std::ceil(high / binWidth));
+      if (end <= first) {
+        first = size_t(std::round(center / binWidth));
+        end = first + 1;
+      }
+      first = std::clamp<size_t>(first, 1, fft_.binCount() - 1);
+      end = std::clamp<size_t>(end, first + 1, fft_.binCount());
+      bucketFrequencies_[bucket] = AUValue(center);
+      bucketFirstBins_[bucket] = first;
+      bucketEndBins_[bucket] = end;
+    }
+  }
+
+  void updateTimeConstants() noexcept
+  {
+    auto hopSeconds = double(hopSize_) / sampleRate_;
+    averagingFactor_ = averagingTime_ > 0.0 ? AUValue(1.0 - std::exp(-hopSeconds * 1'000.0 / averagingTime_)) : 1.0f;
+    holdTransforms_ = size_t(std::round(holdTime_ / 1'000.0 / hopSeconds));
+    peakDecayFactor_ = AUValue(std::pow(10.0, -peakDecayRate_ * hopSeconds / 10.0));
+  }
+
+  void analyze(size_t channel) noexcept
+  {
+    const auto* __restrict history = history_[channel].data();
+    const auto* __restrict window = window_.data();
+    auto* __restrict scratch = scratch_.data();
+    for (size_t index = 0; index < fft_.size(); ++index) scratch[index] = history[index] * window[index];
+    fft_.forward(scratch, re_.data(), im_.data());
+
+    const auto* __restrict re = re_.data();
+    const auto* __restrict im = im_.data();
+    auto* __restrict average = averages_[channel].data();
+    for (size_t bin = 0; bin < fft_.binCount(); ++bin) {
+      auto power = (re[bin] * re[bin] + im[bin] * im[bin]) * scale_;
+      average[bin] += averagingFactor_ * (power - average[bin]);
+    }
+
+    auto& powers = bucketPowers_[channel];
+    auto& peaks = peakPowers_[channel];
+    auto& holds = holdCounts_[channel];
+    for (size_t bucket = 0; bucket < powers.size(); ++bucket) {
+      auto power = *std::max_element(average + bucketFirstBins_[bucket], average + bucketEndBins_[bucket]);
+      powers[bucket] = power;
+      if (power >= peaks[bucket]) {
+        peaks[bucket] = power;
+        holds[bucket] = holdTransforms_;
+      } else if (holds[bucket] > 0) {
+        --holds[bucket];
+      } else {
+        peaks[bucket] = std::max(power, peaks[bucket] * peakDecayFactor_);
+      }
+    }
+  }
+
+  static void toDecibels(const std::vector<AUValue>& powers, std::vector<AUValue>& levels) noexcept
+  {
+    constexpr AUValue floor = 1.0e-20f;
+    for (size_t index = 0; index < powers.size(); ++index) {
+      levels[index] = 10.0f * std::log10(std::max(powers[index], floor));
+    }
+  }
+
+  RealFFT fft_;
+  std::vector<AUValue> window_;
+  size_t hopSize_;
+  size_t overlap_;
+  AUValue scale_;
+  std::vector<AUValue> scratch_;
+  std::vector<AUValue> re_;
+  std::vector<AUValue> im_;
+
+  double sampleRate_{48'000.0};
+  size_t channelCount_{0};
+  std::unique_ptr<RingBuffer<AUValue>> ring_{};
+  std::vector<std::vector<AUValue>> staging_{};
+  std::vector<AUValue*> stagingPointers_{};
+  std::vector<std::vector<AUValue>> history_{};
+  std::vector<std::vector<AUValue>> averages_{};
+
+  std::vector<AUValue> bucketFrequencies_{};
+  std::vector<size_t> bucketFirstBins_{};
+  std::vector<size_t> bucketEndBins_{};
+  std::vector<std::vector<AUValue>> bucketPowers_{};
+  std::vector<std::vector<AUValue>> peakPowers_{};
+  std::vector<std::vector<size_t>> holdCounts_{};
+  std::vector<std::vector<AUValue>> levels_{};
+  std::vector<std::vector<AUValue>> peaks_{};
+
+  size_t maxTransformsPerUpdate_{4};
+  double averagingTime_{100.0};
+  double holdTime_{1'000.0};
+  double peakDecayRate_{20.0};
+  AUValue averagingFactor_{1.0};
+  size_t holdTransforms_{0};
+  AUValue peakDecayFactor_{1.0};
+};
+
+} // end namespace DSPHeaders
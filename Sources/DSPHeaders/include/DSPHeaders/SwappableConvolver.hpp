@@ -0,0 +1,356 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <atomic>
+#import <chrono>
+#import <cmath>
+#import <condition_variable>
+#import <memory>
+#import <mutex>
+#import <optional>
+#import <thread>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/DSP.hpp"
+#import "DSPHeaders/PartitionedConvolver.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Multichannel convolver whose impulse response (IR) can be replaced while rendering without causing dropouts.
+
+ All of the costly work of a change happens on a worker thread owned by the instance: `load` hands the new IR to the
+ worker, which resamples it to the rendering sample rate and builds a set of `PartitionedConvolver` instances (one per
+ output channel) with the IR partitions already transformed. The prepared set is handed to the render thread through
+ an atomic pointer. At the start of a `process` call the render thread picks it up and crossfades from the old IR to
+ the new one over `Options::crossfadeFrames` frames, running both while doing so. When the crossfade is done, the old
+ set goes back to the worker through another atomic pointer to be freed there. The render thread never allocates,
+ frees, locks or runs a forward FFT on IR data.
+
+ The worker frees returned sets when a `load` wakes it and again just before it hands over a prepared set, so the
+ hand-back slot is open by the time the render thread can pick up the new set and back-to-back loads never wait on it.
+ Without further loads, the last set returned is freed within 50 ms, when the worker next wakes up on its own.
+
+ Only the latest `load` matters: if several arrive before the render thread picks up a prepared set, the older ones are
+ dropped. A new IR is not picked up until any crossfade in progress is done. There is no output until the first IR is
+ installed, and the first one fades in from silence.
+
+ IR channels are assigned to output channels in turn, so a mono IR is used for all channels, and a stereo IR is used
+ as left/right.
+ */
+class SwappableConvolver {
+public:
+
+  /// Configuration of the convolver.
+  struct Options {
+    /// The partitioning used for the convolvers.
+    PartitionedConvolver::Options partitioning{};
+    /// The number of frames over which to crossfade from the old IR to the new one.
+    AUAudioFrameCount crossfadeFrames{4096};
+  };
+
+  /// Collection of IR channels.
+  using ImpulseResponse = std::vector<std::vector<AUValue>>;
+
+  SwappableConvolver() : SwappableConvolver(Options{}) {}
+
+  /**
+   Construct a new instance and start its worker thread.
+
+   @param options the configuration to use
+   @throws std::invalid_argument if the partitioning options are not valid
+   */
+  explicit SwappableConvolver(const Options& options) : options_{options}
+  {
+    // Check the partitioning here, where an error can be reported.
+    PartitionedConvolver{options.partitioning}.setImpulseResponse(nullptr, 0);
+    worker_ = std::thread([this]() { runWorker(); });
+  }
+
+  /**
+   Stop the worker thread and free all IR data.
+   */
+  ~SwappableConvolver() noexcept
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    condition_.notify_one();
+    worker_.join();
+    delete pending_.exchange(nullptr);
+    delete retired_.exchange(nullptr);
+    delete parked_;
+    delete previous_;
+    delete active_;
+  }
+
+  SwappableConvolver(const SwappableConvolver&) = delete;
+  SwappableConvolver& operator =(const SwappableConvolver&) = delete;
+
+  /**
+   Set the rendering format. Must not be called while rendering. Removes the current IR and any that is being prepared
+   and, if an IR was ever loaded, loads the last one again for the new format.
+
+   @param sampleRate the rendering sample rate
+   @param channelCount the number of channels to render
+   @param maxFramesToRender the maximum number of frames in a `process` call
+   */
+  void setRenderingFormat(double sampleRate, size_t channelCount, AUAudioFrameCount maxFramesToRender)
+  {
+    assert(channelCount <= BusBuffers::MaxChannelCount);
+    std::lock_guard<std::mutex> lock(mutex_);
+    sampleRate_ = sampleRate;
+    channelCount_ = channelCount;
+    ++generation_;
+
+    delete pending_.exchange(nullptr);
+    delete retired_.exchange(nullptr);
+    delete parked_;
+    delete previous_;
+    delete active_;
+    parked_ = nullptr;
+    previous_ = nullptr;
+    active_ = nullptr;
+    fadePosition_ = 0;
+    fadeBuffer_.assign(maxFramesToRender, 0.0);
+
+    if (source_.has_value()) {
+      request_ = source_;
+      condition_.notify_one();
+    }
+  }
+
+  /**
+   Load a new IR. Returns at once -- the IR is prepared on the worker thread and swapped in by a later `process` call.
+   Must not be called on the render thread.
+
+   @param impulseResponse the IR channels to use
+   @param sampleRate the sample rate of the IR
+   */
+  void load(ImpulseResponse impulseResponse, double sampleRate)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      source_ = Source{std::move(impulseResponse), sampleRate};
+      request_ = source_;
+    }
+    condition_.notify_one();
+  }
+
+  /// @returns the number of IRs that have been swapped in by the render thread
+  size_t installedCount() const noexcept { return installedCount_.load(std::memory_order_acquire); }
+
+  /// @returns true if the render thread is crossfading between two IRs. Only meaningful on the render thread.
+  bool isCrossfading() const noexcept { return fadePosition_ > 0; }
+
+  /**
+   Convolve the samples of a bus. Only to be called on the render thread.
+
+   @param ins the input samples
+   @param outs storage for the output samples. May be the same as `ins`. Channels without a convolver are zeroed.
+   @param frameCount the number of frames to process
+   */
+  void process(BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) noexcept
+  {
+    assert(frameCount <= fadeBuffer_.size());
+    retire();
+
+    if (!isCrossfading() && parked_ == nullptr) {
+      if (auto prepared = pending_.exchange(nullptr, std::memory_order_acquire)) {
+        previous_ = active_;
+        active_ = prepared;
+        installedCount_.fetch_add(1, std::memory_order_release);
+        if (options_.crossfadeFrames > 0) {
+          fadePosition_ = 1;
+        } else {
+          parked_ = previous_;
+          previous_ = nullptr;
+          retire();
+        }
+      }
+    }
+
+    // The channel count travels with the convolvers, so `channelCount_` (owned by the worker) is never read here.
+    auto channelCount = active_ != nullptr ? std::min({ins.size(), outs.size(), active_->convolvers.size()}) : 0;
+    for (size_t channel = channelCount; channel < outs.size(); ++channel) {
+      std::fill(outs[channel], outs[channel] + frameCount, 0.0f);
+    }
+    if (active_ == nullptr) return;
+
+    if (!isCrossfading()) {
+      for (size_t channel = 0; channel < channelCount; ++channel) {
+        active_->convolvers[channel].process(ins[channel], outs[channel], frameCount);
+      }
+      return;
+    }
+
+    // Fade position counts from 1 so that 0 can mean no crossfade.
+    auto start = fadePosition_ - 1;
+    auto step = 1.0f / AUValue(options_.crossfadeFrames);
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      AUValue* old = fadeBuffer_.data();
+      if (previous_ != nullptr) {
+        previous_->convolvers[channel].process(ins[channel], old, frameCount);
+      } else {
+        std::fill(old, old + frameCount, 0.0f);
+      }
+      AUValue* out = outs[channel];
+      active_->convolvers[channel].process(ins[channel], out, frameCount);
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        auto gain = std::min(AUValue(start + frame) * step, 1.0f);
+        out[frame] = old[frame] + gain * (out[frame] - old[frame]);
+      }
+    }
+
+    fadePosition_ += frameCount;
+    if (fadePosition_ > options_.crossfadeFrames) {
+      fadePosition_ = 0;
+      parked_ = previous_;
+      previous_ = nullptr;
+      retire();
+    }
+  }
+
+  /**
+   Resample an IR channel with Kaiser-windowed sinc interpolation. The result is scaled by the ratio of the rates so
+   that the response keeps its gain. Allocates memory, so not for the render thread.
+
+   @param taps the IR samples to resample
+   @param fromRate the sample rate of the IR
+   @param toRate the desired sample rate
+   @returns the resampled IR
+   */
+  static std::vector<AUValue> resample(const std::vector<AUValue>& taps, double fromRate, double toRate)
+  {
+    if (fromRate == toRate || taps.empty()) return taps;
+
+    constexpr double ZeroCrossings = 32.0;
+    // About 100 dB of stopband attenuation, which the long window leaves room for.
+    constexpr double beta = 10.0;
+    auto ratio = toRate / fromRate;
+    auto cutoff = std::min(1.0, ratio);
+    auto halfWidth = ZeroCrossings / cutoff;
+    auto length = size_t(std::ceil(double(taps.size()) * toRate / fromRate));
+    std::vector<AUValue> result(length);
+    for (size_t index = 0; index < length; ++index) {
+      auto position = double(index) / ratio;
+      auto first = size_t(std::max(0.0, std::ceil(position - halfWidth)));
+      auto last = std::min(taps.size() - 1, size_t(std::floor(position + halfWidth)));
+      double sum = 0.0;
+      for (auto tap = first; tap <= last; ++tap) {
+        sum += double(taps[tap]) * DSP::kaiserSinc(position - double(tap), cutoff, halfWidth, beta);
+      }
+      result[index] = AUValue(sum / ratio);
+    }
+    return result;
+  }
+
+private:
+
+  struct Source {
+    ImpulseResponse impulseResponse;
+    double sampleRate;
+  };
+
+  /// The convolvers for one IR, made on the worker thread.
+  struct Prepared {
+    std::vector<PartitionedConvolver> convolvers;
+  };
+
+  /// Hand a parked set back to the worker if the hand-off slot is free.
+  void retire() noexcept {
+    if (parked_ != nullptr && retired_.load(std::memory_order_relaxed) == nullptr) {
+      retired_.store(parked_, std::memory_order_release);
+      parked_ = nullptr;
+    }
+  }
+
+  void runWorker()
+  {
+    using namespace std::chrono_literals;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+      // Wake up regularly to free IR data returned by the render thread.
+      condition_.wait_for(lock, 50ms, [this]() { return stopping_ || request_.has_value(); });
+      delete retired_.exchange(nullptr, std::memory_order_acquire);
+      if (stopping_ || !request_.has_value()) continue;
+
+      auto source = std::move(*request_);
+      request_.reset();
+      auto generation = generation_;
+      auto sampleRate = sampleRate_;
+      auto channelCount = channelCount_;
+      lock.unlock();
+
+      std::unique_ptr<Prepared> prepared;
+      try {
+        prepared = prepare(source, sampleRate, channelCount);
+      } catch (...) {
+        // Out of memory -- keep the current IR.
+      }
+
+      // Free what the render thread returned while the set was being made, so that it can retire the set this one
+      // replaces without waiting for the worker to wake up again.
+      delete retired_.exchange(nullptr, std::memory_order_acquire);
+
+      lock.lock();
+      // Drop the result if the rendering format changed while it was being made.
+      if (prepared && generation == generation_) {
+        delete pending_.exchange(prepared.release(), std::memory_order_acq_rel);
+      }
+    }
+  }
+
+  std::unique_ptr<Prepared> prepare(const Source& source, double sampleRate, size_t channelCount) const
+  {
+    std::vector<std::vector<AUValue>> channels;
+    for (const auto& taps : source.impulseResponse) {
+      channels.push_back(resample(taps, source.sampleRate, sampleRate));
+    }
+
+    auto prepared = std::make_unique<Prepared>();
+    prepared->convolvers.reserve(channelCount);
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      prepared->convolvers.emplace_back(options_.partitioning);
+      if (!channels.empty()) {
+        const auto& taps = channels[channel % channels.size()];
+        prepared->convolvers.back().setImpulseResponse(taps.data(), taps.size());
+      }
+    }
+    return prepared;
+  }
+
+  Options options_;
+
+  // Shared with the worker thread and guarded by `mutex_`
+  std::mutex mutex_{};
+  std::condition_variable condition_{};
+  std::optional<Source> source_{};
+  std::optional<Source> request_{};
+  double sampleRate_{44100.0};
+  size_t channelCount_{0};
+  size_t generation_{0};
+  bool stopping_{false};
+
+  // Hand-off slots between the worker and render threads
+  std::atomic<Prepared*> pending_{nullptr};
+  std::atomic<Prepared*> retired_{nullptr};
+  std::atomic<size_t> installedCount_{0};
+
+  // Render thread state
+  Prepared* active_{nullptr};
+  Prepared* previous_{nullptr};
+  Prepared* parked_{nullptr};
+  AUAudioFrameCount fadePosition_{0};
+  std::vector<AUValue> fadeBuffer_{};
+
+  std::thread worker_{};
+};
+
+} // end namespace DSPHeaders
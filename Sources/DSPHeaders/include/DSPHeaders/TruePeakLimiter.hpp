@@ -0,0 +1,328 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cmath>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/DelayBuffer.hpp"
+#import "DSPHeaders/DSP.hpp"
+#import "DSPHeaders/MillisecondsParameter.hpp"
+#import "DSPHeaders/RampingParameter.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Brickwall limiter that keeps the true (intersample) peak level of the output at or below a threshold, in the manner of
+ ITU-R BS.1770.
+
+ The true peak of each input frame is found by 4x polyphase interpolation with a 48-tap Kaiser-windowed sinc (12 taps
+ per phase), taking the largest magnitude of the four phases over all channels -- the channels are always linked. The
+ gain needed to bring each peak down to the threshold then goes through three steps:
+
+ - hold: the lowest gain over the lookahead window, found with a monotonic deque of the window's peaks. Each frame is
+ pushed and popped at most once, so the cost per frame does not depend on the length of the window.
+ - release: rises back towards unity with a one-pole curve set by the release time. Drops pass straight through.
+ - smooth: a moving average over the lookahead window, kept as a running sum, which makes the gain ramp down over the
+ whole window ahead of a peak. Since every gain in the window is at or below the gain a peak needs by the time the peak
+ is output, the average is too.
+
+ The audio is delayed in a `DelayBuffer` per channel by the lookahead plus the delay of the interpolation filter; the
+ total is given by `latency`. All storage is allocated in `setRenderingFormat`.
+ */
+class TruePeakLimiter {
+public:
+
+  /// Number of input samples used for each interpolated sample.
+  inline static constexpr size_t TapsPerPhase = 12;
+
+  /// Oversampling factor of the peak detection.
+  inline static constexpr size_t PhaseCount = 4;
+
+  /// Delay in frames of the peak detection.
+  inline static constexpr AUAudioFrameCount DetectionDelay = TapsPerPhase / 2;
+
+  /**
+   Construct a new instance.
+
+   @param threshold the highest true peak level of the output, in dB
+   @param release the time in milliseconds for the gain to recover 63% of the way back to unity
+   */
+  explicit TruePeakLimiter(AUValue threshold = -1.0, AUValue release = 100.0) noexcept :
+  threshold_{toAmplitude(threshold)}, thresholdDecibels_{threshold}, release_{release}, releaseMilliseconds_{release}
+  {
+    makeTaps();
+  }
+
+  /**
+   Allocate storage for rendering, and reset the limiter.
+
+   @param sampleRate the sample rate of the samples to process
+   @param channelCount the number of channels to process
+   @param maxFramesToRender the maximum number of frames in a `process` call
+   @param lookahead the time in milliseconds that gain reductions start ahead of a peak
+   */
+  void setRenderingFormat(double sampleRate, size_t channelCount, AUAudioFrameCount maxFramesToRender,
+                          AUValue lookahead = 5.0)
+  {
+    assert(channelCount <= BusBuffers::MaxChannelCount);
+    sampleRate_ = sampleRate;
+    channelCount_ = channelCount;
+    maxFramesToRender_ = maxFramesToRender;
+    lookahead_ = lookahead;
+    windowSize_ = std::max<size_t>(2, size_t(std::round(lookahead * sampleRate / 1000.0)) + 1);
+
+    // The deque briefly holds one more than the window size before the oldest peak leaves it.
+    size_t capacity = 1;
+    while (capacity <= windowSize_) capacity *= 2;
+    dequeValues_.assign(capacity, 0.0);
+    dequeFrames_.assign(capacity, 0);
+    dequeMask_ = capacity - 1;
+    averageValues_.assign(windowSize_, 1.0);
+
+    delays_.assign(channelCount, DelayBuffer<AUValue>(double(latency() + 1)));
+    history_.assign(channelCount, std::vector<AUValue>(TapsPerPhase - 1 + maxFramesToRender, 0.0));
+    phase_.assign(maxFramesToRender, 0.0);
+    peaks_.assign(maxFramesToRender, 0.0);
+    gains_.assign(maxFramesToRender, 1.0);
+    releaseCoefficient_ = coefficient(releaseMilliseconds_);
+    reset();
+  }
+
+  /**
+   Clear the delays and return to unity gain.
+   */
+  void reset() noexcept
+  {
+    for (auto& delay : delays_) delay.clear();
+    for (auto& history : history_) std::fill(history.begin(), history.end(), 0.0f);
+    dequeHead_ = 0;
+    dequeTail_ = 0;
+    frame_ = 0;
+    std::fill(averageValues_.begin(), averageValues_.end(), 1.0f);
+    averagePosition_ = 0;
+    averageSum_ = double(averageValues_.size());
+    released_ = 1.0;
+    gainReduction_ = 0.0;
+  }
+
+  /**
+   Set the highest true peak level of the output.
+
+   @param threshold the new level in dB
+   @param rampingDuration number of frames to ramp over
+   */
+  void setThreshold(AUValue threshold, AUAudioFrameCount rampingDuration = 0) noexcept
+  {
+    thresholdDecibels_ = threshold;
+    threshold_.set(toAmplitude(threshold), rampingDuration);
+  }
+
+  /// @returns the highest true peak level of the output in dB
+  AUValue threshold() const noexcept { return thresholdDecibels_; }
+
+  /**
+   Set the release time.
+
+   @param milliseconds the time for the gain to recover 63% of the way back to unity
+   @param rampingDuration number of frames to ramp over
+   */
+  void setRelease(AUValue milliseconds, AUAudioFrameCount rampingDuration = 0) noexcept
+  {
+    release_.set(milliseconds, rampingDuration);
+  }
+
+  /// @returns the release time in milliseconds
+  AUValue release() const noexcept { return release_.get(); }
+
+  /// @returns the lookahead time in milliseconds
+  AUValue lookahead() const noexcept { return lookahead_; }
+
+  /// @returns the delay in frames of the output
+  AUAudioFrameCount latency() const noexcept { return AUAudioFrameCount(windowSize_ - 1) + DetectionDelay; }
+
+  /// @returns the gain in dB that was applied to the last frame
+  AUValue gainReduction() const noexcept { return gainReduction_; }
+
+  /**
+   Obtain the true peak of each frame of a block, as found by the interpolation filter. The value for a frame is
+   available `DetectionDelay` frames after the frame itself.
+
+   @returns the true peak amplitudes of the frames of the last `process` call
+   */
+  const std::vector<AUValue>& truePeaks() const noexcept { return peaks_; }
+
+  /**
+   Process a block of samples.
+
+   @param ins the samples to process
+   @param outs storage for the results. May be the same as `ins`.
+   @param frameCount the number of frames to process
+   */
+  void process(BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) noexcept
+  {
+    assert(frameCount <= maxFramesToRender_);
+    auto channelCount = std::min({ins.size(), outs.size(), channelCount_});
+    if (channelCount == 0 || frameCount == 0) return;
+
+    std::fill(peaks_.begin(), peaks_.begin() + frameCount, 0.0f);
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      detectPeaks(channel, ins[channel], frameCount);
+    }
+
+    updateRelease(frameCount);
+    makeGains(frameCount);
+    gainReduction_ = AUValue(20.0 * std::log10(gains_[frameCount - 1]));
+
+    auto delay = ssize_t(latency());
+    const AUValue* __restrict gains = gains_.data();
+    for (size_t channel = 0; channel < channelCount; ++channel) {
+      const AUValue* in = ins[channel];
+      AUValue* out = outs[channel];
+      auto& buffer = delays_[channel];
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        buffer.write(in[frame]);
+        out[frame] = buffer.readFromOffset(delay) * gains[frame];
+      }
+    }
+  }
+
+private:
+
+  /// Natural log of the amount left after one time constant (36.8%).
+  inline static constexpr double TimeConstant = -0.99967234081320612357829304641019;
+
+  static AUValue toAmplitude(AUValue decibels) noexcept { return AUValue(std::pow(10.0, decibels / 20.0)); }
+
+  AUValue coefficient(AUValue milliseconds) const noexcept
+  {
+    return milliseconds > 0.0f ? AUValue(std::exp(TimeConstant / (milliseconds * 0.001 * sampleRate_))) : 0.0f;
+  }
+
+  void makeTaps() noexcept
+  {
+    // Phase `k` interpolates the position `k / PhaseCount` after the sample `DetectionDelay` frames back. Phase 0 is
+    // that sample itself, so only the other phases need taps.
+    constexpr double beta = 8.0;
+    constexpr double halfWidth = double(DetectionDelay) + 0.5;
+    for (size_t phase = 1; phase < PhaseCount; ++phase) {
+      double sum = 0.0;
+      auto* taps = taps_[phase - 1];
+      for (size_t tap = 0; tap < TapsPerPhase; ++tap) {
+        auto offset = double(DetectionDelay) - double(phase) / double(PhaseCount) - double(tap);
+        auto value = DSP::kaiserSinc(offset, 1.0, halfWidth, beta);
+        taps[tap] = AUValue(value);
+        sum += value;
+      }
+      for (size_t tap = 0; tap < TapsPerPhase; ++tap) taps[tap] = AUValue(double(taps[tap]) / sum);
+    }
+  }
+
+  void detectPeaks(size_t channel, const AUValue* input, AUAudioFrameCount frameCount) noexcept
+  {
+    // The history holds the last `TapsPerPhase - 1` samples ahead of the block, so `newest[frame - tap]` is the sample
+    // `tap` frames before `frame`.
+    AUValue* buffer = history_[channel].data();
+    std::copy(input, input + frameCount, buffer + TapsPerPhase - 1);
+    const AUValue* newest = buffer + TapsPerPhase - 1;
+
+    AUValue* __restrict peaks = peaks_.data();
+    const AUValue* __restrict center = newest - DetectionDelay;
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      peaks[frame] = std::max(peaks[frame], std::abs(center[frame]));
+    }
+
+    AUValue* __restrict sum = phase_.data();
+    for (size_t phase = 0; phase < PhaseCount - 1; ++phase) {
+      std::fill(phase_.begin(), phase_.begin() + frameCount, 0.0f);
+      for (size_t tap = 0; tap < TapsPerPhase; ++tap) {
+        auto weight = taps_[phase][tap];
+        const AUValue* __restrict source = newest - tap;
+        for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+          sum[frame] += weight * source[frame];
+        }
+      }
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        peaks[frame] = std::max(peaks[frame], std::abs(sum[frame]));
+      }
+    }
+
+    std::copy(buffer + frameCount, buffer + frameCount + TapsPerPhase - 1, buffer);
+  }
+
+  void updateRelease(AUAudioFrameCount frameCount) noexcept
+  {
+    auto release = release_.frameValue();
+    for (AUAudioFrameCount frame = 1; frame < frameCount && release_.isRamping(); ++frame) {
+      release = release_.frameValue();
+    }
+    if (release != releaseMilliseconds_) {
+      releaseMilliseconds_ = release;
+      releaseCoefficient_ = coefficient(release);
+    }
+  }
+
+  void makeGains(AUAudioFrameCount frameCount) noexcept
+  {
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame, ++frame_) {
+
+      // Keep the peaks of the window in decreasing order. Any peak that is not larger than the new one can never be
+      // the largest in the window again.
+      auto peak = peaks_[frame];
+      while (dequeTail_ != dequeHead_ && dequeValues_[(dequeTail_ - 1) & dequeMask_] <= peak) --dequeTail_;
+      dequeValues_[dequeTail_ & dequeMask_] = peak;
+      dequeFrames_[dequeTail_ & dequeMask_] = frame_;
+      ++dequeTail_;
+      if (dequeFrames_[dequeHead_ & dequeMask_] + windowSize_ <= frame_) ++dequeHead_;
+
+      auto threshold = threshold_.frameValue();
+      auto largest = dequeValues_[dequeHead_ & dequeMask_];
+      auto held = largest > threshold ? threshold / largest : 1.0f;
+
+      released_ = held < released_ ? held : held + releaseCoefficient_ * (released_ - held);
+
+      averageSum_ += double(released_) - double(averageValues_[averagePosition_]);
+      averageValues_[averagePosition_] = released_;
+      if (++averagePosition_ == averageValues_.size()) averagePosition_ = 0;
+      gains_[frame] = std::min(AUValue(averageSum_ / double(windowSize_)), 1.0f);
+    }
+  }
+
+  Parameters::RampingParameter<AUValue> threshold_;
+  AUValue thresholdDecibels_;
+  Parameters::MillisecondsParameter<AUValue> release_;
+  AUValue releaseMilliseconds_;
+  AUValue releaseCoefficient_{0.0};
+  AUValue lookahead_{0.0};
+  AUValue taps_[PhaseCount - 1][TapsPerPhase]{};
+
+  double sampleRate_{44'100.0};
+  size_t channelCount_{0};
+  AUAudioFrameCount maxFramesToRender_{0};
+  size_t windowSize_{2};
+
+  std::vector<DelayBuffer<AUValue>> delays_{};
+  std::vector<std::vector<AUValue>> history_{};
+  std::vector<AUValue> phase_{};
+  std::vector<AUValue> peaks_{};
+  std::vector<AUValue> gains_{};
+
+  std::vector<AUValue> dequeValues_{};
+  std::vector<uint64_t> dequeFrames_{};
+  size_t dequeMask_{0};
+  size_t dequeHead_{0};
+  size_t dequeTail_{0};
+  uint64_t frame_{0};
+
+  std::vector<AUValue> averageValues_{};
+  size_t averagePosition_{0};
+  double averageSum_{0.0};
+  AUValue released_{1.0};
+  AUValue gainReduction_{0.0};
+};
+
+} // end namespace DSPHeaders
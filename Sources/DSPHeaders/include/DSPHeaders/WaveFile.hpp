@@ -0,0 +1,310 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <algorithm>
+#import <cstdint>
+#import <cstdio>
+#import <cstring>
+#import <stdexcept>
+#import <string>
+
+#import <fcntl.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <unistd.h>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+#import "DSPHeaders/SampleConversion.hpp"
+
+namespace DSPHeaders {
+
+/**
+ Read-only view of the samples in a RIFF/WAVE file. The file is memory-mapped so that samples are paged in on demand
+ and can be shared by several readers without copying. Supports 16, 24, and 32-bit integer PCM and 32-bit float
+ samples, in plain or `WAVE_FORMAT_EXTENSIBLE` headers. Samples are interleaved as stored in the file.
+
+ Problems opening or parsing the file throw `std::runtime_error`.
+ */
+class WaveFileReader {
+public:
+
+  /**
+   Open and map the given file.
+
+   @param path the location of the file to read
+   */
+  explicit WaveFileReader(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0) throw std::runtime_error("failed to open " + path);
+
+    struct stat info;
+    if (::fstat(fd_, &info) != 0 || info.st_size < 12) {
+      ::close(fd_);
+      throw std::runtime_error("invalid file " + path);
+    }
+
+    size_ = size_t(info.st_size);
+    void* base = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (base == MAP_FAILED) {
+      ::close(fd_);
+      throw std::runtime_error("failed to map " + path);
+    }
+
+    base_ = static_cast<const uint8_t*>(base);
+    ::madvise(base, size_, MADV_SEQUENTIAL);
+
+    try {
+      parse();
+    } catch (...) {
+      unmap();
+      throw;
+    }
+  }
+
+  ~WaveFileReader() noexcept { unmap(); }
+
+  WaveFileReader(const WaveFileReader&) = delete;
+  WaveFileReader& operator =(const WaveFileReader&) = delete;
+
+  /// @returns the sample rate of the file
+  double sampleRate() const noexcept { return sampleRate_; }
+
+  /// @returns the number of interleaved channels
+  AUAudioChannelCount channelCount() const noexcept { return channelCount_; }
+
+  /// @returns the type of the samples in the file
+  SampleConversion::SampleType sampleType() const noexcept { return sampleType_; }
+
+  /// @returns the number of frames in the file
+  AUAudioFrameCount frameCount() const noexcept { return frameCount_; }
+
+  /// @returns the number of bytes in one frame
+  size_t bytesPerFrame() const noexcept { return bytesPerFrame_; }
+
+  /**
+   Obtain a pointer to the interleaved samples of a frame.
+
+   @param frame the index of the frame to get
+   @returns pointer to the first sample of the frame
+   */
+  const void* frames(AUAudioFrameCount frame) const noexcept { return data_ + size_t(frame) * bytesPerFrame_; }
+
+private:
+
+  static uint16_t read16(const uint8_t* ptr) noexcept { return uint16_t(ptr[0] | ptr[1] << 8); }
+  static uint32_t read32(const uint8_t* ptr) noexcept {
+    return uint32_t(ptr[0]) | uint32_t(ptr[1]) << 8 | uint32_t(ptr[2]) << 16 | uint32_t(ptr[3]) << 24;
+  }
+
+  void parse() {
+    if (memcmp(base_, "RIFF", 4) != 0 || memcmp(base_ + 8, "WAVE", 4) != 0) {
+      throw std::runtime_error("not a RIFF/WAVE file");
+    }
+
+    bool haveFormat = false;
+    size_t pos = 12;
+    while (pos + 8 <= size_) {
+      auto chunk = base_ + pos;
+      size_t chunkSize = read32(chunk + 4);
+      auto body = chunk + 8;
+      if (memcmp(chunk, "fmt ", 4) == 0) {
+        if (chunkSize < 16 || pos + 8 + chunkSize > size_) throw std::runtime_error("invalid fmt chunk");
+        parseFormat(body, chunkSize);
+        haveFormat = true;
+      } else if (memcmp(chunk, "data", 4) == 0) {
+        if (!haveFormat) throw std::runtime_error("data chunk before fmt chunk");
+        chunkSize = std::min(chunkSize, size_ - pos - 8);
+        data_ = body;
+        frameCount_ = AUAudioFrameCount(chunkSize / bytesPerFrame_);
+        return;
+      }
+      pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    throw std::runtime_error("missing data chunk");
+  }
+
+  void parseFormat(const uint8_t* body, size_t chunkSize) {
+    auto formatTag = read16(body);
+    channelCount_ = read16(body + 2);
+    sampleRate_ = read32(body + 4);
+    auto bitsPerSample = read16(body + 14);
+    if (formatTag == 0xFFFE && chunkSize >= 40) {
+      // WAVE_FORMAT_EXTENSIBLE -- the real format tag is the start of the subformat GUID
+      formatTag = read16(body + 24);
+    }
+
+    if (formatTag == 1 && bitsPerSample == 16) {
+      sampleType_ = SampleConversion::SampleType::int16;
+    } else if (formatTag == 1 && bitsPerSample == 24) {
+      sampleType_ = SampleConversion::SampleType::int24;
+    } else if (formatTag == 1 && bitsPerSample == 32) {
+      sampleType_ = SampleConversion::SampleType::int32;
+    } else if (formatTag == 3 && bitsPerSample == 32) {
+      sampleType_ = SampleConversion::SampleType::float32;
+    } else {
+      throw std::runtime_error("unsupported sample format");
+    }
+
+    if (channelCount_ == 0) throw std::runtime_error("invalid channel count");
+    bytesPerFrame_ = SampleConversion::bytesPerSample(sampleType_) * channelCount_;
+  }
+
+  void unmap() noexcept {
+    if (base_ != nullptr) {
+      ::munmap(const_cast<uint8_t*>(base_), size_);
+      base_ = nullptr;
+    }
+    if (fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+  }
+
+  int fd_{-1};
+  const uint8_t* base_{nullptr};
+  size_t size_{0};
+  const uint8_t* data_{nullptr};
+  double sampleRate_{0.0};
+  AUAudioChannelCount channelCount_{0};
+  SampleConversion::SampleType sampleType_{SampleConversion::SampleType::float32};
+  AUAudioFrameCount frameCount_{0};
+  size_t bytesPerFrame_{0};
+};
+
+/**
+ Writes interleaved samples to a RIFF/WAVE file. The header is written when the file is created and the sizes in it
+ are updated by `close`, which is also called by the destructor. Files with more than two channels or more than 16
+ bits per sample get a `WAVE_FORMAT_EXTENSIBLE` header with a default channel mask, as readers expect for them.
+ Problems writing the file throw `std::runtime_error`.
+ */
+class WaveFileWriter {
+public:
+
+  /**
+   Create the file.
+
+   @param path the location of the file to write
+   @param sampleRate the sample rate of the samples
+   @param channelCount the number of interleaved channels
+   @param sampleType the type of the samples
+   */
+  WaveFileWriter(const std::string& path, double sampleRate, AUAudioChannelCount channelCount,
+                 SampleConversion::SampleType sampleType)
+  : bytesPerFrame_{SampleConversion::bytesPerSample(sampleType) * channelCount}
+  {
+    auto bitsPerSample = uint16_t(SampleConversion::bytesPerSample(sampleType) * 8);
+    auto formatTag = uint16_t(sampleType == SampleConversion::SampleType::float32 ? 3 : 1);
+    bool extensible = channelCount > 2 || bitsPerSample > 16;
+    size_t formatSize = extensible ? 40 : 16;
+    headerSize_ = 12 + 8 + formatSize + 8;
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr) throw std::runtime_error("failed to create " + path);
+
+    uint8_t header[MaxHeaderSize] = {};
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write32(header + 16, uint32_t(formatSize));
+    write16(header + 20, extensible ? 0xFFFE : formatTag);
+    write16(header + 22, uint16_t(channelCount));
+    write32(header + 24, uint32_t(sampleRate));
+    write32(header + 28, uint32_t(sampleRate * double(bytesPerFrame_)));
+    write16(header + 32, uint16_t(bytesPerFrame_));
+    write16(header + 34, bitsPerSample);
+    if (extensible) {
+      // Extension size, valid bits, channel mask, and the subformat GUID, which begins with the real format tag
+      static constexpr uint8_t guidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+                                               0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+      write16(header + 36, 22);
+      write16(header + 38, bitsPerSample);
+      write32(header + 40, channelMask(channelCount));
+      write16(header + 44, formatTag);
+      memcpy(header + 46, guidTail, sizeof(guidTail));
+    }
+    memcpy(header + headerSize_ - 8, "data", 4);
+    if (std::fwrite(header, 1, headerSize_, file_) != headerSize_) {
+      std::fclose(file_);
+      throw std::runtime_error("failed to write header to " + path);
+    }
+  }
+
+  ~WaveFileWriter() noexcept {
+    try {
+      close();
+    } catch (...) {
+    }
+  }
+
+  WaveFileWriter(const WaveFileWriter&) = delete;
+  WaveFileWriter& operator =(const WaveFileWriter&) = delete;
+
+  /**
+   Append interleaved frames to the file.
+
+   @param frames pointer to the samples to write
+   @param frameCount the number of frames to write
+   */
+  void write(const void* frames, AUAudioFrameCount frameCount) {
+    auto byteCount = size_t(frameCount) * bytesPerFrame_;
+    if (std::fwrite(frames, 1, byteCount, file_) != byteCount) throw std::runtime_error("failed to write samples");
+    dataSize_ += byteCount;
+  }
+
+  /// @returns the number of frames written so far
+  AUAudioFrameCount frameCount() const noexcept { return AUAudioFrameCount(dataSize_ / bytesPerFrame_); }
+
+  /**
+   Update the header with the final sizes and close the file. Does nothing if already closed.
+   */
+  void close() {
+    if (file_ == nullptr) return;
+    auto file = file_;
+    file_ = nullptr;
+
+    // Pad the data chunk to an even size
+    if (dataSize_ & 1) std::fputc(0, file);
+
+    uint8_t size[4];
+    bool ok = true;
+    write32(size, uint32_t(headerSize_ - 8 + dataSize_ + (dataSize_ & 1)));
+    ok = ok && std::fseek(file, 4, SEEK_SET) == 0 && std::fwrite(size, 1, 4, file) == 4;
+    write32(size, uint32_t(dataSize_));
+    ok = ok && std::fseek(file, long(headerSize_ - 4), SEEK_SET) == 0 && std::fwrite(size, 1, 4, file) == 4;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) throw std::runtime_error("failed to finish file");
+  }
+
+private:
+  inline static constexpr size_t MaxHeaderSize = 68;
+
+  /**
+   Obtain the speakers of the channels, which are taken in the standard order: front left, front right, front center,
+   LFE, and so on. A single channel is front center.
+
+   @param channelCount the number of channels
+   @returns the channel mask, or 0 if there are more channels than speaker positions
+   */
+  static uint32_t channelMask(AUAudioChannelCount channelCount) noexcept {
+    if (channelCount == 1) return 0x4;
+    return channelCount <= 18 ? (uint32_t(1) << channelCount) - 1 : 0;
+  }
+
+  static void write16(uint8_t* ptr, uint16_t value) noexcept {
+    ptr[0] = uint8_t(value);
+    ptr[1] = uint8_t(value >> 8);
+  }
+
+  static void write32(uint8_t* ptr, uint32_t value) noexcept {
+    for (int index = 0; index < 4; ++index) ptr[index] = uint8_t(value >> (8 * index));
+  }
+
+  std::FILE* file_{nullptr};
+  size_t bytesPerFrame_;
+  size_t headerSize_;
+  size_t dataSize_{0};
+};
+
+} // end namespace DSPHeaders
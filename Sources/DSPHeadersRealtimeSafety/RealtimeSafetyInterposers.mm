@@ -0,0 +1,6 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+// Builds the `RealtimeSafety` interposers into a dynamic library that can be loaded ahead of a host with
+// `DYLD_INSERT_LIBRARIES` (macOS) or `LD_PRELOAD` (Linux).
+
+#include "DSPHeaders/RealtimeSafetyInterposers.hpp"
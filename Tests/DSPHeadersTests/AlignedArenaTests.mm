@@ -0,0 +1,105 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cstdint>
+
+#import "DSPHeaders/AlignedArena.hpp"
+
+using namespace DSPHeaders;
+
+@interface AlignedArenaTests : XCTestCase
+
+@end
+
+@implementation AlignedArenaTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testAlignedSize {
+  XCTAssertEqual(0, AlignedArena::alignedSize(0));
+  XCTAssertEqual(64, AlignedArena::alignedSize(1));
+  XCTAssertEqual(64, AlignedArena::alignedSize(64));
+  XCTAssertEqual(128, AlignedArena::alignedSize(65));
+}
+
+- (void)testInit {
+  AlignedArena arena;
+  XCTAssertEqual(0, arena.capacity());
+  XCTAssertEqual(0, arena.size());
+  XCTAssertFalse(arena.isLocked());
+  XCTAssertTrue(arena.data() == nullptr);
+  XCTAssertTrue(arena.take<float>(1) == nullptr);
+}
+
+- (void)testTake {
+  AlignedArena arena;
+  arena.reserve(1000);
+  XCTAssertEqual(1024, arena.capacity());
+  XCTAssertEqual(0, reinterpret_cast<uintptr_t>(arena.data()) % AlignedArena::Alignment);
+
+  auto first = arena.take<float>(3);
+  auto second = arena.take<double>(20);
+  XCTAssertTrue(first != nullptr);
+  XCTAssertTrue(second != nullptr);
+  XCTAssertEqual(0, reinterpret_cast<uintptr_t>(second) % AlignedArena::Alignment);
+  XCTAssertEqual(64, reinterpret_cast<uint8_t*>(second) - reinterpret_cast<uint8_t*>(first));
+  XCTAssertEqual(64 + 192, arena.size());
+  for (int index = 0; index < 3; ++index) XCTAssertEqual(0.0f, first[index]);
+
+  XCTAssertTrue(arena.take<uint8_t>(769) == nullptr);
+  XCTAssertTrue(arena.take<uint8_t>(768) != nullptr);
+  XCTAssertEqual(1024, arena.size());
+
+  arena.reset();
+  XCTAssertEqual(0, arena.size());
+  XCTAssertTrue(arena.take<float>(3) == first);
+}
+
+- (void)testReserveReusesAndClears {
+  AlignedArena arena;
+  arena.reserve(256);
+  auto block = arena.data();
+  auto values = arena.take<float>(4);
+  values[0] = 1.0f;
+  arena.reserve(128);
+  XCTAssertEqual(256, arena.capacity());
+  XCTAssertTrue(arena.data() == block);
+  XCTAssertEqual(0, arena.size());
+  XCTAssertEqual(0.0f, arena.take<float>(4)[0]);
+
+  arena.reserve(512);
+  XCTAssertEqual(512, arena.capacity());
+  arena.release();
+  XCTAssertEqual(0, arena.capacity());
+  XCTAssertTrue(arena.data() == nullptr);
+}
+
+- (void)testLocking {
+  AlignedArena arena;
+  arena.reserve(4096, true);
+  // Locking may be refused by resource limits, but the memory must still be usable.
+  XCTAssertTrue(arena.take<float>(1024) != nullptr);
+  arena.reserve(4096, false);
+  XCTAssertFalse(arena.isLocked());
+}
+
+- (void)testMove {
+  AlignedArena arena;
+  arena.reserve(128);
+  auto block = arena.data();
+  AlignedArena other{std::move(arena)};
+  XCTAssertEqual(0, arena.capacity());
+  XCTAssertEqual(128, other.capacity());
+  XCTAssertTrue(other.data() == block);
+  arena = std::move(other);
+  XCTAssertEqual(128, arena.capacity());
+  XCTAssertEqual(0, other.capacity());
+}
+
+@end
@@ -0,0 +1,211 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <atomic>
+#import <cstdio>
+#import <filesystem>
+#import <string>
+#import <vector>
+
+#import "DSPHeaders/BatchRenderer.hpp"
+#import "DSPHeaders/EventProcessor.hpp"
+
+using namespace DSPHeaders;
+using namespace DSPHeaders::SampleConversion;
+
+static std::string tempPath(const std::string& name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+/**
+ Write a stereo float file holding a constant value.
+ */
+static void writeInput(const std::string& path, AUAudioFrameCount frameCount, float value) {
+  std::vector<float> samples(frameCount * 2, value);
+  WaveFileWriter writer{path, 44100.0, 2, SampleType::float32};
+  writer.write(samples.data(), frameCount);
+}
+
+static std::atomic<int> kernelCount{0};
+
+/**
+ Effect that scales its input by a gain value set by a preset or by parameter events on address 0.
+ */
+struct PresetEffect : public EventProcessor<PresetEffect>
+{
+  PresetEffect() : EventProcessor<PresetEffect>() { ++kernelCount; }
+  void setParameterFromEvent(const AUParameterEvent& event) { gain_ = event.value; }
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        outs[channel][frame] = ins[channel][frame] * gain_;
+      }
+    }
+  }
+  AUValue gain_{1.0};
+};
+
+@interface BatchRendererTests : XCTestCase
+
+@end
+
+@implementation BatchRendererTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testWorkerCount {
+  BatchRenderer<PresetEffect> automatic;
+  XCTAssertTrue(automatic.workerCount() >= 1);
+  BatchRenderer<PresetEffect> fixed{3};
+  XCTAssertEqual(3, fixed.workerCount());
+  XCTAssertEqual(0, fixed.size());
+  auto statistics = fixed.run();
+  XCTAssertEqual(0, statistics.jobCount);
+  XCTAssertEqual(0, statistics.frameCount);
+}
+
+- (void)testPresetsAcrossInputs {
+  std::vector<std::string> inputs{tempPath("BatchRendererTests_a.wav"), tempPath("BatchRendererTests_b.wav")};
+  writeInput(inputs[0], 2000, 0.25f);
+  writeInput(inputs[1], 3000, 0.5f);
+
+  kernelCount = 0;
+  BatchRenderer<PresetEffect> batch{4};
+  std::vector<std::string> outputs;
+  std::vector<float> expected;
+  for (int preset = 0; preset < 10; ++preset) {
+    for (size_t input = 0; input < inputs.size(); ++input) {
+      BatchRenderer<PresetEffect>::Job job;
+      job.inputPath = inputs[input];
+      job.outputPath = tempPath("BatchRendererTests_out" + std::to_string(outputs.size()) + ".wav");
+      job.preset = [preset](PresetEffect& effect) { effect.gain_ = AUValue(preset); };
+      if (preset == 9) job.automation.add(1000, 0, -1.0);
+      XCTAssertEqual(outputs.size(), batch.add(std::move(job)));
+      outputs.push_back(tempPath("BatchRendererTests_out" + std::to_string(outputs.size()) + ".wav"));
+      expected.push_back((input == 0 ? 0.25f : 0.5f) * (preset == 9 ? -1.0f : float(preset)));
+    }
+  }
+
+  auto statistics = batch.run();
+  XCTAssertEqual(20, statistics.jobCount);
+  XCTAssertEqual(0, statistics.failedCount);
+  XCTAssertEqual(4, statistics.workerCount);
+  XCTAssertEqual(10 * (2000 + 3000), statistics.frameCount);
+  XCTAssertEqualWithAccuracy(statistics.frameCount / 44100.0, statistics.audioSeconds, 1.0e-9);
+  XCTAssertTrue(statistics.realtimeFactor() > 0.0);
+  XCTAssertTrue(statistics.framesPerSecond() > 0.0);
+  XCTAssertTrue(kernelCount <= 4);
+
+  XCTAssertEqual(20, batch.results().size());
+  for (size_t index = 0; index < outputs.size(); ++index) {
+    XCTAssertTrue(batch.results()[index].succeeded());
+    XCTAssertTrue(batch.results()[index].worker < 4);
+    WaveFileReader output{outputs[index]};
+    XCTAssertEqual(index % 2 == 0 ? 2000 : 3000, output.frameCount());
+    auto samples = static_cast<const float*>(output.frames(output.frameCount() - 1));
+    XCTAssertEqual(expected[index], samples[0]);
+    XCTAssertEqual(expected[index], samples[1]);
+    std::remove(outputs[index].c_str());
+  }
+
+  // Kernels are kept for the next batch
+  batch.clear();
+  XCTAssertEqual(0, batch.size());
+  BatchRenderer<PresetEffect>::Job job;
+  job.inputPath = inputs[0];
+  job.outputPath = outputs[0];
+  batch.add(std::move(job));
+  XCTAssertEqual(0, batch.run().failedCount);
+  XCTAssertTrue(kernelCount <= 4);
+  std::remove(outputs[0].c_str());
+
+  for (const auto& input : inputs) std::remove(input.c_str());
+}
+
+- (void)testFailedJobs {
+  auto inputPath = tempPath("BatchRendererTests_ok.wav");
+  auto outputPath = tempPath("BatchRendererTests_okout.wav");
+  writeInput(inputPath, 500, 1.0f);
+
+  int created = 0;
+  BatchRenderer<PresetEffect> batch{2, OfflineRenderer::Options(), [&created]() {
+    ++created;
+    return std::make_unique<PresetEffect>();
+  }};
+  batch.add({inputPath, outputPath});
+  batch.add({tempPath("BatchRendererTests_missing.wav"), tempPath("BatchRendererTests_never.wav")});
+  batch.add({inputPath, "/nonexistent/dir/out.wav"});
+
+  auto statistics = batch.run();
+  XCTAssertEqual(3, statistics.jobCount);
+  XCTAssertEqual(2, statistics.failedCount);
+  XCTAssertEqual(500, statistics.frameCount);
+  XCTAssertTrue(created >= 1 && created <= 2);
+  XCTAssertTrue(batch.results()[0].succeeded());
+  XCTAssertFalse(batch.results()[1].succeeded());
+  XCTAssertFalse(batch.results()[1].error.empty());
+  XCTAssertFalse(batch.results()[2].succeeded());
+
+  std::remove(inputPath.c_str());
+  std::remove(outputPath.c_str());
+}
+
+- (void)testWorkStealing {
+  // One long job followed by many short ones. The short jobs dealt to the worker that runs the long one are stolen by
+  // the other worker.
+  auto longPath = tempPath("BatchRendererTests_long.wav");
+  auto shortPath = tempPath("BatchRendererTests_short.wav");
+  writeInput(longPath, 44100 * 20, 0.5f);
+  writeInput(shortPath, 64, 0.5f);
+
+  BatchRenderer<PresetEffect> batch{2};
+  batch.add({longPath, tempPath("BatchRendererTests_longout.wav")});
+  for (int index = 1; index < 8; ++index) {
+    batch.add({shortPath, tempPath("BatchRendererTests_shortout" + std::to_string(index) + ".wav")});
+  }
+
+  auto statistics = batch.run();
+  XCTAssertEqual(0, statistics.failedCount);
+  XCTAssertTrue(statistics.stolenCount >= 1);
+  for (int index = 1; index < 8; ++index) {
+    std::remove(tempPath("BatchRendererTests_shortout" + std::to_string(index) + ".wav").c_str());
+  }
+  std::remove(tempPath("BatchRendererTests_longout.wav").c_str());
+  std::remove(longPath.c_str());
+  std::remove(shortPath.c_str());
+}
+
+- (void)testBatchPerformance {
+  std::vector<std::string> inputs;
+  for (int index = 0; index < 4; ++index) {
+    inputs.push_back(tempPath("BatchRendererTests_perf" + std::to_string(index) + ".wav"));
+    writeInput(inputs.back(), 44100 * 5, 0.1f * (index + 1));
+  }
+  [self measureBlock:^{
+    BatchRenderer<PresetEffect> batch;
+    for (int preset = 0; preset < 16; ++preset) {
+      for (size_t input = 0; input < inputs.size(); ++input) {
+        BatchRenderer<PresetEffect>::Job job;
+        job.inputPath = inputs[input];
+        job.outputPath = tempPath("BatchRendererTests_perfout" + std::to_string(batch.size()) + ".wav");
+        job.preset = [preset](PresetEffect& effect) { effect.gain_ = AUValue(preset) / 16; };
+        batch.add(std::move(job));
+      }
+    }
+    auto statistics = batch.run();
+    XCTAssertEqual(0, statistics.failedCount);
+    for (size_t index = 0; index < batch.size(); ++index) {
+      std::remove(tempPath("BatchRendererTests_perfout" + std::to_string(index) + ".wav").c_str());
+    }
+  }];
+  for (const auto& input : inputs) std::remove(input.c_str());
+}
+
+@end
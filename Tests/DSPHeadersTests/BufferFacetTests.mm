@@ -65,6 +65,13 @@ static AUAudioFrameCount maxFrames = 100;
   XCTAssertThrows(facet.setBufferList(stereoBuffer.mutableAudioBufferList()));
 }
 
+- (void)testTooManyChannels {
+  BufferFacet facet;
+  XCTAssertNoThrow(facet.setChannelCount(BusBuffers::MaxChannelCount));
+  XCTAssertThrows(facet.setChannelCount(BusBuffers::MaxChannelCount + 1));
+  XCTAssertEqual(BusBuffers::MaxChannelCount, facet.channelCount());
+}
+
 - (void)testFrameCount {
   SampleBuffer monoBuffer;
   monoBuffer.allocate(monoFormat, maxFrames);
@@ -122,4 +129,31 @@ static AUAudioFrameCount maxFrames = 100;
   XCTAssertThrows(facet.unlink());
 }
 
+- (void)testUnchecked {
+  SampleBuffer stereoBuffer;
+  stereoBuffer.allocate(stereoFormat, maxFrames);
+  SampleBuffer otherBuffer;
+  otherBuffer.allocate(stereoFormat, maxFrames);
+
+  BufferFacet facet;
+  facet.setChannelCount(2);
+  facet.setBufferListUnchecked(stereoBuffer.mutableAudioBufferList());
+  XCTAssertTrue(facet.isLinked());
+  facet.setFrameCountUnchecked(7);
+  XCTAssertEqual(7 * sizeof(float), stereoBuffer.mutableAudioBufferList()->mBuffers[1].mDataByteSize);
+
+  BusBuffers bb{facet.busBuffers()};
+  bb.addAll(2, 3.0);
+  facet.setOffsetUnchecked(2);
+  XCTAssertEqual(3.0, facet.busBuffers()[0][0]);
+  XCTAssertEqual(3.0, facet.busBuffers()[1][0]);
+
+  BufferFacet other;
+  other.setChannelCount(2);
+  other.setBufferListUnchecked(otherBuffer.mutableAudioBufferList());
+  facet.copyIntoUnchecked(other, 2, 1);
+  float* left = (float*)(otherBuffer.mutableAudioBufferList()->mBuffers[0].mData);
+  XCTAssertEqual(3.0, left[2]);
+}
+
 @end
@@ -128,4 +128,119 @@ static AUAudioFrameCount maxFrames = 100;
   XCTAssertThrows(facet.unlink());
 }
 
+- (void)testPassByValue {
+  SampleBuffer stereoBuffer;
+  stereoBuffer.allocate(stereoFormat, maxFrames);
+  BufferFacet facet;
+  facet.setChannelCount(2);
+  facet.setBufferList(stereoBuffer.mutableAudioBufferList());
+  BusBuffers bb1{facet.busBuffers()};
+  BusBuffers bb2{bb1};
+  bb2.shiftOver(1);
+  XCTAssertEqual(bb1[0] + 1, bb2[0]);
+  XCTAssertEqual(bb1[1] + 1, bb2[1]);
+}
+
+- (void)testPeakMagnitude {
+  std::vector<AUValue> left{0.0, 0.25, -0.5, 0.0};
+  std::vector<AUValue> right{0.0, -0.75, 0.0, 1.5};
+  std::vector<AUValue*> pointers{left.data(), right.data()};
+  BusBuffers bb{pointers};
+  XCTAssertEqual(1.5, bb.peakMagnitude(4));
+  XCTAssertEqual(0.75, bb.peakMagnitude(3));
+  XCTAssertEqual(0.0, bb.peakMagnitude(1));
+  left[0] = -0.0;
+  XCTAssertEqual(0.0, bb.peakMagnitude(1));
+}
+
+- (void)testVectorConstructor {
+  std::vector<AUValue> left(4, 0.0);
+  std::vector<AUValue> right(4, 0.0);
+  std::vector<AUValue*> pointers{left.data(), right.data()};
+  BusBuffers bb{pointers};
+  XCTAssertTrue(bb.isStereo());
+  bb.addStereo(1, 1.0, 2.0);
+  XCTAssertEqual(1.0, left[1]);
+  XCTAssertEqual(2.0, right[1]);
+}
+
+- (void)testBlockAdds {
+  std::vector<AUValue> c0(4, 0.0), c1(4, 0.0), c2(4, 0.0);
+  std::vector<AUValue> even{1.0, 2.0, 3.0, 4.0};
+  std::vector<AUValue> odd{10.0, 20.0, 30.0, 40.0};
+
+  std::vector<AUValue*> monoPointers{c0.data()};
+  BusBuffers mono{monoPointers};
+  mono.addMono(1, even.data(), 3);
+  XCTAssertEqual(0.0, c0[0]);
+  XCTAssertEqual(1.0, c0[1]);
+  XCTAssertEqual(3.0, c0[3]);
+
+  std::vector<AUValue*> stereoPointers{c1.data(), c2.data()};
+  BusBuffers stereo{stereoPointers};
+  stereo.addStereo(0, even.data(), odd.data(), 4);
+  XCTAssertEqual(4.0, c1[3]);
+  XCTAssertEqual(40.0, c2[3]);
+
+  stereo.addAll(0, even.data(), 2);
+  XCTAssertEqual(2.0, c1[0]);
+  XCTAssertEqual(11.0, c2[0]);
+  XCTAssertEqual(3.0, c1[2]);
+
+  std::vector<AUValue*> triplePointers{c0.data(), c1.data(), c2.data()};
+  BusBuffers triple{triplePointers};
+  triple.addAlternating(3, even.data(), odd.data(), 1);
+  XCTAssertEqual(4.0, c0[3]);
+  XCTAssertEqual(14.0, c1[3]);
+  XCTAssertEqual(41.0, c2[3]);
+}
+
+static constexpr AUAudioFrameCount benchmarkFrames = 512;
+
+/// Gain kernel that works frame-by-frame, indexing the channel pointers for each sample.
+static void gainPerFrame(BusBuffers& ins, BusBuffers& outs, AUValue gain, AUAudioFrameCount frameCount) {
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      outs[channel][frame] += gain * ins[channel][frame];
+    }
+  }
+}
+
+/// Gain kernel that works one channel block at a time with the channel pointers held in locals.
+static void gainBlock(BusBuffers ins, BusBuffers outs, AUValue gain, AUAudioFrameCount frameCount) {
+  for (size_t channel = 0; channel < outs.size(); ++channel) {
+    const AUValue* __restrict in = ins[channel];
+    AUValue* __restrict out = outs[channel];
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      out[frame] += gain * in[frame];
+    }
+  }
+}
+
+- (void)testGainPerFramePerformance {
+  [self measureBlock:^{
+    std::vector<AUValue> samples(benchmarkFrames * 4, 0.5);
+    std::vector<AUValue*> inPointers{samples.data(), samples.data() + benchmarkFrames};
+    std::vector<AUValue*> outPointers{samples.data() + 2 * benchmarkFrames, samples.data() + 3 * benchmarkFrames};
+    BusBuffers ins{inPointers};
+    BusBuffers outs{outPointers};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      gainPerFrame(ins, outs, 0.5, benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testGainBlockPerformance {
+  [self measureBlock:^{
+    std::vector<AUValue> samples(benchmarkFrames * 4, 0.5);
+    std::vector<AUValue*> inPointers{samples.data(), samples.data() + benchmarkFrames};
+    std::vector<AUValue*> outPointers{samples.data() + 2 * benchmarkFrames, samples.data() + 3 * benchmarkFrames};
+    BusBuffers ins{inPointers};
+    BusBuffers outs{outPointers};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      gainBlock(ins, outs, 0.5, benchmarkFrames);
+    }
+  }];
+}
+
 @end
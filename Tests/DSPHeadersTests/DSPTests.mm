@@ -60,6 +60,66 @@ using namespace DSPHeaders;
   }
 }
 
+- (void)testFastLog2Accuracy {
+  for (int index = 0; index < 100000; ++index) {
+    auto value = float(std::pow(10.0, -12.0 + 16.0 * index / 100000.0));
+    auto real = std::log2(value);
+    XCTAssertEqualWithAccuracy(DSP::fastLog2(value), real, 1.0e-6 * std::max(1.0f, std::abs(real)));
+  }
+  XCTAssertEqual(DSP::fastLog2(1.0f), 0.0f);
+  XCTAssertEqual(DSP::fastLog2(0.0f), DSP::fastLog2(1.0e-30f));
+}
+
+- (void)testFastExp2Accuracy {
+  for (int index = 0; index < 100000; ++index) {
+    auto value = float(-40.0 + 80.0 * index / 100000.0);
+    auto real = std::exp2(value);
+    XCTAssertEqualWithAccuracy(DSP::fastExp2(value), real, real * 1.0e-6);
+  }
+  XCTAssertEqualWithAccuracy(DSP::fastExp2(0.0f), 1.0f, 1.0e-6);
+}
+
+- (void)testFastAtan2Accuracy {
+  for (int row = -200; row <= 200; ++row) {
+    for (int column = -200; column <= 200; ++column) {
+      auto y = float(row * 0.37);
+      auto x = float(column * 0.53);
+      if (row == 0 && column == 0) continue;
+      XCTAssertEqualWithAccuracy(DSP::fastAtan2(y, x), std::atan2(double(y), double(x)), 5.0e-7);
+    }
+  }
+  XCTAssertEqual(DSP::fastAtan2(0.0f, 0.0f), 0.0f);
+  XCTAssertEqualWithAccuracy(DSP::fastAtan2(1.0e-30f, -1.0f), M_PI, 5.0e-7);
+  XCTAssertEqualWithAccuracy(DSP::fastAtan2(1.0e30f, 1.0e-30f), M_PI_2, 5.0e-7);
+}
+
+- (void)testFastSinCosAccuracy {
+  for (int index = 0; index <= 200000; ++index) {
+    auto angle = float(-1000.0 + 2000.0 * index / 200000.0);
+    float sine;
+    float cosine;
+    DSP::fastSinCos(angle, sine, cosine);
+    XCTAssertEqualWithAccuracy(sine, std::sin(double(angle)), 2.0e-7);
+    XCTAssertEqualWithAccuracy(cosine, std::cos(double(angle)), 2.0e-7);
+  }
+}
+
+- (void)testBesselI0 {
+  XCTAssertEqual(1.0, DSP::besselI0(0.0));
+  XCTAssertEqualWithAccuracy(1.2660658777520082, DSP::besselI0(1.0), 1.0e-12);
+  XCTAssertEqualWithAccuracy(2815.7166284662544, DSP::besselI0(10.0), 1.0e-8);
+}
+
+- (void)testKaiserSinc {
+  // The center tap is the cutoff, taps at multiples of 1 / cutoff are zero, and the window ends at 1 / I0(beta).
+  XCTAssertEqual(0.5, DSP::kaiserSinc(0.0, 0.5, 8.0, 6.0));
+  XCTAssertEqualWithAccuracy(0.0, DSP::kaiserSinc(2.0, 0.5, 8.0, 6.0), 1.0e-12);
+  XCTAssertEqualWithAccuracy(DSP::kaiserSinc(-3.0, 0.5, 8.0, 6.0), DSP::kaiserSinc(3.0, 0.5, 8.0, 6.0), 1.0e-15);
+  auto edge = 0.5 * std::sin(M_PI * 0.5 * 7.0) / (M_PI * 0.5 * 7.0) / DSP::besselI0(6.0);
+  XCTAssertEqualWithAccuracy(edge, DSP::kaiserSinc(7.0, 0.5, 7.0, 6.0), 1.0e-15);
+  XCTAssertEqualWithAccuracy(edge, DSP::kaiserSinc(7.0, 0.5, 6.5, 6.0), 1.0e-15);
+}
+
 - (void)testInterpolationCubic4thOrderInterpolate {
   double epsilon = 1.0e-18;
 
@@ -0,0 +1,283 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/DynamicsProcessor.hpp"
+#import "Pirkle/fxobjects.h"
+
+using namespace DSPHeaders;
+
+using Mode = DynamicsProcessor::Mode;
+using Detection = DynamicsProcessor::Detection;
+
+static constexpr double SampleRate = 48'000.0;
+static constexpr AUAudioFrameCount MaxFrames = 512;
+
+static AUValue toDecibels(AUValue value) { return AUValue(20.0 * std::log10(std::abs(value))); }
+
+/**
+ Make a 1 kHz sine whose amplitude steps between loud and quiet every 2400 frames.
+ */
+static std::vector<AUValue> makeBursts(size_t count, double loud = 0.9, double quiet = 0.05) {
+  std::vector<AUValue> samples(count);
+  for (size_t index = 0; index < count; ++index) {
+    auto amplitude = (index / 2'400) % 2 ? quiet : loud;
+    samples[index] = AUValue(amplitude * std::sin(2.0 * M_PI * 1'000.0 * double(index) / SampleRate));
+  }
+  return samples;
+}
+
+/**
+ Process mono samples in place in blocks of MaxFrames.
+ */
+static void process(DynamicsProcessor& processor, std::vector<AUValue>& samples) {
+  for (size_t frame = 0; frame < samples.size(); frame += MaxFrames) {
+    auto count = AUAudioFrameCount(std::min(size_t(MaxFrames), samples.size() - frame));
+    BusBuffers bus{std::vector<AUValue*>{samples.data() + frame}};
+    processor.process(bus, bus, count);
+  }
+}
+
+/**
+ Obtain the gain in dB applied to a constant input level once the detector has settled.
+ */
+static AUValue staticGain(DynamicsProcessor& processor, AUValue level) {
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setAttack(0.0);
+  processor.setRelease(0.0);
+  std::vector<AUValue> samples(MaxFrames, level);
+  process(processor, samples);
+  return toDecibels(samples.back()) - toDecibels(level);
+}
+
+static void measureProcessor(size_t channelCount, bool linked, Detection detection, AUValue lookahead) {
+  DynamicsProcessor processor{Mode::compressor, detection};
+  processor.setRenderingFormat(96'000.0, channelCount, MaxFrames);
+  processor.setThreshold(-20.0);
+  processor.setStereoLinked(linked);
+  processor.setLookahead(lookahead);
+  std::vector<std::vector<AUValue>> channels(channelCount, makeBursts(MaxFrames));
+  std::vector<AUValue*> pointers;
+  for (auto& channel : channels) pointers.push_back(channel.data());
+  BusBuffers bus{pointers};
+  for (int block = 0; block < 96'000 / int(MaxFrames); ++block) {
+    processor.process(bus, bus, MaxFrames);
+  }
+}
+
+@interface DynamicsProcessorTests : XCTestCase
+
+@end
+
+@implementation DynamicsProcessorTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testHardKneeCompressor {
+  DynamicsProcessor processor;
+  processor.setThreshold(-20.0);
+  processor.setRatio(4.0);
+  processor.setKneeWidth(0.0);
+  XCTAssertEqualWithAccuracy(0.0, staticGain(processor, 0.05), 1.0e-4);
+  // -8 dB is 12 dB over, which should come out 3 dB over.
+  XCTAssertEqualWithAccuracy(-9.0, staticGain(processor, std::pow(10.0, -8.0 / 20.0)), 1.0e-3);
+  XCTAssertEqualWithAccuracy(-9.0, processor.gainReduction(), 1.0e-3);
+}
+
+- (void)testSoftKneeCompressor {
+  DynamicsProcessor processor;
+  processor.setThreshold(-20.0);
+  processor.setRatio(4.0);
+  processor.setKneeWidth(10.0);
+  XCTAssertEqualWithAccuracy(0.0, staticGain(processor, std::pow(10.0, -25.5 / 20.0)), 1.0e-4);
+  // At the threshold the curve is halfway around the knee: (1/4 - 1) * 5^2 / 20
+  XCTAssertEqualWithAccuracy(-0.9375, staticGain(processor, 0.1), 1.0e-3);
+  XCTAssertEqualWithAccuracy(-9.0, staticGain(processor, std::pow(10.0, -8.0 / 20.0)), 1.0e-3);
+}
+
+- (void)testExpander {
+  DynamicsProcessor processor{Mode::expander};
+  processor.setThreshold(-30.0);
+  processor.setRatio(2.0);
+  processor.setKneeWidth(0.0);
+  XCTAssertEqualWithAccuracy(0.0, staticGain(processor, 0.1), 1.0e-4);
+  XCTAssertEqualWithAccuracy(-10.0, staticGain(processor, 0.01), 1.0e-3);
+
+  processor.setRatio(1'000.0);
+  XCTAssertEqualWithAccuracy(DynamicsProcessor::MinimumGain, staticGain(processor, 0.01), 1.0e-3);
+}
+
+- (void)testLimiterWithMakeupGain {
+  DynamicsProcessor processor{Mode::limiter};
+  processor.setThreshold(-6.0);
+  processor.setKneeWidth(0.0);
+  processor.setMakeupGain(3.0);
+  XCTAssertEqualWithAccuracy(3.0, staticGain(processor, 0.25), 1.0e-3);
+  XCTAssertEqualWithAccuracy(-3.0, staticGain(processor, 1.0), 1.0e-3);
+  XCTAssertEqualWithAccuracy(-15.0412, staticGain(processor, 4.0), 1.0e-3);
+  XCTAssertEqualWithAccuracy(-18.0412, processor.gainReduction(), 1.0e-3);
+}
+
+// Compare against Will Pirkle's dynamics processor
+- (void)testCompressorMatchesPirkle {
+  Pirkle::DynamicsProcessor pirkle;
+  pirkle.reset(SampleRate);
+  Pirkle::DynamicsProcessorParameters params;
+  params.threshold_dB = -20.0;
+  params.ratio = 4.0;
+  params.kneeWidth_dB = 10.0;
+  params.attackTime_mSec = 5.0;
+  params.releaseTime_mSec = 50.0;
+  params.outputGain_dB = 6.0;
+  pirkle.setParameters(params);
+
+  DynamicsProcessor processor;
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setThreshold(-20.0);
+  processor.setRatio(4.0);
+  processor.setKneeWidth(10.0);
+  processor.setAttack(5.0);
+  processor.setRelease(50.0);
+  processor.setMakeupGain(6.0);
+
+  auto samples = makeBursts(24'000);
+  auto input = samples;
+  process(processor, samples);
+  for (size_t index = 0; index < samples.size(); ++index) {
+    auto expected = pirkle.processAudioSample(input[index]);
+    XCTAssertEqualWithAccuracy(expected, samples[index], 1.0e-4);
+  }
+}
+
+// Compare against Will Pirkle's peak limiter
+- (void)testLimiterMatchesPirkle {
+  Pirkle::PeakLimiter pirkle;
+  pirkle.reset(SampleRate);
+  pirkle.setThreshold_dB(-12.0);
+
+  DynamicsProcessor processor{Mode::limiter};
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setThreshold(-12.0);
+  processor.setKneeWidth(10.0);
+  processor.setAttack(5.0);
+  processor.setRelease(25.0);
+
+  auto samples = makeBursts(24'000);
+  auto input = samples;
+  process(processor, samples);
+  for (size_t index = 0; index < samples.size(); ++index) {
+    auto expected = pirkle.processAudioSample(input[index]);
+    XCTAssertEqualWithAccuracy(expected, samples[index], 1.0e-4);
+  }
+}
+
+- (void)testRMSDetection {
+  // A full-scale sine has an RMS level of -3 dB, so limiting at -20 dB should leave a sine with an RMS of 0.1.
+  DynamicsProcessor processor{Mode::limiter, Detection::rms};
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setThreshold(-20.0);
+  processor.setKneeWidth(0.0);
+  processor.setAttack(50.0);
+  processor.setRelease(50.0);
+  auto samples = makeBursts(48'000, 1.0, 1.0);
+  process(processor, samples);
+
+  double sum = 0.0;
+  for (size_t index = 24'000; index < samples.size(); ++index) sum += samples[index] * samples[index];
+  XCTAssertEqualWithAccuracy(0.1, std::sqrt(sum / 24'000.0), 0.002);
+}
+
+- (void)testStereoLink {
+  for (auto linked : {true, false}) {
+    DynamicsProcessor processor{Mode::limiter};
+    processor.setRenderingFormat(SampleRate, 2, MaxFrames);
+    processor.setThreshold(-12.0);
+    processor.setKneeWidth(0.0);
+    processor.setAttack(0.0);
+    processor.setStereoLinked(linked);
+    std::vector<AUValue> left(MaxFrames, 1.0);
+    std::vector<AUValue> right(MaxFrames, 0.1);
+    BusBuffers bus{std::vector<AUValue*>{left.data(), right.data()}};
+    processor.process(bus, bus, MaxFrames);
+    XCTAssertEqualWithAccuracy(-12.0, toDecibels(left.back()), 1.0e-3);
+    XCTAssertEqualWithAccuracy(linked ? -32.0 : -20.0, toDecibels(right.back()), 1.0e-3);
+  }
+}
+
+- (void)testLookahead {
+  DynamicsProcessor processor{Mode::limiter};
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setThreshold(-6.0);
+  processor.setKneeWidth(0.0);
+  processor.setAttack(1.0);
+  processor.setRelease(100.0);
+  processor.setLookahead(5.0);
+  XCTAssertEqual(240.0, processor.latency());
+
+  // A step from silence to full scale. Without lookahead the first loud samples pass through untouched.
+  std::vector<AUValue> samples(4 * MaxFrames, 0.0);
+  std::fill(samples.begin() + 1'000, samples.end(), 1.0f);
+  process(processor, samples);
+  for (size_t index = 0; index < 1'240; ++index) XCTAssertEqual(0.0, samples[index]);
+  for (size_t index = 1'240; index < samples.size(); ++index) XCTAssertLessThan(samples[index], 0.51);
+  XCTAssertEqualWithAccuracy(0.5012, samples.back(), 1.0e-3);
+}
+
+- (void)testRampedAttack {
+  DynamicsProcessor processor;
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setAttack(100.0);
+  processor.setAttack(1.0, 1'000);
+  XCTAssertEqual(1.0, processor.attack());
+  std::vector<AUValue> samples(4 * MaxFrames, 0.5);
+  process(processor, samples);
+  XCTAssertEqual(1.0, processor.attack());
+}
+
+- (void)testReset {
+  DynamicsProcessor processor;
+  processor.setRenderingFormat(SampleRate, 1, MaxFrames);
+  processor.setLookahead(2.0);
+  auto samples = makeBursts(MaxFrames);
+  process(processor, samples);
+  processor.reset();
+  std::vector<AUValue> silence(MaxFrames, 0.0);
+  process(processor, silence);
+  for (auto sample : silence) XCTAssertEqual(0.0, sample);
+  XCTAssertEqualWithAccuracy(0.0, processor.gainReduction(), 1.0e-4);
+}
+
+- (void)testMonoPerformance {
+  [self measureBlock:^{
+    measureProcessor(1, false, Detection::peak, 0.0);
+  }];
+}
+
+- (void)testStereoLinkedRMSLookaheadPerformance {
+  [self measureBlock:^{
+    measureProcessor(2, true, Detection::rms, 5.0);
+  }];
+}
+
+- (void)testPirklePerformance {
+  [self measureBlock:^{
+    Pirkle::DynamicsProcessor pirkle;
+    pirkle.reset(96'000.0);
+    Pirkle::DynamicsProcessorParameters params;
+    params.threshold_dB = -20.0;
+    params.ratio = 4.0;
+    pirkle.setParameters(params);
+    auto samples = makeBursts(96'000);
+    for (auto& sample : samples) sample = AUValue(pirkle.processAudioSample(sample));
+  }];
+}
+
+@end
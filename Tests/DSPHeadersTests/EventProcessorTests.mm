@@ -2,6 +2,7 @@
 
 #import <XCTest/XCTest.h>
 #import <cmath>
+#import <vector>
 
 #import "DSPHeaders/DSP.hpp"
 #import "DSPHeaders/EventProcessor.hpp"
@@ -16,6 +17,159 @@ struct MockEffect : public EventProcessor<MockEffect>
   void doRendering(NSInteger outputBusNumber, BusBuffers, BusBuffers, AUAudioFrameCount) {}
 };
 
+struct DrainingEffect : public EventProcessor<DrainingEffect>
+{
+  DrainingEffect() : EventProcessor<DrainingEffect>() {}
+  void setParameterFromEvent(const AUParameterEvent&) {}
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger outputBusNumber, BusBuffers, BusBuffers, AUAudioFrameCount) {}
+  void drainParameterChanges() { ++drainCount; }
+  int drainCount{0};
+};
+
+/**
+ Effect that records what it is given. Recording allocates, so it is done with `RealtimeSafety` checks suspended.
+ */
+struct RecordingEffect : public EventProcessor<RecordingEffect>
+{
+  RecordingEffect() : EventProcessor<RecordingEffect>() {}
+  void setParameterFromEvent(const AUParameterEvent&) {
+    RealtimeSafety::Suspend suspend;
+    eventFrames.push_back(rendered);
+  }
+  void doMIDIEvent(AUMIDIEvent) {
+    RealtimeSafety::Suspend suspend;
+    eventFrames.push_back(rendered);
+  }
+  void doRendering(NSInteger outputBusNumber, BusBuffers, BusBuffers, AUAudioFrameCount frameCount) {
+    RealtimeSafety::Suspend suspend;
+    chunks.push_back(frameCount);
+    rendered += frameCount;
+  }
+  std::vector<AUAudioFrameCount> chunks;
+  std::vector<AUAudioFrameCount> eventFrames;
+  AUAudioFrameCount rendered{0};
+};
+
+/**
+ Effect that does a fixed amount of work per sample (a one-pole lowpass).
+ */
+template <typename Derived>
+struct LowpassBase : public EventProcessor<Derived>
+{
+  LowpassBase() : EventProcessor<Derived>() {}
+  void setParameterFromEvent(const AUParameterEvent&) { ++eventCount; }
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    rendered += frameCount;
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        state[channel] += 0.01f * (ins[channel][frame] - state[channel]);
+        outs[channel][frame] = state[channel];
+      }
+    }
+  }
+  AUValue state[2]{0.0, 0.0};
+  AUAudioFrameCount rendered{0};
+  int eventCount{0};
+};
+
+struct LowpassEffect : public LowpassBase<LowpassEffect> {};
+
+/// Same as `LowpassEffect` but declares a tail length so that silent input can be skipped.
+struct TailedLowpassEffect : public LowpassBase<TailedLowpassEffect>
+{
+  AUAudioFrameCount tailLength() const { return 16; }
+};
+
+/**
+ Make a pull-input block that fills the input with a constant value, or with zeros if `signal` points to false. If
+ `flagSilence` is true, the upstream silence flag is also set for silent input, and the samples are left as-is.
+ */
+static AURenderPullInputBlock makeSparseInput(const bool* signal, bool flagSilence) {
+  return ^(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+           AUAudioFrameCount frameCount, NSInteger inputBusNumber, AudioBufferList *inputData) {
+    if (!*signal && flagSilence) {
+      *actionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+      return AUAudioUnitStatus(0);
+    }
+    for (UInt32 index = 0; index < inputData->mNumberBuffers; ++index) {
+      auto ptr = reinterpret_cast<AUValue*>(inputData->mBuffers[index].mData);
+      for (UInt32 pos = 0; pos < frameCount; ++pos) {
+        ptr[pos] = *signal ? 0.5 : 0.0;
+      }
+    }
+    return AUAudioUnitStatus(0);
+  };
+}
+
+/**
+ Four-band crossover built from three one-pole lowpass filters, with each band sent to its own output bus. In normal
+ mode each bus is rendered by its own `doRendering` call, which has to run all of the filters (with state of its own)
+ to get at its band. In multi-bus mode `doRenderingAllBuses` runs the filters once and writes all four bands.
+ */
+struct CrossoverEffect : public EventProcessor<CrossoverEffect>
+{
+  CrossoverEffect() : EventProcessor<CrossoverEffect>() {}
+  void setParameterFromEvent(const AUParameterEvent&) { ++eventCount; }
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger bus, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    ++renderCalls;
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      AUValue* bands[4] = {nullptr, nullptr, nullptr, nullptr};
+      bands[bus] = outs[channel];
+      split(state[bus][channel], ins[channel], bands, frameCount);
+    }
+  }
+  void doRenderingAllBuses(BusBuffers ins, const BusBuffers* outs, size_t busCount, AUAudioFrameCount frameCount) {
+    ++allBusRenderCalls;
+    for (size_t channel = 0; channel < ins.size(); ++channel) {
+      AUValue* bands[4] = {outs[0][channel], outs[1][channel], outs[2][channel], outs[3][channel]};
+      split(state[0][channel], ins[channel], bands, frameCount);
+    }
+  }
+  static void split(AUValue* lows, const AUValue* in, AUValue* const* bands, AUAudioFrameCount frameCount) {
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      auto sample = in[frame];
+      lows[0] += 0.05f * (sample - lows[0]);
+      lows[1] += 0.2f * (sample - lows[1]);
+      lows[2] += 0.5f * (sample - lows[2]);
+      AUValue values[4] = {lows[0], lows[1] - lows[0], lows[2] - lows[1], sample - lows[2]};
+      for (size_t band = 0; band < 4; ++band) {
+        if (bands[band] != nullptr) bands[band][frame] = values[band];
+      }
+    }
+  }
+  AUValue state[4][2][3]{};
+  int eventCount{0};
+  int renderCalls{0};
+  int allBusRenderCalls{0};
+};
+
+/**
+ Make a pull-input block that fills the input with a sawtooth and counts the number of pulls.
+ */
+static AURenderPullInputBlock makeCountingInput(int* pullCount) {
+  return ^(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+           AUAudioFrameCount frameCount, NSInteger inputBusNumber, AudioBufferList *inputData) {
+    ++*pullCount;
+    for (UInt32 index = 0; index < inputData->mNumberBuffers; ++index) {
+      auto ptr = reinterpret_cast<AUValue*>(inputData->mBuffers[index].mData);
+      for (UInt32 pos = 0; pos < frameCount; ++pos) {
+        ptr[pos] = AUValue((AUAudioFrameCount(timestamp->mSampleTime) + pos) % 64) / 64.0f - 0.5f;
+      }
+    }
+    return AUAudioUnitStatus(0);
+  };
+}
+
+static AURenderEvent makeParameterEvent(AUEventSampleTime when) {
+  AURenderEvent event{};
+  event.parameter.eventType = AURenderEventParameter;
+  event.parameter.eventSampleTime = when;
+  return event;
+}
+
 @interface EventProcessorTests : XCTestCase
 @end
 
@@ -35,6 +189,16 @@ struct MockEffect : public EventProcessor<MockEffect>
   effect.setRenderingFormat(1, format, 512);
 }
 
+- (void)testTooManyChannels {
+  auto effect = MockEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  XCTAssertEqual(noErr, effect.setRenderingFormat(1, format, 512));
+  AVAudioFormat* wide = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0
+                                                                       channels:BusBuffers::MaxChannelCount + 1];
+  XCTAssertEqual(kAudioUnitErr_FormatNotSupported, effect.setRenderingFormat(1, wide, 512));
+  XCTAssertEqual(SampleBuffer::arenaSize(2, 512), effect.renderingMemorySize());
+}
+
 - (void)testBypass {
   auto effect = MockEffect();
   AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
@@ -47,6 +211,23 @@ struct MockEffect : public EventProcessor<MockEffect>
   XCTAssertFalse(effect.isBypassed());
 }
 
+- (void)testRenderingMemory {
+  auto effect = MockEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  XCTAssertEqual(0, effect.renderingMemorySize());
+  effect.setRenderingFormat(3, format, 512);
+  XCTAssertEqual(3 * SampleBuffer::arenaSize(2, 512), effect.renderingMemorySize());
+  XCTAssertFalse(effect.isMemoryLocked());
+  effect.renderingStopped();
+  XCTAssertEqual(0, effect.renderingMemorySize());
+
+  XCTAssertFalse(effect.isMemoryLockingEnabled());
+  effect.setMemoryLockingEnabled(true);
+  XCTAssertTrue(effect.isMemoryLockingEnabled());
+  effect.setRenderingFormat(3, format, 256);
+  XCTAssertEqual(3 * SampleBuffer::arenaSize(2, 256), effect.renderingMemorySize());
+}
+
 - (void)testProcessAndRender {
   auto effect = MockEffect();
   AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
@@ -83,4 +264,442 @@ struct MockEffect : public EventProcessor<MockEffect>
   XCTAssertEqual(status, 0);
 }
 
+- (void)testDrainParameterChanges {
+  auto effect = DrainingEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  effect.setRenderingFormat(1, format, maxFrames);
+
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(0, effect.drainCount);
+  effect.processAndRender(&timestamp, 4, 0, [buffer mutableAudioBufferList], nil, nil);
+  XCTAssertEqual(1, effect.drainCount);
+  effect.processAndRender(&timestamp, 4, 0, [buffer mutableAudioBufferList], nil, nil);
+  XCTAssertEqual(2, effect.drainCount);
+}
+
+- (void)testChunkedRendering {
+  auto effect = RecordingEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  effect.setRenderingFormat(1, format, maxFrames);
+  effect.setRenderChunkSize(32);
+  XCTAssertEqual(32, effect.renderChunkSize());
+  XCTAssertEqual(ChunkEventPolicy::exact, effect.chunkEventPolicy());
+
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  effect.processAndRender(&timestamp, 100, 0, [buffer mutableAudioBufferList], nil, nil);
+  std::vector<AUAudioFrameCount> expected{32, 32, 32, 4};
+  XCTAssertTrue(effect.chunks == expected);
+}
+
+- (void)testChunkedRenderingWithExactEvents {
+  auto effect = RecordingEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  effect.setRenderingFormat(1, format, maxFrames);
+  effect.setRenderChunkSize(32, ChunkEventPolicy::exact);
+
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  auto event = makeParameterEvent(40);
+  effect.processAndRender(&timestamp, 100, 0, [buffer mutableAudioBufferList], &event, nil);
+  std::vector<AUAudioFrameCount> expectedChunks{32, 8, 32, 28};
+  XCTAssertTrue(effect.chunks == expectedChunks);
+  XCTAssertEqual(1, effect.eventFrames.size());
+  XCTAssertEqual(40, effect.eventFrames[0]);
+}
+
+- (void)testChunkedRenderingWithQuantizedEvents {
+  auto effect = RecordingEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  effect.setRenderingFormat(1, format, maxFrames);
+  effect.setRenderChunkSize(32, ChunkEventPolicy::quantized);
+
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  auto first = makeParameterEvent(40);
+  auto second = makeParameterEvent(64);
+  first.head.next = &second;
+  effect.processAndRender(&timestamp, 100, 0, [buffer mutableAudioBufferList], &first, nil);
+  std::vector<AUAudioFrameCount> expectedChunks{32, 32, 32, 4};
+  XCTAssertTrue(effect.chunks == expectedChunks);
+  std::vector<AUAudioFrameCount> expectedEvents{32, 64};
+  XCTAssertTrue(effect.eventFrames == expectedEvents);
+}
+
+- (void)testChannelCountMismatch {
+  auto effect = MockEffect();
+  AVAudioFormat* stereo = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AVAudioFormat* mono = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:1];
+  AUAudioFrameCount maxFrames = 512;
+  effect.setRenderingFormat(1, stereo, maxFrames);
+
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:mono frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  auto status = effect.processAndRender(&timestamp, 4, 0, [buffer mutableAudioBufferList], nil, nil);
+  XCTAssertEqual(kAudioUnitErr_FormatNotSupported, status);
+}
+
+- (void)testBypassCopiesInput {
+  auto effect = MockEffect();
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  effect.setRenderingFormat(1, format, maxFrames);
+  effect.setBypass(true);
+
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+
+  AUAudioUnitStatus (^mockPullInput)(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+                                     AUAudioFrameCount frameCount, NSInteger inputBusNumber,
+                                     AudioBufferList *inputData);
+  mockPullInput = ^(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+                    AUAudioFrameCount frameCount, NSInteger inputBusNumber, AudioBufferList *inputData) {
+    for (UInt32 index = 0; index < inputData->mNumberBuffers; ++index) {
+      auto ptr = reinterpret_cast<AUValue*>(inputData->mBuffers[index].mData);
+      for (UInt32 pos = 0; pos < frameCount; ++pos) {
+        ptr[pos] = pos + index * 100;
+      }
+    }
+    return 0;
+  };
+
+  AUAudioFrameCount frames = 8;
+  auto status = effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, mockPullInput);
+  XCTAssertEqual(status, 0);
+  auto left = reinterpret_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[0].mData);
+  auto right = reinterpret_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[1].mData);
+  for (UInt32 pos = 0; pos < frames; ++pos) {
+    XCTAssertEqual(pos, left[pos]);
+    XCTAssertEqual(pos + 100, right[pos]);
+  }
+}
+
+- (void)testSilenceSkipping {
+  TailedLowpassEffect effect;
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 8;
+  effect.setRenderingFormat(1, format, frames);
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  bool signal = true;
+  auto pullInput = makeSparseInput(&signal, false);
+  AudioUnitRenderActionFlags flags = 0;
+
+  XCTAssertEqual(0, effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput,
+                                            &flags));
+  XCTAssertEqual(8, effect.rendered);
+  XCTAssertFalse(effect.isSkippingSilence());
+
+  // Input is silent but the tail of 16 frames has not passed yet.
+  signal = false;
+  for (int block = 0; block < 2; ++block) {
+    effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput, &flags);
+    XCTAssertFalse(effect.isSkippingSilence());
+    XCTAssertEqual(0, flags);
+  }
+  XCTAssertEqual(24, effect.rendered);
+
+  // Tail has passed -- events are still applied but nothing is rendered.
+  auto event = makeParameterEvent(2);
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], &event, pullInput, &flags);
+  XCTAssertTrue(effect.isSkippingSilence());
+  XCTAssertEqual(kAudioUnitRenderAction_OutputIsSilence, flags);
+  XCTAssertEqual(24, effect.rendered);
+  XCTAssertEqual(1, effect.eventCount);
+  auto left = reinterpret_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[0].mData);
+  for (UInt32 pos = 0; pos < frames; ++pos) {
+    XCTAssertEqual(0.0, left[pos]);
+  }
+
+  // Signal resumes rendering immediately.
+  signal = true;
+  flags = 0;
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput, &flags);
+  XCTAssertFalse(effect.isSkippingSilence());
+  XCTAssertEqual(32, effect.rendered);
+  XCTAssertEqual(0, flags);
+}
+
+- (void)testSilenceSkippingPerBus {
+  // Every bus pulls its own input when rendered one at a time, so each one must render the full tail.
+  TailedLowpassEffect effect;
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 8;
+  effect.setRenderingFormat(4, format, frames);
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  bool signal = false;
+  auto pullInput = makeSparseInput(&signal, false);
+  for (int block = 0; block < 2; ++block) {
+    for (NSInteger bus = 0; bus < 4; ++bus) {
+      effect.processAndRender(&timestamp, frames, bus, [buffer mutableAudioBufferList], nil, pullInput);
+      XCTAssertFalse(effect.isSkippingSilence());
+    }
+  }
+  XCTAssertEqual(4 * 16, effect.rendered);
+
+  for (NSInteger bus = 0; bus < 4; ++bus) {
+    effect.processAndRender(&timestamp, frames, bus, [buffer mutableAudioBufferList], nil, pullInput);
+    XCTAssertTrue(effect.isSkippingSilence());
+  }
+  XCTAssertEqual(4 * 16, effect.rendered);
+}
+
+- (void)testSilenceFlagFromUpstream {
+  TailedLowpassEffect effect;
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 16;
+  effect.setRenderingFormat(1, format, frames);
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+
+  // Fill the internal buffer with non-zero samples and then have upstream report silence without touching them.
+  bool signal = true;
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil,
+                          makeSparseInput(&signal, true));
+  signal = false;
+  auto pullInput = makeSparseInput(&signal, true);
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+  XCTAssertFalse(effect.isSkippingSilence());
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+  XCTAssertTrue(effect.isSkippingSilence());
+}
+
+- (void)testSilenceThreshold {
+  TailedLowpassEffect effect;
+  XCTAssertEqual(0.0, effect.silenceThreshold());
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 16;
+  effect.setRenderingFormat(1, format, frames);
+  effect.setSilenceThreshold(0.5);
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+
+  // Input of 0.5 is at the threshold and so is treated as silence.
+  bool signal = true;
+  auto pullInput = makeSparseInput(&signal, false);
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+  effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+  XCTAssertTrue(effect.isSkippingSilence());
+}
+
+- (void)testNoSkippingWithoutTailLength {
+  LowpassEffect effect;
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 16;
+  effect.setRenderingFormat(1, format, frames);
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  bool signal = false;
+  auto pullInput = makeSparseInput(&signal, false);
+  for (int block = 0; block < 10; ++block) {
+    effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+    XCTAssertFalse(effect.isSkippingSilence());
+  }
+  XCTAssertEqual(160, effect.rendered);
+}
+
+- (void)testMultiBusRendering {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 256;
+  std::vector<AVAudioPCMBuffer*> buffers;
+  std::vector<AudioBufferList*> perBusOutputs;
+  std::vector<AudioBufferList*> multiBusOutputs;
+  for (int bus = 0; bus < 4; ++bus) {
+    AVAudioPCMBuffer* perBusBuffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+    AVAudioPCMBuffer* multiBusBuffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+    buffers.push_back(perBusBuffer);
+    buffers.push_back(multiBusBuffer);
+    perBusOutputs.push_back([perBusBuffer mutableAudioBufferList]);
+    multiBusOutputs.push_back([multiBusBuffer mutableAudioBufferList]);
+  }
+
+  CrossoverEffect perBus;
+  perBus.setRenderingFormat(4, format, frames);
+  CrossoverEffect multiBus;
+  XCTAssertFalse(multiBus.isMultiBusRenderingEnabled());
+  multiBus.setMultiBusRenderingEnabled(true);
+  XCTAssertTrue(multiBus.isMultiBusRenderingEnabled());
+  multiBus.setRenderingFormat(4, format, frames);
+
+  int perBusPulls = 0;
+  int multiBusPulls = 0;
+  auto perBusInput = makeCountingInput(&perBusPulls);
+  auto multiBusInput = makeCountingInput(&multiBusPulls);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  for (int cycle = 0; cycle < 3; ++cycle) {
+    timestamp.mSampleTime = cycle * frames;
+    auto event = makeParameterEvent(AUEventSampleTime(timestamp.mSampleTime));
+    for (NSInteger bus = 0; bus < 4; ++bus) {
+      XCTAssertEqual(noErr, perBus.processAndRender(&timestamp, frames, bus, perBusOutputs[bus], &event,
+                                                    perBusInput));
+      XCTAssertEqual(noErr, multiBus.processAndRender(&timestamp, frames, bus, multiBusOutputs[bus], &event,
+                                                      multiBusInput));
+    }
+
+    for (int bus = 0; bus < 4; ++bus) {
+      for (UInt32 channel = 0; channel < 2; ++channel) {
+        auto expected = static_cast<AUValue*>(perBusOutputs[bus]->mBuffers[channel].mData);
+        auto actual = static_cast<AUValue*>(multiBusOutputs[bus]->mBuffers[channel].mData);
+        for (AUAudioFrameCount frame = 0; frame < frames; ++frame) {
+          XCTAssertEqual(expected[frame], actual[frame]);
+        }
+      }
+    }
+  }
+
+  // The multi-bus kernel saw each cycle's input, events, and render call once.
+  XCTAssertEqual(12, perBusPulls);
+  XCTAssertEqual(12, perBus.eventCount);
+  XCTAssertEqual(12, perBus.renderCalls);
+  XCTAssertEqual(3, multiBusPulls);
+  XCTAssertEqual(3, multiBus.eventCount);
+  XCTAssertEqual(3, multiBus.allBusRenderCalls);
+  XCTAssertEqual(0, multiBus.renderCalls);
+}
+
+- (void)testMultiBusInPlaceHandOver {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 64;
+  CrossoverEffect effect;
+  effect.setMultiBusRenderingEnabled(true);
+  effect.setRenderingFormat(4, format, frames);
+  XCTAssertEqual(5 * SampleBuffer::arenaSize(2, frames), effect.renderingMemorySize());
+
+  std::vector<AVAudioPCMBuffer*> buffers;
+  std::vector<AudioBufferList*> outputs;
+  for (int bus = 0; bus < 4; ++bus) {
+    AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+    buffers.push_back(buffer);
+    outputs.push_back([buffer mutableAudioBufferList]);
+  }
+
+  int pulls = 0;
+  auto input = makeCountingInput(&pulls);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  std::vector<void*> pointers;
+  for (NSInteger bus = 0; bus < 4; ++bus) {
+    auto bufferList = outputs[bus];
+    bufferList->mBuffers[0].mData = nullptr;
+    bufferList->mBuffers[1].mData = nullptr;
+    XCTAssertEqual(noErr, effect.processAndRender(&timestamp, frames, bus, bufferList, nullptr, input));
+    XCTAssertTrue(bufferList->mBuffers[0].mData != nullptr);
+    XCTAssertEqual(frames * sizeof(AUValue), bufferList->mBuffers[0].mDataByteSize);
+    pointers.push_back(bufferList->mBuffers[0].mData);
+  }
+  XCTAssertEqual(1, pulls);
+  for (size_t index = 1; index < pointers.size(); ++index) XCTAssertTrue(pointers[index] != pointers[index - 1]);
+
+  // The bands add back up to the input
+  for (AUAudioFrameCount frame = 0; frame < frames; ++frame) {
+    AUValue sum = 0.0;
+    for (auto pointer : pointers) sum += static_cast<AUValue*>(pointer)[frame];
+    XCTAssertEqualWithAccuracy(AUValue(frame % 64) / 64.0f - 0.5f, sum, 1.0e-6);
+  }
+
+  // Pulling a bus again with the same timestamp starts a new render cycle.
+  XCTAssertEqual(noErr, effect.processAndRender(&timestamp, frames, 2, outputs[2], nullptr, input));
+  XCTAssertEqual(2, pulls);
+  XCTAssertEqual(2, effect.allBusRenderCalls);
+}
+
+- (void)testMultiBusWithoutAllBusesMethod {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 64;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  RecordingEffect effect;
+  effect.setMultiBusRenderingEnabled(true);
+  effect.setRenderingFormat(3, format, frames);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  for (NSInteger bus = 0; bus < 3; ++bus) {
+    XCTAssertEqual(noErr, effect.processAndRender(&timestamp, frames, bus, [buffer mutableAudioBufferList], nullptr,
+                                                  nullptr));
+  }
+  // `doRendering` was called once per bus on the first pull and not at all for the others.
+  XCTAssertEqual(3, effect.chunks.size());
+  XCTAssertEqual(3 * frames, effect.rendered);
+}
+
+- (void)testPerBusCrossoverPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  [self measureBlock:^{
+    CrossoverEffect effect;
+    effect.setRenderingFormat(4, format, frames);
+    int pulls = 0;
+    auto input = makeCountingInput(&pulls);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    for (int iteration = 0; iteration < 2'000; ++iteration) {
+      timestamp.mSampleTime = iteration * frames;
+      auto event = makeParameterEvent(AUEventSampleTime(timestamp.mSampleTime));
+      for (NSInteger bus = 0; bus < 4; ++bus) {
+        effect.processAndRender(&timestamp, frames, bus, [buffer mutableAudioBufferList], &event, input);
+      }
+    }
+  }];
+}
+
+- (void)testMultiBusCrossoverPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  [self measureBlock:^{
+    CrossoverEffect effect;
+    effect.setMultiBusRenderingEnabled(true);
+    effect.setRenderingFormat(4, format, frames);
+    int pulls = 0;
+    auto input = makeCountingInput(&pulls);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    for (int iteration = 0; iteration < 2'000; ++iteration) {
+      timestamp.mSampleTime = iteration * frames;
+      auto event = makeParameterEvent(AUEventSampleTime(timestamp.mSampleTime));
+      for (NSInteger bus = 0; bus < 4; ++bus) {
+        effect.processAndRender(&timestamp, frames, bus, [buffer mutableAudioBufferList], &event, input);
+      }
+    }
+  }];
+}
+
+- (void)testSparseInputPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  [self measureBlock:^{
+    LowpassEffect effect;
+    effect.setRenderingFormat(1, format, frames);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    bool signal = false;
+    auto pullInput = makeSparseInput(&signal, false);
+    for (int iteration = 0; iteration < 10'000; ++iteration) {
+      // One block in ten has signal
+      signal = iteration % 10 == 0;
+      effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+    }
+  }];
+}
+
+- (void)testSparseInputSkippingPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  [self measureBlock:^{
+    TailedLowpassEffect effect;
+    effect.setRenderingFormat(1, format, frames);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    bool signal = false;
+    auto pullInput = makeSparseInput(&signal, false);
+    for (int iteration = 0; iteration < 10'000; ++iteration) {
+      // One block in ten has signal
+      signal = iteration % 10 == 0;
+      effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+    }
+  }];
+}
+
 @end
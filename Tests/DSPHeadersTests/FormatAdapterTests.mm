@@ -0,0 +1,189 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <vector>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/FormatAdapter.hpp"
+
+using namespace DSPHeaders;
+using namespace DSPHeaders::SampleConversion;
+
+/**
+ Effect that scales its input by a gain value given by parameter events. When acting as an instrument it has no input
+ and emits the gain value.
+ */
+struct ScalingEffect : public EventProcessor<ScalingEffect>
+{
+  ScalingEffect() : EventProcessor<ScalingEffect>() {}
+  void setParameterFromEvent(const AUParameterEvent& event) { gain_ = event.value; }
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        outs[channel][frame] = instrument_ ? gain_ : ins[channel][frame] * gain_;
+      }
+    }
+  }
+  AUValue gain_{0.5};
+  bool instrument_{false};
+};
+
+@interface FormatAdapterTests : XCTestCase
+
+@end
+
+@implementation FormatAdapterTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testBytesPerFrame {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::int24, 64);
+  XCTAssertEqual(SampleType::int24, adapter.sampleType());
+  XCTAssertEqual(6, adapter.bytesPerFrame());
+  XCTAssertFalse(adapter.isDitherEnabled());
+  adapter.setDitherEnabled(true);
+  XCTAssertTrue(adapter.isDitherEnabled());
+}
+
+- (void)testTooManyChannels {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0
+                                                                         channels:BusBuffers::MaxChannelCount + 1];
+  FormatAdapter adapter;
+  XCTAssertEqual(kAudioUnitErr_FormatNotSupported, adapter.setRenderingFormat(format, SampleType::int16, 64));
+  XCTAssertEqual(0, adapter.bytesPerFrame());
+}
+
+- (void)testInt16Effect {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frameCount = 64;
+  ScalingEffect effect;
+  effect.setRenderingFormat(1, format, frameCount);
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::int16, frameCount);
+
+  std::vector<int16_t> input(frameCount * 2);
+  for (size_t index = 0; index < input.size(); ++index) input[index] = int16_t(index * 100);
+  std::vector<int16_t> output(frameCount * 2);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(noErr, adapter.render(effect, &timestamp, frameCount, nullptr, input.data(), output.data()));
+  for (size_t index = 0; index < output.size(); ++index) {
+    XCTAssertEqual(int16_t(index * 50), output[index]);
+  }
+}
+
+- (void)testMixedSampleTypes {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frameCount = 64;
+  ScalingEffect effect;
+  effect.setRenderingFormat(1, format, frameCount);
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::int16, SampleType::float32, frameCount);
+  XCTAssertEqual(SampleType::int16, adapter.inputSampleType());
+  XCTAssertEqual(SampleType::float32, adapter.sampleType());
+  XCTAssertEqual(8, adapter.bytesPerFrame());
+
+  std::vector<int16_t> input(frameCount * 2);
+  for (size_t index = 0; index < input.size(); ++index) input[index] = int16_t(index * 128);
+  std::vector<float> output(frameCount * 2);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(noErr, adapter.render(effect, &timestamp, frameCount, nullptr, input.data(), output.data()));
+  for (size_t index = 0; index < output.size(); ++index) {
+    XCTAssertEqualWithAccuracy(index * 64 / 32768.0, output[index], 1.0e-6);
+  }
+}
+
+- (void)testEventsAreApplied {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frameCount = 8;
+  ScalingEffect effect;
+  effect.setRenderingFormat(1, format, frameCount);
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::float32, frameCount);
+
+  AURenderEvent event{};
+  event.parameter.eventType = AURenderEventParameter;
+  event.parameter.eventSampleTime = 4;
+  event.parameter.value = 0.25;
+
+  std::vector<AUValue> input(frameCount * 2, 1.0);
+  std::vector<AUValue> output(frameCount * 2);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(noErr, adapter.render(effect, &timestamp, frameCount, &event, input.data(), output.data()));
+  for (size_t frame = 0; frame < frameCount; ++frame) {
+    auto expected = frame < 4 ? 0.5 : 0.25;
+    XCTAssertEqual(expected, output[frame * 2]);
+    XCTAssertEqual(expected, output[frame * 2 + 1]);
+  }
+}
+
+- (void)testInstrument {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:1];
+  AUAudioFrameCount frameCount = 16;
+  ScalingEffect effect;
+  effect.instrument_ = true;
+  effect.setRenderingFormat(1, format, frameCount);
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::int32, frameCount);
+
+  std::vector<int32_t> output(frameCount);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(noErr, adapter.render(effect, &timestamp, frameCount, nullptr, nullptr, output.data()));
+  for (auto sample : output) {
+    XCTAssertEqual(1 << 30, sample);
+  }
+}
+
+- (void)testBypass {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frameCount = 32;
+  ScalingEffect effect;
+  effect.setRenderingFormat(1, format, frameCount);
+  effect.setBypass(true);
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::int24, frameCount);
+
+  std::vector<uint8_t> input(frameCount * 2 * 3);
+  for (size_t index = 0; index < input.size(); ++index) input[index] = uint8_t(index * 7);
+  std::vector<uint8_t> output(input.size());
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(noErr, adapter.render(effect, &timestamp, frameCount, nullptr, input.data(), output.data()));
+
+  // 24-bit samples survive the round trip through float without change.
+  for (size_t index = 0; index < input.size(); ++index) {
+    XCTAssertEqual(input[index], output[index]);
+  }
+}
+
+- (void)testTooManyFrames {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  ScalingEffect effect;
+  effect.setRenderingFormat(1, format, 16);
+  FormatAdapter adapter;
+  adapter.setRenderingFormat(format, SampleType::int16, 16);
+  std::vector<int16_t> samples(64);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(kAudioUnitErr_TooManyFramesToProcess,
+                 adapter.render(effect, &timestamp, 32, nullptr, samples.data(), samples.data()));
+}
+
+- (void)testRenderBeforeFormat {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  ScalingEffect effect;
+  effect.setRenderingFormat(1, format, 16);
+  FormatAdapter adapter;
+  std::vector<int16_t> samples(32);
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(kAudioUnitErr_Uninitialized,
+                 adapter.render(effect, &timestamp, 0, nullptr, samples.data(), samples.data()));
+}
+
+@end
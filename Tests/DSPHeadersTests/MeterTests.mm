@@ -0,0 +1,299 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <atomic>
+#import <cmath>
+#import <thread>
+#import <vector>
+
+#import "DSPHeaders/Meter.hpp"
+#import "TestSupport.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr double SampleRate = 48'000.0;
+static constexpr AUAudioFrameCount MaxFrames = 512;
+
+/// The frequency BS.1770 uses to calibrate its loudness scale.
+static constexpr double CalibrationFrequency = 997.0;
+
+/**
+ Meter channels in blocks of MaxFrames.
+ */
+static void process(Meter& meter, std::vector<std::vector<AUValue>>& channels) {
+  auto size = channels[0].size();
+  for (size_t frame = 0; frame < size; frame += MaxFrames) {
+    auto count = AUAudioFrameCount(std::min(size_t(MaxFrames), size - frame));
+    std::vector<AUValue*> pointers;
+    for (auto& channel : channels) pointers.push_back(channel.data() + frame);
+    meter.process(BusBuffers{pointers}, count);
+  }
+}
+
+static Meter::Readings meterSine(size_t channelCount, size_t count, double amplitude) {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, channelCount);
+  std::vector<std::vector<AUValue>> channels(channelCount,
+                                            makeSine(CalibrationFrequency, SampleRate, count, amplitude));
+  process(meter, channels);
+  Meter::Readings readings;
+  meter.readings(readings);
+  return readings;
+}
+
+static void measureMeter() {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 2);
+  auto left = makeSine(CalibrationFrequency, SampleRate, MaxFrames, 0.5);
+  auto right = makeSine(CalibrationFrequency, SampleRate, MaxFrames, 0.5, 1.0);
+  BusBuffers bus{std::vector<AUValue*>{left.data(), right.data()}};
+  Meter::Readings readings;
+  for (int block = 0; block < int(SampleRate) / int(MaxFrames); ++block) {
+    meter.process(bus, MaxFrames);
+    meter.readings(readings);
+  }
+}
+
+@interface MeterTests : XCTestCase
+
+@end
+
+@implementation MeterTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+// Values from Table 1 of ITU-R BS.1770-4
+- (void)testKWeightingCoefficients {
+  auto shelf = Meter::kWeightingShelf(48'000.0);
+  XCTAssertEqualWithAccuracy(1.53512485958697, shelf.a0, 1.0e-10);
+  XCTAssertEqualWithAccuracy(-2.69169618940638, shelf.a1, 1.0e-10);
+  XCTAssertEqualWithAccuracy(1.19839281085285, shelf.a2, 1.0e-10);
+  XCTAssertEqualWithAccuracy(-1.69065929318241, shelf.b1, 1.0e-10);
+  XCTAssertEqualWithAccuracy(0.73248077421585, shelf.b2, 1.0e-10);
+
+  auto highPass = Meter::kWeightingHighPass(48'000.0);
+  XCTAssertEqual(1.0, highPass.a0);
+  XCTAssertEqual(-2.0, highPass.a1);
+  XCTAssertEqual(1.0, highPass.a2);
+  XCTAssertEqualWithAccuracy(-1.99004745483398, highPass.b1, 1.0e-10);
+  XCTAssertEqualWithAccuracy(0.99007225036621, highPass.b2, 1.0e-10);
+}
+
+- (void)testNoReadingsBeforeFirstStep {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 1);
+  std::vector<std::vector<AUValue>> channels{makeSine(CalibrationFrequency, SampleRate, 4'799, 0.5)};
+  process(meter, channels);
+  Meter::Readings readings;
+  XCTAssertFalse(meter.readings(readings));
+  XCTAssertEqual(0, readings.count);
+
+  std::vector<std::vector<AUValue>> one{{0.0f}};
+  process(meter, one);
+  XCTAssertTrue(meter.readings(readings));
+  XCTAssertEqual(1, readings.count);
+  XCTAssertFalse(meter.readings(readings));
+  XCTAssertEqual(1, readings.count);
+}
+
+- (void)testPeakAndRMS {
+  auto readings = meterSine(2, 48'000, 0.5);
+  XCTAssertEqual(2, readings.channelCount);
+  XCTAssertEqual(10, readings.count);
+  for (size_t channel = 0; channel < 2; ++channel) {
+    XCTAssertEqualWithAccuracy(-6.0206, readings.peak[channel], 1.0e-3);
+    XCTAssertEqualWithAccuracy(-6.0206, readings.peakHold[channel], 1.0e-3);
+    XCTAssertEqualWithAccuracy(-9.0309, readings.rms[channel], 1.0e-2);
+  }
+  XCTAssertEqual(Meter::Silence, readings.peak[2]);
+  XCTAssertEqual(Meter::Silence, readings.rms[2]);
+}
+
+- (void)testPeakHold {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 1);
+  std::vector<std::vector<AUValue>> loud{makeSine(CalibrationFrequency, SampleRate, 4'800, 1.0)};
+  std::vector<std::vector<AUValue>> quiet{makeSine(CalibrationFrequency, SampleRate, 4'800, 0.1)};
+  process(meter, loud);
+  process(meter, quiet);
+  Meter::Readings readings;
+  XCTAssertTrue(meter.readings(readings));
+  XCTAssertEqualWithAccuracy(-20.0, readings.peak[0], 1.0e-3);
+  XCTAssertEqualWithAccuracy(0.0, readings.peakHold[0], 1.0e-3);
+
+  meter.requestReset();
+  process(meter, quiet);
+  XCTAssertTrue(meter.readings(readings));
+  XCTAssertEqual(1, readings.count);
+  XCTAssertEqualWithAccuracy(-20.0, readings.peakHold[0], 1.0e-3);
+}
+
+// A full-scale 997 Hz sine in one channel reads -3.01 LUFS, and in both channels 0.0 LUFS.
+- (void)testLoudnessCalibration {
+  auto mono = meterSine(1, 96'000, 1.0);
+  XCTAssertEqualWithAccuracy(-3.01, mono.momentary, 0.02);
+  XCTAssertEqualWithAccuracy(-3.01, mono.integrated, 0.02);
+
+  auto stereo = meterSine(2, 96'000, 1.0);
+  XCTAssertEqualWithAccuracy(0.0, stereo.momentary, 0.02);
+  XCTAssertEqualWithAccuracy(0.0, stereo.integrated, 0.02);
+
+  auto quiet = meterSine(2, 96'000, 0.1);
+  XCTAssertEqualWithAccuracy(-20.0, quiet.momentary, 0.02);
+}
+
+- (void)testShortTermLoudness {
+  // 2 s loud then 1 s at 20 dB less fills the 3 s window with an average of (2 + 0.01) / 3 of full power.
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> loud(2, makeSine(CalibrationFrequency, SampleRate, 96'000, 1.0));
+  std::vector<std::vector<AUValue>> quiet(2, makeSine(CalibrationFrequency, SampleRate, 48'000, 0.1));
+  process(meter, loud);
+  process(meter, quiet);
+  Meter::Readings readings;
+  meter.readings(readings);
+  XCTAssertEqualWithAccuracy(10.0 * std::log10(2.01 / 3.0), readings.shortTerm, 0.02);
+  XCTAssertEqualWithAccuracy(-20.0, readings.momentary, 0.02);
+}
+
+- (void)testChannelWeight {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 2);
+  meter.setChannelWeight(1, 0.0);
+  std::vector<std::vector<AUValue>> channels(2, makeSine(CalibrationFrequency, SampleRate, 48'000, 1.0));
+  process(meter, channels);
+  Meter::Readings readings;
+  meter.readings(readings);
+  XCTAssertEqualWithAccuracy(-3.01, readings.momentary, 0.02);
+}
+
+- (void)testIntegratedGating {
+  // Silence falls below the absolute gate, and a level 20 LU below falls below the relative gate, so neither changes
+  // the integrated loudness.
+  for (auto tail : {0.0, 0.1}) {
+    Meter meter;
+    meter.setRenderingFormat(SampleRate, 2);
+    std::vector<std::vector<AUValue>> loud(2, makeSine(CalibrationFrequency, SampleRate, 480'000, 1.0));
+    std::vector<std::vector<AUValue>> quiet(2, makeSine(CalibrationFrequency, SampleRate, 480'000, tail));
+    process(meter, loud);
+    process(meter, quiet);
+    Meter::Readings readings;
+    meter.readings(readings);
+    XCTAssertEqualWithAccuracy(0.0, readings.integrated, 0.1);
+    XCTAssertEqual(tail == 0.0 ? Meter::Silence : -20.0f, std::round(readings.momentary));
+  }
+
+  // Two levels 6 dB apart are both within the gate, so the result is the loudness of the average power.
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> loud(2, makeSine(CalibrationFrequency, SampleRate, 480'000, 1.0));
+  std::vector<std::vector<AUValue>> half(2, makeSine(CalibrationFrequency, SampleRate, 480'000, 0.5));
+  process(meter, loud);
+  process(meter, half);
+  Meter::Readings readings;
+  meter.readings(readings);
+  XCTAssertEqualWithAccuracy(10.0 * std::log10(1.25 / 2.0), readings.integrated, 0.1);
+}
+
+- (void)testIntegratedSilence {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 1);
+  std::vector<std::vector<AUValue>> silence{std::vector<AUValue>(48'000, 0.0)};
+  process(meter, silence);
+  Meter::Readings readings;
+  XCTAssertTrue(meter.readings(readings));
+  XCTAssertEqual(Meter::Silence, readings.integrated);
+  XCTAssertEqual(Meter::Silence, readings.peak[0]);
+  XCTAssertEqual(0.0, readings.correlation);
+}
+
+- (void)testCorrelation {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 2);
+  Meter::Readings readings;
+
+  std::vector<std::vector<AUValue>> same(2, makeSine(CalibrationFrequency, SampleRate, 24'000, 0.5));
+  process(meter, same);
+  meter.readings(readings);
+  XCTAssertEqualWithAccuracy(1.0, readings.correlation, 1.0e-4);
+
+  std::vector<std::vector<AUValue>> inverted{makeSine(CalibrationFrequency, SampleRate, 24'000, 0.5),
+                                             makeSine(CalibrationFrequency, SampleRate, 24'000, -0.5)};
+  process(meter, inverted);
+  meter.readings(readings);
+  XCTAssertEqualWithAccuracy(-1.0, readings.correlation, 1.0e-4);
+
+  std::vector<std::vector<AUValue>> quadrature{makeSine(CalibrationFrequency, SampleRate, 24'000, 0.5),
+                                               makeSine(CalibrationFrequency, SampleRate, 24'000, 0.5, M_PI / 2.0)};
+  process(meter, quadrature);
+  meter.readings(readings);
+  XCTAssertEqualWithAccuracy(0.0, readings.correlation, 1.0e-2);
+}
+
+- (void)testOddBlockSizes {
+  // Steps must not depend on how the render blocks line up with them.
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 1);
+  auto samples = makeSine(CalibrationFrequency, SampleRate, 48'000, 0.5);
+  size_t frame = 0;
+  for (AUAudioFrameCount count = 1; frame < samples.size(); count = count * 7 % 1'021 + 1) {
+    count = AUAudioFrameCount(std::min(size_t(count), samples.size() - frame));
+    AUValue* pointer = samples.data() + frame;
+    meter.process(BusBuffers{std::vector<AUValue*>{pointer}}, count);
+    frame += count;
+  }
+  auto expected = meterSine(1, 48'000, 0.5);
+  Meter::Readings readings;
+  meter.readings(readings);
+  XCTAssertEqual(expected.count, readings.count);
+  XCTAssertEqualWithAccuracy(expected.momentary, readings.momentary, 1.0e-4);
+  XCTAssertEqualWithAccuracy(expected.rms[0], readings.rms[0], 1.0e-4);
+}
+
+// The render thread publishes while another thread reads. Every reading seen must be whole and in order.
+- (void)testConcurrentReader {
+  Meter meter;
+  meter.setRenderingFormat(SampleRate, 2);
+  std::atomic<bool> done{false};
+  uint64_t seen = 0;
+  bool consistent = true;
+  std::thread reader([&]() {
+    Meter::Readings readings;
+    while (!done.load(std::memory_order_acquire)) {
+      if (meter.readings(readings)) {
+        consistent = consistent && readings.count > seen && readings.peak[0] == readings.peak[1];
+        seen = readings.count;
+      }
+    }
+  });
+
+  std::vector<AUValue> samples(MaxFrames);
+  BusBuffers bus{std::vector<AUValue*>{samples.data(), samples.data()}};
+  for (int block = 0; block < 5'000; ++block) {
+    std::fill(samples.begin(), samples.end(), AUValue(block % 100) / 100.0f);
+    meter.process(bus, MaxFrames);
+  }
+  done.store(true, std::memory_order_release);
+  reader.join();
+
+  XCTAssertTrue(consistent);
+  // The reader may or may not have seen the last one.
+  Meter::Readings readings;
+  if (meter.readings(readings)) seen = readings.count;
+  XCTAssertEqual(5'000 * MaxFrames / 4'800, seen);
+}
+
+// Metering one second of stereo should take a small fraction of a second.
+- (void)testPerformance {
+  [self measureBlock:^{
+    measureMeter();
+  }];
+}
+
+@end
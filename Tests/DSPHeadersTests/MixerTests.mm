@@ -0,0 +1,256 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/Mixer.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr AUAudioFrameCount frameCount = 37;
+static constexpr AUAudioFrameCount benchmarkFrames = 512;
+
+/**
+ Holds sample storage for a bus with a given number of channels, filled with a distinct ramp per channel.
+ */
+struct TestBus {
+  TestBus(size_t channels, AUAudioFrameCount frames, AUValue seed) : samples_(channels * frames), pointers_(channels) {
+    for (size_t index = 0; index < samples_.size(); ++index) {
+      samples_[index] = seed + AUValue(index % 101) * 0.01f - 0.5f;
+    }
+    for (size_t channel = 0; channel < channels; ++channel) {
+      pointers_[channel] = samples_.data() + channel * frames;
+    }
+  }
+
+  BusBuffers bus() const { return BusBuffers(pointers_); }
+
+  std::vector<AUValue> samples_;
+  std::vector<AUValue*> pointers_;
+};
+
+/**
+ @returns the largest absolute difference between the samples of two buses
+ */
+static AUValue maxDifference(const TestBus& lhs, const TestBus& rhs) {
+  AUValue result = 0.0;
+  for (size_t index = 0; index < lhs.samples_.size(); ++index) {
+    result = std::max(result, std::abs(lhs.samples_[index] - rhs.samples_[index]));
+  }
+  return result;
+}
+
+@interface MixerTests : XCTestCase
+
+@end
+
+@implementation MixerTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testPanGains {
+  auto [left, right] = Mixer::panGains(-1.0);
+  XCTAssertEqualWithAccuracy(1.0, left, 1.0e-6);
+  XCTAssertEqualWithAccuracy(0.0, right, 1.0e-6);
+  std::tie(left, right) = Mixer::panGains(0.0);
+  XCTAssertEqualWithAccuracy(std::sqrt(0.5), left, 1.0e-6);
+  XCTAssertEqualWithAccuracy(std::sqrt(0.5), right, 1.0e-6);
+  std::tie(left, right) = Mixer::panGains(2.0);
+  XCTAssertEqualWithAccuracy(0.0, left, 1.0e-6);
+  XCTAssertEqualWithAccuracy(1.0, right, 1.0e-6);
+}
+
+- (void)testScale {
+  TestBus vector{3, frameCount, 0.1f};
+  TestBus reference{3, frameCount, 0.1f};
+  Mixer::scale(vector.bus(), 0.25, frameCount);
+  Mixer::Reference::scale(reference.bus(), 0.25, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+  XCTAssertEqualWithAccuracy((0.1f - 0.5f) * 0.25f, vector.samples_[0], 1.0e-6);
+}
+
+- (void)testScaledCopy {
+  TestBus source{2, frameCount, 0.2f};
+  TestBus vector{2, frameCount, 0.0f};
+  TestBus reference{2, frameCount, 0.0f};
+  Mixer::scaledCopy(source.bus(), vector.bus(), -0.5, frameCount);
+  Mixer::Reference::scaledCopy(source.bus(), reference.bus(), -0.5, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+}
+
+- (void)testScaledCopyChannelMismatch {
+  TestBus source{1, frameCount, 0.2f};
+  TestBus vector{2, frameCount, 0.0f};
+  TestBus reference{2, frameCount, 0.0f};
+  Mixer::scaledCopy(source.bus(), vector.bus(), 2.0, frameCount);
+  Mixer::Reference::scaledCopy(source.bus(), reference.bus(), 2.0, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+
+  // Second channel is untouched
+  TestBus original{2, frameCount, 0.0f};
+  XCTAssertEqual(original.samples_[frameCount], vector.samples_[frameCount]);
+}
+
+- (void)testMultiplyAccumulate {
+  TestBus source{2, frameCount, 0.3f};
+  TestBus vector{2, frameCount, 0.1f};
+  TestBus reference{2, frameCount, 0.1f};
+  Mixer::multiplyAccumulate(source.bus(), vector.bus(), 0.75, frameCount);
+  Mixer::Reference::multiplyAccumulate(source.bus(), reference.bus(), 0.75, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+}
+
+- (void)testConstantPowerPanMono {
+  TestBus source{1, frameCount, 0.3f};
+  TestBus vector{2, frameCount, 0.0f};
+  TestBus reference{2, frameCount, 0.0f};
+  Mixer::constantPowerPan(source.bus(), vector.bus(), 0.3, frameCount);
+  Mixer::Reference::constantPowerPan(source.bus(), reference.bus(), 0.3, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+
+  // Power is preserved
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    auto left = vector.samples_[frame];
+    auto right = vector.samples_[frameCount + frame];
+    auto in = source.samples_[frame];
+    XCTAssertEqualWithAccuracy(in * in, left * left + right * right, 1.0e-6);
+  }
+}
+
+- (void)testConstantPowerPanStereoInPlace {
+  TestBus vector{2, frameCount, 0.3f};
+  TestBus reference{2, frameCount, 0.3f};
+  Mixer::constantPowerPan(vector.bus(), vector.bus(), -0.6, frameCount);
+  Mixer::Reference::constantPowerPan(reference.bus(), reference.bus(), -0.6, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+}
+
+- (void)testConstantPowerPanMonoInPlace {
+  // A mono source that is either one of the output channels
+  for (size_t channel = 0; channel < 2; ++channel) {
+    TestBus bus{2, frameCount, 0.3f};
+    std::vector<AUValue> mono(bus.pointers_[channel], bus.pointers_[channel] + frameCount);
+    Mixer::constantPowerPan(BusBuffers(std::vector<AUValue*>{bus.pointers_[channel]}), bus.bus(), 0.3, frameCount);
+    auto [leftGain, rightGain] = Mixer::panGains(0.3);
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      XCTAssertEqualWithAccuracy(mono[frame] * leftGain, bus.pointers_[0][frame], 1.0e-6);
+      XCTAssertEqualWithAccuracy(mono[frame] * rightGain, bus.pointers_[1][frame], 1.0e-6);
+    }
+  }
+}
+
+- (void)testCrossfade {
+  TestBus dry{2, frameCount, 0.1f};
+  TestBus wet{2, frameCount, 0.6f};
+  TestBus vector{2, frameCount, 0.0f};
+  TestBus reference{2, frameCount, 0.0f};
+  Parameters::PercentageParameter<AUValue> vectorMix{25.0};
+  Parameters::PercentageParameter<AUValue> referenceMix{25.0};
+  Mixer::crossfade(dry.bus(), wet.bus(), vector.bus(), vectorMix, frameCount);
+  Mixer::Reference::crossfade(dry.bus(), wet.bus(), reference.bus(), referenceMix, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+  XCTAssertEqualWithAccuracy(dry.samples_[0] * 0.75f + wet.samples_[0] * 0.25f, vector.samples_[0], 1.0e-6);
+}
+
+- (void)testCrossfadeRamping {
+  TestBus dry{2, frameCount, 0.1f};
+  TestBus wet{2, frameCount, 0.6f};
+  TestBus vector{2, frameCount, 0.1f};
+  TestBus reference{2, frameCount, 0.1f};
+  Parameters::PercentageParameter<AUValue> vectorMix{0.0};
+  Parameters::PercentageParameter<AUValue> referenceMix{0.0};
+  vectorMix.set(100.0, 10);
+  referenceMix.set(100.0, 10);
+
+  // Render in place over the dry buffers
+  Mixer::crossfade(vector.bus(), wet.bus(), vector.bus(), vectorMix, frameCount);
+  Mixer::Reference::crossfade(reference.bus(), wet.bus(), reference.bus(), referenceMix, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+  XCTAssertFalse(vectorMix.isRamping());
+  XCTAssertEqualWithAccuracy(wet.samples_[frameCount - 1], vector.samples_[frameCount - 1], 1.0e-6);
+}
+
+- (void)testAlternating {
+  TestBus source{4, frameCount, 0.3f};
+  TestBus vector{4, frameCount, 0.1f};
+  TestBus reference{4, frameCount, 0.1f};
+  Mixer::scaleAlternating(vector.bus(), 0.5, -1.0, frameCount);
+  Mixer::Reference::scaleAlternating(reference.bus(), 0.5, -1.0, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+  Mixer::multiplyAccumulateAlternating(source.bus(), vector.bus(), 0.25, 2.0, frameCount);
+  Mixer::Reference::multiplyAccumulateAlternating(source.bus(), reference.bus(), 0.25, 2.0, frameCount);
+  XCTAssertEqualWithAccuracy(0.0, maxDifference(vector, reference), 1.0e-6);
+}
+
+- (void)testMultiplyAccumulateReferencePerformance {
+  [self measureBlock:^{
+    TestBus source{2, benchmarkFrames, 0.3f};
+    TestBus destination{2, benchmarkFrames, 0.1f};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      Mixer::Reference::multiplyAccumulate(source.bus(), destination.bus(), 0.5, benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testMultiplyAccumulatePerformance {
+  [self measureBlock:^{
+    TestBus source{2, benchmarkFrames, 0.3f};
+    TestBus destination{2, benchmarkFrames, 0.1f};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      Mixer::multiplyAccumulate(source.bus(), destination.bus(), 0.5, benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testConstantPowerPanReferencePerformance {
+  [self measureBlock:^{
+    TestBus source{1, benchmarkFrames, 0.3f};
+    TestBus destination{2, benchmarkFrames, 0.0f};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      Mixer::Reference::constantPowerPan(source.bus(), destination.bus(), 0.25, benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testConstantPowerPanPerformance {
+  [self measureBlock:^{
+    TestBus source{1, benchmarkFrames, 0.3f};
+    TestBus destination{2, benchmarkFrames, 0.0f};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      Mixer::constantPowerPan(source.bus(), destination.bus(), 0.25, benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testCrossfadeReferencePerformance {
+  [self measureBlock:^{
+    TestBus dry{2, benchmarkFrames, 0.1f};
+    TestBus wet{2, benchmarkFrames, 0.6f};
+    TestBus destination{2, benchmarkFrames, 0.0f};
+    Parameters::PercentageParameter<AUValue> mix{50.0};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      Mixer::Reference::crossfade(dry.bus(), wet.bus(), destination.bus(), mix, benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testCrossfadePerformance {
+  [self measureBlock:^{
+    TestBus dry{2, benchmarkFrames, 0.1f};
+    TestBus wet{2, benchmarkFrames, 0.6f};
+    TestBus destination{2, benchmarkFrames, 0.0f};
+    Parameters::PercentageParameter<AUValue> mix{50.0};
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      Mixer::crossfade(dry.bus(), wet.bus(), destination.bus(), mix, benchmarkFrames);
+    }
+  }];
+}
+
+@end
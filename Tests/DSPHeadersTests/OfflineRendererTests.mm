@@ -0,0 +1,219 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <cstdio>
+#import <filesystem>
+#import <sstream>
+#import <vector>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/OfflineRenderer.hpp"
+#import "DSPHeaders/ParameterAutomation.hpp"
+#import "DSPHeaders/WaveFile.hpp"
+
+using namespace DSPHeaders;
+using namespace DSPHeaders::SampleConversion;
+
+static std::string tempPath(const char* name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+/**
+ Write a stereo float file holding a constant value in the left channel and a ramp in the right.
+ */
+static void writeInput(const std::string& path, AUAudioFrameCount frameCount) {
+  std::vector<float> samples(frameCount * 2);
+  for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+    samples[frame * 2] = 0.5f;
+    samples[frame * 2 + 1] = float(frame % 1000) / 1000.0f;
+  }
+  WaveFileWriter writer{path, 48000.0, 2, SampleType::float32};
+  writer.write(samples.data(), frameCount);
+}
+
+/**
+ Effect that scales its input by a gain value given by parameter events on address 0.
+ */
+struct GainEffect : public EventProcessor<GainEffect>
+{
+  GainEffect() : EventProcessor<GainEffect>() {}
+  void setParameterFromEvent(const AUParameterEvent& event) { gain_ = event.value; }
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        outs[channel][frame] = ins[channel][frame] * gain_;
+      }
+    }
+  }
+  AUValue gain_{1.0};
+};
+
+@interface OfflineRendererTests : XCTestCase
+
+@end
+
+@implementation OfflineRendererTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testRenderWithAutomation {
+  auto inputPath = tempPath("OfflineRendererTests_in.wav");
+  auto outputPath = tempPath("OfflineRendererTests_out.wav");
+  AUAudioFrameCount frameCount = 10'000;
+  writeInput(inputPath, frameCount);
+
+  ParameterAutomation automation;
+  automation.add(1000, 0, 0.5);
+  automation.add(5003, 0, 0.25);
+
+  GainEffect effect;
+  OfflineRenderer::Options options;
+  options.blockSize = 256;
+  options.blocksPerWrite = 3;
+  WaveFileReader input{inputPath};
+  OfflineRenderer renderer{options};
+  auto result = renderer.render(effect, input, outputPath, automation);
+  XCTAssertEqual(frameCount, result.frameCount);
+  XCTAssertEqualWithAccuracy(frameCount / 48000.0, result.audioSeconds, 1.0e-9);
+  XCTAssertTrue(result.realtimeFactor() > 0.0);
+
+  WaveFileReader output{outputPath};
+  XCTAssertEqual(48000.0, output.sampleRate());
+  XCTAssertEqual(2, output.channelCount());
+  XCTAssertEqual(SampleType::float32, output.sampleType());
+  XCTAssertEqual(frameCount, output.frameCount());
+  auto samples = static_cast<const float*>(output.frames(0));
+  XCTAssertEqual(0.5f, samples[999 * 2]);
+  XCTAssertEqual(0.25f, samples[1000 * 2]);
+  XCTAssertEqual(0.25f, samples[5002 * 2]);
+  XCTAssertEqual(0.125f, samples[5003 * 2]);
+  XCTAssertEqualWithAccuracy(0.25 * 0.999, samples[9999 * 2 + 1], 1.0e-6);
+
+  std::remove(inputPath.c_str());
+  std::remove(outputPath.c_str());
+}
+
+- (void)testRenderToInt16 {
+  auto inputPath = tempPath("OfflineRendererTests_in16.wav");
+  auto outputPath = tempPath("OfflineRendererTests_out16.wav");
+  writeInput(inputPath, 1000);
+
+  ParameterAutomation automation;
+  GainEffect effect;
+  OfflineRenderer::Options options;
+  options.outputSampleType = SampleType::int16;
+  WaveFileReader input{inputPath};
+  OfflineRenderer renderer{options};
+  renderer.render(effect, input, outputPath, automation);
+
+  WaveFileReader output{outputPath};
+  XCTAssertEqual(SampleType::int16, output.sampleType());
+  XCTAssertEqual(1000, output.frameCount());
+  auto samples = static_cast<const int16_t*>(output.frames(0));
+  XCTAssertEqual(16384, samples[0]);
+  XCTAssertEqual(int16_t(std::round(0.5 * 32768.0)), samples[500 * 2 + 1]);
+
+  std::remove(inputPath.c_str());
+  std::remove(outputPath.c_str());
+}
+
+- (void)testReuse {
+  auto inputPath = tempPath("OfflineRendererTests_inreuse.wav");
+  auto outputPath = tempPath("OfflineRendererTests_outreuse.wav");
+  writeInput(inputPath, 3000);
+
+  GainEffect effect;
+  OfflineRenderer renderer;
+  WaveFileReader input{inputPath};
+  for (AUValue gain : {0.5f, 2.0f}) {
+    ParameterAutomation automation;
+    automation.add(0, 0, gain);
+    XCTAssertEqual(3000, renderer.render(effect, input, outputPath, automation).frameCount);
+    WaveFileReader output{outputPath};
+    XCTAssertEqual(3000, output.frameCount());
+    XCTAssertEqual(0.5f * gain, static_cast<const float*>(output.frames(2999))[0]);
+  }
+
+  std::remove(inputPath.c_str());
+  std::remove(outputPath.c_str());
+}
+
+- (void)testBadOutputPath {
+  auto inputPath = tempPath("OfflineRendererTests_inbad.wav");
+  writeInput(inputPath, 100);
+  ParameterAutomation automation;
+  GainEffect effect;
+  WaveFileReader input{inputPath};
+  OfflineRenderer renderer;
+  XCTAssertThrows(renderer.render(effect, input, "/nonexistent/dir/out.wav", automation));
+  std::remove(inputPath.c_str());
+}
+
+- (void)testParseAutomation {
+  std::istringstream script{"# gain changes\n0 1 0.5\n\n  256 1 1.0 128  # ramp up\n64 2 3.0\n"};
+  auto automation = ParameterAutomation::parse(script);
+  XCTAssertEqual(3, automation.size());
+
+  auto events = automation.eventsFor(0, 128);
+  XCTAssertTrue(events != nullptr);
+  XCTAssertEqual(0, events->parameter.eventSampleTime);
+  XCTAssertEqual(1, events->parameter.parameterAddress);
+  XCTAssertEqual(0.5, events->parameter.value);
+  XCTAssertEqual(AURenderEventParameter, events->head.eventType);
+  events = events->head.next;
+  XCTAssertTrue(events != nullptr);
+  XCTAssertEqual(64, events->parameter.eventSampleTime);
+  XCTAssertEqual(2, events->parameter.parameterAddress);
+  XCTAssertTrue(events->head.next == nullptr);
+
+  XCTAssertTrue(automation.eventsFor(128, 128) == nullptr);
+  events = automation.eventsFor(256, 128);
+  XCTAssertTrue(events != nullptr);
+  XCTAssertEqual(AURenderEventParameterRamp, events->head.eventType);
+  XCTAssertEqual(128, events->parameter.rampDurationSampleFrames);
+}
+
+- (void)testParseErrors {
+  std::istringstream missingValue{"0 1 0.5\n10 1\n"};
+  XCTAssertThrows(ParameterAutomation::parse(missingValue));
+  std::istringstream negativeTime{"-5 1 0.5\n"};
+  XCTAssertThrows(ParameterAutomation::parse(negativeTime));
+  std::istringstream garbage{"abc\n"};
+  XCTAssertThrows(ParameterAutomation::parse(garbage));
+  std::istringstream negativeDuration{"0 1 0.5 -5\n"};
+  XCTAssertThrows(ParameterAutomation::parse(negativeDuration));
+  std::istringstream negativeAddress{"0 -1 0.5\n"};
+  XCTAssertThrows(ParameterAutomation::parse(negativeAddress));
+  std::istringstream trailing{"0 1 0.5 16 32\n"};
+  XCTAssertThrows(ParameterAutomation::parse(trailing));
+  std::istringstream trailingValue{"0 1 0.5x\n"};
+  XCTAssertThrows(ParameterAutomation::parse(trailingValue));
+  std::istringstream badDuration{"0 1 0.5 ramp\n"};
+  XCTAssertThrows(ParameterAutomation::parse(badDuration));
+}
+
+- (void)testRenderPerformance {
+  auto inputPath = tempPath("OfflineRendererTests_inperf.wav");
+  auto outputPath = tempPath("OfflineRendererTests_outperf.wav");
+  writeInput(inputPath, 48000 * 60);
+  [self measureBlock:^{
+    ParameterAutomation automation;
+    for (AUEventSampleTime when = 0; when < 48000 * 60; when += 4800) automation.add(when, 0, AUValue(when % 3) / 2);
+    GainEffect effect;
+    WaveFileReader input{inputPath};
+    OfflineRenderer renderer;
+    renderer.render(effect, input, outputPath, automation);
+  }];
+  std::remove(inputPath.c_str());
+  std::remove(outputPath.c_str());
+}
+
+@end
@@ -0,0 +1,200 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/Oversampler.hpp"
+#import "TestSupport.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr double SampleRate = 48'000.0;
+static constexpr AUAudioFrameCount MaxFrames = 512;
+
+/**
+ Obtain the magnitude of one frequency in a span of samples (a single DFT bin).
+ */
+static double magnitudeAt(const AUValue* samples, size_t count, double frequency, double sampleRate) {
+  double re = 0.0;
+  double im = 0.0;
+  for (size_t index = 0; index < count; ++index) {
+    auto theta = 2.0 * M_PI * frequency * double(index) / sampleRate;
+    re += samples[index] * std::cos(theta);
+    im -= samples[index] * std::sin(theta);
+  }
+  return 2.0 * std::sqrt(re * re + im * im) / double(count);
+}
+
+/**
+ Run samples through an oversampler with a 5th-power waveshaper. A 7 kHz sine makes a 5th harmonic at 35 kHz, which
+ aliases to 13 kHz unless the shaping is done at 96 kHz or above.
+ */
+static std::vector<AUValue> shape(size_t factor, const std::vector<AUValue>& input) {
+  Oversampler oversampler{factor};
+  oversampler.setRenderingFormat(1, MaxFrames);
+  auto output = input;
+  for (size_t frame = 0; frame < output.size(); frame += MaxFrames) {
+    BusBuffers bus{std::vector<AUValue*>{output.data() + frame}};
+    oversampler.processSamples(bus, bus, MaxFrames, [](AUValue x) { return x * x * x * x * x; });
+  }
+  return output;
+}
+
+static void measureOversampler(size_t factor) {
+  Oversampler oversampler{factor};
+  oversampler.setRenderingFormat(2, MaxFrames);
+  auto left = makeSine(440.0, SampleRate, MaxFrames, 0.8);
+  auto right = makeSine(660.0, SampleRate, MaxFrames, 0.8);
+  std::vector<AUValue> outLeft(MaxFrames);
+  std::vector<AUValue> outRight(MaxFrames);
+  BusBuffers ins{std::vector<AUValue*>{left.data(), right.data()}};
+  BusBuffers outs{std::vector<AUValue*>{outLeft.data(), outRight.data()}};
+  for (int block = 0; block < int(SampleRate) / int(MaxFrames); ++block) {
+    oversampler.processSamples(ins, outs, MaxFrames, [](AUValue x) { return std::tanh(4.0f * x); });
+  }
+}
+
+@interface OversamplerTests : XCTestCase
+
+@end
+
+@implementation OversamplerTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInvalidFactor {
+  XCTAssertThrows(Oversampler(3));
+  XCTAssertThrows(Oversampler(16));
+  XCTAssertEqual(4, Oversampler(4).factor());
+}
+
+- (void)testLatency {
+  XCTAssertEqual(0.0, Oversampler(1).latency());
+  XCTAssertEqual(31.0, Oversampler(2).latency());
+  XCTAssertEqual(36.5, Oversampler(4).latency());
+  XCTAssertEqual(38.25, Oversampler(8).latency());
+}
+
+- (void)testRoundTripIsDelay {
+  constexpr double frequency = 1'000.0;
+  for (size_t factor : {1, 2, 4, 8}) {
+    Oversampler oversampler{factor};
+    oversampler.setRenderingFormat(1, MaxFrames);
+    auto samples = makeSine(frequency, SampleRate, 4 * MaxFrames);
+    size_t upsampledCount = 0;
+    for (size_t frame = 0; frame < samples.size(); frame += 100) {
+      auto count = AUAudioFrameCount(std::min(size_t(100), samples.size() - frame));
+      BusBuffers bus{std::vector<AUValue*>{samples.data() + frame}};
+      oversampler.process(bus, bus, count, [&](BusBuffers buffers, AUAudioFrameCount upsampled) {
+        XCTAssertEqual(1, buffers.size());
+        upsampledCount += upsampled;
+      });
+    }
+    XCTAssertEqual(samples.size() * factor, upsampledCount);
+
+    auto latency = oversampler.latency();
+    for (size_t frame = 100; frame < samples.size(); ++frame) {
+      auto expected = std::sin(2.0 * M_PI * frequency * (double(frame) - latency) / SampleRate);
+      XCTAssertEqualWithAccuracy(expected, samples[frame], 1.0e-3);
+    }
+  }
+}
+
+- (void)testImageRejection {
+  // Capture the 2x signal of a 9375 Hz sine (a whole number of cycles in a block). The image of the sine at 38625 Hz
+  // must be well below the sine.
+  Oversampler oversampler{2};
+  oversampler.setRenderingFormat(1, MaxFrames);
+  auto samples = makeSine(9'375.0, SampleRate, 4 * MaxFrames);
+  std::vector<AUValue> upsampled;
+  for (size_t frame = 0; frame < samples.size(); frame += MaxFrames) {
+    BusBuffers bus{std::vector<AUValue*>{samples.data() + frame}};
+    oversampler.process(bus, bus, MaxFrames, [&](BusBuffers buffers, AUAudioFrameCount count) {
+      upsampled.assign(buffers[0], buffers[0] + count);
+    });
+  }
+
+  auto signal = magnitudeAt(upsampled.data(), upsampled.size(), 9'375.0, 2 * SampleRate);
+  auto image = magnitudeAt(upsampled.data(), upsampled.size(), 38'625.0, 2 * SampleRate);
+  XCTAssertEqualWithAccuracy(1.0, signal, 0.01);
+  XCTAssertLessThan(image, signal * 1.0e-3);
+}
+
+- (void)testAliasingReduced {
+  auto input = makeSine(7'000.0, SampleRate, 16 * MaxFrames);
+  auto plain = shape(1, input);
+  auto skip = 4 * MaxFrames;
+  auto aliased = magnitudeAt(plain.data() + skip, plain.size() - skip, 13'000.0, SampleRate);
+  XCTAssertEqualWithAccuracy(1.0 / 16.0, aliased, 0.01);
+
+  for (size_t factor : {2, 4, 8}) {
+    auto oversampled = shape(factor, input);
+    auto alias = magnitudeAt(oversampled.data() + skip, oversampled.size() - skip, 13'000.0, SampleRate);
+    XCTAssertLessThan(alias, aliased * 1.0e-3);
+  }
+}
+
+- (void)testStereoInPlace {
+  Oversampler oversampler{4};
+  oversampler.setRenderingFormat(2, MaxFrames);
+  auto left = makeSine(500.0, SampleRate, 2 * MaxFrames);
+  auto right = makeSine(500.0, SampleRate, 2 * MaxFrames, -0.5);
+  for (size_t frame = 0; frame < left.size(); frame += MaxFrames) {
+    BusBuffers bus{std::vector<AUValue*>{left.data() + frame, right.data() + frame}};
+    oversampler.processSamples(bus, bus, MaxFrames, [](AUValue x) { return 2.0f * x; });
+  }
+
+  auto latency = oversampler.latency();
+  for (size_t frame = 100; frame < left.size(); ++frame) {
+    auto expected = 2.0 * std::sin(2.0 * M_PI * 500.0 * (double(frame) - latency) / SampleRate);
+    XCTAssertEqualWithAccuracy(expected, left[frame], 2.0e-3);
+    XCTAssertEqualWithAccuracy(-0.5 * expected, right[frame], 1.0e-3);
+  }
+}
+
+- (void)testReset {
+  Oversampler oversampler{2};
+  oversampler.setRenderingFormat(1, MaxFrames);
+  auto samples = makeSine(1'000.0, SampleRate, MaxFrames);
+  BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+  oversampler.processSamples(bus, bus, MaxFrames, [](AUValue x) { return x; });
+  oversampler.reset();
+
+  std::vector<AUValue> silence(MaxFrames, 0.0);
+  BusBuffers quiet{std::vector<AUValue*>{silence.data()}};
+  oversampler.processSamples(quiet, quiet, MaxFrames, [](AUValue x) { return x; });
+  for (auto sample : silence) XCTAssertEqual(0.0, sample);
+}
+
+- (void)testPerformance1x {
+  [self measureBlock:^{
+    measureOversampler(1);
+  }];
+}
+
+- (void)testPerformance2x {
+  [self measureBlock:^{
+    measureOversampler(2);
+  }];
+}
+
+- (void)testPerformance4x {
+  [self measureBlock:^{
+    measureOversampler(4);
+  }];
+}
+
+- (void)testPerformance8x {
+  [self measureBlock:^{
+    measureOversampler(8);
+  }];
+}
+
+@end
@@ -0,0 +1,146 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <array>
+#import <atomic>
+#import <thread>
+#import <vector>
+
+#import "DSPHeaders/ParameterStore.hpp"
+
+using namespace DSPHeaders;
+
+@interface ParameterStoreTests : XCTestCase
+
+@end
+
+@implementation ParameterStoreTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInit {
+  ParameterStore<4> store;
+  XCTAssertEqual(4, ParameterStore<4>::Capacity);
+  XCTAssertFalse(store.hasChanges());
+  for (AUParameterAddress address = 0; address < 4; ++address) {
+    XCTAssertEqual(0.0, store.get(address));
+  }
+  XCTAssertEqual(0, store.drain([](AUParameterAddress, AUValue) {}));
+}
+
+- (void)testSetGet {
+  ParameterStore<4> store;
+  store.set(1, 12.5);
+  XCTAssertTrue(store.hasChanges());
+  XCTAssertEqual(12.5, store.get(1));
+  XCTAssertEqual(0.0, store.get(0));
+  store.set(1, 3.25);
+  XCTAssertEqual(3.25, store.get(1));
+}
+
+- (void)testStoreDoesNotMarkDirty {
+  ParameterStore<4> store;
+  store.store(2, 7.0);
+  XCTAssertEqual(7.0, store.get(2));
+  XCTAssertFalse(store.hasChanges());
+}
+
+- (void)testDrainVisitsOnlyChanged {
+  ParameterStore<130> store;
+  store.set(0, 1.0);
+  store.set(63, 2.0);
+  store.set(64, 3.0);
+  store.set(129, 4.0);
+  store.set(63, 5.0);
+
+  std::vector<std::pair<AUParameterAddress, AUValue>> seen;
+  auto count = store.drain([&](AUParameterAddress address, AUValue value) { seen.emplace_back(address, value); });
+  XCTAssertEqual(4, count);
+  XCTAssertEqual(4, seen.size());
+  XCTAssertEqual(0, seen[0].first);
+  XCTAssertEqual(1.0, seen[0].second);
+  XCTAssertEqual(63, seen[1].first);
+  XCTAssertEqual(5.0, seen[1].second);
+  XCTAssertEqual(64, seen[2].first);
+  XCTAssertEqual(3.0, seen[2].second);
+  XCTAssertEqual(129, seen[3].first);
+  XCTAssertEqual(4.0, seen[3].second);
+
+  XCTAssertFalse(store.hasChanges());
+  XCTAssertEqual(0, store.drain([](AUParameterAddress, AUValue) {}));
+}
+
+- (void)testSnapshot {
+  ParameterStore<3> store;
+  store.set(0, 1.5);
+  store.set(2, -2.5);
+  std::array<AUValue, 3> values;
+  store.snapshot(values);
+  XCTAssertEqual(1.5, values[0]);
+  XCTAssertEqual(0.0, values[1]);
+  XCTAssertEqual(-2.5, values[2]);
+}
+
+- (void)testConcurrentWritersAndDrain {
+  constexpr size_t ParameterCount = 96;
+  constexpr size_t WriterCount = 4;
+  constexpr int Iterations = 20'000;
+
+  ParameterStore<ParameterCount> store;
+  std::array<AUValue, ParameterCount> applied{};
+  std::atomic<bool> done{false};
+  bool monotonic = true;
+
+  // Each writer owns a disjoint set of addresses and writes ever-increasing values to them. The reader must see values
+  // for an address that never go backwards, and after all writers are done it must see the last value written.
+  std::vector<std::thread> writers;
+  for (size_t writer = 0; writer < WriterCount; ++writer) {
+    writers.emplace_back([&store, writer]() {
+      for (int iteration = 1; iteration <= Iterations; ++iteration) {
+        for (size_t address = writer; address < ParameterCount; address += WriterCount) {
+          store.set(address, AUValue(iteration));
+        }
+      }
+    });
+  }
+
+  std::thread reader([&]() {
+    auto apply = [&](AUParameterAddress address, AUValue value) {
+      if (value < applied[address]) monotonic = false;
+      applied[address] = value;
+    };
+    while (!done.load()) {
+      store.drain(apply);
+    }
+    store.drain(apply);
+  });
+
+  for (auto& writer : writers) writer.join();
+  done.store(true);
+  reader.join();
+
+  XCTAssertTrue(monotonic);
+  for (size_t address = 0; address < ParameterCount; ++address) {
+    XCTAssertEqual(AUValue(Iterations), applied[address]);
+  }
+}
+
+- (void)testDrainPerformance {
+  __block AUValue sum = 0.0;
+  [self measureBlock:^{
+    ParameterStore<64> store;
+    for (int iteration = 0; iteration < 100'000; ++iteration) {
+      store.set(AUParameterAddress(iteration % 8), AUValue(iteration));
+      store.drain([&sum](AUParameterAddress, AUValue value) { sum += value; });
+    }
+  }];
+  XCTAssertNotEqual(0.0, sum);
+}
+
+@end
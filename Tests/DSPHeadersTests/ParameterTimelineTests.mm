@@ -0,0 +1,262 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <array>
+#import <vector>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/ParameterTimeline.hpp"
+#import "DSPHeaders/RampingParameter.hpp"
+
+using namespace DSPHeaders;
+
+static AUParameterEvent makeEvent(AUParameterAddress address, AUValue value, AUAudioFrameCount duration = 0) {
+  AUParameterEvent event{};
+  event.eventType = duration > 0 ? AURenderEventParameterRamp : AURenderEventParameter;
+  event.parameterAddress = address;
+  event.value = value;
+  event.rampDurationSampleFrames = duration;
+  return event;
+}
+
+/**
+ Build a linked list of `count` parameter ramp events spread evenly over `frameCount` samples.
+ */
+static void makeAutomation(std::vector<AURenderEvent>& events, size_t count, AUAudioFrameCount frameCount) {
+  events.resize(count);
+  for (size_t index = 0; index < count; ++index) {
+    auto& event = events[index].parameter;
+    event = makeEvent(0, AUValue(index % 2), 4);
+    event.eventSampleTime = AUEventSampleTime(index * frameCount / count);
+    event.next = index + 1 < count ? &events[index + 1] : nullptr;
+  }
+}
+
+struct GainKernel : public EventProcessor<GainKernel>
+{
+  GainKernel() : EventProcessor<GainKernel>() {}
+
+  void setParameterFromEvent(const AUParameterEvent& event) {
+    gain_.set(event.value, event.rampDurationSampleFrames);
+  }
+
+  void doMIDIEvent(AUMIDIEvent) { ++midiEvents_; }
+
+  void doRendering(NSInteger, BusBuffers, BusBuffers outs, AUAudioFrameCount frameCount) {
+    ++renderCalls_;
+    if (isParameterTimelineEnabled()) {
+      parameterTimeline().render(0, gain_, curve_.data(), frameCount);
+    } else {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) curve_[frame] = gain_.frameValue();
+    }
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        outs[channel][frame] += curve_[frame];
+      }
+    }
+  }
+
+  Parameters::RampingParameter<AUValue> gain_{0.0};
+  std::array<AUValue, 512> curve_;
+  int renderCalls_{0};
+  int midiEvents_{0};
+};
+
+@interface ParameterTimelineTests : XCTestCase
+
+@end
+
+@implementation ParameterTimelineTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testFinalizeSortsAndMerges {
+  ParameterTimeline timeline;
+  timeline.reserve(8);
+  timeline.beginBlock();
+  XCTAssertTrue(timeline.add(makeEvent(2, 1.0), 10));
+  XCTAssertTrue(timeline.add(makeEvent(1, 2.0), 5));
+  XCTAssertTrue(timeline.add(makeEvent(2, 3.0), 10));
+  XCTAssertTrue(timeline.add(makeEvent(1, 4.0), 0));
+  timeline.finalize();
+  XCTAssertEqual(3, timeline.size());
+  XCTAssertTrue(timeline.hasEvents(1));
+  XCTAssertTrue(timeline.hasEvents(2));
+  XCTAssertFalse(timeline.hasEvents(3));
+
+  std::vector<AUValue> values;
+  timeline.endBlock([&](const AUParameterEvent& event) { values.push_back(event.value); });
+  XCTAssertEqual(3, values.size());
+  XCTAssertEqual(4.0, values[0]);
+  XCTAssertEqual(2.0, values[1]);
+  XCTAssertEqual(3.0, values[2]);
+}
+
+- (void)testFinalizeInterleavedAddresses {
+  // Full capacity with eight addresses taking turns, and each event repeated at the same offset with a later value.
+  ParameterTimeline timeline;
+  timeline.reserve(ParameterTimeline::DefaultCapacity);
+  timeline.beginBlock();
+  for (size_t index = 0; index < ParameterTimeline::DefaultCapacity; ++index) {
+    auto pair = index / 2;
+    XCTAssertTrue(timeline.add(makeEvent(pair % 8, AUValue(index)), AUAudioFrameCount(pair / 8)));
+  }
+  timeline.finalize();
+  XCTAssertEqual(ParameterTimeline::DefaultCapacity / 2, timeline.size());
+
+  std::vector<AUParameterEvent> events;
+  timeline.endBlock([&](const AUParameterEvent& event) { events.push_back(event); });
+  XCTAssertEqual(ParameterTimeline::DefaultCapacity / 2, events.size());
+  for (size_t index = 0; index < events.size(); ++index) {
+    auto address = index / 32;
+    auto offset = index % 32;
+    XCTAssertEqual(address, events[index].parameterAddress);
+    // The second event of each pair wins.
+    XCTAssertEqual(AUValue(2 * (offset * 8 + address) + 1), events[index].value);
+  }
+}
+
+- (void)testCapacity {
+  ParameterTimeline timeline;
+  timeline.reserve(2);
+  timeline.beginBlock();
+  XCTAssertTrue(timeline.add(makeEvent(0, 1.0), 0));
+  XCTAssertTrue(timeline.add(makeEvent(0, 1.0), 1));
+  XCTAssertFalse(timeline.add(makeEvent(0, 1.0), 2));
+  timeline.beginBlock();
+  XCTAssertTrue(timeline.empty());
+}
+
+- (void)testRenderCurve {
+  ParameterTimeline timeline;
+  timeline.reserve(8);
+  timeline.beginBlock();
+  timeline.add(makeEvent(0, 1.0), 4);
+  timeline.add(makeEvent(0, 0.0, 4), 8);
+  timeline.add(makeEvent(7, 9.0), 0);
+  timeline.finalize();
+
+  Parameters::RampingParameter<float> param{0.5};
+  std::array<float, 16> curve;
+  timeline.render(0, param, curve.data(), 16);
+  std::array<float, 16> expected{0.5, 0.5, 0.5, 0.5, 1.0, 1.0, 1.0, 1.0, 0.75, 0.5, 0.25, 0.0, 0.0, 0.0, 0.0, 0.0};
+  for (size_t index = 0; index < curve.size(); ++index) {
+    XCTAssertEqual(expected[index], curve[index]);
+  }
+
+  // Parameter 7 was not rendered so its event is still pending
+  std::vector<AUParameterAddress> pending;
+  timeline.endBlock([&](const AUParameterEvent& event) { pending.push_back(event.parameterAddress); });
+  XCTAssertEqual(1, pending.size());
+  XCTAssertEqual(7, pending[0]);
+}
+
+- (void)testRenderInSegments {
+  ParameterTimeline timeline;
+  timeline.reserve(8);
+  timeline.beginBlock();
+  timeline.add(makeEvent(0, 1.0), 2);
+  timeline.add(makeEvent(0, 2.0), 6);
+  timeline.finalize();
+
+  Parameters::RampingParameter<float> param{0.0};
+  std::array<float, 4> curve;
+  timeline.render(0, param, curve.data(), 4);
+  XCTAssertEqual(0.0, curve[1]);
+  XCTAssertEqual(1.0, curve[2]);
+  timeline.advance(4);
+  timeline.render(0, param, curve.data(), 4);
+  XCTAssertEqual(1.0, curve[1]);
+  XCTAssertEqual(2.0, curve[2]);
+}
+
+- (void)testEventProcessorSplitsOnlyForMIDI {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+
+  std::vector<AURenderEvent> events;
+  makeAutomation(events, 100, maxFrames);
+
+  GainKernel standard;
+  standard.setRenderingFormat(1, format, maxFrames);
+  standard.processAndRender(&timestamp, maxFrames, 0, [buffer mutableAudioBufferList], events.data(), nil);
+  XCTAssertEqual(100, standard.renderCalls_);
+  std::vector<AUValue> expected(static_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[0].mData),
+                                static_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[0].mData) + maxFrames);
+
+  GainKernel timeline;
+  timeline.setRenderingFormat(1, format, maxFrames);
+  timeline.setParameterTimelineEnabled(true);
+  XCTAssertTrue(timeline.isParameterTimelineEnabled());
+  timeline.processAndRender(&timestamp, maxFrames, 0, [buffer mutableAudioBufferList], events.data(), nil);
+  XCTAssertEqual(1, timeline.renderCalls_);
+
+  auto samples = static_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[0].mData);
+  for (size_t frame = 0; frame < maxFrames; ++frame) {
+    XCTAssertEqualWithAccuracy(expected[frame], samples[frame], 1.0e-6);
+  }
+}
+
+- (void)testMIDIAfterBlockDelivered {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+
+  std::vector<AURenderEvent> events(2);
+  events[0].MIDI.eventType = AURenderEventMIDI;
+  events[0].MIDI.eventSampleTime = 100;
+  events[0].MIDI.next = &events[1];
+  events[1].MIDI.eventType = AURenderEventMIDI;
+  events[1].MIDI.eventSampleTime = 1'000;
+
+  GainKernel kernel;
+  kernel.setRenderingFormat(1, format, maxFrames);
+  kernel.setParameterTimelineEnabled(true);
+  kernel.processAndRender(&timestamp, maxFrames, 0, [buffer mutableAudioBufferList], events.data(), nil);
+  XCTAssertEqual(2, kernel.renderCalls_);
+  XCTAssertEqual(2, kernel.midiEvents_);
+}
+
+- (void)testStandardPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  [self measureBlock:^{
+    std::vector<AURenderEvent> events;
+    makeAutomation(events, 100, maxFrames);
+    GainKernel kernel;
+    kernel.setRenderingFormat(1, format, maxFrames);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    for (int iteration = 0; iteration < 2'000; ++iteration) {
+      kernel.processAndRender(&timestamp, maxFrames, 0, [buffer mutableAudioBufferList], events.data(), nil);
+    }
+  }];
+}
+
+- (void)testTimelinePerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  [self measureBlock:^{
+    std::vector<AURenderEvent> events;
+    makeAutomation(events, 100, maxFrames);
+    GainKernel kernel;
+    kernel.setRenderingFormat(1, format, maxFrames);
+    kernel.setParameterTimelineEnabled(true);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    for (int iteration = 0; iteration < 2'000; ++iteration) {
+      kernel.processAndRender(&timestamp, maxFrames, 0, [buffer mutableAudioBufferList], events.data(), nil);
+    }
+  }];
+}
+
+@end
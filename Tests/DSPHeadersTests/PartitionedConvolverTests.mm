@@ -0,0 +1,354 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <random>
+#import <vector>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/FFT.hpp"
+#import "DSPHeaders/PartitionedConvolver.hpp"
+#import "Pirkle/fxobjects.h"
+
+using namespace DSPHeaders;
+
+/**
+ Make an impulse response of noise with an exponential decay, like a small room.
+ */
+static std::vector<AUValue> makeImpulseResponse(size_t length, unsigned seed = 1) {
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<AUValue> noise{-1.0, 1.0};
+  std::vector<AUValue> taps(length);
+  for (size_t index = 0; index < length; ++index) {
+    taps[index] = noise(generator) * AUValue(std::exp(-5.0 * double(index) / double(length)));
+  }
+  return taps;
+}
+
+static std::vector<AUValue> makeNoise(size_t length, unsigned seed = 2) {
+  std::mt19937 generator{seed};
+  std::uniform_real_distribution<AUValue> noise{-0.5, 0.5};
+  std::vector<AUValue> samples(length);
+  for (auto& sample : samples) sample = noise(generator);
+  return samples;
+}
+
+/**
+ Straight time-domain convolution in double precision.
+ */
+static std::vector<double> convolve(const std::vector<AUValue>& input, const std::vector<AUValue>& taps) {
+  std::vector<double> output(input.size(), 0.0);
+  for (size_t frame = 0; frame < input.size(); ++frame) {
+    double sum = 0.0;
+    for (size_t tap = 0; tap < taps.size() && tap <= frame; ++tap) {
+      sum += double(taps[tap]) * double(input[frame - tap]);
+    }
+    output[frame] = sum;
+  }
+  return output;
+}
+
+/**
+ Run samples through a convolver in blocks of varying size.
+ */
+static std::vector<AUValue> run(PartitionedConvolver& convolver, const std::vector<AUValue>& input) {
+  static const AUAudioFrameCount blockSizes[] = {37, 512, 1, 100, 64, 333};
+  std::vector<AUValue> output(input.size());
+  size_t frame = 0;
+  for (size_t block = 0; frame < input.size(); ++block) {
+    auto count = std::min(size_t(blockSizes[block % 6]), input.size() - frame);
+    convolver.process(input.data() + frame, output.data() + frame, AUAudioFrameCount(count));
+    frame += count;
+  }
+  return output;
+}
+
+/**
+ Convolution reverb kernel with one convolver per channel.
+ */
+struct ConvolutionEffect : public EventProcessor<ConvolutionEffect>
+{
+  explicit ConvolutionEffect(const std::vector<AUValue>& taps) : EventProcessor<ConvolutionEffect>(), taps_{taps} {}
+
+  void setRenderingFormat(NSInteger busCount, AVAudioFormat* format, AUAudioFrameCount maxFramesToRender) {
+    EventProcessor<ConvolutionEffect>::setRenderingFormat(busCount, format, maxFramesToRender);
+    convolvers_.resize([format channelCount]);
+    for (auto& convolver : convolvers_) convolver.setImpulseResponse(taps_.data(), taps_.size());
+  }
+
+  AUAudioFrameCount tailLength() const { return AUAudioFrameCount(taps_.size()); }
+
+  void setParameterFromEvent(const AUParameterEvent&) {}
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      convolvers_[channel].process(ins[channel], outs[channel], frameCount);
+    }
+  }
+
+  std::vector<AUValue> taps_;
+  std::vector<PartitionedConvolver> convolvers_{};
+};
+
+/**
+ Make a pull-input block that generates a unit impulse at the first frame followed by silence.
+ */
+static AURenderPullInputBlock makeImpulseInput(AUAudioFrameCount* position) {
+  return ^(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+           AUAudioFrameCount frameCount, NSInteger inputBusNumber, AudioBufferList *inputData) {
+    for (UInt32 index = 0; index < inputData->mNumberBuffers; ++index) {
+      auto ptr = reinterpret_cast<AUValue*>(inputData->mBuffers[index].mData);
+      for (UInt32 pos = 0; pos < frameCount; ++pos) {
+        ptr[pos] = *position + pos == 0 ? 1.0 : 0.0;
+      }
+    }
+    *position += frameCount;
+    return AUAudioUnitStatus(0);
+  };
+}
+
+static void measureConvolver(size_t irLength, const PartitionedConvolver::Options& options) {
+  auto taps = makeImpulseResponse(irLength);
+  auto input = makeNoise(48'000);
+  std::vector<AUValue> output(input.size());
+  PartitionedConvolver convolver{options};
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  for (size_t frame = 0; frame < input.size(); frame += 480) {
+    convolver.process(input.data() + frame, output.data() + frame, 480);
+  }
+}
+
+@interface PartitionedConvolverTests : XCTestCase
+
+@end
+
+@implementation PartitionedConvolverTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testFFTSize {
+  XCTAssertThrows(RealFFT(2));
+  XCTAssertThrows(RealFFT(24));
+  RealFFT fft{16};
+  XCTAssertEqual(16, fft.size());
+  XCTAssertEqual(9, fft.binCount());
+}
+
+- (void)testFFTMatchesDFT {
+  // Sizes with and without a final radix-2 pass
+  for (size_t size : {4, 8, 16, 32, 64, 128}) {
+    auto input = makeNoise(size);
+    RealFFT fft{size};
+    std::vector<AUValue> re(fft.binCount());
+    std::vector<AUValue> im(fft.binCount());
+    fft.forward(input.data(), re.data(), im.data());
+    for (size_t bin = 0; bin < fft.binCount(); ++bin) {
+      double sumRe = 0.0;
+      double sumIm = 0.0;
+      for (size_t index = 0; index < size; ++index) {
+        auto theta = 2.0 * M_PI * double(bin * index) / double(size);
+        sumRe += input[index] * std::cos(theta);
+        sumIm -= input[index] * std::sin(theta);
+      }
+      XCTAssertEqualWithAccuracy(sumRe, re[bin], 1.0e-4);
+      XCTAssertEqualWithAccuracy(sumIm, im[bin], 1.0e-4);
+    }
+  }
+}
+
+- (void)testFFTRoundTrip {
+  for (size_t size = 4; size <= 8192; size *= 2) {
+    auto input = makeNoise(size);
+    RealFFT fft{size};
+    std::vector<AUValue> re(fft.binCount());
+    std::vector<AUValue> im(fft.binCount());
+    std::vector<AUValue> output(size);
+    fft.forward(input.data(), re.data(), im.data());
+    fft.inverse(re.data(), im.data(), output.data());
+    for (size_t index = 0; index < size; ++index) {
+      XCTAssertEqualWithAccuracy(input[index], output[index], 1.0e-5);
+    }
+  }
+}
+
+- (void)testPartitioning {
+  auto taps = makeImpulseResponse(5'000);
+  PartitionedConvolver uniform{{64, 64}};
+  uniform.setImpulseResponse(taps.data(), taps.size());
+  XCTAssertEqual(5'000, uniform.length());
+  XCTAssertEqual(1, uniform.stageCount());
+  XCTAssertEqual(64, uniform.stageBlockSize(0));
+  XCTAssertEqual(78, uniform.stagePartitionCount(0));
+
+  // Head covers [0, 64), then 64 x 3, 256 x 3, 1024 x 1, and 2048 x 2 for the rest.
+  PartitionedConvolver nonUniform{{64, 2048}};
+  nonUniform.setImpulseResponse(taps.data(), taps.size());
+  XCTAssertEqual(4, nonUniform.stageCount());
+  XCTAssertEqual(64, nonUniform.stageBlockSize(0));
+  XCTAssertEqual(3, nonUniform.stagePartitionCount(0));
+  XCTAssertEqual(256, nonUniform.stageBlockSize(1));
+  XCTAssertEqual(3, nonUniform.stagePartitionCount(1));
+  XCTAssertEqual(1024, nonUniform.stageBlockSize(2));
+  XCTAssertEqual(1, nonUniform.stagePartitionCount(2));
+  XCTAssertEqual(2048, nonUniform.stageBlockSize(3));
+  XCTAssertEqual(2, nonUniform.stagePartitionCount(3));
+
+  PartitionedConvolver headOnly;
+  headOnly.setImpulseResponse(taps.data(), 10);
+  XCTAssertEqual(0, headOnly.stageCount());
+
+  PartitionedConvolver invalid{{48, 1024}};
+  XCTAssertThrows(invalid.setImpulseResponse(taps.data(), taps.size()));
+}
+
+- (void)testZeroLatency {
+  auto taps = makeImpulseResponse(1'000);
+  PartitionedConvolver convolver{{32, 256}};
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  std::vector<AUValue> input(1'500, 0.0);
+  input[0] = 1.0;
+  auto output = run(convolver, input);
+  for (size_t frame = 0; frame < output.size(); ++frame) {
+    XCTAssertEqualWithAccuracy(frame < taps.size() ? taps[frame] : 0.0, output[frame], 1.0e-5);
+  }
+}
+
+- (void)testHeadOnly {
+  auto taps = makeImpulseResponse(20);
+  auto input = makeNoise(300);
+  PartitionedConvolver convolver;
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  auto output = run(convolver, input);
+  auto expected = convolve(input, taps);
+  for (size_t frame = 0; frame < output.size(); ++frame) {
+    XCTAssertEqualWithAccuracy(expected[frame], output[frame], 1.0e-5);
+  }
+}
+
+// Compare against Will Pirkle's time-domain convolver
+- (void)testUniformMatchesPirkle {
+  auto taps = makeImpulseResponse(1'024);
+  auto input = makeNoise(8'000);
+
+  std::vector<double> pirkleTaps(taps.begin(), taps.end());
+  Pirkle::ImpulseConvolver pirkle;
+  pirkle.setImpulseResponse(pirkleTaps.data(), (unsigned int)pirkleTaps.size());
+
+  PartitionedConvolver convolver{{64, 64}};
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  auto output = run(convolver, input);
+  for (size_t frame = 0; frame < input.size(); ++frame) {
+    XCTAssertEqualWithAccuracy(pirkle.processAudioSample(input[frame]), output[frame], 1.0e-4);
+  }
+}
+
+- (void)testNonUniformMatchesPirkle {
+  auto taps = makeImpulseResponse(4'096);
+  auto input = makeNoise(20'000);
+
+  std::vector<double> pirkleTaps(taps.begin(), taps.end());
+  Pirkle::ImpulseConvolver pirkle;
+  pirkle.setImpulseResponse(pirkleTaps.data(), (unsigned int)pirkleTaps.size());
+
+  PartitionedConvolver convolver{{32, 1024}};
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  auto output = run(convolver, input);
+  for (size_t frame = 0; frame < input.size(); ++frame) {
+    XCTAssertEqualWithAccuracy(pirkle.processAudioSample(input[frame]), output[frame], 1.0e-4);
+  }
+}
+
+- (void)testOddLengthInPlace {
+  auto taps = makeImpulseResponse(3'001);
+  auto input = makeNoise(10'000);
+  auto expected = convolve(input, taps);
+
+  PartitionedConvolver convolver{{16, 512}};
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  auto samples = input;
+  for (size_t frame = 0; frame < samples.size(); frame += 250) {
+    convolver.process(samples.data() + frame, samples.data() + frame, 250);
+  }
+  for (size_t frame = 0; frame < samples.size(); ++frame) {
+    XCTAssertEqualWithAccuracy(expected[frame], samples[frame], 1.0e-4);
+  }
+}
+
+- (void)testReset {
+  auto taps = makeImpulseResponse(2'000);
+  auto input = makeNoise(3'000);
+  PartitionedConvolver convolver{{64, 1024}};
+  convolver.setImpulseResponse(taps.data(), taps.size());
+  auto first = run(convolver, input);
+  convolver.reset();
+  auto second = run(convolver, input);
+  for (size_t frame = 0; frame < input.size(); ++frame) {
+    XCTAssertEqual(first[frame], second[frame]);
+  }
+}
+
+- (void)testProcessBeforeImpulseResponse {
+  auto input = makeNoise(300);
+  PartitionedConvolver convolver;
+  auto output = run(convolver, input);
+  for (size_t frame = 0; frame < input.size(); ++frame) {
+    XCTAssertEqual(0.0f, output[frame]);
+  }
+
+  convolver.reset();
+  auto samples = input;
+  convolver.process(samples.data(), samples.data(), AUAudioFrameCount(samples.size()));
+  for (size_t frame = 0; frame < samples.size(); ++frame) {
+    XCTAssertEqual(0.0f, samples[frame]);
+  }
+}
+
+- (void)testKernel {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount frames = 512;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:frames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  auto taps = makeImpulseResponse(1'200);
+
+  ConvolutionEffect effect{taps};
+  effect.setRenderingFormat(1, format, frames);
+  AUAudioFrameCount position = 0;
+  auto pullInput = makeImpulseInput(&position);
+  for (size_t block = 0; block < 3; ++block) {
+    effect.processAndRender(&timestamp, frames, 0, [buffer mutableAudioBufferList], nil, pullInput);
+    auto left = static_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[0].mData);
+    auto right = static_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[1].mData);
+    for (size_t frame = 0; frame < frames; ++frame) {
+      auto index = block * frames + frame;
+      AUValue expected = index < taps.size() ? taps[index] : 0.0;
+      XCTAssertEqualWithAccuracy(expected, left[frame], 1.0e-5);
+      XCTAssertEqualWithAccuracy(expected, right[frame], 1.0e-5);
+    }
+  }
+}
+
+- (void)testOneSecondUniformPerformance {
+  [self measureBlock:^{
+    measureConvolver(48'000, {64, 64});
+  }];
+}
+
+- (void)testOneSecondNonUniformPerformance {
+  [self measureBlock:^{
+    measureConvolver(48'000, {64, 4096});
+  }];
+}
+
+- (void)testFiveSecondNonUniformPerformance {
+  [self measureBlock:^{
+    measureConvolver(240'000, {64, 8192});
+  }];
+}
+
+@end
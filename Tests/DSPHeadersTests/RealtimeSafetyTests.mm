@@ -0,0 +1,316 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <atomic>
+#import <cstdlib>
+#import <mutex>
+#import <thread>
+#import <vector>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/RealtimeSafety.hpp"
+
+using namespace DSPHeaders;
+
+// Report every C allocation and lock in the test bundle to `RealtimeSafety`. See the header for what is covered on
+// each platform.
+#import "DSPHeaders/RealtimeSafetyInterposers.hpp"
+
+static XCTestCase* currentTestCase = nil;
+static std::atomic<bool> violationRecorded{false};
+
+static NSString* describe(RealtimeSafety::Violation violation) {
+  switch (violation) {
+    case RealtimeSafety::Violation::allocation: return @"allocation";
+    case RealtimeSafety::Violation::deallocation: return @"deallocation";
+    case RealtimeSafety::Violation::lock: return @"lock";
+  }
+  return @"unknown";
+}
+
+/**
+ Fail the running test on its first violation.
+ */
+static void failCurrentTest(RealtimeSafety::Violation violation) {
+  if (violationRecorded.exchange(true)) return;
+  XCTestCase* testCase = currentTestCase;
+  if (testCase == nil) return;
+  NSString* description = [NSString stringWithFormat:@"RealtimeSafety: %@ while rendering", describe(violation)];
+  [testCase recordIssue:[[XCTIssue alloc] initWithType:XCTIssueTypeAssertionFailure compactDescription:description]];
+}
+
+/**
+ Installs `failCurrentTest` as the `RealtimeSafety` handler around every test case in the bundle, so that any test that
+ renders also checks that rendering does not allocate or lock.
+ */
+@interface RealtimeSafetyObserver : NSObject <XCTestObservation>
+
+@end
+
+@implementation RealtimeSafetyObserver
+
++ (void)load {
+  [[XCTestObservationCenter sharedTestObservationCenter] addTestObserver:[RealtimeSafetyObserver new]];
+}
+
+- (void)testCaseWillStart:(XCTestCase *)testCase {
+  currentTestCase = testCase;
+  violationRecorded = false;
+  RealtimeSafety::resetCounts();
+  RealtimeSafety::setHandler(failCurrentTest);
+}
+
+- (void)testCaseDidFinish:(XCTestCase *)testCase {
+  RealtimeSafety::setHandler(nullptr);
+  currentTestCase = nil;
+}
+
+@end
+
+/**
+ Replaces the handler for the lifetime of the instance, for tests that make violations on purpose.
+ */
+struct ExpectViolations {
+  explicit ExpectViolations(RealtimeSafety::Handler handler = nullptr) :
+  previous_{RealtimeSafety::setHandler(handler)} {}
+  ~ExpectViolations() { RealtimeSafety::setHandler(previous_); }
+  RealtimeSafety::Handler previous_;
+};
+
+/**
+ Mutex that reports a lock violation before locking, since `pthread_mutex_lock` is not interposed in a test bundle on
+ Apple platforms.
+ */
+struct CheckedMutex {
+  void lock() { RealtimeSafety::note(RealtimeSafety::Violation::lock); mutex_.lock(); }
+  void unlock() { mutex_.unlock(); }
+  std::mutex mutex_;
+};
+
+/// Keep allocations from being optimized away.
+static std::vector<int>* sink = nullptr;
+static void* volatile rawSink = nullptr;
+
+/**
+ Effect that does whatever unsafe operations it is told to do while rendering.
+ */
+struct UnsafeEffect : public EventProcessor<UnsafeEffect>
+{
+  UnsafeEffect() : EventProcessor<UnsafeEffect>() {}
+  void setParameterFromEvent(const AUParameterEvent&) {}
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers ins, BusBuffers outs, AUAudioFrameCount frameCount) {
+    if (allocate_) {
+      sink = new std::vector<int>(frameCount);
+      delete sink;
+      sink = nullptr;
+    }
+    if (lock_) {
+      std::lock_guard<CheckedMutex> guard(mutex_);
+    }
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        outs[channel][frame] = ins[channel][frame] * 0.5f;
+      }
+    }
+  }
+  bool allocate_{false};
+  bool lock_{false};
+  CheckedMutex mutex_;
+};
+
+static int handlerCalls = 0;
+
+static void countingHandler(RealtimeSafety::Violation) { ++handlerCalls; }
+
+/**
+ Render a few cycles with events, chunking, and a pull block while the thread is marked as rendering. Every other cycle
+ uses the parameter timeline.
+ */
+static void renderCycles(UnsafeEffect& effect) {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  effect.setRenderingFormat(1, format, 512);
+  effect.setRenderChunkSize(64);
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:512];
+  AUAudioUnitStatus (^pullInput)(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+                                 AUAudioFrameCount frameCount, NSInteger inputBusNumber,
+                                 AudioBufferList *inputData);
+  pullInput = ^(AudioUnitRenderActionFlags *actionFlags, const AudioTimeStamp *timestamp,
+                AUAudioFrameCount frameCount, NSInteger inputBusNumber, AudioBufferList *inputData) {
+    for (UInt32 index = 0; index < inputData->mNumberBuffers; ++index) {
+      auto ptr = reinterpret_cast<AUValue*>(inputData->mBuffers[index].mData);
+      for (UInt32 pos = 0; pos < frameCount; ++pos) ptr[pos] = 1.0;
+    }
+    return 0;
+  };
+
+  std::vector<AURenderEvent> events(4);
+  for (size_t index = 0; index < events.size(); ++index) {
+    events[index].parameter.eventType = AURenderEventParameter;
+    events[index].parameter.eventSampleTime = AUEventSampleTime(index * 100);
+    events[index].parameter.next = index + 1 < events.size() ? &events[index + 1] : nullptr;
+  }
+
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  RealtimeSafety::resetCounts();
+  for (int cycle = 0; cycle < 4; ++cycle) {
+    effect.setParameterTimelineEnabled(cycle % 2 == 1);
+    RealtimeSafety::Scope scope;
+    effect.processAndRender(&timestamp, 512, 0, [buffer mutableAudioBufferList], events.data(), pullInput);
+  }
+}
+
+@interface RealtimeSafetyTests : XCTestCase
+
+@end
+
+@implementation RealtimeSafetyTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testScope {
+  XCTAssertFalse(RealtimeSafety::isRendering());
+  {
+    RealtimeSafety::Scope outer;
+    XCTAssertTrue(RealtimeSafety::isRendering());
+    {
+      RealtimeSafety::Scope inner;
+      XCTAssertTrue(RealtimeSafety::isRendering());
+    }
+    XCTAssertTrue(RealtimeSafety::isRendering());
+
+    // Other threads are not affected. Starting one allocates, which is not what is being checked here.
+    bool otherRendering = true;
+    {
+      RealtimeSafety::Suspend suspend;
+      std::thread other([&]() { otherRendering = RealtimeSafety::isRendering(); });
+      other.join();
+    }
+    XCTAssertFalse(otherRendering);
+  }
+  XCTAssertFalse(RealtimeSafety::isRendering());
+}
+
+- (void)testAllocationCounted {
+  ExpectViolations expect;
+  RealtimeSafety::resetCounts();
+  sink = new std::vector<int>(10);
+  delete sink;
+  XCTAssertEqual(0, RealtimeSafety::totalCount());
+  {
+    RealtimeSafety::Scope scope;
+    sink = new std::vector<int>(10);
+    delete sink;
+    sink = nullptr;
+  }
+  XCTAssertEqual(2, RealtimeSafety::count(RealtimeSafety::Violation::allocation));
+  XCTAssertEqual(2, RealtimeSafety::count(RealtimeSafety::Violation::deallocation));
+  XCTAssertEqual(0, RealtimeSafety::count(RealtimeSafety::Violation::lock));
+}
+
+- (void)testMallocCounted {
+  ExpectViolations expect;
+  RealtimeSafety::resetCounts();
+  {
+    RealtimeSafety::Scope scope;
+    rawSink = std::malloc(16);
+    rawSink = std::realloc(rawSink, 4'096);
+    std::free(rawSink);
+    rawSink = std::calloc(4, 16);
+    std::free(rawSink);
+    rawSink = nullptr;
+  }
+  XCTAssertEqual(3, RealtimeSafety::count(RealtimeSafety::Violation::allocation));
+  XCTAssertEqual(2, RealtimeSafety::count(RealtimeSafety::Violation::deallocation));
+}
+
+- (void)testAlignedAllocationCounted {
+  ExpectViolations expect;
+  RealtimeSafety::resetCounts();
+  {
+    RealtimeSafety::Scope scope;
+    void* aligned = nullptr;
+    XCTAssertEqual(0, posix_memalign(&aligned, 64, 256));
+    rawSink = aligned;
+    std::free(rawSink);
+    rawSink = valloc(256);
+    std::free(rawSink);
+    rawSink = nullptr;
+  }
+  XCTAssertEqual(2, RealtimeSafety::count(RealtimeSafety::Violation::allocation));
+  XCTAssertEqual(2, RealtimeSafety::count(RealtimeSafety::Violation::deallocation));
+}
+
+- (void)testMutexLockCounted {
+  ExpectViolations expect;
+  RealtimeSafety::resetCounts();
+  std::mutex mutex;
+  {
+    RealtimeSafety::Scope scope;
+    std::lock_guard<std::mutex> guard(mutex);
+  }
+  if (RealtimeSafety::count(RealtimeSafety::Violation::lock) == 0) {
+    XCTSkip(@"pthread_mutex_lock is only interposed when the library is loaded at launch");
+  }
+  XCTAssertEqual(1, RealtimeSafety::count(RealtimeSafety::Violation::lock));
+}
+
+- (void)testSuspend {
+  RealtimeSafety::resetCounts();
+  RealtimeSafety::Scope scope;
+  {
+    RealtimeSafety::Suspend suspend;
+    XCTAssertFalse(RealtimeSafety::isRendering());
+    sink = new std::vector<int>(10);
+    delete sink;
+    sink = nullptr;
+  }
+  XCTAssertTrue(RealtimeSafety::isRendering());
+  XCTAssertEqual(0, RealtimeSafety::totalCount());
+}
+
+- (void)testHandler {
+  handlerCalls = 0;
+  RealtimeSafety::resetCounts();
+  {
+    ExpectViolations expect{countingHandler};
+    RealtimeSafety::Scope scope;
+    RealtimeSafety::note(RealtimeSafety::Violation::lock);
+  }
+  XCTAssertEqual(1, handlerCalls);
+  XCTAssertEqual(1, RealtimeSafety::count(RealtimeSafety::Violation::lock));
+}
+
+- (void)testEventProcessorIsSafe {
+  UnsafeEffect effect;
+  renderCycles(effect);
+  XCTAssertEqual(0, RealtimeSafety::totalCount());
+}
+
+- (void)testEventProcessorReportsAllocation {
+  ExpectViolations expect;
+  UnsafeEffect effect;
+  effect.allocate_ = true;
+  renderCycles(effect);
+  XCTAssertTrue(RealtimeSafety::count(RealtimeSafety::Violation::allocation) > 0);
+  XCTAssertEqual(RealtimeSafety::count(RealtimeSafety::Violation::allocation),
+                 RealtimeSafety::count(RealtimeSafety::Violation::deallocation));
+  XCTAssertEqual(0, RealtimeSafety::count(RealtimeSafety::Violation::lock));
+}
+
+- (void)testEventProcessorReportsLock {
+  ExpectViolations expect;
+  UnsafeEffect effect;
+  effect.lock_ = true;
+  renderCycles(effect);
+  XCTAssertTrue(RealtimeSafety::count(RealtimeSafety::Violation::lock) > 0);
+  XCTAssertEqual(0, RealtimeSafety::count(RealtimeSafety::Violation::allocation));
+}
+
+@end
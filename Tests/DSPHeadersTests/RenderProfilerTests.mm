@@ -0,0 +1,174 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <thread>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/RenderProfiler.hpp"
+
+using namespace DSPHeaders;
+
+/**
+ Effect that does a fixed amount of work per sample. The profiled version defines `renderProfiler`.
+ */
+template <typename Derived>
+struct WorkingEffect : public EventProcessor<Derived>
+{
+  WorkingEffect() : EventProcessor<Derived>() {}
+  void setParameterFromEvent(const AUParameterEvent&) {}
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers, BusBuffers outs, AUAudioFrameCount frameCount) {
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        state_ = state_ * 0.999f + 0.001f;
+        outs[channel][frame] = std::sin(state_);
+      }
+    }
+  }
+  AUValue state_{0.0};
+};
+
+struct PlainEffect : public WorkingEffect<PlainEffect> {};
+
+struct ProfiledEffect : public WorkingEffect<ProfiledEffect>
+{
+  RenderProfiler& renderProfiler() { return profiler_; }
+  RenderProfiler profiler_{};
+};
+
+static RenderProfiler::Ticks ticksAgo(double nanoseconds) {
+  return RenderProfiler::now() - RenderProfiler::Ticks(nanoseconds / RenderProfiler::nanosecondsPerTick());
+}
+
+@interface RenderProfilerTests : XCTestCase
+
+@end
+
+@implementation RenderProfilerTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testEmpty {
+  RenderProfiler profiler;
+  XCTAssertEqual(0, profiler.collect());
+  auto stats = profiler.statistics(RenderProfiler::Kind::processAndRender);
+  XCTAssertEqual(0, stats.count);
+  XCTAssertEqual(0.0, stats.maxLoad);
+  XCTAssertEqual(0, profiler.droppedCount());
+}
+
+- (void)testClockAdvances {
+  auto start = RenderProfiler::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  XCTAssertTrue(RenderProfiler::now() > start);
+}
+
+- (void)testLoadStatistics {
+  RenderProfiler profiler;
+  profiler.setSampleRate(48000.0);
+  XCTAssertEqual(48000.0, profiler.sampleRate());
+
+  // 480 frames at 48 kHz is a 10 ms budget. Record 98 calls at ~10% load, one at ~50% and one at ~150%
+  for (int index = 0; index < 98; ++index) {
+    profiler.record(RenderProfiler::Kind::processAndRender, ticksAgo(1.0e6), 480);
+  }
+  profiler.record(RenderProfiler::Kind::processAndRender, ticksAgo(5.0e6), 480);
+  profiler.record(RenderProfiler::Kind::processAndRender, ticksAgo(15.0e6), 480);
+  profiler.record(RenderProfiler::Kind::doRendering, ticksAgo(1.0e6), 480);
+  XCTAssertEqual(101, profiler.collect());
+
+  auto stats = profiler.statistics(RenderProfiler::Kind::processAndRender);
+  XCTAssertEqual(100, stats.count);
+  XCTAssertEqual(1, stats.overBudgetCount);
+  XCTAssertEqualWithAccuracy(0.1, stats.p50Load, 0.01);
+  XCTAssertEqualWithAccuracy(0.5, stats.p99Load, 0.01);
+  XCTAssertEqualWithAccuracy(1.5, stats.maxLoad, 0.01);
+  XCTAssertEqualWithAccuracy(15.0e6, stats.maxNanoseconds, 0.1e6);
+  XCTAssertEqualWithAccuracy(1.18e6, stats.meanNanoseconds, 0.05e6);
+
+  XCTAssertEqual(1, profiler.statistics(RenderProfiler::Kind::doRendering).count);
+
+  profiler.reset();
+  XCTAssertEqual(0, profiler.statistics(RenderProfiler::Kind::processAndRender).count);
+}
+
+- (void)testDropped {
+  RenderProfiler profiler{16};
+  for (int index = 0; index < 20; ++index) {
+    profiler.record(RenderProfiler::Kind::doRendering, RenderProfiler::now(), 64);
+  }
+  XCTAssertEqual(16, profiler.collect());
+  XCTAssertEqual(4, profiler.droppedCount());
+  XCTAssertEqual(16, profiler.statistics(RenderProfiler::Kind::doRendering).count);
+}
+
+- (void)testEventProcessorRecords {
+  ProfiledEffect effect;
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:48000.0 channels:2];
+  effect.setRenderingFormat(1, format, 64);
+  XCTAssertEqual(48000.0, effect.profiler_.sampleRate());
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:64];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+
+  AURenderEvent event{};
+  event.parameter.eventType = AURenderEventParameter;
+  event.parameter.eventSampleTime = 32;
+
+  effect.processAndRender(&timestamp, 64, 0, [buffer mutableAudioBufferList], nil, nil);
+  effect.processAndRender(&timestamp, 64, 0, [buffer mutableAudioBufferList], &event, nil);
+  XCTAssertEqual(5, effect.profiler_.collect());
+  XCTAssertEqual(2, effect.profiler_.statistics(RenderProfiler::Kind::processAndRender).count);
+  XCTAssertEqual(3, effect.profiler_.statistics(RenderProfiler::Kind::doRendering).count);
+}
+
+- (void)testConcurrentCollect {
+  RenderProfiler profiler{256};
+  std::atomic<bool> done{false};
+  size_t collected = 0;
+  std::thread reader([&]() {
+    while (!done.load()) collected += profiler.collect();
+    collected += profiler.collect();
+  });
+  for (int index = 0; index < 100'000; ++index) {
+    profiler.record(RenderProfiler::Kind::processAndRender, RenderProfiler::now(), 64);
+  }
+  done.store(true);
+  reader.join();
+  XCTAssertEqual(100'000, collected + profiler.droppedCount());
+  XCTAssertEqual(collected, profiler.statistics(RenderProfiler::Kind::processAndRender).count);
+}
+
+- (void)testPlainRenderPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:48000.0 channels:2];
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:64];
+  [self measureBlock:^{
+    PlainEffect effect;
+    effect.setRenderingFormat(1, format, 64);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    for (int iteration = 0; iteration < 50'000; ++iteration) {
+      effect.processAndRender(&timestamp, 64, 0, [buffer mutableAudioBufferList], nil, nil);
+    }
+  }];
+}
+
+- (void)testProfiledRenderPerformance {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:48000.0 channels:2];
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:64];
+  [self measureBlock:^{
+    ProfiledEffect effect;
+    effect.setRenderingFormat(1, format, 64);
+    AudioTimeStamp timestamp = AudioTimeStamp();
+    for (int iteration = 0; iteration < 50'000; ++iteration) {
+      effect.processAndRender(&timestamp, 64, 0, [buffer mutableAudioBufferList], nil, nil);
+      if (iteration % 1'000 == 0) effect.profiler_.collect();
+    }
+  }];
+}
+
+@end
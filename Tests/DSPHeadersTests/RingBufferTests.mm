@@ -0,0 +1,229 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <atomic>
+#import <thread>
+#import <vector>
+
+#import "DSPHeaders/BusBuffers.hpp"
+#import "DSPHeaders/RingBuffer.hpp"
+
+using namespace DSPHeaders;
+
+using Ring = RingBuffer<AUValue>;
+
+/**
+ Fill channels with a running count starting at `start`, with each channel offset by 0.25 from the one before it.
+ Values stay exact as long as the count is below 2^22.
+ */
+static void fillCount(std::vector<std::vector<AUValue>>& channels, size_t start, size_t frameCount) {
+  for (size_t channel = 0; channel < channels.size(); ++channel) {
+    for (size_t frame = 0; frame < frameCount; ++frame) {
+      channels[channel][frame] = AUValue((start + frame) % 4'000'000) + 0.25f * channel;
+    }
+  }
+}
+
+static std::vector<AUValue*> pointers(std::vector<std::vector<AUValue>>& channels) {
+  std::vector<AUValue*> result;
+  for (auto& channel : channels) result.push_back(channel.data());
+  return result;
+}
+
+/**
+ Run a producer pushing a running count in blocks of 1 to 512 frames against a consumer popping in blocks of 1 to
+ 1000 frames, checking that every pop holds whole frames in order.
+
+ @returns the number of frames popped, or 0 if a pop was out of order
+ */
+static size_t stress(Ring& ring, size_t total) {
+  auto channelCount = ring.channelCount();
+  std::atomic<bool> done{false};
+  size_t popped = 0;
+  bool ordered = true;
+  std::thread consumer([&]() {
+    std::vector<std::vector<AUValue>> channels(channelCount, std::vector<AUValue>(1'000));
+    auto outs = pointers(channels);
+    size_t expected = 0;
+    size_t count = 1;
+    while (true) {
+      auto finished = done.load(std::memory_order_acquire);
+      auto frameCount = ring.pop(outs, count);
+      if (frameCount > 0) {
+        auto first = size_t(channels[0][0]);
+        // Overwritten frames may be skipped but never repeated or reordered.
+        ordered = ordered && (first == expected % 4'000'000 || ring.droppedCount() > 0);
+        for (size_t channel = 0; channel < channelCount; ++channel) {
+          for (size_t frame = 0; frame < frameCount; ++frame) {
+            ordered = ordered && channels[channel][frame] == AUValue((first + frame) % 4'000'000) + 0.25f * channel;
+          }
+        }
+        expected = first + frameCount;
+        popped += frameCount;
+      } else if (finished) {
+        break;
+      } else {
+        std::this_thread::yield();
+      }
+      count = count * 13 % 997 + 1;
+    }
+  });
+
+  std::vector<std::vector<AUValue>> channels(channelCount, std::vector<AUValue>(512));
+  auto ins = pointers(channels);
+  size_t pushed = 0;
+  size_t count = 1;
+  while (pushed < total) {
+    auto frameCount = std::min(count, total - pushed);
+    fillCount(channels, pushed, frameCount);
+    // Retry until everything is in, moving the pointers along past what was taken.
+    size_t offset = 0;
+    while (offset < frameCount) {
+      std::vector<AUValue*> remaining;
+      for (auto* pointer : ins) remaining.push_back(pointer + offset);
+      auto taken = ring.push(remaining, frameCount - offset);
+      if (taken == 0) std::this_thread::yield();
+      offset += taken;
+    }
+    pushed += frameCount;
+    count = count * 7 % 509 + 1;
+  }
+  done.store(true, std::memory_order_release);
+  consumer.join();
+  return ordered ? popped : 0;
+}
+
+@interface RingBufferTests : XCTestCase
+
+@end
+
+@implementation RingBufferTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testCapacityIsPowerOf2 {
+  XCTAssertEqual(1, Ring(1, 0).capacity());
+  XCTAssertEqual(1'024, Ring(1, 1'000).capacity());
+  XCTAssertEqual(1'024, Ring(2, 1'024).capacity());
+  XCTAssertEqual(2, Ring(2, 1'024).channelCount());
+}
+
+- (void)testPushAndPopAcrossWrap {
+  Ring ring{2, 8};
+  std::vector<std::vector<AUValue>> ins(2, std::vector<AUValue>(6));
+  std::vector<std::vector<AUValue>> outs(2, std::vector<AUValue>(6));
+  BusBuffers inBus{pointers(ins)};
+  BusBuffers outBus{pointers(outs)};
+  for (size_t start = 0; start < 30; start += 6) {
+    fillCount(ins, start, 6);
+    XCTAssertEqual(6, ring.push(inBus, 6));
+    XCTAssertEqual(6, ring.available());
+    XCTAssertEqual(4, ring.pop(outBus, 4));
+    XCTAssertEqual(2, ring.available());
+    for (size_t frame = 0; frame < 4; ++frame) {
+      XCTAssertEqual(AUValue(start + frame), outs[0][frame]);
+      XCTAssertEqual(AUValue(start + frame) + 0.25f, outs[1][frame]);
+    }
+    XCTAssertEqual(2, ring.pop(outBus, 6));
+    XCTAssertEqual(AUValue(start + 4), outs[0][0]);
+    XCTAssertEqual(AUValue(start + 5) + 0.25f, outs[1][1]);
+    XCTAssertEqual(0, ring.pop(outBus, 6));
+  }
+  XCTAssertEqual(0, ring.droppedCount());
+}
+
+- (void)testDropNewestWhenFull {
+  Ring ring{1, 8};
+  std::vector<std::vector<AUValue>> ins(1, std::vector<AUValue>(6));
+  std::vector<std::vector<AUValue>> outs(1, std::vector<AUValue>(8));
+  fillCount(ins, 0, 6);
+  XCTAssertEqual(6, ring.push(pointers(ins), 6));
+  fillCount(ins, 6, 6);
+  XCTAssertEqual(2, ring.push(pointers(ins), 6));
+  XCTAssertEqual(0, ring.push(pointers(ins), 6));
+  XCTAssertEqual(8, ring.pop(pointers(outs), 8));
+  for (size_t frame = 0; frame < 8; ++frame) XCTAssertEqual(AUValue(frame), outs[0][frame]);
+  XCTAssertEqual(0, ring.droppedCount());
+}
+
+- (void)testOverwriteOldestWhenFull {
+  Ring ring{1, 8, Ring::Overflow::overwriteOldest};
+  std::vector<std::vector<AUValue>> ins(1, std::vector<AUValue>(20));
+  std::vector<std::vector<AUValue>> outs(1, std::vector<AUValue>(8));
+  fillCount(ins, 0, 6);
+  XCTAssertEqual(6, ring.push(pointers(ins), 6));
+  fillCount(ins, 6, 6);
+  XCTAssertEqual(6, ring.push(pointers(ins), 6));
+  XCTAssertEqual(8, ring.available());
+  XCTAssertEqual(8, ring.pop(pointers(outs), 8));
+  for (size_t frame = 0; frame < 8; ++frame) XCTAssertEqual(AUValue(frame + 4), outs[0][frame]);
+  XCTAssertEqual(4, ring.droppedCount());
+
+  // A push larger than the capacity only keeps its last frames.
+  fillCount(ins, 12, 20);
+  XCTAssertEqual(20, ring.push(pointers(ins), 20));
+  XCTAssertEqual(8, ring.pop(pointers(outs), 8));
+  for (size_t frame = 0; frame < 8; ++frame) XCTAssertEqual(AUValue(frame + 24), outs[0][frame]);
+  XCTAssertEqual(16, ring.droppedCount());
+}
+
+- (void)testChannelCountMismatch {
+  Ring ring{2, 8};
+  std::vector<std::vector<AUValue>> ins(1, std::vector<AUValue>(4, 1.0));
+  std::vector<std::vector<AUValue>> outs(3, std::vector<AUValue>(4, -1.0));
+  XCTAssertEqual(4, ring.push(pointers(ins), 4));
+  XCTAssertEqual(4, ring.pop(pointers(outs), 4));
+  XCTAssertEqual(1.0, outs[0][3]);
+  XCTAssertEqual(0.0, outs[1][3]);
+  XCTAssertEqual(-1.0, outs[2][3]);
+}
+
+// Run both modes under ThreadSanitizer to check the memory ordering.
+- (void)testDropNewestStress {
+  Ring ring{2, 1'024};
+  XCTAssertEqual(1'000'000, stress(ring, 1'000'000));
+  XCTAssertEqual(0, ring.droppedCount());
+}
+
+- (void)testOverwriteOldestStress {
+  Ring ring{2, 1'024, Ring::Overflow::overwriteOldest};
+  auto popped = stress(ring, 1'000'000);
+  XCTAssertGreaterThan(popped, 0);
+  XCTAssertEqual(1'000'000, popped + ring.droppedCount());
+}
+
+// Moving 10 seconds of 8 channels at 192 kHz between two threads in 512-frame blocks should take well under
+// 100 ms, i.e. more than 100 times faster than real time (about 27 ms when both threads share one core).
+- (void)testThroughput {
+  [self measureBlock:^{
+    Ring ring{8, 8'192};
+    constexpr size_t total = 1'920'000;
+    std::vector<std::vector<AUValue>> ins(8, std::vector<AUValue>(512, 0.5));
+    auto inPointers = pointers(ins);
+    std::thread consumer([&]() {
+      std::vector<std::vector<AUValue>> outs(8, std::vector<AUValue>(512));
+      auto outPointers = pointers(outs);
+      size_t popped = 0;
+      while (popped < total) {
+        auto count = ring.pop(outPointers, 512);
+        if (count == 0) std::this_thread::yield();
+        popped += count;
+      }
+    });
+    size_t pushed = 0;
+    while (pushed < total) {
+      auto count = ring.push(inPointers, std::min<size_t>(512, total - pushed));
+      if (count == 0) std::this_thread::yield();
+      pushed += count;
+    }
+    consumer.join();
+  }];
+}
+
+@end
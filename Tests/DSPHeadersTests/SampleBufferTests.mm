@@ -1,6 +1,7 @@
 // Copyright © 2021 Brad Howes. All rights reserved.
 
 #import <XCTest/XCTest.h>
+#import <cstdint>
 #import <vector>
 
 #import "DSPHeaders/EventProcessor.hpp"
@@ -41,6 +42,36 @@ static AUAudioFrameCount maxFrames = 100;
   XCTAssertEqual(buffer.mutableAudioBufferList(), nullptr);
 }
 
+- (void)testAlignment {
+  SampleBuffer buffer;
+  buffer.allocate(format, maxFrames);
+  auto bufferList = buffer.mutableAudioBufferList();
+  XCTAssertEqual(2, bufferList->mNumberBuffers);
+  for (UInt32 channel = 0; channel < bufferList->mNumberBuffers; ++channel) {
+    XCTAssertEqual(1, bufferList->mBuffers[channel].mNumberChannels);
+    XCTAssertEqual(maxFrames * sizeof(AUValue), bufferList->mBuffers[channel].mDataByteSize);
+    XCTAssertEqual(0, reinterpret_cast<uintptr_t>(bufferList->mBuffers[channel].mData) % AlignedArena::Alignment);
+    auto samples = static_cast<AUValue*>(bufferList->mBuffers[channel].mData);
+    for (AUAudioFrameCount frame = 0; frame < maxFrames; ++frame) XCTAssertEqual(0.0, samples[frame]);
+  }
+}
+
+- (void)testSharedArena {
+  AlignedArena arena;
+  arena.reserve(2 * SampleBuffer::arenaSize(2, maxFrames));
+  SampleBuffer first;
+  SampleBuffer second;
+  first.allocate(format, maxFrames, arena);
+  second.allocate(format, maxFrames, arena);
+  XCTAssertEqual(arena.capacity(), arena.size());
+  auto lhs = static_cast<AUValue*>(first.mutableAudioBufferList()->mBuffers[1].mData);
+  auto rhs = static_cast<AUValue*>(second.mutableAudioBufferList()->mBuffers[0].mData);
+  XCTAssertTrue(lhs + maxFrames <= rhs);
+
+  SampleBuffer third;
+  XCTAssertThrows(third.allocate(format, maxFrames, arena));
+}
+
 - (void)testPullInput {
   SampleBuffer buffer;
   buffer.allocate(format, maxFrames);
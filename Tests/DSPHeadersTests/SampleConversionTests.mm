@@ -0,0 +1,197 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/SampleConversion.hpp"
+
+using namespace DSPHeaders;
+using namespace DSPHeaders::SampleConversion;
+
+static constexpr AUAudioFrameCount benchmarkFrames = 512;
+
+/**
+ Holds non-interleaved sample storage for a bus with a given number of channels.
+ */
+struct TestBus {
+  TestBus(size_t channels, AUAudioFrameCount frames) : samples_(channels * frames), pointers_(channels) {
+    for (size_t channel = 0; channel < channels; ++channel) {
+      pointers_[channel] = samples_.data() + channel * frames;
+    }
+  }
+
+  BusBuffers bus() const { return BusBuffers(pointers_); }
+
+  std::vector<AUValue> samples_;
+  std::vector<AUValue*> pointers_;
+};
+
+/**
+ Fill a bus with values in range [-1, +1) that differ by channel and frame.
+ */
+static void fill(TestBus& bus, AUAudioFrameCount frames) {
+  for (size_t channel = 0; channel < bus.pointers_.size(); ++channel) {
+    for (AUAudioFrameCount frame = 0; frame < frames; ++frame) {
+      bus.pointers_[channel][frame] = AUValue((frame * 7 + channel * 13) % 64) / 32.0f - 1.0f;
+    }
+  }
+}
+
+/**
+ Convert a bus to an interleaved format and back, returning the largest absolute difference between the original and
+ the round-tripped samples.
+ */
+template <typename C, typename D = NoDither>
+static AUValue roundTrip(size_t channels, AUAudioFrameCount frames, D&& dither = D{}) {
+  TestBus source{channels, frames};
+  fill(source, frames);
+  std::vector<uint8_t> interleaved(channels * frames * C::Size);
+  interleave<C>(source.bus(), interleaved.data(), frames, dither);
+  TestBus result{channels, frames};
+  deinterleave<C>(interleaved.data(), result.bus(), frames);
+  AUValue maxError = 0.0;
+  for (size_t index = 0; index < source.samples_.size(); ++index) {
+    maxError = std::max(maxError, std::abs(source.samples_[index] - result.samples_[index]));
+  }
+  return maxError;
+}
+
+@interface SampleConversionTests : XCTestCase
+
+@end
+
+@implementation SampleConversionTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testBytesPerSample {
+  XCTAssertEqual(4, bytesPerSample(SampleType::float32));
+  XCTAssertEqual(2, bytesPerSample(SampleType::int16));
+  XCTAssertEqual(3, bytesPerSample(SampleType::int24));
+  XCTAssertEqual(4, bytesPerSample(SampleType::int32));
+}
+
+- (void)testInterleaveOrder {
+  TestBus source{2, 3};
+  for (size_t index = 0; index < source.samples_.size(); ++index) source.samples_[index] = AUValue(index);
+  std::vector<AUValue> interleaved(6);
+  interleave<Codec::Float32>(source.bus(), interleaved.data(), 3);
+  std::vector<AUValue> expected{0, 3, 1, 4, 2, 5};
+  for (size_t index = 0; index < expected.size(); ++index) {
+    XCTAssertEqual(expected[index], interleaved[index]);
+  }
+
+  TestBus result{2, 3};
+  deinterleave<Codec::Float32>(interleaved.data(), result.bus(), 3);
+  for (size_t index = 0; index < source.samples_.size(); ++index) {
+    XCTAssertEqual(source.samples_[index], result.samples_[index]);
+  }
+}
+
+- (void)testFloatRoundTrip {
+  for (size_t channels : {1, 2, 3, 4, 6, 8}) {
+    XCTAssertEqual(0.0, roundTrip<Codec::Float32>(channels, 37));
+  }
+}
+
+- (void)testIntegerRoundTrip {
+  for (size_t channels : {1, 2, 3, 4, 6, 8}) {
+    XCTAssertEqualWithAccuracy(0.0, roundTrip<Codec::Int16>(channels, 37), 1.0 / 32768.0);
+    XCTAssertEqualWithAccuracy(0.0, roundTrip<Codec::Int24>(channels, 37), 1.0 / 8388608.0);
+    XCTAssertEqualWithAccuracy(0.0, roundTrip<Codec::Int32>(channels, 37), 1.0e-7);
+  }
+}
+
+- (void)testDitheredRoundTrip {
+  // TPDF dither adds at most 1 LSB before rounding to the nearest integer.
+  XCTAssertTrue(roundTrip<Codec::Int16>(2, 100, TPDFDither()) <= 1.5 / 32768.0);
+  XCTAssertTrue(roundTrip<Codec::Int24>(2, 100, TPDFDither()) <= 1.5 / 8388608.0);
+}
+
+- (void)testInt16Values {
+  TestBus source{1, 4};
+  source.samples_ = {1.0, -1.0, 0.5, 2.0};
+  std::vector<int16_t> samples(4);
+  interleave<Codec::Int16>(source.bus(), samples.data(), 4);
+  XCTAssertEqual(32767, samples[0]);
+  XCTAssertEqual(-32768, samples[1]);
+  XCTAssertEqual(16384, samples[2]);
+  XCTAssertEqual(32767, samples[3]);
+}
+
+- (void)testInt24Values {
+  std::vector<uint8_t> bytes{0xFF, 0xFF, 0x7F, 0x00, 0x00, 0x80, 0xFF, 0xFF, 0xFF};
+  TestBus result{1, 3};
+  deinterleave<Codec::Int24>(bytes.data(), result.bus(), 3);
+  XCTAssertEqualWithAccuracy(1.0, result.samples_[0], 1.0e-6);
+  XCTAssertEqual(-1.0, result.samples_[1]);
+  XCTAssertEqual(-1.0f / 8388608.0f, result.samples_[2]);
+}
+
+- (void)testRuntimeDispatch {
+  TestBus source{2, 16};
+  fill(source, 16);
+  std::vector<uint8_t> interleaved(2 * 16 * 3);
+  interleave(SampleType::int24, source.bus(), interleaved.data(), 16);
+  TestBus result{2, 16};
+  deinterleave(SampleType::int24, interleaved.data(), result.bus(), 16);
+  for (size_t index = 0; index < source.samples_.size(); ++index) {
+    XCTAssertEqualWithAccuracy(source.samples_[index], result.samples_[index], 1.0 / 8388608.0);
+  }
+}
+
+- (void)testTPDFDitherRange {
+  TPDFDither dither;
+  AUValue sum = 0.0;
+  for (int index = 0; index < 10'000; ++index) {
+    auto value = dither();
+    XCTAssertTrue(value > -1.0 && value < 1.0);
+    sum += value;
+  }
+  XCTAssertEqualWithAccuracy(0.0, sum / 10'000, 0.02);
+}
+
+- (void)testScalarDeinterleavePerformance {
+  [self measureBlock:^{
+    TestBus result{2, benchmarkFrames};
+    std::vector<int16_t> interleaved(2 * benchmarkFrames, 1234);
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      for (AUAudioFrameCount frame = 0; frame < benchmarkFrames; ++frame) {
+        for (size_t channel = 0; channel < 2; ++channel) {
+          result.pointers_[channel][frame] = interleaved[frame * 2 + channel] / 32768.0f;
+        }
+      }
+    }
+  }];
+}
+
+- (void)testDeinterleavePerformance {
+  [self measureBlock:^{
+    TestBus result{2, benchmarkFrames};
+    std::vector<int16_t> interleaved(2 * benchmarkFrames, 1234);
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      deinterleave<Codec::Int16>(interleaved.data(), result.bus(), benchmarkFrames);
+    }
+  }];
+}
+
+- (void)testInterleaveDitheredPerformance {
+  [self measureBlock:^{
+    TestBus source{2, benchmarkFrames};
+    fill(source, benchmarkFrames);
+    std::vector<int16_t> interleaved(2 * benchmarkFrames);
+    TPDFDither dither;
+    for (int iteration = 0; iteration < 20'000; ++iteration) {
+      interleave<Codec::Int16>(source.bus(), interleaved.data(), benchmarkFrames, dither);
+    }
+  }];
+}
+
+@end
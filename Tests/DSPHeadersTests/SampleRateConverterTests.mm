@@ -0,0 +1,191 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/SampleRateConverter.hpp"
+#import "TestSupport.hpp"
+
+using namespace DSPHeaders;
+
+using Quality = SampleRateConverter::Quality;
+
+/**
+ Convert mono samples by pushing blocks of the given size.
+ */
+static std::vector<AUValue> convert(SampleRateConverter& converter, const std::vector<AUValue>& input,
+                                    size_t blockSize = 512) {
+  std::vector<AUValue> output;
+  std::vector<AUValue> block(converter.maxOutputFramesFor(AUAudioFrameCount(blockSize)));
+  for (size_t frame = 0; frame < input.size(); frame += blockSize) {
+    auto count = AUAudioFrameCount(std::min(blockSize, input.size() - frame));
+    BusBuffers ins{std::vector<AUValue*>{const_cast<AUValue*>(input.data()) + frame}};
+    BusBuffers outs{std::vector<AUValue*>{block.data()}};
+    auto made = converter.process(ins, count, outs, AUAudioFrameCount(block.size()));
+    output.insert(output.end(), block.begin(), block.begin() + made);
+  }
+  return output;
+}
+
+/**
+ Obtain the signal-to-noise ratio in dB of converting a sine wave of the given frequency for one second.
+ */
+static double measureSNR(Quality quality, double inputRate, double outputRate, double frequency) {
+  SampleRateConverter converter{1, inputRate, outputRate, quality};
+  auto output = convert(converter, makeSine(frequency, inputRate, size_t(inputRate), 0.5));
+  auto step = inputRate / outputRate;
+  double signal = 0.0;
+  double noise = 0.0;
+  for (size_t frame = converter.tapCount(); frame + converter.tapCount() < output.size(); ++frame) {
+    auto time = (double(frame) * step - converter.latency()) / inputRate;
+    auto expected = 0.5 * std::sin(2.0 * M_PI * frequency * time);
+    signal += expected * expected;
+    noise += (output[frame] - expected) * (output[frame] - expected);
+  }
+  return 10.0 * std::log10(signal / noise);
+}
+
+static void measureConverter(Quality quality, double inputRate, double outputRate) {
+  SampleRateConverter converter{2, inputRate, outputRate, quality};
+  constexpr AUAudioFrameCount outputFrames = 512;
+  auto left = makeSine(440.0, inputRate, size_t(2.0 * outputFrames * inputRate / outputRate), 0.5);
+  auto right = makeSine(660.0, inputRate, left.size(), 0.5);
+  std::vector<AUValue> outLeft(outputFrames);
+  std::vector<AUValue> outRight(outputFrames);
+  BusBuffers ins{std::vector<AUValue*>{left.data(), right.data()}};
+  BusBuffers outs{std::vector<AUValue*>{outLeft.data(), outRight.data()}};
+  for (int block = 0; block < int(outputRate) / int(outputFrames); ++block) {
+    converter.render(ins, outs, outputFrames);
+  }
+}
+
+@interface SampleRateConverterTests : XCTestCase
+
+@end
+
+@implementation SampleRateConverterTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInvalidRates {
+  XCTAssertThrows(SampleRateConverter(1, 0.0, 48'000.0));
+  XCTAssertThrows(SampleRateConverter(1, 44'100.0, -1.0));
+  XCTAssertThrows(SampleRateConverter(9, 44'100.0, 48'000.0));
+}
+
+- (void)testTapCounts {
+  XCTAssertEqual(16, SampleRateConverter(1, 44'100.0, 48'000.0, Quality::draft).tapCount());
+  XCTAssertEqual(32, SampleRateConverter(1, 44'100.0, 48'000.0).tapCount());
+  XCTAssertEqual(64, SampleRateConverter(1, 96'000.0, 48'000.0).tapCount());
+  XCTAssertEqual(256, SampleRateConverter(1, 192'000.0, 48'000.0, Quality::high).tapCount());
+  XCTAssertEqual(16.0, SampleRateConverter(1, 44'100.0, 48'000.0).latency());
+}
+
+- (void)testOutputCount {
+  for (auto rates : {std::make_pair(44'100.0, 48'000.0), std::make_pair(192'000.0, 44'100.0),
+                     std::make_pair(48'000.0, 88'200.0)}) {
+    SampleRateConverter converter{1, rates.first, rates.second};
+    auto output = convert(converter, std::vector<AUValue>(size_t(rates.first), 0.0), 333);
+    XCTAssertEqualWithAccuracy(rates.second, double(output.size()), 1.0);
+  }
+}
+
+- (void)testPullMatchesPush {
+  auto input = makeSine(1'000.0, 96'000.0, 20'000, 0.5);
+  SampleRateConverter push{1, 96'000.0, 44'100.0};
+  auto expected = convert(push, input, 333);
+
+  SampleRateConverter pull{1, 96'000.0, 44'100.0};
+  constexpr AUAudioFrameCount outputFrames = 256;
+  std::vector<AUValue> output(outputFrames);
+  size_t consumed = 0;
+  for (size_t frame = 0; frame + outputFrames <= expected.size(); frame += outputFrames) {
+    auto needed = pull.inputFramesFor(outputFrames);
+    if (consumed + needed > input.size()) break;
+    BusBuffers ins{std::vector<AUValue*>{input.data() + consumed}};
+    BusBuffers outs{std::vector<AUValue*>{output.data()}};
+    pull.render(ins, outs, outputFrames);
+    consumed += needed;
+    for (size_t index = 0; index < outputFrames; ++index) {
+      XCTAssertEqual(expected[frame + index], output[index]);
+    }
+  }
+  XCTAssertTrue(consumed > input.size() - 1'000);
+}
+
+- (void)testSmallBlocks {
+  auto input = makeSine(2'000.0, 44'100.0, 5'000, 0.5);
+  SampleRateConverter whole{1, 44'100.0, 48'000.0};
+  auto expected = convert(whole, input, 5'000);
+  SampleRateConverter pieces{1, 44'100.0, 48'000.0};
+  auto output = convert(pieces, input, 7);
+  XCTAssertEqual(expected.size(), output.size());
+  for (size_t index = 0; index < std::min(expected.size(), output.size()); ++index) {
+    XCTAssertEqual(expected[index], output[index]);
+  }
+}
+
+- (void)testSignalToNoise {
+  // Measured: draft ~75 dB, normal ~85 dB, high ~110 dB (near the limit of 32-bit samples) for low and high sines.
+  XCTAssertGreaterThan(measureSNR(Quality::draft, 44'100.0, 48'000.0, 1'000.0), 70.0);
+  XCTAssertGreaterThan(measureSNR(Quality::normal, 44'100.0, 48'000.0, 1'000.0), 80.0);
+  XCTAssertGreaterThan(measureSNR(Quality::high, 44'100.0, 48'000.0, 1'000.0), 105.0);
+  XCTAssertGreaterThan(measureSNR(Quality::draft, 44'100.0, 48'000.0, 10'000.0), 70.0);
+  XCTAssertGreaterThan(measureSNR(Quality::normal, 44'100.0, 48'000.0, 10'000.0), 80.0);
+  XCTAssertGreaterThan(measureSNR(Quality::high, 44'100.0, 48'000.0, 10'000.0), 105.0);
+  XCTAssertGreaterThan(measureSNR(Quality::normal, 96'000.0, 48'000.0, 10'000.0), 80.0);
+  XCTAssertGreaterThan(measureSNR(Quality::normal, 192'000.0, 44'100.0, 5'000.0), 80.0);
+}
+
+- (void)testRejectsAboveOutputNyquist {
+  SampleRateConverter converter{1, 96'000.0, 48'000.0, Quality::normal};
+  auto output = convert(converter, makeSine(30'000.0, 96'000.0, 96'000, 0.5));
+  AUValue peak = 0.0;
+  for (size_t frame = converter.tapCount(); frame < output.size(); ++frame) {
+    peak = std::max(peak, std::abs(output[frame]));
+  }
+  XCTAssertLessThan(peak, 0.5 * 1.0e-3);
+}
+
+- (void)testReset {
+  auto input = makeSine(1'000.0, 48'000.0, 2'000, 0.5);
+  SampleRateConverter converter{1, 48'000.0, 44'100.0};
+  auto first = convert(converter, input);
+  converter.reset();
+  auto second = convert(converter, input);
+  XCTAssertEqual(first.size(), second.size());
+  for (size_t index = 0; index < first.size(); ++index) XCTAssertEqual(first[index], second[index]);
+}
+
+- (void)testDraftPerformance {
+  [self measureBlock:^{
+    measureConverter(Quality::draft, 44'100.0, 48'000.0);
+  }];
+}
+
+- (void)testNormalPerformance {
+  [self measureBlock:^{
+    measureConverter(Quality::normal, 44'100.0, 48'000.0);
+  }];
+}
+
+- (void)testHighPerformance {
+  [self measureBlock:^{
+    measureConverter(Quality::high, 44'100.0, 48'000.0);
+  }];
+}
+
+- (void)testDownsamplePerformance {
+  [self measureBlock:^{
+    measureConverter(Quality::normal, 96'000.0, 48'000.0);
+  }];
+}
+
+@end
@@ -0,0 +1,124 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cstdint>
+#import <vector>
+
+#import "DSPHeaders/EventProcessor.hpp"
+#import "DSPHeaders/ScratchPool.hpp"
+
+using namespace DSPHeaders;
+
+/**
+ Effect that builds a gain curve and a copy of its input in scratch space before writing the product to its output.
+ */
+struct ScratchEffect : public EventProcessor<ScratchEffect>
+{
+  ScratchEffect() : EventProcessor<ScratchEffect>() {}
+  size_t scratchSize(AUAudioFrameCount maxFrames) const {
+    return ScratchPool::bytesFor<AUValue>(maxFrames) + ScratchPool::bytesFor<double>(maxFrames);
+  }
+  void setParameterFromEvent(const AUParameterEvent&) {}
+  void doMIDIEvent(AUMIDIEvent) {}
+  void doRendering(NSInteger, BusBuffers, BusBuffers outs, AUAudioFrameCount frameCount) {
+    auto curve = scratch().take<AUValue>(frameCount);
+    auto sums = scratch().take<double>(frameCount);
+    {
+      // Recording allocates, which is not what is being checked here.
+      RealtimeSafety::Suspend suspend;
+      curves_.push_back(curve);
+    }
+    aligned_ = aligned_ && reinterpret_cast<uintptr_t>(curve) % AlignedArena::Alignment == 0 &&
+    reinterpret_cast<uintptr_t>(sums) % AlignedArena::Alignment == 0;
+    for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+      curve[frame] = AUValue(frame);
+      sums[frame] = curve[frame] * 0.5;
+    }
+    for (size_t channel = 0; channel < outs.size(); ++channel) {
+      for (AUAudioFrameCount frame = 0; frame < frameCount; ++frame) {
+        outs[channel][frame] = AUValue(sums[frame]);
+      }
+    }
+  }
+  using EventProcessor<ScratchEffect>::scratch;
+  std::vector<AUValue*> curves_;
+  bool aligned_{true};
+};
+
+@interface ScratchPoolTests : XCTestCase
+
+@end
+
+@implementation ScratchPoolTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testBytesFor {
+  XCTAssertEqual(0, ScratchPool::bytesFor<float>(0));
+  XCTAssertEqual(64, ScratchPool::bytesFor<float>(3));
+  XCTAssertEqual(128, ScratchPool::bytesFor<double>(9));
+}
+
+- (void)testTakeAndReset {
+  AlignedArena arena;
+  arena.reserve(256);
+  ScratchPool pool;
+  XCTAssertEqual(0, pool.capacity());
+  pool.assign(arena.take<std::byte>(256), 256);
+  XCTAssertEqual(256, pool.capacity());
+
+  auto first = pool.take<float>(20);
+  auto second = pool.take<int>(10);
+  XCTAssertTrue(first != nullptr);
+  XCTAssertEqual(128, reinterpret_cast<std::byte*>(second) - reinterpret_cast<std::byte*>(first));
+  XCTAssertEqual(192, pool.size());
+  pool.reset();
+  XCTAssertEqual(0, pool.size());
+  XCTAssertEqual(192, pool.highWaterMark());
+  XCTAssertTrue(pool.take<float>(64) == first);
+  XCTAssertEqual(256, pool.highWaterMark());
+
+  pool.assign(nullptr, 0);
+  XCTAssertEqual(0, pool.capacity());
+  XCTAssertEqual(0, pool.highWaterMark());
+}
+
+- (void)testEventProcessorScratch {
+  AVAudioFormat* format = [[AVAudioFormat alloc] initStandardFormatWithSampleRate:44100.0 channels:2];
+  AUAudioFrameCount maxFrames = 512;
+  ScratchEffect effect;
+  effect.setRenderingFormat(1, format, maxFrames);
+  XCTAssertEqual(maxFrames * sizeof(AUValue) + maxFrames * sizeof(double), effect.scratch().capacity());
+  XCTAssertEqual(SampleBuffer::arenaSize(2, maxFrames) + effect.scratch().capacity(), effect.renderingMemorySize());
+
+  // Splitting the render cycle at a MIDI event leads to two doRendering calls which both start at the pool start.
+  AURenderEvent event{};
+  event.MIDI.eventType = AURenderEventMIDI;
+  event.MIDI.eventSampleTime = 100;
+  event.MIDI.length = 3;
+  AVAudioPCMBuffer* buffer = [[AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:maxFrames];
+  AudioTimeStamp timestamp = AudioTimeStamp();
+  XCTAssertEqual(noErr, effect.processAndRender(&timestamp, maxFrames, 0, [buffer mutableAudioBufferList], &event,
+                                                nil));
+  XCTAssertEqual(2, effect.curves_.size());
+  XCTAssertTrue(effect.curves_[0] == effect.curves_[1]);
+  XCTAssertTrue(effect.aligned_);
+  XCTAssertEqual(ScratchPool::bytesFor<AUValue>(412) + ScratchPool::bytesFor<double>(412),
+                 effect.scratch().highWaterMark());
+
+  auto samples = static_cast<AUValue*>([buffer mutableAudioBufferList]->mBuffers[1].mData);
+  XCTAssertEqual(49.5, samples[99]);
+  XCTAssertEqual(0.0, samples[100]);
+  XCTAssertEqual(0.5, samples[101]);
+
+  effect.renderingStopped();
+  XCTAssertEqual(0, effect.scratch().capacity());
+}
+
+@end
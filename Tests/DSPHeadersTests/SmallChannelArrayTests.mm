@@ -0,0 +1,67 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+
+#import "DSPHeaders/SmallChannelArray.hpp"
+
+using namespace DSPHeaders;
+
+@interface SmallChannelArrayTests : XCTestCase
+
+@end
+
+@implementation SmallChannelArrayTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInit {
+  SmallChannelArray<int, 8> empty;
+  XCTAssertTrue(empty.empty());
+  XCTAssertEqual(0, empty.size());
+  XCTAssertEqual(8, empty.capacity());
+
+  SmallChannelArray<int, 8> sized(3);
+  XCTAssertFalse(sized.empty());
+  XCTAssertEqual(3, sized.size());
+  XCTAssertEqual(0, sized[2]);
+}
+
+- (void)testResize {
+  SmallChannelArray<int, 4> array(2);
+  array[0] = 1;
+  array[1] = 2;
+  array.resize(4);
+  XCTAssertEqual(4, array.size());
+  XCTAssertEqual(1, array[0]);
+  XCTAssertEqual(2, array[1]);
+  XCTAssertEqual(0, array[3]);
+  array.resize(1);
+  XCTAssertEqual(1, array.size());
+}
+
+- (void)testCopyIsIndependent {
+  SmallChannelArray<int, 4> array(2);
+  array[0] = 1;
+  auto copy = array;
+  copy[0] = 5;
+  XCTAssertEqual(1, array[0]);
+  XCTAssertEqual(5, copy[0]);
+}
+
+- (void)testIteration {
+  SmallChannelArray<int, 4> array(3);
+  int value = 0;
+  for (auto& entry : array) entry = ++value;
+  int sum = 0;
+  for (auto entry : array) sum += entry;
+  XCTAssertEqual(6, sum);
+  XCTAssertEqual(array.data() + 3, array.end());
+}
+
+@end
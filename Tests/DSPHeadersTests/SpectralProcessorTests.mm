@@ -0,0 +1,266 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/SpectralProcessor.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr double SampleRate = 48'000.0;
+static constexpr AUAudioFrameCount MaxFrames = 512;
+
+using Form = SpectralProcessor::Form;
+using Frame = SpectralProcessor::Frame;
+
+/**
+ @returns a mix of sines that are not centered in any bin, so that every bin holds something
+ */
+static std::vector<AUValue> makeSignal(size_t count, double offset = 0.0) {
+  std::vector<AUValue> samples(count);
+  for (size_t index = 0; index < count; ++index) {
+    auto time = double(index) / SampleRate;
+    samples[index] = AUValue(0.4 * std::sin(2.0 * M_PI * 123.4 * time + offset) +
+                             0.3 * std::sin(2.0 * M_PI * 2'345.6 * time) +
+                             0.2 * std::sin(2.0 * M_PI * 13'579.1 * time + offset));
+  }
+  return samples;
+}
+
+/**
+ @returns a sine that completes a whole number of cycles in a 4096-sample transform
+ */
+static std::vector<AUValue> makeBinSine(size_t count, size_t bin, double amplitude) {
+  std::vector<AUValue> samples(count);
+  for (size_t index = 0; index < count; ++index) {
+    samples[index] = AUValue(amplitude * std::sin(2.0 * M_PI * double(bin) * double(index) / 4'096.0));
+  }
+  return samples;
+}
+
+/**
+ Run channels through a processor in blocks of at most `blockSize` frames.
+
+ @returns the processed channels
+ */
+template <typename Proc>
+static std::vector<std::vector<AUValue>> run(SpectralProcessor& processor, std::vector<std::vector<AUValue>> channels,
+                                             size_t blockSize, Proc&& proc) {
+  auto size = channels[0].size();
+  std::vector<std::vector<AUValue>> outputs(channels.size(), std::vector<AUValue>(size));
+  for (size_t frame = 0; frame < size; frame += blockSize) {
+    auto count = AUAudioFrameCount(std::min(blockSize, size - frame));
+    std::vector<AUValue*> ins;
+    std::vector<AUValue*> outs;
+    for (auto& channel : channels) ins.push_back(channel.data() + frame);
+    for (auto& channel : outputs) outs.push_back(channel.data() + frame);
+    processor.process(BusBuffers{ins}, BusBuffers{outs}, count, proc);
+  }
+  return outputs;
+}
+
+/**
+ @returns the largest difference between the output and the input delayed by the processor latency, after the first
+ `skip` input samples
+ */
+static double delayedError(const SpectralProcessor& processor, const std::vector<AUValue>& input,
+                           const std::vector<AUValue>& output, double gain = 1.0, size_t skip = 0) {
+  double worst = 0.0;
+  for (size_t index = skip; index + processor.latency() < output.size(); ++index) {
+    worst = std::max(worst, std::abs(output[index + processor.latency()] - gain * input[index]));
+  }
+  return worst;
+}
+
+static void measureProcessor(Form form) {
+  SpectralProcessor processor{4'096, 1'024, form};
+  processor.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> channels{makeSignal(size_t(SampleRate)), makeSignal(size_t(SampleRate), 1.0)};
+  run(processor, channels, MaxFrames, [](Frame&) {});
+}
+
+@interface SpectralProcessorTests : XCTestCase
+
+@end
+
+@implementation SpectralProcessorTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInvalidArguments {
+  XCTAssertThrows(SpectralProcessor(1'000));
+  XCTAssertThrows(SpectralProcessor(4'096, 0));
+  XCTAssertThrows(SpectralProcessor(4'096, 1'000));
+  XCTAssertThrows(SpectralProcessor(4'096, 2'048));
+  SpectralProcessor processor{1'024, 128, Form::polar};
+  XCTAssertEqual(1'024, processor.fftSize());
+  XCTAssertEqual(128, processor.hopSize());
+  XCTAssertEqual(513, processor.binCount());
+  XCTAssertEqual(1'024, processor.latency());
+  XCTAssertTrue(processor.form() == Form::polar);
+}
+
+- (void)testBinFrequency {
+  SpectralProcessor processor;
+  processor.setRenderingFormat(SampleRate, 1);
+  XCTAssertEqual(0.0, processor.binFrequency(0));
+  XCTAssertEqual(12'000.0, processor.binFrequency(1'024));
+  XCTAssertEqual(24'000.0, processor.binFrequency(2'048));
+}
+
+- (void)testRectangularIdentity {
+  for (auto [fftSize, hopSize] : {std::pair{4'096, 1'024}, std::pair{1'024, 128}, std::pair{512, 128}}) {
+    SpectralProcessor processor{size_t(fftSize), size_t(hopSize)};
+    processor.setRenderingFormat(SampleRate, 1);
+    auto input = makeSignal(24'000);
+    auto outputs = run(processor, {input}, MaxFrames, [](Frame&) {});
+    for (size_t index = 0; index < processor.latency(); ++index) {
+      XCTAssertEqualWithAccuracy(0.0, outputs[0][index], 1.0e-6);
+    }
+    XCTAssertEqualWithAccuracy(0.0, delayedError(processor, input, outputs[0]), 1.0e-5);
+  }
+}
+
+- (void)testPolarIdentity {
+  SpectralProcessor processor{4'096, 1'024, Form::polar};
+  processor.setRenderingFormat(SampleRate, 1);
+  auto input = makeSignal(24'000);
+  auto outputs = run(processor, {input}, MaxFrames, [](Frame&) {});
+  XCTAssertEqualWithAccuracy(0.0, delayedError(processor, input, outputs[0]), 1.0e-4);
+}
+
+- (void)testBlockSizeDoesNotMatter {
+  SpectralProcessor processor{1'024, 256};
+  processor.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> channels{makeSignal(10'000), makeSignal(10'000, 1.0)};
+  auto halve = [](Frame& frame) {
+    for (size_t bin = 0; bin < frame.binCount; ++bin) frame.re[bin] *= 0.5f;
+  };
+  auto expected = run(processor, channels, 10'000, halve);
+  for (auto blockSize : {1, 7, 256, 333, 1'500}) {
+    processor.reset();
+    auto outputs = run(processor, channels, size_t(blockSize), halve);
+    XCTAssertTrue(expected == outputs);
+  }
+}
+
+- (void)testInPlace {
+  SpectralProcessor processor{1'024, 256};
+  processor.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> channels{makeSignal(10'000), makeSignal(10'000, 1.0)};
+  auto expected = run(processor, channels, MaxFrames, [](Frame&) {});
+  processor.reset();
+  for (size_t frame = 0; frame < 10'000; frame += MaxFrames) {
+    auto count = AUAudioFrameCount(std::min(size_t(MaxFrames), 10'000 - frame));
+    std::vector<AUValue*> pointers{channels[0].data() + frame, channels[1].data() + frame};
+    BusBuffers buffers{pointers};
+    processor.process(buffers, buffers, count, [](Frame&) {});
+  }
+  XCTAssertTrue(expected == channels);
+}
+
+- (void)testExtraOutputsZeroed {
+  SpectralProcessor processor{1'024, 256};
+  processor.setRenderingFormat(SampleRate, 1);
+  auto input = makeSignal(MaxFrames);
+  std::vector<AUValue> output(MaxFrames, 1.0);
+  std::vector<AUValue> extra(MaxFrames, 1.0);
+  std::vector<AUValue*> ins{input.data()};
+  std::vector<AUValue*> outs{output.data(), extra.data()};
+  processor.process(BusBuffers{ins}, BusBuffers{outs}, MaxFrames, [](Frame&) {});
+  for (auto sample : extra) XCTAssertEqual(0.0, sample);
+}
+
+- (void)testFrames {
+  SpectralProcessor processor;
+  processor.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> channels(2, std::vector<AUValue>(48'000));
+  std::vector<size_t> order;
+  size_t binCount = 0;
+  run(processor, channels, MaxFrames, [&](Frame& frame) {
+    order.push_back(frame.channel);
+    binCount = frame.binCount;
+  });
+  // The first transform happens after one hop of input and every hop thereafter, each channel in turn.
+  XCTAssertEqual(2 * (48'000 / 1'024), order.size());
+  for (size_t index = 0; index < order.size(); ++index) XCTAssertEqual(index % 2, order[index]);
+  XCTAssertEqual(2'049, binCount);
+}
+
+- (void)testRemoveBins {
+  // Drop everything above 2.3 kHz, which removes the high sine and leaves the low one alone.
+  SpectralProcessor processor;
+  processor.setRenderingFormat(SampleRate, 1);
+  auto low = makeBinSine(24'000, 40, 0.5);
+  auto high = makeBinSine(24'000, 400, 0.5);
+  std::vector<AUValue> mix(24'000);
+  for (size_t index = 0; index < mix.size(); ++index) mix[index] = low[index] + high[index];
+  auto outputs = run(processor, {mix}, MaxFrames, [](Frame& frame) {
+    for (size_t bin = 200; bin < frame.binCount; ++bin) frame.re[bin] = frame.im[bin] = 0.0f;
+  });
+  // Skip the first transform size of input, which mixes with the silence before the start.
+  XCTAssertEqualWithAccuracy(0.0, delayedError(processor, low, outputs[0], 1.0, 4'096), 1.0e-4);
+}
+
+- (void)testPolarMagnitudeScaling {
+  SpectralProcessor processor{4'096, 1'024, Form::polar};
+  processor.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> channels{makeSignal(24'000), makeSignal(24'000, 1.0)};
+  auto outputs = run(processor, channels, MaxFrames, [](Frame& frame) {
+    auto gain = frame.channel == 0 ? 0.5f : 0.25f;
+    for (size_t bin = 0; bin < frame.binCount; ++bin) frame.magnitude[bin] *= gain;
+  });
+  XCTAssertEqualWithAccuracy(0.0, delayedError(processor, channels[0], outputs[0], 0.5), 1.0e-4);
+  XCTAssertEqualWithAccuracy(0.0, delayedError(processor, channels[1], outputs[1], 0.25), 1.0e-4);
+}
+
+- (void)testPolarPhaseAdvance {
+  // A sine centered in bin 101 turns a quarter cycle more than a whole number of cycles every 1024-sample hop. This
+  // is what a phase vocoder measures to find the true frequency in a bin.
+  SpectralProcessor processor{4'096, 1'024, Form::polar};
+  processor.setRenderingFormat(SampleRate, 1);
+  std::vector<AUValue> phases;
+  std::vector<AUValue> magnitudes;
+  run(processor, {makeBinSine(24'000, 101, 0.5)}, MaxFrames, [&](Frame& frame) {
+    phases.push_back(frame.phase[101]);
+    magnitudes.push_back(frame.magnitude[101]);
+  });
+  XCTAssertEqual(23, phases.size());
+  for (size_t index = 4; index < phases.size(); ++index) {
+    // The Hann window sums to N/2, and a sine puts half of its amplitude in the bin.
+    XCTAssertEqualWithAccuracy(0.5 * 4'096.0 / 4.0, magnitudes[index], 0.01);
+    auto advance = std::remainder(double(phases[index]) - double(phases[index - 1]), 2.0 * M_PI);
+    XCTAssertEqualWithAccuracy(M_PI_2, advance, 1.0e-4);
+  }
+}
+
+- (void)testReset {
+  SpectralProcessor processor;
+  processor.setRenderingFormat(SampleRate, 1);
+  run(processor, {makeSignal(10'000)}, MaxFrames, [](Frame&) {});
+  processor.reset();
+  auto outputs = run(processor, {std::vector<AUValue>(10'000, 0.0)}, MaxFrames, [](Frame&) {});
+  for (auto sample : outputs[0]) XCTAssertEqual(0.0, sample);
+}
+
+// One second of stereo at 48 kHz with 4096-sample transforms every 1024 samples takes about 1% of a second.
+- (void)testRectangularPerformance {
+  [self measureBlock:^{
+    measureProcessor(Form::rectangular);
+  }];
+}
+
+- (void)testPolarPerformance {
+  [self measureBlock:^{
+    measureProcessor(Form::polar);
+  }];
+}
+
+@end
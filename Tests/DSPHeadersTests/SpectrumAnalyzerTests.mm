@@ -0,0 +1,246 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/SpectrumAnalyzer.hpp"
+#import "TestSupport.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr double SampleRate = 48'000.0;
+static constexpr AUAudioFrameCount MaxFrames = 512;
+
+/**
+ Push channels in blocks of MaxFrames, running an update after every `updateFrames` frames.
+ */
+static void feed(SpectrumAnalyzer& analyzer, std::vector<std::vector<AUValue>>& channels, size_t updateFrames) {
+  auto size = channels[0].size();
+  size_t sinceUpdate = 0;
+  for (size_t frame = 0; frame < size; frame += MaxFrames) {
+    auto count = AUAudioFrameCount(std::min(size_t(MaxFrames), size - frame));
+    std::vector<AUValue*> pointers;
+    for (auto& channel : channels) pointers.push_back(channel.data() + frame);
+    analyzer.push(BusBuffers{pointers}, count);
+    sinceUpdate += count;
+    if (sinceUpdate >= updateFrames) {
+      analyzer.update();
+      sinceUpdate = 0;
+    }
+  }
+  analyzer.update();
+}
+
+/**
+ @returns the index of the bucket whose range of frequencies holds the given one
+ */
+static size_t bucketFor(const SpectrumAnalyzer& analyzer, double frequency) {
+  const auto& centers = analyzer.bucketFrequencies();
+  size_t best = 0;
+  for (size_t bucket = 1; bucket < centers.size(); ++bucket) {
+    if (std::abs(std::log(centers[bucket] / frequency)) < std::abs(std::log(centers[best] / frequency))) best = bucket;
+  }
+  return best;
+}
+
+static void measureAnalyzer(Window window, size_t overlap) {
+  constexpr double sampleRate = 192'000.0;
+  SpectrumAnalyzer analyzer{4'096, window, overlap};
+  analyzer.setRenderingFormat(sampleRate, 8, 256);
+  std::vector<std::vector<AUValue>> channels;
+  for (size_t channel = 0; channel < 8; ++channel) {
+    channels.push_back(makeSine(100.0 * double(channel + 1), sampleRate, size_t(sampleRate), 0.5));
+  }
+  // One second of audio with updates at 60 Hz
+  feed(analyzer, channels, size_t(sampleRate / 60.0));
+}
+
+@interface SpectrumAnalyzerTests : XCTestCase
+
+@end
+
+@implementation SpectrumAnalyzerTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInvalidArguments {
+  XCTAssertThrows(SpectrumAnalyzer(1'000));
+  XCTAssertThrows(SpectrumAnalyzer(4'096, Window::hann, 0));
+  XCTAssertThrows(SpectrumAnalyzer(4'096, Window::hann, 3));
+  SpectrumAnalyzer analyzer{1'024, Window::blackmanHarris, 4};
+  XCTAssertEqual(1'024, analyzer.fftSize());
+  XCTAssertEqual(256, analyzer.hopSize());
+}
+
+- (void)testWindowsOverlapToConstant {
+  auto hann = makeWindow(Window::hann, 64);
+  XCTAssertEqual(0.0, hann[0]);
+  XCTAssertEqualWithAccuracy(1.0, hann[32], 1.0e-7);
+  XCTAssertEqualWithAccuracy(hann[1], hann[63], 1.0e-7);
+  for (size_t index = 0; index < 32; ++index) XCTAssertEqualWithAccuracy(1.0, hann[index] + hann[index + 32], 1.0e-6);
+
+  auto blackmanHarris = makeWindow(Window::blackmanHarris, 64);
+  XCTAssertEqualWithAccuracy(1.0, blackmanHarris[32], 1.0e-6);
+  for (size_t index = 0; index < 16; ++index) {
+    auto sum = blackmanHarris[index] + blackmanHarris[index + 16] + blackmanHarris[index + 32] +
+    blackmanHarris[index + 48];
+    XCTAssertEqualWithAccuracy(4.0 * 0.35875, sum, 1.0e-6);
+  }
+}
+
+- (void)testBucketFrequencies {
+  SpectrumAnalyzer analyzer;
+  analyzer.setRenderingFormat(SampleRate, 1, 100, 20.0, 30'000.0);
+  XCTAssertEqual(100, analyzer.bucketCount());
+  XCTAssertEqual(100, analyzer.levels(0).size());
+  const auto& centers = analyzer.bucketFrequencies();
+  // The top is limited to Nyquist, and each bucket is the same fraction of an octave wide.
+  XCTAssertEqualWithAccuracy(20.0 * std::pow(1'200.0, 0.5 / 100.0), centers.front(), 1.0e-3);
+  XCTAssertEqualWithAccuracy(24'000.0 / std::pow(1'200.0, 0.5 / 100.0), centers.back(), 1.0e-1);
+  for (size_t bucket = 1; bucket < centers.size(); ++bucket) {
+    XCTAssertEqualWithAccuracy(std::pow(1'200.0, 1.0 / 100.0), centers[bucket] / centers[bucket - 1], 1.0e-5);
+  }
+}
+
+- (void)testSineLevel {
+  // A sine in the center of bin 100 reads 0 dB at full scale with either window.
+  auto frequency = 100.0 * SampleRate / 4'096.0;
+  for (auto [window, overlap] : {std::pair{Window::hann, 2}, std::pair{Window::blackmanHarris, 4}}) {
+    for (auto amplitude : {1.0, 0.1}) {
+      SpectrumAnalyzer analyzer{4'096, window, size_t(overlap)};
+      analyzer.setRenderingFormat(SampleRate, 1);
+      analyzer.setAveragingTime(0.0);
+      std::vector<std::vector<AUValue>> channels{makeSine(frequency, SampleRate, 24'000, amplitude)};
+      feed(analyzer, channels, 800);
+      auto level = analyzer.levels(0)[bucketFor(analyzer, frequency)];
+      XCTAssertEqualWithAccuracy(20.0 * std::log10(amplitude), level, 0.01);
+    }
+  }
+}
+
+- (void)testBlackmanHarrisLeakage {
+  // No averaging, so the splatter from the sine starting up does not linger.
+  SpectrumAnalyzer analyzer{4'096, Window::blackmanHarris, 4};
+  analyzer.setRenderingFormat(SampleRate, 1);
+  analyzer.setAveragingTime(0.0);
+  std::vector<std::vector<AUValue>> channels{makeSine(1'000.0, SampleRate, 24'000, 1.0)};
+  feed(analyzer, channels, 800);
+  const auto& levels = analyzer.levels(0);
+  XCTAssertGreaterThan(levels[bucketFor(analyzer, 1'000.0)], -1.0);
+  XCTAssertLessThan(levels[bucketFor(analyzer, 1'100.0)], -90.0);
+  XCTAssertLessThan(levels[bucketFor(analyzer, 10'000.0)], -90.0);
+  XCTAssertLessThan(levels[bucketFor(analyzer, 100.0)], -90.0);
+}
+
+- (void)testChannelsAreIndependent {
+  SpectrumAnalyzer analyzer;
+  analyzer.setRenderingFormat(SampleRate, 2);
+  std::vector<std::vector<AUValue>> channels{makeSine(1'000.0, SampleRate, 24'000, 1.0),
+                                             std::vector<AUValue>(24'000, 0.0)};
+  feed(analyzer, channels, 800);
+  XCTAssertGreaterThan(analyzer.levels(0)[bucketFor(analyzer, 1'000.0)], -2.0);
+  for (auto level : analyzer.levels(1)) XCTAssertEqual(SpectrumAnalyzer::MinimumLevel, level);
+  for (auto level : analyzer.peaks(1)) XCTAssertEqual(SpectrumAnalyzer::MinimumLevel, level);
+}
+
+- (void)testAveraging {
+  SpectrumAnalyzer analyzer{1'024, Window::hann, 2};
+  analyzer.setRenderingFormat(SampleRate, 1);
+  analyzer.setAveragingTime(100.0);
+  auto frequency = 20.0 * SampleRate / 1'024.0;
+  auto bucket = bucketFor(analyzer, frequency);
+  std::vector<std::vector<AUValue>> channels{makeSine(frequency, SampleRate, 48'000, 1.0)};
+  feed(analyzer, channels, 800);
+  XCTAssertEqualWithAccuracy(0.0, analyzer.levels(0)[bucket], 0.01);
+
+  // Once the windows only hold silence, each transform moves the average 1 - exp(-hop / 100 ms) of the way to zero.
+  std::vector<std::vector<AUValue>> silence{std::vector<AUValue>(4'096, 0.0)};
+  feed(analyzer, silence, 4'096);
+  auto before = analyzer.levels(0)[bucket];
+  silence[0].resize(2'048);
+  feed(analyzer, silence, 2'048);
+  auto decay = 4.0 * 10.0 * std::log10(std::exp(-512.0 / SampleRate / 0.1));
+  XCTAssertEqualWithAccuracy(decay, analyzer.levels(0)[bucket] - before, 0.01);
+}
+
+- (void)testPeakHold {
+  SpectrumAnalyzer analyzer{1'024, Window::hann, 2};
+  analyzer.setRenderingFormat(SampleRate, 1);
+  analyzer.setAveragingTime(0.0);
+  analyzer.setPeakHold(100.0, 50.0);
+  auto frequency = 20.0 * SampleRate / 1'024.0;
+  auto bucket = bucketFor(analyzer, frequency);
+  std::vector<std::vector<AUValue>> loud{makeSine(frequency, SampleRate, 4'096, 1.0)};
+  feed(analyzer, loud, 512);
+  XCTAssertEqualWithAccuracy(0.0, analyzer.peaks(0)[bucket], 0.01);
+
+  // The peak holds for 100 ms (about 9 hops) and then falls 50 dB/s.
+  std::vector<std::vector<AUValue>> quiet{std::vector<AUValue>(512 * 8, 0.0)};
+  feed(analyzer, quiet, 512);
+  XCTAssertLessThan(analyzer.levels(0)[bucket], -60.0);
+  XCTAssertEqualWithAccuracy(0.0, analyzer.peaks(0)[bucket], 0.01);
+
+  quiet[0].resize(48'000 - 512 * 8);
+  feed(analyzer, quiet, 512);
+  auto decayTime = 1.0 - std::round(0.1 * SampleRate / 512.0) * 512.0 / SampleRate;
+  XCTAssertEqualWithAccuracy(-50.0 * decayTime, analyzer.peaks(0)[bucket], 0.6);
+}
+
+- (void)testTransformBudget {
+  SpectrumAnalyzer analyzer;
+  analyzer.setRenderingFormat(SampleRate, 1);
+  analyzer.setMaxTransformsPerUpdate(3);
+  std::vector<AUValue> samples(MaxFrames, 0.5);
+  BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+  for (int block = 0; block < 40; ++block) analyzer.push(bus, MaxFrames);
+  XCTAssertEqual(3, analyzer.update());
+  XCTAssertEqual(0, analyzer.update());
+  for (int block = 0; block < 4; ++block) analyzer.push(bus, MaxFrames);
+  XCTAssertEqual(1, analyzer.update());
+}
+
+- (void)testReset {
+  SpectrumAnalyzer analyzer;
+  analyzer.setRenderingFormat(SampleRate, 1);
+  std::vector<std::vector<AUValue>> channels{makeSine(1'000.0, SampleRate, 24'000, 1.0)};
+  feed(analyzer, channels, 800);
+  analyzer.reset();
+  for (auto level : analyzer.levels(0)) XCTAssertEqual(SpectrumAnalyzer::MinimumLevel, level);
+  for (auto level : analyzer.peaks(0)) XCTAssertEqual(SpectrumAnalyzer::MinimumLevel, level);
+  XCTAssertEqual(0, analyzer.update());
+}
+
+- (void)testPushBeforeFormat {
+  SpectrumAnalyzer analyzer;
+  std::vector<AUValue> samples(MaxFrames, 0.5);
+  BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+  for (int block = 0; block < 40; ++block) analyzer.push(bus, MaxFrames);
+  XCTAssertEqual(0, analyzer.update());
+  analyzer.reset();
+
+  // Nothing pushed before the format is set is analyzed afterwards.
+  analyzer.setRenderingFormat(SampleRate, 1);
+  XCTAssertEqual(0, analyzer.update());
+}
+
+// One second of 8 channels at 192 kHz with 60 updates should take only a few percent of a second.
+- (void)testHannPerformance {
+  [self measureBlock:^{
+    measureAnalyzer(Window::hann, 2);
+  }];
+}
+
+- (void)testBlackmanHarrisPerformance {
+  [self measureBlock:^{
+    measureAnalyzer(Window::blackmanHarris, 4);
+  }];
+}
+
+@end
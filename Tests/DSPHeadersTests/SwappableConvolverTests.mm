@@ -0,0 +1,236 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <chrono>
+#import <cmath>
+#import <thread>
+#import <vector>
+
+#import "DSPHeaders/RealtimeSafety.hpp"
+#import "DSPHeaders/SwappableConvolver.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr AUAudioFrameCount MaxFrames = 256;
+
+/**
+ Make an IR with a smooth exponential decay (a one-pole lowpass).
+ */
+static std::vector<AUValue> makeDecay(size_t length, double rate) {
+  std::vector<AUValue> taps(length);
+  for (size_t index = 0; index < length; ++index) {
+    taps[index] = AUValue(std::exp(-double(index) * 1000.0 / rate) * 1000.0 / rate);
+  }
+  return taps;
+}
+
+/**
+ Render blocks of constant input until the convolver has installed `count` IRs. Gives up after a few seconds.
+ */
+static bool renderUntilInstalled(SwappableConvolver& convolver, size_t count, std::vector<AUValue>& samples,
+                                 AUValue level = 1.0) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (convolver.installedCount() < count) {
+    if (std::chrono::steady_clock::now() > deadline) return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::fill(samples.begin(), samples.end(), level);
+    BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+    convolver.process(bus, bus, AUAudioFrameCount(samples.size()));
+  }
+  return true;
+}
+
+@interface SwappableConvolverTests : XCTestCase
+
+@end
+
+@implementation SwappableConvolverTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testResample {
+  auto taps = makeDecay(4'410, 44'100.0);
+  double gain = 0.0;
+  for (auto tap : taps) gain += tap;
+
+  auto up = SwappableConvolver::resample(taps, 44'100.0, 88'200.0);
+  XCTAssertEqual(8'820, up.size());
+  double upGain = 0.0;
+  for (auto tap : up) upGain += tap;
+  XCTAssertEqualWithAccuracy(gain, upGain, 0.01 * gain);
+
+  auto down = SwappableConvolver::resample(taps, 44'100.0, 22'050.0);
+  XCTAssertEqual(2'205, down.size());
+  double downGain = 0.0;
+  for (auto tap : down) downGain += tap;
+  XCTAssertEqualWithAccuracy(gain, downGain, 0.01 * gain);
+
+  auto same = SwappableConvolver::resample(taps, 48'000.0, 48'000.0);
+  XCTAssertEqual(taps.size(), same.size());
+}
+
+- (void)testInvalidOptions {
+  SwappableConvolver::Options options;
+  options.partitioning.blockSize = 48;
+  XCTAssertThrows(SwappableConvolver{options});
+}
+
+- (void)testSilentUntilLoaded {
+  SwappableConvolver convolver;
+  convolver.setRenderingFormat(48'000.0, 1, MaxFrames);
+  std::vector<AUValue> samples(MaxFrames, 1.0);
+  BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+  convolver.process(bus, bus, MaxFrames);
+  for (auto sample : samples) XCTAssertEqual(0.0, sample);
+  XCTAssertEqual(0, convolver.installedCount());
+}
+
+- (void)testCrossfade {
+  SwappableConvolver::Options options;
+  options.crossfadeFrames = 1'000;
+  SwappableConvolver convolver{options};
+  convolver.setRenderingFormat(48'000.0, 1, MaxFrames);
+  std::vector<AUValue> samples(MaxFrames);
+
+  // The first IR fades in from silence.
+  convolver.load({{1.0}}, 48'000.0);
+  XCTAssertTrue(renderUntilInstalled(convolver, 1, samples));
+  XCTAssertTrue(convolver.isCrossfading());
+  XCTAssertEqualWithAccuracy(MaxFrames / 1'000.0, samples.back(), 0.01);
+
+  BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+  for (int block = 0; block < 4; ++block) {
+    std::fill(samples.begin(), samples.end(), 1.0f);
+    convolver.process(bus, bus, MaxFrames);
+  }
+  XCTAssertFalse(convolver.isCrossfading());
+  for (auto sample : samples) XCTAssertEqualWithAccuracy(1.0, sample, 1.0e-6);
+
+  // Swap to a quieter IR -- the output must move steadily from the old level to the new.
+  convolver.load({{0.25}}, 48'000.0);
+  XCTAssertTrue(renderUntilInstalled(convolver, 2, samples));
+  AUValue last = samples.back();
+  XCTAssertTrue(last < 1.0 && last > 0.25);
+  for (int block = 0; block < 4; ++block) {
+    std::fill(samples.begin(), samples.end(), 1.0f);
+    convolver.process(bus, bus, MaxFrames);
+    for (auto sample : samples) {
+      XCTAssertTrue(sample <= last + 1.0e-6);
+      last = sample;
+    }
+  }
+  XCTAssertFalse(convolver.isCrossfading());
+  XCTAssertEqualWithAccuracy(0.25, last, 1.0e-6);
+}
+
+- (void)testStereoFromMono {
+  SwappableConvolver::Options options;
+  options.crossfadeFrames = 0;
+  SwappableConvolver convolver{options};
+  convolver.setRenderingFormat(48'000.0, 2, MaxFrames);
+  convolver.load({{0.5}}, 48'000.0);
+
+  std::vector<AUValue> scratch(MaxFrames);
+  XCTAssertTrue(renderUntilInstalled(convolver, 1, scratch));
+
+  std::vector<AUValue> left(MaxFrames, 1.0);
+  std::vector<AUValue> right(MaxFrames, -1.0);
+  BusBuffers bus{std::vector<AUValue*>{left.data(), right.data()}};
+  convolver.process(bus, bus, MaxFrames);
+  XCTAssertEqualWithAccuracy(0.5, left[10], 1.0e-6);
+  XCTAssertEqualWithAccuracy(-0.5, right[10], 1.0e-6);
+}
+
+- (void)testExtraOutputsZeroed {
+  SwappableConvolver::Options options;
+  options.crossfadeFrames = 0;
+  SwappableConvolver convolver{options};
+  convolver.setRenderingFormat(48'000.0, 1, MaxFrames);
+  std::vector<AUValue> left(MaxFrames, 1.0);
+  std::vector<AUValue> right(MaxFrames, 1.0);
+  std::vector<AUValue> output(MaxFrames, 1.0);
+  BusBuffers ins{std::vector<AUValue*>{left.data(), right.data()}};
+  BusBuffers outs{std::vector<AUValue*>{output.data(), right.data()}};
+
+  // Nothing loaded yet
+  convolver.process(ins, outs, MaxFrames);
+  for (auto sample : right) XCTAssertEqual(0.0, sample);
+
+  convolver.load({{0.5}}, 48'000.0);
+  XCTAssertTrue(renderUntilInstalled(convolver, 1, output));
+  std::fill(left.begin(), left.end(), 1.0f);
+  std::fill(right.begin(), right.end(), 1.0f);
+  convolver.process(ins, outs, MaxFrames);
+  XCTAssertEqualWithAccuracy(0.5, output[10], 1.0e-6);
+  for (auto sample : right) XCTAssertEqual(0.0, sample);
+}
+
+- (void)testResampledOnLoad {
+  SwappableConvolver::Options options;
+  options.crossfadeFrames = 0;
+  SwappableConvolver convolver{options};
+  convolver.setRenderingFormat(48'000.0, 1, MaxFrames);
+
+  // A tap at 100 samples at 24 kHz should land near 200 samples at 48 kHz.
+  std::vector<AUValue> taps(400, 0.0);
+  taps[100] = 1.0;
+  convolver.load({taps}, 24'000.0);
+  std::vector<AUValue> samples(MaxFrames);
+  XCTAssertTrue(renderUntilInstalled(convolver, 1, samples, 0.0));
+
+  std::vector<AUValue> impulse(MaxFrames, 0.0);
+  impulse[0] = 1.0;
+  BusBuffers bus{std::vector<AUValue*>{impulse.data()}};
+  convolver.process(bus, bus, MaxFrames);
+  auto peak = std::max_element(impulse.begin(), impulse.end()) - impulse.begin();
+  XCTAssertEqual(200, peak);
+}
+
+- (void)testFormatChangeReloads {
+  SwappableConvolver convolver;
+  convolver.setRenderingFormat(44'100.0, 1, MaxFrames);
+  convolver.load({makeDecay(1'000, 44'100.0)}, 44'100.0);
+  std::vector<AUValue> samples(MaxFrames);
+  XCTAssertTrue(renderUntilInstalled(convolver, 1, samples));
+
+  convolver.setRenderingFormat(96'000.0, 2, MaxFrames);
+  XCTAssertTrue(renderUntilInstalled(convolver, 2, samples));
+}
+
+- (void)testRenderThreadIsSafe {
+  SwappableConvolver::Options options;
+  options.crossfadeFrames = 512;
+  SwappableConvolver convolver{options};
+  convolver.setRenderingFormat(48'000.0, 1, MaxFrames);
+  std::vector<AUValue> samples(MaxFrames);
+  BusBuffers bus{std::vector<AUValue*>{samples.data()}};
+
+  RealtimeSafety::resetCounts();
+  for (size_t count = 1; count <= 5; ++count) {
+    convolver.load({makeDecay(20'000, 48'000.0)}, 44'100.0);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (convolver.installedCount() < count && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      RealtimeSafety::Scope scope;
+      convolver.process(bus, bus, MaxFrames);
+    }
+    XCTAssertEqual(count, convolver.installedCount());
+  }
+  XCTAssertEqual(0, RealtimeSafety::totalCount());
+}
+
+- (void)testResamplePerformance {
+  auto taps = makeDecay(44'100, 44'100.0);
+  [self measureBlock:^{
+    auto result = SwappableConvolver::resample(taps, 44'100.0, 48'000.0);
+    XCTAssertEqual(48'000, result.size());
+  }];
+}
+
+@end
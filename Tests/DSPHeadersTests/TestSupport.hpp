@@ -0,0 +1,27 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#pragma once
+
+#import <cmath>
+#import <vector>
+
+#import <AudioToolbox/AudioToolbox.h>
+
+/**
+ Make a sine wave.
+
+ @param frequency the frequency of the sine in Hz
+ @param sampleRate the sample rate in Hz
+ @param count the number of samples to make
+ @param amplitude the peak value of the sine
+ @param phase the phase of the first sample in radians
+ @returns the samples
+ */
+inline std::vector<AUValue> makeSine(double frequency, double sampleRate, size_t count, double amplitude = 1.0,
+                                     double phase = 0.0) {
+  std::vector<AUValue> samples(count);
+  for (size_t index = 0; index < count; ++index) {
+    samples[index] = AUValue(amplitude * std::sin(2.0 * M_PI * frequency * double(index) / sampleRate + phase));
+  }
+  return samples;
+}
@@ -0,0 +1,207 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cmath>
+#import <vector>
+
+#import "DSPHeaders/TruePeakLimiter.hpp"
+
+using namespace DSPHeaders;
+
+static constexpr double SampleRate = 48'000.0;
+static constexpr AUAudioFrameCount MaxFrames = 512;
+
+/**
+ Make a sum of sines below 16 kHz whose level swells and fades every 4800 frames.
+ */
+static std::vector<AUValue> makeProgram(size_t count, double level) {
+  std::vector<AUValue> samples(count);
+  for (size_t index = 0; index < count; ++index) {
+    auto time = double(index) / SampleRate;
+    auto swell = 0.5 - 0.5 * std::cos(2.0 * M_PI * 5.0 * time);
+    auto value = 0.5 * std::sin(2.0 * M_PI * 110.0 * time) + 0.3 * std::sin(2.0 * M_PI * 3'137.0 * time + 1.0) +
+    0.2 * std::sin(2.0 * M_PI * 11'003.0 * time + 2.0) + 0.2 * std::sin(2.0 * M_PI * 15'511.0 * time);
+    samples[index] = AUValue(level * swell * value);
+  }
+  return samples;
+}
+
+/**
+ Process mono samples in place in blocks of MaxFrames.
+ */
+static void process(TruePeakLimiter& limiter, std::vector<AUValue>& samples) {
+  for (size_t frame = 0; frame < samples.size(); frame += MaxFrames) {
+    auto count = AUAudioFrameCount(std::min(size_t(MaxFrames), samples.size() - frame));
+    BusBuffers bus{std::vector<AUValue*>{samples.data() + frame}};
+    limiter.process(bus, bus, count);
+  }
+}
+
+/**
+ Obtain the true peak of a span of samples by 16x interpolation with a long windowed sinc, independently of the
+ limiter's own detection.
+ */
+static double measureTruePeak(const std::vector<AUValue>& samples, size_t begin, size_t end) {
+  constexpr int halfLength = 32;
+  double peak = 0.0;
+  for (size_t index = begin; index < end; ++index) {
+    for (int phase = 0; phase < 16; ++phase) {
+      auto position = double(index) + phase / 16.0;
+      double sum = 0.0;
+      for (int tap = -halfLength + 1; tap <= halfLength; ++tap) {
+        auto sample = ptrdiff_t(index) + tap;
+        if (sample < 0 || sample >= ptrdiff_t(samples.size())) continue;
+        auto offset = position - double(sample);
+        auto sinc = offset == 0.0 ? 1.0 : std::sin(M_PI * offset) / (M_PI * offset);
+        auto window = 0.5 + 0.5 * std::cos(M_PI * offset / (halfLength + 1));
+        sum += samples[size_t(sample)] * sinc * window;
+      }
+      peak = std::max(peak, std::abs(sum));
+    }
+  }
+  return peak;
+}
+
+static void measureLimiter(AUValue lookahead) {
+  TruePeakLimiter limiter{-1.0, 50.0};
+  limiter.setRenderingFormat(SampleRate, 2, MaxFrames, lookahead);
+  auto left = makeProgram(MaxFrames, 2.0);
+  auto right = makeProgram(MaxFrames, 1.5);
+  std::vector<AUValue> outLeft(MaxFrames);
+  std::vector<AUValue> outRight(MaxFrames);
+  BusBuffers ins{std::vector<AUValue*>{left.data(), right.data()}};
+  BusBuffers outs{std::vector<AUValue*>{outLeft.data(), outRight.data()}};
+  for (int block = 0; block < int(SampleRate) / int(MaxFrames); ++block) {
+    limiter.process(ins, outs, MaxFrames);
+  }
+}
+
+@interface TruePeakLimiterTests : XCTestCase
+
+@end
+
+@implementation TruePeakLimiterTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testLatency {
+  TruePeakLimiter limiter;
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames, 5.0);
+  XCTAssertEqual(246, limiter.latency());
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames, 0.0);
+  XCTAssertEqual(7, limiter.latency());
+}
+
+- (void)testQuietSignalIsDelayed {
+  TruePeakLimiter limiter{-1.0};
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames, 2.0);
+  auto input = makeProgram(4 * MaxFrames, 0.5);
+  auto samples = input;
+  process(limiter, samples);
+  auto latency = limiter.latency();
+  for (size_t index = 0; index < latency; ++index) XCTAssertEqual(0.0, samples[index]);
+  for (size_t index = latency; index < samples.size(); ++index) XCTAssertEqual(input[index - latency], samples[index]);
+  XCTAssertEqual(0.0, limiter.gainReduction());
+}
+
+- (void)testDetectsIntersamplePeaks {
+  // A quarter-rate sine at 45 degrees has samples at ±0.707 but peaks at 1.0 between them.
+  TruePeakLimiter limiter{-3.0};
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames);
+  std::vector<AUValue> samples(8 * MaxFrames);
+  for (size_t index = 0; index < samples.size(); ++index) {
+    samples[index] = AUValue(std::sin(M_PI * index / 2.0 + M_PI / 4.0));
+  }
+  process(limiter, samples);
+  const auto& peaks = limiter.truePeaks();
+  XCTAssertEqualWithAccuracy(1.0, *std::max_element(peaks.end() - 8, peaks.end()), 0.01);
+
+  // Sample peaks are below the threshold, so only the true peak makes the limiter work.
+  auto peak = measureTruePeak(samples, samples.size() - 100, samples.size() - 40);
+  XCTAssertEqualWithAccuracy(std::pow(10.0, -3.0 / 20.0), peak, 0.01);
+  XCTAssertEqualWithAccuracy(-3.0, limiter.gainReduction(), 0.1);
+}
+
+- (void)testNeverExceedsThreshold {
+  for (auto lookahead : {1.0f, 5.0f}) {
+    TruePeakLimiter limiter{-1.0, 50.0};
+    limiter.setRenderingFormat(SampleRate, 1, MaxFrames, lookahead);
+    auto samples = makeProgram(24'000, 4.0);
+    process(limiter, samples);
+    auto limit = std::pow(10.0, -1.0 / 20.0);
+    auto peak = measureTruePeak(samples, limiter.latency(), samples.size() - 32);
+    // 4x detection can miss a little of the peaks of the highest frequencies, so allow 0.1 dB.
+    XCTAssertLessThan(peak, limit * 1.012);
+    XCTAssertGreaterThan(peak, limit * 0.95);
+  }
+}
+
+- (void)testGainMovesAheadOfPeak {
+  // A step from silence to a loud level. The output must be quiet from its very first loud frame, with the gain
+  // ramping down over the lookahead before it. The step itself has true peaks above 1.0 that hold the gain down for a
+  // while.
+  TruePeakLimiter limiter{-6.0, 10.0};
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames, 2.0);
+  std::vector<AUValue> samples(8 * MaxFrames, 0.0);
+  std::fill(samples.begin() + 1'000, samples.end(), 1.0f);
+  process(limiter, samples);
+  auto start = 1'000 + limiter.latency();
+  for (size_t index = start; index < samples.size(); ++index) XCTAssertLessThan(samples[index], 0.5013);
+  XCTAssertEqualWithAccuracy(0.5012, samples.back(), 1.0e-3);
+}
+
+- (void)testReleaseRecovers {
+  TruePeakLimiter limiter{-6.0, 10.0};
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames, 1.0);
+  std::vector<AUValue> samples(24 * MaxFrames, 0.25);
+  std::fill(samples.begin(), samples.begin() + 1'000, 1.0f);
+  process(limiter, samples);
+  XCTAssertEqualWithAccuracy(0.0, limiter.gainReduction(), 1.0e-3);
+  XCTAssertEqualWithAccuracy(0.25, samples.back(), 1.0e-4);
+}
+
+- (void)testChannelsAreLinked {
+  TruePeakLimiter limiter{-6.0, 10.0};
+  limiter.setRenderingFormat(SampleRate, 2, MaxFrames, 1.0);
+  std::vector<AUValue> left(8 * MaxFrames, 1.0);
+  std::vector<AUValue> right(8 * MaxFrames, 0.1);
+  for (size_t frame = 0; frame < left.size(); frame += MaxFrames) {
+    BusBuffers bus{std::vector<AUValue*>{left.data() + frame, right.data() + frame}};
+    limiter.process(bus, bus, MaxFrames);
+  }
+  XCTAssertEqualWithAccuracy(0.5012, left.back(), 1.0e-3);
+  XCTAssertEqualWithAccuracy(0.05012, right.back(), 1.0e-4);
+}
+
+- (void)testReset {
+  TruePeakLimiter limiter{-6.0};
+  limiter.setRenderingFormat(SampleRate, 1, MaxFrames);
+  std::vector<AUValue> samples(MaxFrames, 1.0);
+  process(limiter, samples);
+  limiter.reset();
+  std::vector<AUValue> silence(MaxFrames, 0.0);
+  process(limiter, silence);
+  for (auto sample : silence) XCTAssertEqual(0.0, sample);
+  XCTAssertEqual(0.0, limiter.gainReduction());
+}
+
+// The cost per frame should not depend on the lookahead.
+- (void)testPerformanceShortLookahead {
+  [self measureBlock:^{
+    measureLimiter(0.5);
+  }];
+}
+
+- (void)testPerformanceLongLookahead {
+  [self measureBlock:^{
+    measureLimiter(50.0);
+  }];
+}
+
+@end
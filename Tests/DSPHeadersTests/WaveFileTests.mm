@@ -0,0 +1,184 @@
+// Copyright © 2022 Brad Howes. All rights reserved.
+
+#import <XCTest/XCTest.h>
+#import <cstdio>
+#import <filesystem>
+#import <fstream>
+#import <vector>
+
+#import "DSPHeaders/WaveFile.hpp"
+
+using namespace DSPHeaders;
+using namespace DSPHeaders::SampleConversion;
+
+static std::string tempPath(const char* name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+static std::vector<uint8_t> readBytes(const std::string& path) {
+  std::ifstream file{path, std::ios::binary};
+  return std::vector<uint8_t>{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+}
+
+static uint32_t read32(const std::vector<uint8_t>& bytes, size_t offset) {
+  return uint32_t(bytes[offset]) | uint32_t(bytes[offset + 1]) << 8 | uint32_t(bytes[offset + 2]) << 16 |
+  uint32_t(bytes[offset + 3]) << 24;
+}
+
+static uint16_t read16(const std::vector<uint8_t>& bytes, size_t offset) {
+  return uint16_t(bytes[offset] | bytes[offset + 1] << 8);
+}
+
+@interface WaveFileTests : XCTestCase
+
+@end
+
+@implementation WaveFileTests
+
+- (void)setUp {
+  // Put setup code here. This method is called before the invocation of each test method in the class.
+}
+
+- (void)tearDown {
+  // Put teardown code here. This method is called after the invocation of each test method in the class.
+}
+
+- (void)testInt16RoundTrip {
+  auto path = tempPath("WaveFileTests_int16.wav");
+  std::vector<int16_t> samples(200);
+  for (size_t index = 0; index < samples.size(); ++index) samples[index] = int16_t(index * 97 - 9000);
+  {
+    WaveFileWriter writer{path, 48000.0, 2, SampleType::int16};
+    writer.write(samples.data(), 60);
+    writer.write(samples.data() + 120, 40);
+    XCTAssertEqual(100, writer.frameCount());
+  }
+
+  WaveFileReader reader{path};
+  XCTAssertEqual(48000.0, reader.sampleRate());
+  XCTAssertEqual(2, reader.channelCount());
+  XCTAssertEqual(SampleType::int16, reader.sampleType());
+  XCTAssertEqual(100, reader.frameCount());
+  XCTAssertEqual(4, reader.bytesPerFrame());
+  auto data = static_cast<const int16_t*>(reader.frames(0));
+  for (size_t index = 0; index < samples.size(); ++index) {
+    XCTAssertEqual(samples[index], data[index]);
+  }
+  XCTAssertEqual(samples[20], *static_cast<const int16_t*>(reader.frames(10)));
+  std::remove(path.c_str());
+}
+
+- (void)testInt24RoundTrip {
+  auto path = tempPath("WaveFileTests_int24.wav");
+  std::vector<uint8_t> samples(3 * 32);
+  for (size_t index = 0; index < samples.size(); ++index) samples[index] = uint8_t(index * 7);
+  {
+    WaveFileWriter writer{path, 44100.0, 1, SampleType::int24};
+    writer.write(samples.data(), 32);
+    writer.close();
+    XCTAssertEqual(32, writer.frameCount());
+  }
+
+  WaveFileReader reader{path};
+  XCTAssertEqual(1, reader.channelCount());
+  XCTAssertEqual(SampleType::int24, reader.sampleType());
+  XCTAssertEqual(32, reader.frameCount());
+  auto data = static_cast<const uint8_t*>(reader.frames(0));
+  for (size_t index = 0; index < samples.size(); ++index) {
+    XCTAssertEqual(samples[index], data[index]);
+  }
+  std::remove(path.c_str());
+}
+
+- (void)testFloatRoundTrip {
+  auto path = tempPath("WaveFileTests_float.wav");
+  std::vector<float> samples(6 * 10);
+  for (size_t index = 0; index < samples.size(); ++index) samples[index] = float(index) / 64.0f - 0.5f;
+  {
+    WaveFileWriter writer{path, 96000.0, 6, SampleType::float32};
+    writer.write(samples.data(), 10);
+  }
+
+  WaveFileReader reader{path};
+  XCTAssertEqual(96000.0, reader.sampleRate());
+  XCTAssertEqual(6, reader.channelCount());
+  XCTAssertEqual(SampleType::float32, reader.sampleType());
+  XCTAssertEqual(10, reader.frameCount());
+  auto data = static_cast<const float*>(reader.frames(0));
+  for (size_t index = 0; index < samples.size(); ++index) {
+    XCTAssertEqual(samples[index], data[index]);
+  }
+  std::remove(path.c_str());
+}
+
+- (void)testInvalidFiles {
+  XCTAssertThrows(WaveFileReader{tempPath("WaveFileTests_missing.wav")});
+
+  auto path = tempPath("WaveFileTests_invalid.wav");
+  {
+    std::ofstream file{path, std::ios::binary};
+    file << "RIFF1234AIFFjunkjunkjunk";
+  }
+  XCTAssertThrows(WaveFileReader{path});
+  std::remove(path.c_str());
+}
+
+- (void)testPlainHeader {
+  auto path = tempPath("WaveFileTests_plain.wav");
+  std::vector<int16_t> samples(8);
+  {
+    WaveFileWriter writer{path, 44100.0, 2, SampleType::int16};
+    writer.write(samples.data(), 4);
+  }
+
+  auto bytes = readBytes(path);
+  XCTAssertEqual(44 + 16, bytes.size());
+  XCTAssertEqual(16, read32(bytes, 16));
+  XCTAssertEqual(1, read16(bytes, 20));
+  XCTAssertEqual(0, memcmp(bytes.data() + 36, "data", 4));
+  XCTAssertEqual(16, read32(bytes, 40));
+  std::remove(path.c_str());
+}
+
+- (void)testExtensibleHeader {
+  auto path = tempPath("WaveFileTests_extensible.wav");
+  std::vector<float> samples(6 * 4);
+  {
+    WaveFileWriter writer{path, 48000.0, 6, SampleType::float32};
+    writer.write(samples.data(), 4);
+  }
+
+  auto bytes = readBytes(path);
+  XCTAssertEqual(68 + 96, bytes.size());
+  XCTAssertEqual(68 - 8 + 96, read32(bytes, 4));
+  XCTAssertEqual(40, read32(bytes, 16));
+  XCTAssertEqual(0xFFFE, read16(bytes, 20));
+  XCTAssertEqual(6, read16(bytes, 22));
+  XCTAssertEqual(32, read16(bytes, 34));
+  XCTAssertEqual(22, read16(bytes, 36));
+  XCTAssertEqual(32, read16(bytes, 38));
+  XCTAssertEqual(0x3F, read32(bytes, 40));
+  const uint8_t floatGUID[16] = {0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+                                 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+  XCTAssertEqual(0, memcmp(bytes.data() + 44, floatGUID, 16));
+  XCTAssertEqual(0, memcmp(bytes.data() + 60, "data", 4));
+  XCTAssertEqual(96, read32(bytes, 64));
+  std::remove(path.c_str());
+
+  path = tempPath("WaveFileTests_extensible24.wav");
+  {
+    WaveFileWriter writer{path, 48000.0, 1, SampleType::int24};
+  }
+  bytes = readBytes(path);
+  XCTAssertEqual(0xFFFE, read16(bytes, 20));
+  XCTAssertEqual(24, read16(bytes, 38));
+  XCTAssertEqual(0x4, read32(bytes, 40));
+  XCTAssertEqual(1, read16(bytes, 44));
+
+  WaveFileReader reader{path};
+  XCTAssertEqual(SampleType::int24, reader.sampleType());
+  XCTAssertEqual(0, reader.frameCount());
+  std::remove(path.c_str());
+}
+
+@end